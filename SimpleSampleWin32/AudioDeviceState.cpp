@@ -0,0 +1,72 @@
+//
+// AudioDeviceState.cpp
+//
+
+#include "pch.h"
+#include "AudioDeviceState.h"
+
+using namespace DX;
+
+AudioDeviceStateMachine::AudioDeviceStateMachine(IAudioDevice& device, float retryDelaySeconds) noexcept :
+    m_device(device),
+    m_retryDelay(retryDelaySeconds),
+    m_retryTimer(0.f),
+    m_retryPending(false),
+    m_state(device.IsAudioDevicePresent() && !device.IsCriticalError() ? Active : Silent),
+    m_resets(0),
+    m_failedResets(0)
+{
+}
+
+bool AudioDeviceStateMachine::Tick(float elapsedSeconds)
+{
+    if (m_retryPending)
+    {
+        m_retryTimer -= elapsedSeconds;
+        if (m_retryTimer > 0.f)
+            return false;
+
+        m_retryPending = false;
+
+        // Observers see Resetting for as long as the engine is being recreated.
+        m_state.store(Resetting, std::memory_order_release);
+
+        if (m_device.Reset() && m_device.IsAudioDevicePresent())
+        {
+            ++m_resets;
+            m_state.store(Active, std::memory_order_release);
+            return true;
+        }
+
+        // Stay silent until the system reports another device change.
+        ++m_failedResets;
+        m_state.store(Silent, std::memory_order_release);
+        return false;
+    }
+
+    if (GetState() == Active)
+    {
+        if (!m_device.Update() && m_device.IsCriticalError())
+        {
+            m_state.store(Silent, std::memory_order_release);
+            ScheduleRetry();
+        }
+    }
+
+    return false;
+}
+
+void AudioDeviceStateMachine::NotifyDeviceChange()
+{
+    if (GetState() != Active || !m_device.IsAudioDevicePresent())
+    {
+        ScheduleRetry();
+    }
+}
+
+void AudioDeviceStateMachine::ScheduleRetry()
+{
+    // A later notification restarts the delay, so a burst of device events causes one reset.
+    m_retryPending = true;
+    m_retryTimer = m_retryDelay;
+}
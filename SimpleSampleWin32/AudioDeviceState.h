@@ -0,0 +1,69 @@
+//
+// AudioDeviceState.h - Audio device loss and recovery state machine
+//
+
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+namespace DX
+{
+    // The subset of AudioEngine that device recovery depends on, so the state machine can be
+    // driven by a simulated device as well as the real engine.
+    class IAudioDevice
+    {
+    public:
+        virtual ~IAudioDevice() = default;
+
+        // Same contract as AudioEngine: Update returns false when the engine is silent, and
+        // IsCriticalError distinguishes a lost device from one that was never present.
+        virtual bool Update() = 0;
+        virtual bool Reset() = 0;
+        virtual bool IsAudioDevicePresent() const = 0;
+        virtual bool IsCriticalError() const = 0;
+    };
+
+    // Tracks whether audio is active, being reset, or silent, and schedules a reset after the
+    // device is lost or a new device arrives. All methods except GetState must be called from
+    // one thread (the thread that owns the engine); GetState may be read from any thread.
+    class AudioDeviceStateMachine
+    {
+    public:
+        enum State
+        {
+            Active,
+            Resetting,
+            Silent,
+        };
+
+        explicit AudioDeviceStateMachine(IAudioDevice& device, float retryDelaySeconds = 1.f) noexcept;
+
+        AudioDeviceStateMachine(AudioDeviceStateMachine const&) = delete;
+        AudioDeviceStateMachine& operator= (AudioDeviceStateMachine const&) = delete;
+
+        // Updates the device and performs any reset that has come due. Returns true if a reset
+        // succeeded during this call, in which case looping sounds should be restarted.
+        bool Tick(float elapsedSeconds);
+
+        // Call when the system reports an audio device arriving or being removed.
+        void NotifyDeviceChange();
+
+        State GetState() const { return m_state.load(std::memory_order_acquire); }
+        bool IsRetryPending() const { return m_retryPending; }
+
+        uint32_t GetResetCount() const { return m_resets; }
+        uint32_t GetFailedResetCount() const { return m_failedResets; }
+
+    private:
+        void ScheduleRetry();
+
+        IAudioDevice&       m_device;
+        float               m_retryDelay;
+        float               m_retryTimer;
+        bool                m_retryPending;
+        std::atomic<State>  m_state;
+        uint32_t            m_resets;
+        uint32_t            m_failedResets;
+    };
+}
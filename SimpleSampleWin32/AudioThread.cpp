@@ -0,0 +1,244 @@
+//
+// AudioThread.cpp
+//
+
+#include "pch.h"
+#include "AudioThread.h"
+
+#ifdef DXTK_AUDIO
+
+using namespace DirectX;
+using namespace DX;
+
+// Adapts the real engine to the interface the device state machine drives.
+class AudioThread::EngineDevice : public IAudioDevice
+{
+public:
+    explicit EngineDevice(AudioEngine* engine) noexcept : m_engine(engine) {}
+
+    bool Update() override { return m_engine->Update(); }
+    bool Reset() override { return m_engine->Reset(); }
+    bool IsAudioDevicePresent() const override { return m_engine->IsAudioDevicePresent(); }
+    bool IsCriticalError() const override { return m_engine->IsCriticalError(); }
+
+private:
+    AudioEngine* m_engine;
+};
+
+AudioThread::AudioThread(AudioEngine* engine) noexcept(false) :
+    m_engine(engine),
+    m_exit(false),
+    m_devicePresent(false),
+    m_criticalError(false),
+    m_commandsProcessed(0),
+    m_engineUpdates(0),
+    m_maxLatency(0),
+    m_queueFullStalls(0)
+{
+    if (!engine)
+        throw std::invalid_argument("AudioThread requires an AudioEngine");
+
+    m_device = std::make_unique<EngineDevice>(engine);
+    m_deviceState = std::make_unique<AudioDeviceStateMachine>(*m_device);
+
+    m_devicePresent = engine->IsAudioDevicePresent();
+    m_criticalError = engine->IsCriticalError();
+
+    m_thread = std::thread(&AudioThread::ThreadProc, this);
+}
+
+AudioThread::~AudioThread()
+{
+    Shutdown();
+}
+
+void AudioThread::Play(SoundEffectInstance* instance, bool loop)
+{
+    Enqueue(PlayInstance, instance, loop ? 1u : 0u);
+}
+
+void AudioThread::Play(DynamicSoundEffectInstance* instance)
+{
+    Enqueue(PlayDynamicInstance, instance, 0);
+}
+
+void AudioThread::Play(WaveBank* waveBank, unsigned int index)
+{
+    Enqueue(PlayWaveBank, waveBank, index);
+}
+
+void AudioThread::Stop(SoundEffectInstance* instance, bool immediate)
+{
+    Enqueue(StopInstance, instance, immediate ? 1u : 0u);
+}
+
+void AudioThread::SetOutput(SoundEffectInstance* instance, const VoiceOutput& output)
+{
+    Enqueue(SetInstanceOutput, instance, 0, output);
+}
+
+void AudioThread::RestartOnReset(SoundEffectInstance* instance)
+{
+    Enqueue(RegisterRestart, instance, 0);
+}
+
+void AudioThread::NotifyDeviceChange()
+{
+    Enqueue(DeviceChange, nullptr, 0);
+}
+
+void AudioThread::Suspend()
+{
+    Enqueue(SuspendEngine, nullptr, 0);
+}
+
+void AudioThread::Resume()
+{
+    Enqueue(ResumeEngine, nullptr, 0);
+}
+
+void AudioThread::Shutdown()
+{
+    if (m_thread.joinable())
+    {
+        m_exit = true;
+        m_thread.join();
+    }
+}
+
+AudioThread::Statistics AudioThread::GetStatistics() const
+{
+    Statistics stats = {};
+    stats.commandsProcessed = m_commandsProcessed.load(std::memory_order_relaxed);
+    stats.engineUpdates = m_engineUpdates.load(std::memory_order_relaxed);
+    stats.queueFullStalls = m_queueFullStalls;
+    stats.maxLatencyMicroseconds = m_maxLatency.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void AudioThread::Enqueue(CommandType type, void* target, unsigned int arg, const VoiceOutput& output)
+{
+    Command command = { type, target, arg, output, std::chrono::steady_clock::now() };
+
+    if (!m_thread.joinable())
+    {
+        // Not running (or shut down), so the engine is ours to call directly.
+        Execute(command);
+        return;
+    }
+
+    if (!m_commands.TryPush(command))
+    {
+        // The ring is sized so this should never happen in practice; back off rather than drop.
+        ++m_queueFullStalls;
+        do
+        {
+            std::this_thread::yield();
+        } while (!m_commands.TryPush(command));
+    }
+}
+
+void AudioThread::Execute(const Command& command)
+{
+    switch (command.type)
+    {
+    case PlayInstance:
+        static_cast<SoundEffectInstance*>(command.target)->Play(command.arg != 0);
+        break;
+
+    case PlayDynamicInstance:
+        static_cast<DynamicSoundEffectInstance*>(command.target)->Play();
+        break;
+
+    case PlayWaveBank:
+        static_cast<WaveBank*>(command.target)->Play(command.arg);
+        break;
+
+    case StopInstance:
+        static_cast<SoundEffectInstance*>(command.target)->Stop(command.arg != 0);
+        break;
+
+    case SetInstanceOutput:
+        {
+            auto instance = static_cast<SoundEffectInstance*>(command.target);
+            instance->SetVolume(command.output.volume);
+            instance->SetPitch(command.output.pitch);
+            instance->SetPan(command.output.pan);
+        }
+        break;
+
+    case RegisterRestart:
+        m_restartOnReset.push_back(static_cast<SoundEffectInstance*>(command.target));
+        break;
+
+    case DeviceChange:
+        m_deviceState->NotifyDeviceChange();
+        break;
+
+    case SuspendEngine:
+        m_engine->Suspend();
+        break;
+
+    case ResumeEngine:
+        m_engine->Resume();
+        break;
+    }
+
+    m_devicePresent.store(m_engine->IsAudioDevicePresent(), std::memory_order_relaxed);
+    m_criticalError.store(m_engine->IsCriticalError(), std::memory_order_relaxed);
+}
+
+void AudioThread::ThreadProc()
+{
+    using namespace std::chrono;
+
+    auto lastUpdate = steady_clock::now();
+    auto nextUpdate = lastUpdate;
+
+    for (;;)
+    {
+        // Read the flag first so commands enqueued before Shutdown are still applied.
+        bool exiting = m_exit.load();
+
+        Command command;
+        while (m_commands.TryPop(command))
+        {
+            auto latency = duration_cast<microseconds>(steady_clock::now() - command.enqueued).count();
+            if (static_cast<uint32_t>(latency) > m_maxLatency.load(std::memory_order_relaxed))
+            {
+                m_maxLatency.store(static_cast<uint32_t>(latency), std::memory_order_relaxed);
+            }
+
+            Execute(command);
+            m_commandsProcessed.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        if (exiting)
+            break;
+
+        auto now = steady_clock::now();
+        if (now >= nextUpdate)
+        {
+            // Updates the engine, or resets it if a retry has come due.
+            float elapsed = duration<float>(now - lastUpdate).count();
+            if (m_deviceState->Tick(elapsed))
+            {
+                for (auto instance : m_restartOnReset)
+                {
+                    instance->Play(true);
+                }
+            }
+            lastUpdate = now;
+
+            m_devicePresent.store(m_engine->IsAudioDevicePresent(), std::memory_order_relaxed);
+            m_criticalError.store(m_engine->IsCriticalError(), std::memory_order_relaxed);
+            m_engineUpdates.fetch_add(1, std::memory_order_relaxed);
+
+            nextUpdate = now + milliseconds(UpdatePeriodMilliseconds);
+        }
+
+        std::this_thread::sleep_until(nextUpdate);
+    }
+}
+
+#endif
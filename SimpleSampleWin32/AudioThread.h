@@ -0,0 +1,129 @@
+//
+// AudioThread.h - Runs DirectXTK for Audio on its own thread behind a command queue
+//
+
+#pragma once
+
+#ifdef DXTK_AUDIO
+
+#include "AudioDeviceState.h"
+#include "SpscQueue.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace DX
+{
+    // Takes AudioEngine::Update and all voice operations off the game thread. The game thread
+    // enqueues commands without locking; the audio thread applies them and updates the engine
+    // on a fixed period. Once started, only the audio thread may call into the engine or the
+    // voices used with it.
+    //
+    // Device loss and recovery also happen here: the audio thread runs an
+    // AudioDeviceStateMachine, so a slow engine reset never stalls the frame.
+    class AudioThread
+    {
+    public:
+        struct Statistics
+        {
+            uint64_t    commandsProcessed;
+            uint64_t    engineUpdates;
+            uint32_t    queueFullStalls;        // Enqueues that had to wait for space
+            uint32_t    maxLatencyMicroseconds; // Longest time a command sat in the queue
+        };
+
+        // Gain, pitch shift in octaves and pan, applied with SetVolume, SetPitch and SetPan.
+        struct VoiceOutput
+        {
+            float   volume;
+            float   pitch;
+            float   pan;
+        };
+
+        // The audio thread updates the engine at least this often.
+        static const uint32_t UpdatePeriodMilliseconds = 5;
+
+        explicit AudioThread(DirectX::AudioEngine* engine) noexcept(false);
+        ~AudioThread();
+
+        AudioThread(AudioThread const&) = delete;
+        AudioThread& operator= (AudioThread const&) = delete;
+
+        // Commands, called from the game thread only.
+        void Play(DirectX::SoundEffectInstance* instance, bool loop = false);
+        void Play(DirectX::DynamicSoundEffectInstance* instance);
+        void Play(DirectX::WaveBank* waveBank, unsigned int index);
+        void Stop(DirectX::SoundEffectInstance* instance, bool immediate = true);
+        void SetOutput(DirectX::SoundEffectInstance* instance, const VoiceOutput& output);
+
+        // Registers a sound to be restarted as a looping sound whenever the engine is reset.
+        void RestartOnReset(DirectX::SoundEffectInstance* instance);
+
+        // Call when the system reports an audio device arriving or being removed.
+        void NotifyDeviceChange();
+
+        void Suspend();
+        void Resume();
+
+        AudioDeviceStateMachine::State GetDeviceState() const { return m_deviceState->GetState(); }
+        bool IsAudioDevicePresent() const { return m_devicePresent.load(std::memory_order_relaxed); }
+        bool IsCriticalError() const { return m_criticalError.load(std::memory_order_relaxed); }
+
+        // Applies outstanding commands and stops the thread; the engine may then be used directly.
+        void Shutdown();
+
+        Statistics GetStatistics() const;
+
+    private:
+        enum CommandType
+        {
+            PlayInstance,
+            PlayDynamicInstance,
+            PlayWaveBank,
+            StopInstance,
+            SetInstanceOutput,
+            RegisterRestart,
+            DeviceChange,
+            SuspendEngine,
+            ResumeEngine,
+        };
+
+        struct Command
+        {
+            CommandType                             type;
+            void*                                   target;
+            unsigned int                            arg;
+            VoiceOutput                             output;
+            std::chrono::steady_clock::time_point   enqueued;
+        };
+
+        void Enqueue(CommandType type, void* target, unsigned int arg, const VoiceOutput& output = VoiceOutput());
+        void Execute(const Command& command);
+        void ThreadProc();
+
+        class EngineDevice;
+
+        DirectX::AudioEngine*                           m_engine;
+        std::unique_ptr<EngineDevice>                   m_device;
+        std::unique_ptr<AudioDeviceStateMachine>        m_deviceState;
+        std::vector<DirectX::SoundEffectInstance*>      m_restartOnReset;   // Audio thread only
+        SpscQueue<Command, 256>     m_commands;
+
+        std::atomic<bool>           m_exit;
+        std::atomic<bool>           m_devicePresent;
+        std::atomic<bool>           m_criticalError;
+
+        // Written by the audio thread, read as a snapshot.
+        std::atomic<uint64_t>       m_commandsProcessed;
+        std::atomic<uint64_t>       m_engineUpdates;
+        std::atomic<uint32_t>       m_maxLatency;
+        uint32_t                    m_queueFullStalls;  // Game thread only
+
+        std::thread                 m_thread;
+    };
+}
+
+#endif
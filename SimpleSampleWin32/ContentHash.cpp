@@ -0,0 +1,177 @@
+//
+// ContentHash.cpp
+//
+
+#include "pch.h"
+#include "ContentHash.h"
+
+#include <string.h>
+
+using namespace DX;
+
+namespace
+{
+    const size_t c_stripeBytes = 64;
+
+    const uint64_t c_prime1 = 0x9E3779B185EBCA87ull;
+    const uint64_t c_prime2 = 0xC2B2AE3D27D4EB4Full;
+
+    // Per-word keys for the first stripe and how much each advances per stripe; the steps are
+    // odd so the keys do not repeat for 2^32 stripes.
+    const uint32_t c_keys[16] =
+    {
+        0x7C01812Cu, 0xF721AD1Cu, 0xDED46DE9u, 0x839097DBu,
+        0x7240A4A4u, 0xB7B3671Fu, 0xCB79E64Eu, 0xCCC0E578u,
+        0x825AD07Du, 0xCCFF7221u, 0xB8084674u, 0xF743248Eu,
+        0xE03590E6u, 0x813A264Cu, 0x3C2852BBu, 0x91C300CBu,
+    };
+
+    const uint32_t c_keySteps[16] =
+    {
+        0x85EBCA6Bu, 0xC2B2AE35u, 0x27D4EB2Fu, 0x165667B1u,
+        0x9E3779B1u, 0x61C88647u, 0x2545F491u, 0x4F6CDD1Du,
+        0xD6E8FEB9u, 0xA0761D65u, 0xE7037ED1u, 0x8EBC6AF1u,
+        0x589965CDu, 0x1D8E4E27u, 0xEB44ACCBu, 0x7A646E4Du,
+    };
+
+    inline uint64_t Mix(uint64_t h)
+    {
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDull;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ull;
+        h ^= h >> 33;
+        return h;
+    }
+
+    inline void InitAccumulators(uint64_t acc[8], uint64_t seed)
+    {
+        for (unsigned int i = 0; i < 8; ++i)
+        {
+            acc[i] = seed + c_prime1 * (i + 1);
+        }
+    }
+
+    uint64_t Finish(const uint64_t acc[8], size_t size, uint64_t seed)
+    {
+        uint64_t h = seed ^ (uint64_t(size) * c_prime1);
+        for (unsigned int i = 0; i < 8; ++i)
+        {
+            h = (h ^ Mix(acc[i])) * c_prime2;
+            h = (h << 27) | (h >> 37);
+        }
+        return Mix(h);
+    }
+
+    // One 64-byte stripe. Each 16 bytes, as words w0..w3, feed two accumulators:
+    // acc[0] += (w0 ^ k0) * (w1 ^ k1) + (w2 | w3 << 32), acc[1] += (w2 ^ k2) * (w3 ^ k3) + (w0 | w1 << 32).
+    inline void AccumulateScalar(uint64_t acc[8], const uint8_t* stripe, uint64_t stripeIndex)
+    {
+        uint32_t words[16];
+        memcpy(words, stripe, sizeof(words));
+
+        for (unsigned int i = 0; i < 16; i += 4)
+        {
+            uint32_t k[4];
+            for (unsigned int j = 0; j < 4; ++j)
+            {
+                k[j] = words[i + j] ^ uint32_t(c_keys[i + j] + uint32_t(stripeIndex) * c_keySteps[i + j]);
+            }
+
+            acc[i / 2] += uint64_t(k[0]) * k[1] + (uint64_t(words[i + 3]) << 32 | words[i + 2]);
+            acc[i / 2 + 1] += uint64_t(k[2]) * k[3] + (uint64_t(words[i + 1]) << 32 | words[i]);
+        }
+    }
+
+    // The last partial stripe is zero-padded; the length, mixed in at the end, tells the
+    // padding apart from real zeros.
+    inline void AccumulateTail(uint64_t acc[8], const uint8_t* tail, size_t size, uint64_t stripeIndex)
+    {
+        uint8_t stripe[c_stripeBytes] = {};
+        memcpy(stripe, tail, size);
+        AccumulateScalar(acc, stripe, stripeIndex);
+    }
+}
+
+uint64_t DX::HashContentScalar(const void* data, size_t size, uint64_t seed)
+{
+    auto bytes = static_cast<const uint8_t*>(data);
+
+    uint64_t acc[8];
+    InitAccumulators(acc, seed);
+
+    size_t stripes = size / c_stripeBytes;
+    for (size_t s = 0; s < stripes; ++s)
+    {
+        AccumulateScalar(acc, bytes + s * c_stripeBytes, s);
+    }
+
+    size_t tail = size % c_stripeBytes;
+    if (tail)
+    {
+        AccumulateTail(acc, bytes + stripes * c_stripeBytes, tail, stripes);
+    }
+
+    return Finish(acc, size, seed);
+}
+
+#if defined(_XM_SSE_INTRINSICS_) && !defined(_XM_NO_INTRINSICS_)
+
+uint64_t DX::HashContent(const void* data, size_t size, uint64_t seed)
+{
+    auto bytes = static_cast<const uint8_t*>(data);
+
+    uint64_t initial[8];
+    InitAccumulators(initial, seed);
+
+    __m128i acc[4];
+    __m128i keys[4];
+    __m128i steps[4];
+    for (unsigned int i = 0; i < 4; ++i)
+    {
+        acc[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(initial + i * 2));
+        keys[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(c_keys + i * 4));
+        steps[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(c_keySteps + i * 4));
+    }
+
+    size_t stripes = size / c_stripeBytes;
+    for (size_t s = 0; s < stripes; ++s)
+    {
+        auto stripe = reinterpret_cast<const __m128i*>(bytes + s * c_stripeBytes);
+        for (unsigned int i = 0; i < 4; ++i)
+        {
+            __m128i words = _mm_loadu_si128(stripe + i);
+            __m128i k = _mm_xor_si128(words, keys[i]);
+
+            // Lanes: k0 * k1 and k2 * k3.
+            __m128i product = _mm_mul_epu32(k, _mm_shuffle_epi32(k, _MM_SHUFFLE(3, 3, 1, 1)));
+            __m128i swapped = _mm_shuffle_epi32(words, _MM_SHUFFLE(1, 0, 3, 2));
+
+            acc[i] = _mm_add_epi64(acc[i], _mm_add_epi64(product, swapped));
+            keys[i] = _mm_add_epi32(keys[i], steps[i]);
+        }
+    }
+
+    uint64_t result[8];
+    for (unsigned int i = 0; i < 4; ++i)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(result + i * 2), acc[i]);
+    }
+
+    size_t tail = size % c_stripeBytes;
+    if (tail)
+    {
+        AccumulateTail(result, bytes + stripes * c_stripeBytes, tail, stripes);
+    }
+
+    return Finish(result, size, seed);
+}
+
+#else
+
+uint64_t DX::HashContent(const void* data, size_t size, uint64_t seed)
+{
+    return HashContentScalar(data, size, seed);
+}
+
+#endif
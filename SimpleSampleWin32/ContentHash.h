@@ -0,0 +1,24 @@
+//
+// ContentHash.h - Fast 64-bit hash of a block of memory, for recognizing identical content
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace DX
+{
+    // Hashes 'size' bytes at 'data'. Meant for spotting files with the same contents, not for
+    // security: it is fast on large inputs, and any change to the bytes or their length gives
+    // an unrelated value.
+    //
+    // The bytes are consumed 64 at a time into eight independent 64-bit accumulators, each
+    // adding the product of two 32-bit words mixed with a key that changes with the position,
+    // so both the contents and their order matter. This maps onto SSE2 directly; other
+    // targets compute the same value with scalar code.
+    uint64_t HashContent(const void* data, size_t size, uint64_t seed = 0);
+
+    // The portable implementation, which always gives the same result as HashContent.
+    uint64_t HashContentScalar(const void* data, size_t size, uint64_t seed = 0);
+}
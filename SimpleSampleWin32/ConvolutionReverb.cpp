@@ -0,0 +1,178 @@
+//
+// ConvolutionReverb.cpp
+//
+
+#include "pch.h"
+#include "ConvolutionReverb.h"
+
+#include <cmath>
+#include <random>
+
+using namespace DirectX;
+using namespace DX;
+
+namespace
+{
+    inline bool IsPowerOfTwo(size_t n)
+    {
+        return n && !(n & (n - 1));
+    }
+
+    // accum += x * h over 'count' complex bins; count is a multiple of 4.
+    inline void MultiplyAccumulate(float* accumRe, float* accumIm,
+        const float* xRe, const float* xIm, const float* hRe, const float* hIm, size_t count)
+    {
+        for (size_t k = 0; k < count; k += 4)
+        {
+            XMVECTOR xr = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(xRe + k));
+            XMVECTOR xi = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(xIm + k));
+            XMVECTOR hr = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(hRe + k));
+            XMVECTOR hi = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(hIm + k));
+            XMVECTOR ar = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(accumRe + k));
+            XMVECTOR ai = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(accumIm + k));
+
+            ar = XMVectorNegativeMultiplySubtract(xi, hi, XMVectorMultiplyAdd(xr, hr, ar));
+            ai = XMVectorMultiplyAdd(xi, hr, XMVectorMultiplyAdd(xr, hi, ai));
+
+            XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(accumRe + k), ar);
+            XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(accumIm + k), ai);
+        }
+    }
+}
+
+ConvolutionReverb::ConvolutionReverb(const float* impulse, size_t length, size_t blockSize) noexcept(false) :
+    m_blockSize(blockSize),
+    m_partitions(0),
+    m_stride((blockSize + 4) & ~size_t(3)),
+    m_fft((blockSize < FFT::MinSize / 2 || !IsPowerOfTwo(blockSize)) ? 0 : blockSize * 2),
+    m_historyIndex(0),
+    m_fill(0)
+{
+    if (!impulse || !length)
+        throw std::invalid_argument("ConvolutionReverb: empty impulse response");
+
+    m_partitions = (length + blockSize - 1) / blockSize;
+
+    m_filterRe.assign(m_partitions * m_stride, 0.f);
+    m_filterIm.assign(m_partitions * m_stride, 0.f);
+    m_historyRe.assign(m_partitions * m_stride, 0.f);
+    m_historyIm.assign(m_partitions * m_stride, 0.f);
+    m_accumRe.assign(m_stride, 0.f);
+    m_accumIm.assign(m_stride, 0.f);
+    m_window.assign(blockSize * 2, 0.f);
+    m_result.assign(blockSize * 2, 0.f);
+    m_output.assign(blockSize, 0.f);
+
+    // Each partition is zero padded to the FFT size so the circular convolution of overlap-save
+    // only wraps into the half that is discarded.
+    std::vector<float> padded(blockSize * 2);
+    for (size_t p = 0; p < m_partitions; ++p)
+    {
+        size_t start = p * blockSize;
+        size_t count = std::min(blockSize, length - start);
+
+        std::fill(padded.begin(), padded.end(), 0.f);
+        std::copy(impulse + start, impulse + start + count, padded.begin());
+
+        m_fft.Forward(padded.data(), &m_filterRe[p * m_stride], &m_filterIm[p * m_stride]);
+    }
+}
+
+std::vector<float> ConvolutionReverb::CreateSyntheticImpulse(uint32_t sampleRate, float decaySeconds, uint32_t seed)
+{
+    size_t length = static_cast<size_t>(double(sampleRate) * decaySeconds);
+    if (!length)
+        throw std::invalid_argument("ConvolutionReverb: empty impulse response");
+
+    std::vector<float> impulse(length);
+
+    // -60 dB at decaySeconds: amplitude 10^-3 = e^(-6.9078).
+    const double rate = 6.907755 / (double(sampleRate) * decaySeconds);
+
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> noise(-1.f, 1.f);
+
+    double energy = 0.0;
+    for (size_t j = 0; j < length; ++j)
+    {
+        impulse[j] = noise(rng) * float(exp(-rate * double(j)));
+        energy += double(impulse[j]) * impulse[j];
+    }
+
+    // Normalize to unit energy so the wet level is independent of the decay time.
+    float scale = energy > 0.0 ? float(1.0 / sqrt(energy)) : 0.f;
+    for (auto& s : impulse)
+        s *= scale;
+
+    return impulse;
+}
+
+void ConvolutionReverb::Process(const float* input, float* output, size_t frames)
+{
+    while (frames > 0)
+    {
+        size_t count = std::min(frames, m_blockSize - m_fill);
+
+        // Copy in before out so processing in place works.
+        float* incoming = m_window.data() + m_blockSize + m_fill;
+        const float* outgoing = m_output.data() + m_fill;
+        for (size_t j = 0; j < count; ++j)
+        {
+            float s = input[j];
+            output[j] = outgoing[j];
+            incoming[j] = s;
+        }
+
+        input += count;
+        output += count;
+        frames -= count;
+        m_fill += count;
+
+        if (m_fill == m_blockSize)
+        {
+            ProcessBlock();
+            m_fill = 0;
+        }
+    }
+}
+
+void ConvolutionReverb::ProcessBlock()
+{
+    // The delay line is a ring; step back one slot for the newest spectrum.
+    m_historyIndex = (m_historyIndex == 0) ? m_partitions - 1 : m_historyIndex - 1;
+
+    float* newestRe = &m_historyRe[m_historyIndex * m_stride];
+    float* newestIm = &m_historyIm[m_historyIndex * m_stride];
+    m_fft.Forward(m_window.data(), newestRe, newestIm);
+
+    std::fill(m_accumRe.begin(), m_accumRe.end(), 0.f);
+    std::fill(m_accumIm.begin(), m_accumIm.end(), 0.f);
+
+    // Partition p meets the input spectrum from p blocks ago.
+    size_t slot = m_historyIndex;
+    for (size_t p = 0; p < m_partitions; ++p)
+    {
+        MultiplyAccumulate(m_accumRe.data(), m_accumIm.data(),
+            &m_historyRe[slot * m_stride], &m_historyIm[slot * m_stride],
+            &m_filterRe[p * m_stride], &m_filterIm[p * m_stride], m_stride);
+
+        if (++slot == m_partitions)
+            slot = 0;
+    }
+
+    m_fft.Inverse(m_accumRe.data(), m_accumIm.data(), m_result.data());
+    std::copy(m_result.begin() + ptrdiff_t(m_blockSize), m_result.end(), m_output.begin());
+
+    // Slide the input window by one block.
+    std::copy(m_window.begin() + ptrdiff_t(m_blockSize), m_window.end(), m_window.begin());
+}
+
+void ConvolutionReverb::Reset()
+{
+    std::fill(m_historyRe.begin(), m_historyRe.end(), 0.f);
+    std::fill(m_historyIm.begin(), m_historyIm.end(), 0.f);
+    std::fill(m_window.begin(), m_window.end(), 0.f);
+    std::fill(m_output.begin(), m_output.end(), 0.f);
+    m_historyIndex = 0;
+    m_fill = 0;
+}
@@ -0,0 +1,70 @@
+//
+// ConvolutionReverb.h - Uniformly partitioned FFT convolution for long impulse responses
+//
+
+#pragma once
+
+#include "FFT.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace DX
+{
+    // Convolves a mono signal with an impulse response of any length using uniformly partitioned
+    // overlap-save. The response is split into blockSize partitions whose spectra are kept; each
+    // new input block is transformed once into a frequency-domain delay line and multiplied
+    // against every partition. Cost per block is one forward FFT, one inverse FFT and a complex
+    // multiply-accumulate per partition, and latency is exactly one block.
+    class ConvolutionReverb
+    {
+    public:
+        static const size_t DefaultBlockSize = 256;
+
+        // blockSize must be a power of two of at least FFT::MinSize / 2.
+        ConvolutionReverb(const float* impulse, size_t length, size_t blockSize = DefaultBlockSize) noexcept(false);
+
+        ConvolutionReverb(ConvolutionReverb const&) = delete;
+        ConvolutionReverb& operator= (ConvolutionReverb const&) = delete;
+
+        // Exponentially decaying noise, for when no measured response is available. Decays by
+        // 60 dB over 'decaySeconds'.
+        static std::vector<float> CreateSyntheticImpulse(uint32_t sampleRate, float decaySeconds, uint32_t seed = 1);
+
+        // Any number of frames may be processed per call; output lags input by GetLatency().
+        // input and output may be the same buffer.
+        void Process(const float* input, float* output, size_t frames);
+
+        // Clears all signal history, leaving the impulse response in place.
+        void Reset();
+
+        size_t GetBlockSize() const { return m_blockSize; }
+        size_t GetLatency() const { return m_blockSize; }
+        size_t GetPartitionCount() const { return m_partitions; }
+
+    private:
+        void ProcessBlock();
+
+        size_t              m_blockSize;
+        size_t              m_partitions;
+        size_t              m_stride;           // Bins rounded up to a multiple of 4 for SIMD
+
+        FFT                 m_fft;
+
+        // Partition spectra and the input spectrum history, m_partitions * m_stride each.
+        std::vector<float>  m_filterRe;
+        std::vector<float>  m_filterIm;
+        std::vector<float>  m_historyRe;
+        std::vector<float>  m_historyIm;
+        size_t              m_historyIndex;     // Slot holding the most recent input spectrum
+
+        std::vector<float>  m_accumRe;
+        std::vector<float>  m_accumIm;
+
+        std::vector<float>  m_window;           // Last two input blocks, FFT input
+        std::vector<float>  m_result;           // FFT output; the second half is valid
+        std::vector<float>  m_output;           // Completed block being handed out
+        size_t              m_fill;             // Frames of the current input block received
+    };
+}
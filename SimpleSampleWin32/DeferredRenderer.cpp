@@ -0,0 +1,120 @@
+//
+// DeferredRenderer.cpp
+//
+
+#include "pch.h"
+#include "DeferredRenderer.h"
+#include "TaskPartition.h"
+
+#include <chrono>
+
+using namespace DX;
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+    // Weight kept from the previous cost estimate on each new timing.
+    const float c_costSmoothing = 0.9f;
+}
+
+DeferredRenderer::DeferredRenderer(WorkerPool* workers) noexcept(false) :
+    m_workers(workers),
+    m_workerCount(workers ? workers->GetWorkerCount() : 0u)
+{
+    m_bounds.resize(size_t(m_workerCount) + 1);
+}
+
+void DeferredRenderer::CreateDeviceDependentResources(ID3D11Device* device, ID3D11DeviceContext* immediateContext, size_t chunkCount)
+{
+    m_immediateContext = immediateContext;
+
+    m_chunks.resize(chunkCount);
+    m_costs.resize(chunkCount);
+
+    for (auto& chunk : m_chunks)
+    {
+        chunk.cost = 0.f;
+        if (IsDeferred())
+        {
+            // Command lists are emulated by the runtime when the driver does not support them.
+            DX::ThrowIfFailed(device->CreateDeferredContext(0, chunk.context.ReleaseAndGetAddressOf()));
+        }
+        else
+        {
+            chunk.context = immediateContext;
+        }
+    }
+}
+
+void DeferredRenderer::ReleaseDeviceDependentResources()
+{
+    m_chunks.clear();
+    m_costs.clear();
+    m_immediateContext.Reset();
+}
+
+ID3D11DeviceContext* DeferredRenderer::GetContext(size_t chunk) const
+{
+    return m_chunks[chunk].context.Get();
+}
+
+void DeferredRenderer::Render(const RecordFunction& record)
+{
+    if (!IsDeferred())
+    {
+        for (size_t chunk = 0; chunk < m_chunks.size(); ++chunk)
+        {
+            record(chunk, m_chunks[chunk].context.Get());
+        }
+        return;
+    }
+
+    for (size_t chunk = 0; chunk < m_chunks.size(); ++chunk)
+    {
+        m_costs[chunk] = m_chunks[chunk].cost;
+    }
+    PartitionByCost(m_costs.data(), m_costs.size(), m_workerCount, m_bounds.data());
+
+    try
+    {
+        m_workers->Run([this, &record](unsigned int worker)
+        {
+            RecordRange(record, worker);
+        });
+    }
+    catch (...)
+    {
+        // Drop whatever was recorded so the next frame starts clean. Finishing a context is the
+        // only way to discard commands it has already recorded.
+        for (auto& chunk : m_chunks)
+        {
+            ComPtr<ID3D11CommandList> discard;
+            (void)chunk.context->FinishCommandList(FALSE, discard.GetAddressOf());
+            chunk.commandList.Reset();
+        }
+        throw;
+    }
+
+    for (auto& chunk : m_chunks)
+    {
+        m_immediateContext->ExecuteCommandList(chunk.commandList.Get(), FALSE);
+        chunk.commandList.Reset();
+    }
+}
+
+void DeferredRenderer::RecordRange(const RecordFunction& record, size_t worker)
+{
+    for (size_t index = m_bounds[worker]; index < m_bounds[worker + 1]; ++index)
+    {
+        auto& chunk = m_chunks[index];
+
+        auto start = std::chrono::steady_clock::now();
+
+        record(index, chunk.context.Get());
+        DX::ThrowIfFailed(chunk.context->FinishCommandList(FALSE, chunk.commandList.ReleaseAndGetAddressOf()));
+
+        float elapsed = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        chunk.cost = (chunk.cost > 0.f) ? chunk.cost * c_costSmoothing + elapsed * (1.f - c_costSmoothing) : elapsed;
+    }
+}
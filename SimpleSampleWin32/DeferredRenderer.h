@@ -0,0 +1,71 @@
+//
+// DeferredRenderer.h - Records scene chunks on Direct3D 11 deferred contexts from worker threads
+//
+
+#pragma once
+
+#include "WorkerPool.h"
+
+#include <functional>
+#include <vector>
+
+namespace DX
+{
+    // Splits a frame into a fixed, ordered list of chunks. Each chunk has its own deferred
+    // context, so whatever it draws with (SpriteBatch, PrimitiveBatch, GeometricPrimitive,
+    // effects) is only ever touched by one thread at a time. Every frame the chunks are
+    // divided into contiguous runs balanced by their recent recording times, one run per
+    // worker, and the resulting command lists are executed on the immediate context in chunk
+    // order so the output matches drawing everything on one thread.
+    //
+    // Without a worker pool, every chunk is simply recorded on the immediate context.
+    class DeferredRenderer
+    {
+    public:
+        // Records one chunk. Called on a worker thread, or the render thread for the first run.
+        typedef std::function<void(size_t chunk, ID3D11DeviceContext* context)> RecordFunction;
+
+        // Records on the pool's workers, which must outlive the renderer and may be shared with
+        // other work that runs between frames. A pool of one records on a deferred context
+        // without extra threads; nullptr disables deferred contexts altogether.
+        explicit DeferredRenderer(WorkerPool* workers) noexcept(false);
+
+        DeferredRenderer(DeferredRenderer const&) = delete;
+        DeferredRenderer& operator= (DeferredRenderer const&) = delete;
+
+        void CreateDeviceDependentResources(ID3D11Device* device, ID3D11DeviceContext* immediateContext, size_t chunkCount);
+        void ReleaseDeviceDependentResources();
+
+        bool IsDeferred() const { return m_workerCount != 0; }
+        unsigned int GetWorkerCount() const { return m_workerCount; }
+        size_t GetChunkCount() const { return m_chunks.size(); }
+
+        // The context a chunk records into; create that chunk's DirectXTK objects against it.
+        ID3D11DeviceContext* GetContext(size_t chunk) const;
+
+        // Smoothed recording time of a chunk, in milliseconds.
+        float GetChunkCost(size_t chunk) const { return m_chunks[chunk].cost; }
+
+        // Records every chunk and executes them in order on the immediate context. Chunks start
+        // from default pipeline state and must set their own render targets and viewport.
+        // Exceptions thrown while recording are rethrown here once all workers have finished.
+        void Render(const RecordFunction& record);
+
+    private:
+        struct Chunk
+        {
+            Microsoft::WRL::ComPtr<ID3D11DeviceContext>     context;
+            Microsoft::WRL::ComPtr<ID3D11CommandList>       commandList;
+            float                                           cost;
+        };
+
+        void RecordRange(const RecordFunction& record, size_t worker);
+
+        WorkerPool*                                 m_workers;
+        unsigned int                                m_workerCount;
+        Microsoft::WRL::ComPtr<ID3D11DeviceContext> m_immediateContext;
+        std::vector<Chunk>                          m_chunks;
+        std::vector<float>                          m_costs;
+        std::vector<size_t>                         m_bounds;
+    };
+}
@@ -0,0 +1,51 @@
+//
+// DynamicBufferRing.h - A large per-frame dynamic vertex buffer shared by all dynamic geometry
+//
+
+#pragma once
+
+#include "RingAllocator.h"
+
+namespace DX
+{
+    // One persistent D3D11_USAGE_DYNAMIC buffer that dynamic geometry is appended to with
+    // D3D11_MAP_WRITE_NO_OVERWRITE, discarded once at the start of the frame's first map
+    // rather than once per batch. Every draw can bind the same buffer and select its data
+    // with the start vertex.
+    //
+    // Use from one context at a time. Each deferred context needs its own ring, because the
+    // first map of a command list must discard.
+    class DynamicBufferRing
+    {
+    public:
+        DynamicBufferRing(ID3D11Device* device, size_t capacity, UINT bindFlags = D3D11_BIND_VERTEX_BUFFER) noexcept(false);
+
+        DynamicBufferRing(DynamicBufferRing const&) = delete;
+        DynamicBufferRing& operator= (DynamicBufferRing const&) = delete;
+
+        // Call once per frame before the first Map.
+        void BeginFrame() { m_allocator.BeginFrame(); }
+
+        // Maps 'size' bytes at a multiple of 'alignment' and returns where to write them.
+        // Throws if the request is larger than the whole ring.
+        void* Map(ID3D11DeviceContext* context, size_t size, size_t alignment, size_t& offset);
+        void Unmap(ID3D11DeviceContext* context);
+
+        // Maps room for 'count' vertices; 'startVertex' is the value to pass to Draw.
+        template<typename T>
+        T* MapVertices(ID3D11DeviceContext* context, size_t count, UINT& startVertex)
+        {
+            size_t offset;
+            auto data = static_cast<T*>(Map(context, count * sizeof(T), sizeof(T), offset));
+            startVertex = static_cast<UINT>(offset / sizeof(T));
+            return data;
+        }
+
+        ID3D11Buffer* GetBuffer() const { return m_buffer.Get(); }
+        const RingAllocator::Statistics& GetStatistics() const { return m_allocator.GetStatistics(); }
+
+    private:
+        Microsoft::WRL::ComPtr<ID3D11Buffer>    m_buffer;
+        RingAllocator                           m_allocator;
+    };
+}
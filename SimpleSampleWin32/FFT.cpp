@@ -0,0 +1,303 @@
+//
+// FFT.cpp
+//
+
+#include "pch.h"
+#include "FFT.h"
+
+#include <cmath>
+
+using namespace DirectX;
+using namespace DX;
+
+namespace
+{
+    const double c_pi = 3.14159265358979323846;
+
+    inline bool IsPowerOfTwo(size_t n)
+    {
+        return n && !(n & (n - 1));
+    }
+
+    inline XMVECTOR XM_CALLCONV Load4(const float* ptr)
+    {
+        return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(ptr));
+    }
+
+    inline void XM_CALLCONV Store4(float* ptr, FXMVECTOR v)
+    {
+        XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(ptr), v);
+    }
+
+    // (ar + i ai) (br + i bi) for four complex values held as split real and imaginary vectors.
+    inline void XM_CALLCONV ComplexMultiply(FXMVECTOR ar, FXMVECTOR ai, FXMVECTOR br, GXMVECTOR bi, XMVECTOR& outR, XMVECTOR& outI)
+    {
+        outR = XMVectorNegativeMultiplySubtract(ai, bi, XMVectorMultiply(ar, br));
+        outI = XMVectorMultiplyAdd(ar, bi, XMVectorMultiply(ai, br));
+    }
+}
+
+FFT::FFT(size_t size) noexcept(false) :
+    m_size(size),
+    m_half(size / 2)
+{
+    if (size < MinSize || !IsPowerOfTwo(size))
+        throw std::invalid_argument("FFT size must be a power of two");
+
+    uint32_t bits = 0;
+    while ((size_t(1) << bits) < m_half)
+        ++bits;
+
+    m_bitReverse.resize(m_half);
+    for (size_t j = 0; j < m_half; ++j)
+    {
+        uint32_t r = 0;
+        for (uint32_t b = 0; b < bits; ++b)
+        {
+            if (j & (size_t(1) << b))
+                r |= 1u << (bits - 1 - b);
+        }
+        m_bitReverse[j] = r;
+    }
+
+    // An odd number of radix-2 stages starts with a plain radix-2 pass; every remaining pair
+    // of stages is fused into one radix-4 pass.
+    size_t span = 1;
+    if (bits & 1)
+    {
+        Pass pass = { span, 2, m_twiddleRe.size() };
+        m_passes.push_back(pass);
+        span = 2;
+    }
+
+    while (span < m_half)
+    {
+        Pass pass = { span, 4, m_twiddleRe.size() };
+        m_passes.push_back(pass);
+
+        // Each radix-4 pass needs W(4 span)^j and W(2 span)^j for j < span.
+        for (size_t j = 0; j < span; ++j)
+        {
+            double angle = -2.0 * c_pi * double(j) / double(4 * span);
+            m_twiddleRe.push_back(float(cos(angle)));
+            m_twiddleIm.push_back(float(sin(angle)));
+        }
+        for (size_t j = 0; j < span; ++j)
+        {
+            double angle = -2.0 * c_pi * double(j) / double(2 * span);
+            m_twiddleRe.push_back(float(cos(angle)));
+            m_twiddleIm.push_back(float(sin(angle)));
+        }
+
+        span *= 4;
+    }
+
+    m_unpackRe.resize(m_half + 1);
+    m_unpackIm.resize(m_half + 1);
+    for (size_t k = 0; k <= m_half; ++k)
+    {
+        double angle = -2.0 * c_pi * double(k) / double(m_size);
+        m_unpackRe[k] = float(cos(angle));
+        m_unpackIm[k] = float(sin(angle));
+    }
+
+    m_workRe.resize(m_half);
+    m_workIm.resize(m_half);
+}
+
+void FFT::Transform(float* re, float* im) const
+{
+    for (size_t j = 0; j < m_half; ++j)
+    {
+        size_t r = m_bitReverse[j];
+        if (r > j)
+        {
+            std::swap(re[j], re[r]);
+            std::swap(im[j], im[r]);
+        }
+    }
+
+    for (const auto& pass : m_passes)
+    {
+        const size_t h = pass.span;
+
+        if (pass.radix == 2)
+        {
+            // First stage: span 1, unit twiddles.
+            for (size_t k = 0; k < m_half; k += 2)
+            {
+                float ar = re[k], ai = im[k];
+                float br = re[k + 1], bi = im[k + 1];
+                re[k] = ar + br;
+                im[k] = ai + bi;
+                re[k + 1] = ar - br;
+                im[k + 1] = ai - bi;
+            }
+            continue;
+        }
+
+        const float* w1r = m_twiddleRe.data() + pass.twiddles;
+        const float* w1i = m_twiddleIm.data() + pass.twiddles;
+        const float* w2r = w1r + h;
+        const float* w2i = w1i + h;
+
+        if (h >= 4)
+        {
+            // Spans are powers of two, so from here on every group is a whole number of vectors
+            // of four butterflies.
+            for (size_t k = 0; k < m_half; k += 4 * h)
+            {
+                float* r0 = re + k;
+                float* i0 = im + k;
+                float* r1 = r0 + h;
+                float* i1 = i0 + h;
+                float* r2 = r1 + h;
+                float* i2 = i1 + h;
+                float* r3 = r2 + h;
+                float* i3 = i2 + h;
+
+                for (size_t j = 0; j < h; j += 4)
+                {
+                    XMVECTOR x0r = Load4(r0 + j), x0i = Load4(i0 + j);
+                    XMVECTOR x1r = Load4(r1 + j), x1i = Load4(i1 + j);
+                    XMVECTOR x2r = Load4(r2 + j), x2i = Load4(i2 + j);
+                    XMVECTOR x3r = Load4(r3 + j), x3i = Load4(i3 + j);
+                    XMVECTOR wr = Load4(w2r + j), wi = Load4(w2i + j);
+
+                    XMVECTOR tr, ti;
+                    ComplexMultiply(x1r, x1i, wr, wi, tr, ti);
+                    XMVECTOR a0r = XMVectorAdd(x0r, tr), a0i = XMVectorAdd(x0i, ti);
+                    XMVECTOR a1r = XMVectorSubtract(x0r, tr), a1i = XMVectorSubtract(x0i, ti);
+
+                    ComplexMultiply(x3r, x3i, wr, wi, tr, ti);
+                    XMVECTOR a2r = XMVectorAdd(x2r, tr), a2i = XMVectorAdd(x2i, ti);
+                    XMVECTOR a3r = XMVectorSubtract(x2r, tr), a3i = XMVectorSubtract(x2i, ti);
+
+                    wr = Load4(w1r + j);
+                    wi = Load4(w1i + j);
+
+                    XMVECTOR br, bi;
+                    ComplexMultiply(a2r, a2i, wr, wi, br, bi);
+
+                    // a3 -i W: the real and imaginary parts of a3 W, rotated by a quarter turn.
+                    XMVECTOR cr, ci;
+                    ComplexMultiply(a3r, a3i, wr, wi, ci, cr);
+                    ci = XMVectorNegate(ci);
+
+                    Store4(r0 + j, XMVectorAdd(a0r, br)); Store4(i0 + j, XMVectorAdd(a0i, bi));
+                    Store4(r2 + j, XMVectorSubtract(a0r, br)); Store4(i2 + j, XMVectorSubtract(a0i, bi));
+                    Store4(r1 + j, XMVectorAdd(a1r, cr)); Store4(i1 + j, XMVectorAdd(a1i, ci));
+                    Store4(r3 + j, XMVectorSubtract(a1r, cr)); Store4(i3 + j, XMVectorSubtract(a1i, ci));
+                }
+            }
+            continue;
+        }
+
+        // The first radix-4 pass has a span of 1 or 2, too short to fill a vector.
+        for (size_t k = 0; k < m_half; k += 4 * h)
+        {
+            float* r0 = re + k;
+            float* i0 = im + k;
+            float* r1 = r0 + h;
+            float* i1 = i0 + h;
+            float* r2 = r1 + h;
+            float* i2 = i1 + h;
+            float* r3 = r2 + h;
+            float* i3 = i2 + h;
+
+            for (size_t j = 0; j < h; ++j)
+            {
+                // Stage of span h: (x0, x1) and (x2, x3) with W(2h)^j.
+                float tr = r1[j] * w2r[j] - i1[j] * w2i[j];
+                float ti = r1[j] * w2i[j] + i1[j] * w2r[j];
+                float a0r = r0[j] + tr, a0i = i0[j] + ti;
+                float a1r = r0[j] - tr, a1i = i0[j] - ti;
+
+                tr = r3[j] * w2r[j] - i3[j] * w2i[j];
+                ti = r3[j] * w2i[j] + i3[j] * w2r[j];
+                float a2r = r2[j] + tr, a2i = i2[j] + ti;
+                float a3r = r2[j] - tr, a3i = i2[j] - ti;
+
+                // Stage of span 2h: (a0, a2) with W(4h)^j and (a1, a3) with W(4h)^(j+h) = -i W(4h)^j.
+                float br = a2r * w1r[j] - a2i * w1i[j];
+                float bi = a2r * w1i[j] + a2i * w1r[j];
+                float cr = a3r * w1i[j] + a3i * w1r[j];
+                float ci = a3i * w1i[j] - a3r * w1r[j];
+
+                r0[j] = a0r + br; i0[j] = a0i + bi;
+                r2[j] = a0r - br; i2[j] = a0i - bi;
+                r1[j] = a1r + cr; i1[j] = a1i + ci;
+                r3[j] = a1r - cr; i3[j] = a1i - ci;
+            }
+        }
+    }
+}
+
+void FFT::Forward(const float* input, float* real, float* imag)
+{
+    float* zr = m_workRe.data();
+    float* zi = m_workIm.data();
+
+    for (size_t n = 0; n < m_half; ++n)
+    {
+        zr[n] = input[2 * n];
+        zi[n] = input[2 * n + 1];
+    }
+
+    Transform(zr, zi);
+
+    // X[k] = E[k] + W^k O[k], where E and O are the spectra of the even and odd samples:
+    // E[k] = (Z[k] + conj(Z[h-k])) / 2 and O[k] = (Z[k] - conj(Z[h-k])) / 2i.
+    real[0] = zr[0] + zi[0];
+    imag[0] = 0.f;
+    real[m_half] = zr[0] - zi[0];
+    imag[m_half] = 0.f;
+
+    for (size_t k = 1; k < m_half; ++k)
+    {
+        float ar = zr[k], ai = zi[k];
+        float br = zr[m_half - k], bi = -zi[m_half - k];
+
+        float er = 0.5f * (ar + br);
+        float ei = 0.5f * (ai + bi);
+        float or_ = 0.5f * (ai - bi);
+        float oi = -0.5f * (ar - br);
+
+        real[k] = er + or_ * m_unpackRe[k] - oi * m_unpackIm[k];
+        imag[k] = ei + or_ * m_unpackIm[k] + oi * m_unpackRe[k];
+    }
+}
+
+void FFT::Inverse(const float* real, const float* imag, float* output)
+{
+    float* zr = m_workRe.data();
+    float* zi = m_workIm.data();
+
+    // Rebuild Z[k] = E[k] + i O[k] from the half spectrum, with O[k] = (X[k] - conj(X[h-k])) conj(W^k) / 2.
+    for (size_t k = 0; k < m_half; ++k)
+    {
+        float ar = real[k], ai = imag[k];
+        float br = real[m_half - k], bi = -imag[m_half - k];
+
+        float er = 0.5f * (ar + br);
+        float ei = 0.5f * (ai + bi);
+        float dr = 0.5f * (ar - br);
+        float di = 0.5f * (ai - bi);
+
+        float or_ = dr * m_unpackRe[k] + di * m_unpackIm[k];
+        float oi = di * m_unpackRe[k] - dr * m_unpackIm[k];
+
+        zr[k] = er - oi;
+        zi[k] = ei + or_;
+    }
+
+    // Inverse transform by exchanging the roles of the real and imaginary parts.
+    Transform(zi, zr);
+
+    const float scale = 1.f / float(m_half);
+    for (size_t n = 0; n < m_half; ++n)
+    {
+        output[2 * n] = zr[n] * scale;
+        output[2 * n + 1] = zi[n] * scale;
+    }
+}
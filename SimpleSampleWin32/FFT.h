@@ -0,0 +1,63 @@
+//
+// FFT.h - Real-input fast Fourier transform for audio processing
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace DX
+{
+    // Power-of-two real FFT. The real signal is packed into a complex sequence of half the
+    // length, which is transformed with fused radix-4 passes (plus one radix-2 pass when the
+    // size is an odd power of two) over split real/imaginary arrays, then unpacked.
+    // Twiddles are stored contiguously per pass, so once the span reaches four the radix-4
+    // butterflies are evaluated four at a time with DirectXMath.
+    class FFT
+    {
+    public:
+        static const size_t MinSize = 8;
+
+        // 'size' is the number of real samples and must be a power of two >= MinSize.
+        explicit FFT(size_t size) noexcept(false);
+
+        FFT(FFT const&) = delete;
+        FFT& operator= (FFT const&) = delete;
+
+        size_t GetSize() const { return m_size; }
+
+        // Number of spectrum bins, DC through Nyquist inclusive.
+        size_t GetBinCount() const { return m_half + 1; }
+
+        // Transforms 'size' real samples into GetBinCount() complex bins.
+        void Forward(const float* input, float* real, float* imag);
+
+        // Inverse of Forward, including the 1/size scale. The inputs are left unchanged.
+        void Inverse(const float* real, const float* imag, float* output);
+
+    private:
+        struct Pass
+        {
+            size_t  span;       // Distance between butterfly inputs
+            size_t  radix;      // 2 or 4
+            size_t  twiddles;   // Offset into the twiddle arrays
+        };
+
+        // In-place forward complex FFT of m_half points. Swapping the real and imaginary
+        // arrays turns it into an (unscaled) inverse transform.
+        void Transform(float* re, float* im) const;
+
+        size_t                  m_size;
+        size_t                  m_half;
+        std::vector<uint32_t>   m_bitReverse;
+        std::vector<Pass>       m_passes;
+        std::vector<float>      m_twiddleRe;
+        std::vector<float>      m_twiddleIm;
+        std::vector<float>      m_unpackRe;     // e^(-2 pi i k / size) for the real-signal split
+        std::vector<float>      m_unpackIm;
+        std::vector<float>      m_workRe;
+        std::vector<float>      m_workIm;
+    };
+}
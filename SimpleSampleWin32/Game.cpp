@@ -5,6 +5,8 @@
 #include "pch.h"
 #include "Game.h"
 
+#include <cmath>
+
 extern void ExitGame();
 
 using namespace DirectX;
@@ -12,15 +14,80 @@ using namespace DirectX::SimpleMath;
 
 using Microsoft::WRL::ComPtr;
 
+namespace
+{
+    // Record the scene on deferred contexts from worker threads. When false, everything is
+    // drawn on the immediate context by the render thread.
+    const bool c_deferredRendering = true;
+
+    // Room for every dynamic vertex drawn in a frame; running out only costs an extra discard.
+    const size_t c_dynamicVertexBytes = 1024 * 1024;
+
+    // Occlusion depth buffer size; objects only need to be hidden at roughly this precision.
+    const unsigned int c_occlusionWidth = 256;
+    const unsigned int c_occlusionHeight = 192;
+
+#ifdef DXTK_AUDIO
+    // Scene objects emit sound forward, at full volume within the inner cone and at half volume
+    // beyond the outer one. Attenuation starts a little short of where the objects are placed.
+    const float c_emitterCurveDistance = 5.f;
+    const float c_emitterInnerAngle = XM_PIDIV2;
+    const float c_emitterOuterAngle = XM_PI + XM_PIDIV2;
+    const float c_emitterOuterVolume = 0.5f;
+
+    // Per-object arrays handed to PositionalAudioBatch, each holding one float per object.
+    enum EmitterArray
+    {
+        Emitter_PositionX,
+        Emitter_PositionY,
+        Emitter_PositionZ,
+        Emitter_FrontX,
+        Emitter_FrontY,
+        Emitter_FrontZ,
+        Emitter_Attenuation,
+        Emitter_ConeGain,
+        Emitter_Doppler,
+        Emitter_MatrixLeft,
+        Emitter_MatrixRight,
+        Emitter_Count
+    };
+#endif
+
+    // Scene files name their assets in UTF-8.
+    std::wstring Widen(const char* value)
+    {
+        int length = MultiByteToWideChar(CP_UTF8, 0, value, -1, nullptr, 0);
+        if (length <= 0)
+            throw std::runtime_error("Invalid asset name");
+
+        std::wstring result(size_t(length), L'\0');
+        MultiByteToWideChar(CP_UTF8, 0, value, -1, &result[0], length);
+        result.resize(size_t(length - 1));
+        return result;
+    }
+}
+
 Game::Game() noexcept(false)
 {
     m_deviceResources = std::make_unique<DX::DeviceResources>();
     m_deviceResources->RegisterDeviceNotify(this);
+
+    m_workers = std::make_unique<DX::WorkerPool>(DX::WorkerPool::GetDefaultWorkerCount());
+
+    m_sceneRenderer = std::make_unique<DX::DeferredRenderer>(c_deferredRendering ? m_workers.get() : nullptr);
+
+    m_occlusion = std::make_unique<DX::OcclusionCuller>(c_occlusionWidth, c_occlusionHeight, *m_workers);
+
+    // Created up front since window messages can arrive before Initialize.
+    m_inputEvents = std::make_unique<DX::InputEventQueue>();
 }
 
 Game::~Game()
 {
 #ifdef DXTK_AUDIO
+    // Stop the audio thread first so the engine is not in use.
+    m_audioThread.reset();
+
     if (m_audEngine)
     {
         m_audEngine->Suspend();
@@ -38,6 +105,10 @@ void Game::Initialize(HWND window, int width, int height)
     m_mouse = std::make_unique<Mouse>();
     m_mouse->SetWindow(window);
 
+    m_scene.Open(L"scene.dxsc");
+    m_objectWorlds.resize(m_scene.GetObjectCount());
+    m_objectVisible.resize(m_scene.GetObjectCount(), 1);
+
     m_deviceResources->SetWindow(window, width, height);
 
     m_deviceResources->CreateDeviceResources();
@@ -57,16 +128,60 @@ void Game::Initialize(HWND window, int width, int height)
 
     m_audioEvent = 0;
     m_audioTimerAcc = 10.f;
-    m_retryDefault = false;
 
-    m_waveBank = std::make_unique<WaveBank>(m_audEngine.get(), L"adpcmdroid.xwb");
+    // Only the short sounds the sequencer plays are kept in memory; droidsfx.xwb holds entries
+    // 0-10 of adpcmdroid.xwb, which itself is never loaded. It is rebuilt with
+    // "SampleTools wavebank droidsfx.xwb -inmemory -align 4 -nonames adpcmdroid.xwb:0-10".
+    m_waveBank = std::make_unique<WaveBank>(m_audEngine.get(), L"droidsfx.xwb");
+
+    for (uint32_t j = 0; j < c_audioEventCount; ++j)
+    {
+        m_audioEventInstances.push_back(m_waveBank->CreateInstance(j));
+    }
+
+    auto settings = DX::PositionalAudioBatch::DefaultSettings();
+    settings.curveDistanceScaler = c_emitterCurveDistance;
+    settings.coneInnerAngle = c_emitterInnerAngle;
+    settings.coneOuterAngle = c_emitterOuterAngle;
+    settings.coneOuterVolume = c_emitterOuterVolume;
+    m_positionalAudio = std::make_unique<DX::PositionalAudioBatch>(settings);
+    m_emitterArrays.resize(Emitter_Count * m_objectWorlds.size());
 
     m_soundEffect = std::make_unique<SoundEffect>(m_audEngine.get(), L"MusicMono_adpcm.wav");
     m_effect1 = m_soundEffect->CreateInstance();
-    m_effect2 = m_waveBank->CreateInstance(10);
 
-    m_effect1->Play(true);
-    m_effect2->Play();
+    // Stream the largest entry of the full bank from disk rather than keeping it resident
+    m_waveStream = std::make_unique<DX::WaveBankStream>();
+    m_waveStream->Open(L"adpcmdroid.xwb");
+
+    m_streamEntry = 0;
+    for (size_t j = 1; j < m_waveStream->GetEntryCount(); ++j)
+    {
+        if (m_waveStream->GetEntry(j).dataLength > m_waveStream->GetEntry(m_streamEntry).dataLength)
+            m_streamEntry = j;
+    }
+
+    m_waveStream->Start(m_streamEntry);
+
+    const auto& entry = m_waveStream->GetEntry(m_streamEntry);
+    for (auto& buffer : m_streamBuffers)
+    {
+        buffer.resize(c_streamBufferFrames * entry.channels);
+    }
+    m_streamBufferIndex = 0;
+
+    m_streamVoice = std::make_unique<DynamicSoundEffectInstance>(m_audEngine.get(),
+        [this](DynamicSoundEffectInstance* voice)
+        {
+            SubmitStreamBuffers(voice);
+        },
+        int(entry.sampleRate), int(entry.channels));
+
+    m_audioThread = std::make_unique<DX::AudioThread>(m_audEngine.get());
+
+    m_audioThread->RestartOnReset(m_effect1.get());
+    m_audioThread->Play(m_effect1.get(), true);
+    m_audioThread->Play(m_streamVoice.get());
 #endif
 }
 
@@ -79,16 +194,6 @@ void Game::Tick()
         Update(m_timer);
     });
 
-#ifdef DXTK_AUDIO
-    // Only update audio engine once per frame
-    if (!m_audEngine->IsCriticalError() && m_audEngine->Update())
-    {
-        // Setup a retry in 1 second
-        m_audioTimerAcc = 1.f;
-        m_retryDefault = true;
-    }
-#endif
-
     Render();
 }
 
@@ -102,6 +207,13 @@ void Game::Update(DX::StepTimer const& timer)
 
     m_world = Matrix::CreateRotationY(float(timer.GetTotalSeconds() * XM_PIDIV4));
 
+    // Every object turns in place with the world.
+    const XMFLOAT4X4* transforms = m_scene.GetTransforms();
+    for (size_t i = 0; i < m_objectWorlds.size(); ++i)
+    {
+        m_objectWorlds[i] = XMMatrixMultiply(m_world, XMLoadFloat4x4(&transforms[i]));
+    }
+
     m_batchEffect->SetView(m_view);
     m_batchEffect->SetWorld(Matrix::Identity);
 
@@ -109,25 +221,16 @@ void Game::Update(DX::StepTimer const& timer)
     m_audioTimerAcc -= (float)timer.GetElapsedSeconds();
     if (m_audioTimerAcc < 0)
     {
-        if (m_retryDefault)
-        {
-            m_retryDefault = false;
-            if (m_audEngine->Reset())
-            {
-                // Restart looping audio
-                m_effect1->Play(true);
-            }
-        }
-        else
-        {
-            m_audioTimerAcc = 4.f;
+        m_audioTimerAcc = 4.f;
 
-            m_waveBank->Play(m_audioEvent++);
+        // Device loss and reset are handled on the audio thread, so this never waits on the device
+        m_audioThread->Play(m_audioEventInstances[m_audioEvent++].get());
 
-            if (m_audioEvent >= 11)
-                m_audioEvent = 0;
-        }
+        if (m_audioEvent >= c_audioEventCount)
+            m_audioEvent = 0;
     }
+
+    UpdatePositionalAudio(eye, at);
 #endif
 
     auto pad = m_gamePad->GetState(0);
@@ -139,12 +242,105 @@ void Game::Update(DX::StepTimer const& timer)
         }
     }
 
-    auto kb = m_keyboard->GetState();
-    if (kb.Escape)
+    // Every key transition since the last update, in order, so a tap shorter than a frame still counts.
+    m_inputEvents->Consume(DX::InputEventQueue::GetTimestamp(), [](const DX::InputEvent& event)
     {
-        ExitGame();
+        if (event.type == DX::InputEvent::KeyDown && event.code == VK_ESCAPE)
+        {
+            ExitGame();
+        }
+    });
+}
+
+#ifdef DXTK_AUDIO
+// Places the listener at the camera and evaluates every scene object as an emitter, then hands
+// each sequencer sound the result for the object it plays from.
+void Game::UpdatePositionalAudio(Vector3 const& eye, Vector3 const& at)
+{
+    const size_t count = m_objectWorlds.size();
+    if (!count)
+        return;
+
+    float* arrays[Emitter_Count];
+    for (size_t j = 0; j < Emitter_Count; ++j)
+    {
+        arrays[j] = m_emitterArrays.data() + j * count;
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        Vector3 position = m_objectWorlds[i].Translation();
+        Vector3 front = m_objectWorlds[i].Forward();
+        front.Normalize();
+
+        arrays[Emitter_PositionX][i] = position.x;
+        arrays[Emitter_PositionY][i] = position.y;
+        arrays[Emitter_PositionZ][i] = position.z;
+        arrays[Emitter_FrontX][i] = front.x;
+        arrays[Emitter_FrontY][i] = front.y;
+        arrays[Emitter_FrontZ][i] = front.z;
+    }
+
+    DX::PositionalAudioBatch::Listener listener;
+    listener.position = eye;
+    listener.velocity = Vector3::Zero;
+    listener.orientFront = at - eye;
+    listener.orientTop = Vector3::UnitY;
+
+    // Objects only turn in place, so they have no velocity and there is no doppler shift.
+    DX::PositionalAudioBatch::Emitters emitters =
+    {
+        arrays[Emitter_PositionX], arrays[Emitter_PositionY], arrays[Emitter_PositionZ],
+        nullptr, nullptr, nullptr,
+        arrays[Emitter_FrontX], arrays[Emitter_FrontY], arrays[Emitter_FrontZ],
+    };
+
+    DX::PositionalAudioBatch::Results results =
+    {
+        arrays[Emitter_Attenuation], arrays[Emitter_ConeGain], arrays[Emitter_Doppler], arrays[Emitter_MatrixLeft], arrays[Emitter_MatrixRight],
+    };
+
+    m_positionalAudio->Evaluate(listener, emitters, count, results);
+
+    for (size_t j = 0; j < m_audioEventInstances.size(); ++j)
+    {
+        size_t i = j % count;
+
+        // DirectXTK takes a pan position rather than an output matrix, so recover it from the
+        // constant power pan angle the matrix was built from.
+        float left = arrays[Emitter_MatrixLeft][i];
+        float right = arrays[Emitter_MatrixRight][i];
+        float pan = std::atan2(right, left) / XM_PIDIV4 - 1.f;
+
+        DX::AudioThread::VoiceOutput output;
+        output.volume = arrays[Emitter_Attenuation][i] * arrays[Emitter_ConeGain][i];
+        output.pitch = std::max(-1.f, std::min(1.f, std::log2(arrays[Emitter_Doppler][i])));
+        output.pan = std::max(-1.f, std::min(1.f, pan));
+
+        m_audioThread->SetOutput(m_audioEventInstances[j].get(), output);
+    }
+}
+
+// Keeps the streaming voice fed from the background reader without blocking on I/O.
+// Called by the engine's Update, so this runs on the audio thread.
+void Game::SubmitStreamBuffers(DynamicSoundEffectInstance* voice)
+{
+    // One buffer is always left unqueued so it can be refilled while the others play.
+    while (voice->GetPendingBufferCount() < int(c_streamBufferCount) - 1)
+    {
+        auto& buffer = m_streamBuffers[m_streamBufferIndex];
+
+        size_t frames = m_waveStream->Read(buffer.data(), c_streamBufferFrames);
+        if (!frames)
+            break;
+
+        voice->SubmitBuffer(reinterpret_cast<const uint8_t*>(buffer.data()),
+            frames * m_waveStream->GetEntry(m_streamEntry).channels * sizeof(int16_t));
+
+        m_streamBufferIndex = (m_streamBufferIndex + 1) % c_streamBufferCount;
     }
 }
+#endif
 #pragma endregion
 
 #pragma region Frame Render
@@ -159,41 +355,114 @@ void Game::Render()
 
     Clear();
 
-    m_deviceResources->PIXBeginEvent(L"Render");
-    auto context = m_deviceResources->GetD3DDeviceContext();
+    m_dynamicVertices->BeginFrame();
 
-    // Draw procedurally generated dynamic grid
-    const XMVECTORF32 xaxis = { 20.f, 0.f, 0.f };
-    const XMVECTORF32 yaxis = { 0.f, 0.f, 20.f };
-    DrawGrid(xaxis, yaxis, g_XMZero, 20, 20, Colors::Gray);
+    CullScene();
 
-    // Draw sprite
-    m_deviceResources->PIXBeginEvent(L"Draw sprite");
-    m_sprites->Begin();
-    m_sprites->Draw(m_texture2.Get(), XMFLOAT2(10, 75), nullptr, Colors::White);
+    m_deviceResources->PIXBeginEvent(L"Render");
 
-    m_font->DrawString(m_sprites.get(), L"DirectXTK Simple Sample", XMFLOAT2(100, 10), Colors::Yellow);
-    m_sprites->End();
-    m_deviceResources->PIXEndEvent();
+    m_sceneRenderer->Render([this](size_t chunk, ID3D11DeviceContext* context)
+    {
+        RenderChunk(chunk, context);
+    });
 
-    // Draw 3D object
-    m_deviceResources->PIXBeginEvent(L"Draw teapot");
-    XMMATRIX local = m_world * Matrix::CreateTranslation(-2.f, -2.f, -4.f);
-    m_shape->Draw(local, m_view, m_projection, Colors::White, m_texture1.Get());
     m_deviceResources->PIXEndEvent();
 
-    m_deviceResources->PIXBeginEvent(L"Draw model");
-    const XMVECTORF32 scale = { 0.01f, 0.01f, 0.01f };
-    const XMVECTORF32 translate = { 3.f, -2.f, -4.f };
-    XMVECTOR rotate = Quaternion::CreateFromYawPitchRoll(XM_PI / 2.f, 0.f, -XM_PI / 2.f);
-    local = m_world * XMMatrixTransformation(g_XMZero, Quaternion::Identity, scale, g_XMZero, rotate, translate);
-    m_model->Draw(context, *m_states, local, m_view, m_projection);
-    m_deviceResources->PIXEndEvent();
+    // Show the new frame.
+    m_deviceResources->Present();
+}
+
+// Rasterizes the occluders on the CPU and decides what to draw, before anything is recorded.
+void Game::CullScene()
+{
+    m_deviceResources->PIXBeginEvent(L"Occlusion");
+
+    m_occlusion->BeginFrame(m_view * m_projection);
+
+    // Teapots occlude; models are tested against them.
+    const uint32_t* meshes = m_scene.GetObjectMeshes();
+    for (size_t i = 0; i < m_objectWorlds.size(); ++i)
+    {
+        if (!m_models[meshes[i]])
+        {
+            m_occlusion->AddOccluder(&m_teapotVertices[0].position, sizeof(GeometricPrimitive::VertexType), m_teapotVertices.size(),
+                m_teapotIndices.data(), m_teapotIndices.size(), m_objectWorlds[i]);
+        }
+    }
+
+    m_occlusion->Rasterize();
+
+    for (size_t i = 0; i < m_objectWorlds.size(); ++i)
+    {
+        m_objectVisible[i] = !m_models[meshes[i]] || m_occlusion->IsVisible(m_meshBounds[meshes[i]], m_objectWorlds[i]);
+    }
 
     m_deviceResources->PIXEndEvent();
+}
 
-    // Show the new frame.
-    m_deviceResources->Present();
+// Records one chunk of the scene. This may run on a worker thread, so it only touches
+// objects that were created against 'context' or are never modified while rendering.
+void Game::RenderChunk(size_t chunk, ID3D11DeviceContext* context)
+{
+    if (m_sceneRenderer->IsDeferred())
+    {
+        // Deferred contexts start every command list from default state.
+        auto renderTarget = m_deviceResources->GetRenderTargetView();
+        context->OMSetRenderTargets(1, &renderTarget, m_deviceResources->GetDepthStencilView());
+
+        auto viewport = m_deviceResources->GetScreenViewport();
+        context->RSSetViewports(1, &viewport);
+    }
+
+    switch (chunk)
+    {
+    case SceneChunk_Grid:
+    {
+        // Draw procedurally generated dynamic grid
+        const XMVECTORF32 xaxis = { 20.f, 0.f, 0.f };
+        const XMVECTORF32 yaxis = { 0.f, 0.f, 20.f };
+        DrawGrid(context, xaxis, yaxis, g_XMZero, 20, 20, Colors::Gray);
+        break;
+    }
+
+    case SceneChunk_Sprites:
+        // Draw sprite
+        m_sprites->Begin();
+        m_sprites->Draw(m_texture2.Get(), XMFLOAT2(10, 75), nullptr, Colors::White);
+
+        m_font->DrawString(m_sprites.get(), L"DirectXTK Simple Sample", XMFLOAT2(100, 10), Colors::Yellow);
+        m_sprites->End();
+        break;
+
+    case SceneChunk_Primitives:
+    {
+        // Draw 3D objects
+        const uint32_t* meshes = m_scene.GetObjectMeshes();
+        const uint32_t* materials = m_scene.GetObjectMaterials();
+        for (size_t i = 0; i < m_objectWorlds.size(); ++i)
+        {
+            if (!m_models[meshes[i]])
+            {
+                const auto& material = m_scene.GetMaterials()[materials[i]];
+                m_shape->Draw(m_objectWorlds[i], m_view, m_projection, XMLoadFloat4(&material.color), m_materialTextures[materials[i]].Get());
+            }
+        }
+        break;
+    }
+
+    case SceneChunk_Models:
+    {
+        const uint32_t* meshes = m_scene.GetObjectMeshes();
+        for (size_t i = 0; i < m_objectWorlds.size(); ++i)
+        {
+            if (m_models[meshes[i]] && m_objectVisible[i])
+            {
+                m_models[meshes[i]]->Draw(context, *m_states, m_objectWorlds[i], m_view, m_projection);
+            }
+        }
+        break;
+    }
+    }
 }
 
 // Helper method to clear the back buffers.
@@ -217,11 +486,8 @@ void Game::Clear()
     m_deviceResources->PIXEndEvent();
 }
 
-void XM_CALLCONV Game::DrawGrid(FXMVECTOR xAxis, FXMVECTOR yAxis, FXMVECTOR origin, size_t xdivs, size_t ydivs, GXMVECTOR color)
+void XM_CALLCONV Game::DrawGrid(ID3D11DeviceContext* context, FXMVECTOR xAxis, FXMVECTOR yAxis, FXMVECTOR origin, size_t xdivs, size_t ydivs, GXMVECTOR color)
 {
-    m_deviceResources->PIXBeginEvent(L"Draw grid");
-
-    auto context = m_deviceResources->GetD3DDeviceContext();
     context->OMSetBlendState(m_states->Opaque(), nullptr, 0xFFFFFFFF);
     context->OMSetDepthStencilState(m_states->DepthNone(), 0);
     context->RSSetState(m_states->CullCounterClockwise());
@@ -230,11 +496,15 @@ void XM_CALLCONV Game::DrawGrid(FXMVECTOR xAxis, FXMVECTOR yAxis, FXMVECTOR orig
 
     context->IASetInputLayout(m_batchInputLayout.Get());
 
-    m_batch->Begin();
-
     xdivs = std::max<size_t>(1, xdivs);
     ydivs = std::max<size_t>(1, ydivs);
 
+    // Write the lines straight into the frame's ring; two vertices per line.
+    size_t vertexCount = (xdivs + ydivs + 2) * 2;
+
+    UINT startVertex;
+    auto vertices = m_dynamicVertices->MapVertices<VertexPositionColor>(context, vertexCount, startVertex);
+
     for (size_t i = 0; i <= xdivs; ++i)
     {
         float fPercent = float(i) / float(xdivs);
@@ -242,9 +512,8 @@ void XM_CALLCONV Game::DrawGrid(FXMVECTOR xAxis, FXMVECTOR yAxis, FXMVECTOR orig
         XMVECTOR vScale = XMVectorScale(xAxis, fPercent);
         vScale = XMVectorAdd(vScale, origin);
 
-        VertexPositionColor v1(XMVectorSubtract(vScale, yAxis), color);
-        VertexPositionColor v2(XMVectorAdd(vScale, yAxis), color);
-        m_batch->DrawLine(v1, v2);
+        *vertices++ = VertexPositionColor(XMVectorSubtract(vScale, yAxis), color);
+        *vertices++ = VertexPositionColor(XMVectorAdd(vScale, yAxis), color);
     }
 
     for (size_t i = 0; i <= ydivs; i++)
@@ -254,14 +523,19 @@ void XM_CALLCONV Game::DrawGrid(FXMVECTOR xAxis, FXMVECTOR yAxis, FXMVECTOR orig
         XMVECTOR vScale = XMVectorScale(yAxis, fPercent);
         vScale = XMVectorAdd(vScale, origin);
 
-        VertexPositionColor v1(XMVectorSubtract(vScale, xAxis), color);
-        VertexPositionColor v2(XMVectorAdd(vScale, xAxis), color);
-        m_batch->DrawLine(v1, v2);
+        *vertices++ = VertexPositionColor(XMVectorSubtract(vScale, xAxis), color);
+        *vertices++ = VertexPositionColor(XMVectorAdd(vScale, xAxis), color);
     }
 
-    m_batch->End();
+    m_dynamicVertices->Unmap(context);
 
-    m_deviceResources->PIXEndEvent();
+    auto vertexBuffer = m_dynamicVertices->GetBuffer();
+    UINT vertexStride = sizeof(VertexPositionColor);
+    UINT vertexOffset = 0;
+    context->IASetVertexBuffers(0, 1, &vertexBuffer, &vertexStride, &vertexOffset);
+    context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_LINELIST);
+
+    context->Draw(static_cast<UINT>(vertexCount), startVertex);
 }
 #pragma endregion
 
@@ -278,7 +552,7 @@ void Game::OnDeactivated()
 void Game::OnSuspending()
 {
 #ifdef DXTK_AUDIO
-    m_audEngine->Suspend();
+    m_audioThread->Suspend();
 #endif
 }
 
@@ -287,7 +561,7 @@ void Game::OnResuming()
     m_timer.ResetElapsedTime();
 
 #ifdef DXTK_AUDIO
-    m_audEngine->Resume();
+    m_audioThread->Resume();
 #endif
 }
 
@@ -305,14 +579,18 @@ void Game::OnWindowSizeChanged(int width, int height)
     CreateWindowSizeDependentResources();
 }
 
+void Game::OnInputMessage(UINT message, WPARAM wParam, LPARAM lParam)
+{
+    m_inputEvents->ProcessMessage(message, wParam, lParam);
+}
+
 #ifdef DXTK_AUDIO
 void Game::NewAudioDevice()
 {
-    if (m_audEngine && !m_audEngine->IsAudioDevicePresent())
+    if (m_audioThread)
     {
-        // Setup a retry in 1 second
-        m_audioTimerAcc = 1.f;
-        m_retryDefault = true;
+        // Schedules a reset in 1 second if audio is silent or has no device
+        m_audioThread->NotifyDeviceChange();
     }
 }
 #endif
@@ -334,11 +612,21 @@ void Game::CreateDeviceDependentResources()
 
     m_states = std::make_unique<CommonStates>(device);
 
-    m_fxFactory = std::make_unique<EffectFactory>(device);
+    // Model, effect and sprite textures are shared by content through one cache. Anything
+    // holding references from an earlier cache gives them back before it goes.
+    m_models.clear();
+    m_fxFactory.reset();
+    ReleaseTextures();
+
+    m_textureCache = std::make_unique<DX::TextureCache>(device);
+    m_fxFactory = std::make_unique<DX::TextureCacheEffectFactory>(device, *m_textureCache);
 
-    m_sprites = std::make_unique<SpriteBatch>(context);
+    // Objects a scene chunk draws with are bound to that chunk's context.
+    m_sceneRenderer->CreateDeviceDependentResources(device, context, SceneChunk_Count);
 
-    m_batch = std::make_unique<PrimitiveBatch<VertexPositionColor>>(context);
+    m_sprites = std::make_unique<SpriteBatch>(m_sceneRenderer->GetContext(SceneChunk_Sprites));
+
+    m_dynamicVertices = std::make_unique<DX::DynamicBufferRing>(device, c_dynamicVertexBytes);
 
     m_batchEffect = std::make_unique<BasicEffect>(device);
     m_batchEffect->SetVertexColorEnabled(true);
@@ -359,19 +647,60 @@ void Game::CreateDeviceDependentResources()
 
     m_font = std::make_unique<SpriteFont>(device, L"SegoeUI_18.spritefont");
 
-    m_shape = GeometricPrimitive::CreateTeapot(context, 4.f, 8);
+    GeometricPrimitive::CreateTeapot(m_teapotVertices, m_teapotIndices, 4.f, 8);
+    m_shape = GeometricPrimitive::CreateCustom(m_sceneRenderer->GetContext(SceneChunk_Primitives), m_teapotVertices, m_teapotIndices);
+
+    // Scene meshes are the teapot primitive or SDKMESH files.
+    m_models.clear();
+    m_models.resize(m_scene.GetMeshCount());
+    m_meshBounds.resize(m_scene.GetMeshCount());
+    for (size_t j = 0; j < m_scene.GetMeshCount(); ++j)
+    {
+        const auto& mesh = m_scene.GetMeshes()[j];
+        const char* name = m_scene.GetString(mesh.name);
+
+        if (mesh.kind == DX::Scene::MeshKind_Primitive)
+        {
+            if (strcmp(name, "teapot") != 0)
+                throw std::runtime_error("Scene uses an unknown primitive");
 
-    // SDKMESH has to use clockwise winding with right-handed coordinates, so textures are flipped in U
-    m_model = Model::CreateFromSDKMESH(device, L"tiny.sdkmesh", *m_fxFactory);
+            BoundingBox::CreateFromPoints(m_meshBounds[j], m_teapotVertices.size(), &m_teapotVertices[0].position, sizeof(GeometricPrimitive::VertexType));
+            continue;
+        }
+
+        // SDKMESH has to use clockwise winding with right-handed coordinates, so textures are flipped in U
+        m_models[j] = Model::CreateFromSDKMESH(device, Widen(name).c_str(), *m_fxFactory);
+
+        m_meshBounds[j] = m_models[j]->meshes.front()->boundingBox;
+        for (auto& part : m_models[j]->meshes)
+        {
+            BoundingBox::CreateMerged(m_meshBounds[j], m_meshBounds[j], part->boundingBox);
+        }
+    }
 
     // Load textures
-    DX::ThrowIfFailed(
-        CreateDDSTextureFromFile(device, L"seafloor.dds", nullptr, m_texture1.ReleaseAndGetAddressOf())
-    );
+    m_materialTextures.clear();
+    m_materialTextures.resize(m_scene.GetMaterialCount());
+    for (size_t j = 0; j < m_scene.GetMaterialCount(); ++j)
+    {
+        const char* texture = m_scene.GetString(m_scene.GetMaterials()[j].texture);
+        if (texture)
+        {
+            m_textureCache->CreateTexture(Widen(texture).c_str(), m_materialTextures[j].ReleaseAndGetAddressOf());
+        }
+    }
 
-    DX::ThrowIfFailed(
-        CreateDDSTextureFromFile(device, L"windowslogo.dds", nullptr, m_texture2.ReleaseAndGetAddressOf())
-    );
+    m_textureCache->CreateTexture(L"windowslogo.dds", m_texture2.ReleaseAndGetAddressOf());
+
+#ifdef _DEBUG
+    {
+        auto stats = m_textureCache->GetStatistics();
+        char buff[128] = {};
+        sprintf_s(buff, "Texture cache: %u requests, %u textures, %llu bytes saved\n",
+            stats.requests, stats.texturesCreated, stats.bytesRequested - stats.bytesLoaded);
+        OutputDebugStringA(buff);
+    }
+#endif
 }
 
 // Allocate all memory resources that change on a window SizeChanged event.
@@ -397,6 +726,25 @@ void Game::CreateWindowSizeDependentResources()
     );
 
     m_batchEffect->SetProjection(m_projection);
+
+    // Deferred contexts cannot report the viewport back to SpriteBatch.
+    m_sprites->SetViewport(m_deviceResources->GetScreenViewport());
+}
+
+// Gives the material and sprite textures back to the cache, which counts every reference.
+void Game::ReleaseTextures()
+{
+    if (m_textureCache)
+    {
+        for (auto& texture : m_materialTextures)
+        {
+            m_textureCache->ReleaseTexture(texture.Get());
+        }
+        m_textureCache->ReleaseTexture(m_texture2.Get());
+    }
+
+    m_materialTextures.clear();
+    m_texture2.Reset();
 }
 
 void Game::OnDeviceLost()
@@ -404,14 +752,15 @@ void Game::OnDeviceLost()
     m_states.reset();
     m_fxFactory.reset();
     m_sprites.reset();
-    m_batch.reset();
+    m_dynamicVertices.reset();
     m_batchEffect.reset();
     m_font.reset();
     m_shape.reset();
-    m_model.reset();
-    m_texture1.Reset();
-    m_texture2.Reset();
+    m_models.clear();
+    ReleaseTextures();
+    m_textureCache.reset();
     m_batchInputLayout.Reset();
+    m_sceneRenderer->ReleaseDeviceDependentResources();
 }
 
 void Game::OnDeviceRestored()
@@ -4,8 +4,18 @@
 
 #pragma once
 
+#include "AudioThread.h"
+#include "DeferredRenderer.h"
 #include "DeviceResources.h"
+#include "DynamicBufferRing.h"
+#include "InputEventQueue.h"
+#include "OcclusionCuller.h"
+#include "PositionalAudioBatch.h"
+#include "SceneFile.h"
 #include "StepTimer.h"
+#include "TextureCache.h"
+#include "WaveBankStream.h"
+#include "WorkerPool.h"
 
 
 // A basic game implementation that creates a D3D11 device and
@@ -34,6 +44,7 @@ public:
     void OnResuming();
     void OnWindowMoved();
     void OnWindowSizeChanged(int width, int height);
+    void OnInputMessage(UINT message, WPARAM wParam, LPARAM lParam);
 #ifdef DXTK_AUDIO
     void NewAudioDevice();
 #endif
@@ -43,15 +54,33 @@ public:
 
 private:
 
+    // The scene is recorded as independent chunks, executed in this order.
+    enum SceneChunk
+    {
+        SceneChunk_Grid,
+        SceneChunk_Sprites,
+        SceneChunk_Primitives,
+        SceneChunk_Models,
+        SceneChunk_Count
+    };
+
     void Update(DX::StepTimer const& timer);
     void Render();
+    void RenderChunk(size_t chunk, ID3D11DeviceContext* context);
+    void CullScene();
 
     void Clear();
 
     void CreateDeviceDependentResources();
     void CreateWindowSizeDependentResources();
+    void ReleaseTextures();
+
+#ifdef DXTK_AUDIO
+    void SubmitStreamBuffers(DirectX::DynamicSoundEffectInstance* voice);
+    void UpdatePositionalAudio(DirectX::SimpleMath::Vector3 const& eye, DirectX::SimpleMath::Vector3 const& at);
+#endif
 
-    void XM_CALLCONV DrawGrid(DirectX::FXMVECTOR xAxis, DirectX::FXMVECTOR yAxis, DirectX::FXMVECTOR origin, size_t xdivs, size_t ydivs, DirectX::GXMVECTOR color);
+    void XM_CALLCONV DrawGrid(ID3D11DeviceContext* context, DirectX::FXMVECTOR xAxis, DirectX::FXMVECTOR yAxis, DirectX::FXMVECTOR origin, size_t xdivs, size_t ydivs, DirectX::GXMVECTOR color);
 
     // Device resources.
     std::unique_ptr<DX::DeviceResources>    m_deviceResources;
@@ -63,14 +92,23 @@ private:
     std::unique_ptr<DirectX::GamePad>       m_gamePad;
     std::unique_ptr<DirectX::Keyboard>      m_keyboard;
     std::unique_ptr<DirectX::Mouse>         m_mouse;
+    std::unique_ptr<DX::InputEventQueue>    m_inputEvents;
+
+    // Worker threads shared by the scene renderer and the occlusion culler, which take turns.
+    std::unique_ptr<DX::WorkerPool>         m_workers;
+
+    // Records scene chunks on deferred contexts from worker threads.
+    std::unique_ptr<DX::DeferredRenderer>   m_sceneRenderer;
+
+    // Hides objects behind the occluders before the scene is recorded.
+    std::unique_ptr<DX::OcclusionCuller>    m_occlusion;
 
     // DirectXTK objects.
     std::unique_ptr<DirectX::CommonStates>                                  m_states;
     std::unique_ptr<DirectX::BasicEffect>                                   m_batchEffect;
+    std::unique_ptr<DX::TextureCache>                                       m_textureCache;
     std::unique_ptr<DirectX::EffectFactory>                                 m_fxFactory;
     std::unique_ptr<DirectX::GeometricPrimitive>                            m_shape;
-    std::unique_ptr<DirectX::Model>                                         m_model;
-    std::unique_ptr<DirectX::PrimitiveBatch<DirectX::VertexPositionColor>>  m_batch;
     std::unique_ptr<DirectX::SpriteBatch>                                   m_sprites;
     std::unique_ptr<DirectX::SpriteFont>                                    m_font;
 
@@ -79,21 +117,55 @@ private:
     std::unique_ptr<DirectX::WaveBank>                                      m_waveBank;
     std::unique_ptr<DirectX::SoundEffect>                                   m_soundEffect;
     std::unique_ptr<DirectX::SoundEffectInstance>                           m_effect1;
-    std::unique_ptr<DirectX::SoundEffectInstance>                           m_effect2;
+    std::unique_ptr<DirectX::DynamicSoundEffectInstance>                    m_streamVoice;
 #endif
 
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texture1;
     Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texture2;
     Microsoft::WRL::ComPtr<ID3D11InputLayout>                               m_batchInputLayout;
 
+    // Dynamic vertices for the grid chunk, discarded once per frame.
+    std::unique_ptr<DX::DynamicBufferRing>                                  m_dynamicVertices;
+
 #ifdef DXTK_AUDIO
+    static const uint32_t c_audioEventCount = 11;
+
     uint32_t                                                                m_audioEvent;
     float                                                                   m_audioTimerAcc;
 
-    bool                                                                    m_retryDefault;
+    // Each sequencer sound plays from a scene object, in turn. Its volume, pitch and pan follow
+    // that object as seen from the camera, evaluated for all objects at once each frame.
+    std::vector<std::unique_ptr<DirectX::SoundEffectInstance>>              m_audioEventInstances;
+    std::unique_ptr<DX::PositionalAudioBatch>                               m_positionalAudio;
+    std::vector<float>                                                      m_emitterArrays;
+
+    // Wave bank entry streamed from disk through a small ring of PCM buffers.
+    static const size_t c_streamBufferCount = 4;
+    static const size_t c_streamBufferFrames = 4096;
+
+    std::unique_ptr<DX::WaveBankStream>                                     m_waveStream;
+    size_t                                                                  m_streamEntry;
+    std::vector<int16_t>                                                    m_streamBuffers[c_streamBufferCount];
+    size_t                                                                  m_streamBufferIndex;
+
+    // Updates the engine and applies voice commands off the game thread.
+    std::unique_ptr<DX::AudioThread>                                        m_audioThread;
 #endif
 
     DirectX::SimpleMath::Matrix                                             m_world;
     DirectX::SimpleMath::Matrix                                             m_view;
     DirectX::SimpleMath::Matrix                                             m_projection;
+
+    // What is drawn where comes from scene.dxsc, whose arrays are read where they are mapped.
+    DX::SceneFile                                                           m_scene;
+    std::vector<DirectX::SimpleMath::Matrix>                                m_objectWorlds;
+    std::vector<uint8_t>                                                    m_objectVisible;
+
+    // Per scene mesh and material. Primitive meshes have no model.
+    std::vector<std::unique_ptr<DirectX::Model>>                            m_models;
+    std::vector<DirectX::BoundingBox>                                       m_meshBounds;
+    std::vector<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>>           m_materialTextures;
+
+    // Teapots are drawn from, and occlude with, the same triangles.
+    std::vector<DirectX::GeometricPrimitive::VertexType>                    m_teapotVertices;
+    std::vector<uint16_t>                                                   m_teapotIndices;
 };
\ No newline at end of file
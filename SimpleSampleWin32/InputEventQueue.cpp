@@ -0,0 +1,136 @@
+//
+// InputEventQueue.cpp
+//
+
+#include "pch.h"
+#include "InputEventQueue.h"
+
+using namespace DX;
+
+namespace
+{
+    const uint64_t c_ticksPerSecond = 10000000;
+
+    uint64_t GetCounterFrequency()
+    {
+        LARGE_INTEGER frequency;
+        if (!QueryPerformanceFrequency(&frequency))
+            throw std::runtime_error("QueryPerformanceFrequency");
+
+        return static_cast<uint64_t>(frequency.QuadPart);
+    }
+
+    // Mouse messages carry client coordinates as signed 16-bit values.
+    inline void SetPosition(InputEvent& event, LPARAM lParam)
+    {
+        event.x = static_cast<short>(LOWORD(lParam));
+        event.y = static_cast<short>(HIWORD(lParam));
+    }
+}
+
+InputEventQueue::InputEventQueue() noexcept :
+    m_pushed(0),
+    m_dropped(0),
+    m_consumed(0),
+    m_totalLatency(0),
+    m_maxLatency(0)
+{
+}
+
+uint64_t InputEventQueue::GetTimestamp()
+{
+    static const uint64_t s_frequency = GetCounterFrequency();
+
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+
+    // Split the conversion, as StepTimer does, to avoid overflowing 64 bits.
+    uint64_t ticks = static_cast<uint64_t>(counter.QuadPart);
+    return (ticks / s_frequency) * c_ticksPerSecond + ((ticks % s_frequency) * c_ticksPerSecond) / s_frequency;
+}
+
+bool InputEventQueue::Push(const InputEvent& event)
+{
+    if (!m_queue.TryPush(event))
+    {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    m_pushed.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool InputEventQueue::ProcessMessage(UINT message, WPARAM wParam, LPARAM lParam)
+{
+    InputEvent event = {};
+    event.timestamp = GetTimestamp();
+
+    switch (message)
+    {
+    case WM_KEYDOWN:
+    case WM_SYSKEYDOWN:
+        event.type = InputEvent::KeyDown;
+        event.code = static_cast<uint8_t>(wParam);
+        event.repeat = (lParam & 0x40000000) != 0;
+        break;
+
+    case WM_KEYUP:
+    case WM_SYSKEYUP:
+        event.type = InputEvent::KeyUp;
+        event.code = static_cast<uint8_t>(wParam);
+        break;
+
+    case WM_MOUSEMOVE:
+        event.type = InputEvent::MouseMove;
+        SetPosition(event, lParam);
+        break;
+
+    case WM_LBUTTONDOWN:
+    case WM_RBUTTONDOWN:
+    case WM_MBUTTONDOWN:
+    case WM_LBUTTONUP:
+    case WM_RBUTTONUP:
+    case WM_MBUTTONUP:
+        event.type = (message == WM_LBUTTONDOWN || message == WM_RBUTTONDOWN || message == WM_MBUTTONDOWN)
+            ? InputEvent::MouseButtonDown : InputEvent::MouseButtonUp;
+        event.code = (message == WM_LBUTTONDOWN || message == WM_LBUTTONUP) ? InputEvent::LeftButton
+            : (message == WM_RBUTTONDOWN || message == WM_RBUTTONUP) ? InputEvent::RightButton
+            : InputEvent::MiddleButton;
+        SetPosition(event, lParam);
+        break;
+
+    case WM_XBUTTONDOWN:
+    case WM_XBUTTONUP:
+        event.type = (message == WM_XBUTTONDOWN) ? InputEvent::MouseButtonDown : InputEvent::MouseButtonUp;
+        event.code = (HIWORD(wParam) == XBUTTON1) ? InputEvent::XButton1 : InputEvent::XButton2;
+        SetPosition(event, lParam);
+        break;
+
+    case WM_MOUSEWHEEL:
+        event.type = InputEvent::MouseWheel;
+        event.y = GET_WHEEL_DELTA_WPARAM(wParam);
+        break;
+
+    case WM_MOUSEHWHEEL:
+        event.type = InputEvent::MouseWheel;
+        event.x = GET_WHEEL_DELTA_WPARAM(wParam);
+        break;
+
+    default:
+        return false;
+    }
+
+    return Push(event);
+}
+
+InputEventQueue::Statistics InputEventQueue::GetStatistics() const
+{
+    Statistics stats;
+    stats.pushed = m_pushed.load(std::memory_order_relaxed);
+    stats.consumed = m_consumed;
+    stats.dropped = m_dropped.load(std::memory_order_relaxed);
+    stats.totalLatencyTicks = m_totalLatency;
+    stats.maxLatencyTicks = m_maxLatency;
+    return stats;
+}
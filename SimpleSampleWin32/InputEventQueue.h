@@ -0,0 +1,114 @@
+//
+// InputEventQueue.h - Timestamped keyboard and mouse events, delivered in order
+//
+
+#pragma once
+
+#include "SpscQueue.h"
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace DX
+{
+    struct InputEvent
+    {
+        enum Type : uint8_t
+        {
+            KeyDown,
+            KeyUp,
+            MouseMove,
+            MouseButtonDown,
+            MouseButtonUp,
+            MouseWheel,
+        };
+
+        enum MouseButton : uint8_t
+        {
+            LeftButton,
+            RightButton,
+            MiddleButton,
+            XButton1,
+            XButton2,
+        };
+
+        uint64_t    timestamp;      // In StepTimer ticks (10,000,000 per second)
+        Type        type;
+        uint8_t     code;           // Virtual key or MouseButton
+        bool        repeat;         // Auto-repeated KeyDown
+        int32_t     x;              // Cursor position, or wheel delta in x
+        int32_t     y;
+    };
+
+    // Records input as it arrives on the window message path, each event stamped with the
+    // high-resolution clock, so the game sees every transition in order with its true time
+    // rather than one snapshot per update. Presses shorter than a frame are never lost.
+    // Pushing and consuming may happen on different threads (one each).
+    class InputEventQueue
+    {
+    public:
+        static const size_t Capacity = 512;
+
+        struct Statistics
+        {
+            uint64_t    pushed;
+            uint64_t    consumed;
+            uint64_t    dropped;            // Events lost because the queue was full
+            uint64_t    totalLatencyTicks;  // Sum over consumed events of consume time - timestamp
+            uint64_t    maxLatencyTicks;
+        };
+
+        InputEventQueue() noexcept;
+
+        InputEventQueue(InputEventQueue const&) = delete;
+        InputEventQueue& operator= (InputEventQueue const&) = delete;
+
+        // Current time on the same clock as InputEvent::timestamp.
+        static uint64_t GetTimestamp();
+
+        // Producer side. Returns false and counts a drop if the queue is full.
+        bool Push(const InputEvent& event);
+
+        // Translates keyboard and mouse window messages; anything else is ignored. Returns
+        // true if the message produced an event.
+        bool ProcessMessage(UINT message, WPARAM wParam, LPARAM lParam);
+
+        // Consumer side. Calls handler(const InputEvent&) for every queued event in arrival
+        // order, measuring latency against 'now'. Returns the number of events delivered.
+        template<typename Handler>
+        size_t Consume(uint64_t now, Handler&& handler)
+        {
+            size_t count = 0;
+            InputEvent event;
+            while (m_queue.TryPop(event))
+            {
+                uint64_t latency = (now > event.timestamp) ? now - event.timestamp : 0;
+                m_totalLatency += latency;
+                if (latency > m_maxLatency)
+                    m_maxLatency = latency;
+
+                handler(event);
+                ++count;
+            }
+
+            m_consumed += count;
+            return count;
+        }
+
+        // Consumer side.
+        Statistics GetStatistics() const;
+
+    private:
+        SpscQueue<InputEvent, Capacity> m_queue;
+
+        // Producer side; read by GetStatistics.
+        std::atomic<uint64_t>           m_pushed;
+        std::atomic<uint64_t>           m_dropped;
+
+        // Consumer side.
+        uint64_t                        m_consumed;
+        uint64_t                        m_totalLatency;
+        uint64_t                        m_maxLatency;
+    };
+}
@@ -0,0 +1,426 @@
+//
+// MSADPCM.cpp
+//
+
+#include "pch.h"
+#include "MSADPCM.h"
+
+#include <atomic>
+#include <thread>
+
+using namespace DX;
+
+const int16_t MSADPCM::Coefficients[MSADPCM::NumCoefficients][2] =
+{
+    { 256,    0 },
+    { 512, -256 },
+    {   0,    0 },
+    { 192,   64 },
+    { 240,    0 },
+    { 460, -208 },
+    { 392, -232 },
+};
+
+const int16_t MSADPCM::AdaptationTable[16] =
+{
+    230, 230, 230, 230, 307, 409, 512, 614,
+    768, 614, 512, 409, 307, 230, 230, 230,
+};
+
+namespace
+{
+    const uint32_t c_maxChannels = 8;
+
+    struct ChannelState
+    {
+        int32_t coef1;
+        int32_t coef2;
+        int32_t delta;
+        int32_t sample1;
+        int32_t sample2;
+    };
+
+    inline int16_t ReadInt16(const uint8_t* ptr)
+    {
+        return static_cast<int16_t>(ptr[0] | (ptr[1] << 8));
+    }
+
+    inline int16_t ExpandNibble(ChannelState& state, uint32_t nibble)
+    {
+        int32_t predicted = (state.sample1 * state.coef1 + state.sample2 * state.coef2) >> 8;
+
+        int32_t signedNibble = (nibble & 0x8) ? int32_t(nibble) - 16 : int32_t(nibble);
+        predicted += signedNibble * state.delta;
+
+        if (predicted > 32767)
+            predicted = 32767;
+        else if (predicted < -32768)
+            predicted = -32768;
+
+        state.sample2 = state.sample1;
+        state.sample1 = predicted;
+
+        state.delta = (MSADPCM::AdaptationTable[nibble] * state.delta) >> 8;
+        if (state.delta < 16)
+            state.delta = 16;
+
+        return static_cast<int16_t>(predicted);
+    }
+
+    inline void WriteInt16(uint8_t* ptr, int32_t value)
+    {
+        ptr[0] = static_cast<uint8_t>(value & 0xff);
+        ptr[1] = static_cast<uint8_t>((value >> 8) & 0xff);
+    }
+
+    // Quantizes one sample exactly as the decoder will reconstruct it; returns the 4-bit code.
+    inline uint32_t CompressSample(ChannelState& state, int32_t sample, int32_t& error)
+    {
+        int32_t predicted = (state.sample1 * state.coef1 + state.sample2 * state.coef2) >> 8;
+
+        // Round the residual to the nearest step.
+        int32_t residual = sample - predicted;
+        int32_t code = (residual >= 0)
+            ? (residual + state.delta / 2) / state.delta
+            : -((-residual + state.delta / 2) / state.delta);
+
+        if (code > 7)
+            code = 7;
+        else if (code < -8)
+            code = -8;
+
+        predicted += code * state.delta;
+        if (predicted > 32767)
+            predicted = 32767;
+        else if (predicted < -32768)
+            predicted = -32768;
+
+        error = sample - predicted;
+
+        uint32_t nibble = static_cast<uint32_t>(code) & 0xf;
+
+        state.sample2 = state.sample1;
+        state.sample1 = predicted;
+
+        state.delta = (MSADPCM::AdaptationTable[nibble] * state.delta) >> 8;
+        if (state.delta < 16)
+            state.delta = 16;
+
+        return nibble;
+    }
+
+    // Runs the encoder over one channel of a block. Writes the nibbles when 'nibbles' is
+    // non-null and returns the sum of squared reconstruction errors.
+    uint64_t EncodeChannel(const int32_t* samples, uint32_t count, uint32_t predictor, int32_t delta, uint8_t* nibbles)
+    {
+        ChannelState state;
+        state.coef1 = MSADPCM::Coefficients[predictor][0];
+        state.coef2 = MSADPCM::Coefficients[predictor][1];
+        state.delta = delta;
+        state.sample2 = samples[0];
+        state.sample1 = samples[1];
+
+        uint64_t total = 0;
+        for (uint32_t j = 2; j < count; ++j)
+        {
+            int32_t error;
+            uint32_t nibble = CompressSample(state, samples[j], error);
+            total += uint64_t(int64_t(error) * error);
+
+            if (nibbles)
+                nibbles[j - 2] = static_cast<uint8_t>(nibble);
+        }
+
+        return total;
+    }
+
+    // Open-loop search: squared prediction error of all seven coefficient pairs over the
+    // source signal, evaluated four predictors per vector. Returns the best predictor and its
+    // mean absolute error over the first few samples, which seeds the step size.
+    uint32_t FindPredictor(const int32_t* samples, uint32_t count, int32_t& initialError)
+    {
+        using namespace DirectX;
+
+        static const XMVECTORF32 s_coef1Lo = { { { 256.f / 256.f, 512.f / 256.f, 0.f, 192.f / 256.f } } };
+        static const XMVECTORF32 s_coef1Hi = { { { 240.f / 256.f, 460.f / 256.f, 392.f / 256.f, 0.f } } };
+        static const XMVECTORF32 s_coef2Lo = { { { 0.f, -256.f / 256.f, 0.f, 64.f / 256.f } } };
+        static const XMVECTORF32 s_coef2Hi = { { { 0.f, -208.f / 256.f, -232.f / 256.f, 0.f } } };
+
+        XMVECTOR errLo = XMVectorZero();
+        XMVECTOR errHi = XMVectorZero();
+        XMVECTOR headLo = XMVectorZero();
+        XMVECTOR headHi = XMVectorZero();
+
+        const uint32_t c_headSamples = 4;
+
+        for (uint32_t j = 2; j < count; ++j)
+        {
+            XMVECTOR s1 = XMVectorReplicate(float(samples[j - 1]));
+            XMVECTOR s2 = XMVectorReplicate(float(samples[j - 2]));
+            XMVECTOR x = XMVectorReplicate(float(samples[j]));
+
+            XMVECTOR eLo = XMVectorSubtract(x, XMVectorMultiplyAdd(s2, s_coef2Lo, XMVectorMultiply(s1, s_coef1Lo)));
+            XMVECTOR eHi = XMVectorSubtract(x, XMVectorMultiplyAdd(s2, s_coef2Hi, XMVectorMultiply(s1, s_coef1Hi)));
+
+            errLo = XMVectorMultiplyAdd(eLo, eLo, errLo);
+            errHi = XMVectorMultiplyAdd(eHi, eHi, errHi);
+
+            if (j < 2 + c_headSamples)
+            {
+                headLo = XMVectorAdd(headLo, XMVectorAbs(eLo));
+                headHi = XMVectorAdd(headHi, XMVectorAbs(eHi));
+            }
+        }
+
+        XMFLOAT4 lo, hi, hLo, hHi;
+        XMStoreFloat4(&lo, errLo);
+        XMStoreFloat4(&hi, errHi);
+        XMStoreFloat4(&hLo, headLo);
+        XMStoreFloat4(&hHi, headHi);
+
+        // Lane 3 of the high vector is padding.
+        const float errors[MSADPCM::NumCoefficients] = { lo.x, lo.y, lo.z, lo.w, hi.x, hi.y, hi.z };
+        const float heads[MSADPCM::NumCoefficients] = { hLo.x, hLo.y, hLo.z, hLo.w, hHi.x, hHi.y, hHi.z };
+
+        uint32_t best = 0;
+        for (uint32_t p = 1; p < MSADPCM::NumCoefficients; ++p)
+        {
+            if (errors[p] < errors[best])
+                best = p;
+        }
+
+        uint32_t headCount = std::min(c_headSamples, count > 2 ? count - 2 : 0);
+        initialError = headCount ? static_cast<int32_t>(heads[best] / float(headCount)) : 0;
+        return best;
+    }
+
+    // A step of about half the typical residual keeps the first codes away from saturation.
+    inline int32_t InitialDelta(int32_t error)
+    {
+        return std::min(std::max(error / 2, 16), 32767);
+    }
+}
+
+bool MSADPCM::DecodeBlock(const uint8_t* block, size_t blockAlign, uint32_t channels, int16_t* output)
+{
+    if (!block || !output || !channels || channels > c_maxChannels)
+        return false;
+
+    uint32_t samplesPerBlock = SamplesPerBlock(static_cast<uint32_t>(blockAlign), channels);
+    if (samplesPerBlock < 2)
+        return false;
+
+    // The preamble is stored as arrays of each field, one entry per channel.
+    ChannelState state[c_maxChannels];
+
+    const uint8_t* ptr = block;
+    for (uint32_t ch = 0; ch < channels; ++ch)
+    {
+        uint8_t predictor = *ptr++;
+        if (predictor >= NumCoefficients)
+            return false;
+
+        state[ch].coef1 = Coefficients[predictor][0];
+        state[ch].coef2 = Coefficients[predictor][1];
+    }
+
+    for (uint32_t ch = 0; ch < channels; ++ch, ptr += 2)
+        state[ch].delta = ReadInt16(ptr);
+
+    for (uint32_t ch = 0; ch < channels; ++ch, ptr += 2)
+        state[ch].sample1 = ReadInt16(ptr);
+
+    for (uint32_t ch = 0; ch < channels; ++ch, ptr += 2)
+        state[ch].sample2 = ReadInt16(ptr);
+
+    // The two history samples are the first two output frames, oldest first.
+    for (uint32_t ch = 0; ch < channels; ++ch)
+    {
+        output[ch] = static_cast<int16_t>(state[ch].sample2);
+        output[channels + ch] = static_cast<int16_t>(state[ch].sample1);
+    }
+
+    // Remaining samples are packed two per byte, high nibble first, interleaved by channel.
+    int16_t* dest = output + 2 * channels;
+    const uint8_t* end = block + blockAlign;
+    uint32_t ch = 0;
+
+    for (; ptr < end; ++ptr)
+    {
+        *dest++ = ExpandNibble(state[ch], *ptr >> 4);
+        ch = (ch + 1 == channels) ? 0 : ch + 1;
+
+        *dest++ = ExpandNibble(state[ch], *ptr & 0xf);
+        ch = (ch + 1 == channels) ? 0 : ch + 1;
+    }
+
+    return true;
+}
+
+bool MSADPCM::EncodeBlock(const int16_t* input, size_t frames, uint32_t channels, size_t blockAlign, uint8_t* block,
+    EncodeScratch& scratch, EncodeMode mode)
+{
+    if (!input || !block || !channels || channels > c_maxChannels)
+        return false;
+
+    const uint32_t samplesPerBlock = SamplesPerBlock(static_cast<uint32_t>(blockAlign), channels);
+    if (samplesPerBlock < 2 || !frames || frames > samplesPerBlock)
+        return false;
+
+    uint8_t predictors[c_maxChannels];
+    int32_t deltas[c_maxChannels];
+    int32_t history[c_maxChannels][2];
+
+    scratch.samples.resize(samplesPerBlock);
+    scratch.nibbles.resize(size_t(samplesPerBlock) * channels);
+
+    int32_t* samples = scratch.samples.data();
+    uint8_t* nibbles = scratch.nibbles.data();
+
+    for (uint32_t ch = 0; ch < channels; ++ch)
+    {
+        for (size_t j = 0; j < samplesPerBlock; ++j)
+            samples[j] = (j < frames) ? input[j * channels + ch] : 0;
+
+        int32_t error;
+        uint32_t predictor = FindPredictor(samples, samplesPerBlock, error);
+        int32_t delta = InitialDelta(error);
+
+        if (mode == EncodeMode::Quality)
+        {
+            // Closed loop: the decoder's own reconstruction decides. Padding in a short final
+            // block is left out of the comparison.
+            const uint32_t measured = static_cast<uint32_t>(std::max(frames, size_t(2)));
+            static const int32_t s_deltaScale[] = { 64, 128, 181, 256, 362, 512 };
+
+            uint64_t bestError = UINT64_MAX;
+            uint32_t bestPredictor = predictor;
+            int32_t bestDelta = delta;
+
+            for (uint32_t p = 0; p < NumCoefficients; ++p)
+            {
+                for (int32_t scale : s_deltaScale)
+                {
+                    int32_t candidate = std::min(std::max((delta * scale) >> 8, 16), 32767);
+                    uint64_t total = EncodeChannel(samples, measured, p, candidate, nullptr);
+                    if (total < bestError)
+                    {
+                        bestError = total;
+                        bestPredictor = p;
+                        bestDelta = candidate;
+                    }
+                }
+            }
+
+            predictor = bestPredictor;
+            delta = bestDelta;
+        }
+
+        EncodeChannel(samples, samplesPerBlock, predictor, delta, nibbles + size_t(ch) * samplesPerBlock);
+
+        predictors[ch] = static_cast<uint8_t>(predictor);
+        deltas[ch] = delta;
+        history[ch][0] = samples[1];
+        history[ch][1] = samples[0];
+    }
+
+    // Preamble, as arrays of each field.
+    uint8_t* ptr = block;
+    for (uint32_t ch = 0; ch < channels; ++ch)
+        *ptr++ = predictors[ch];
+
+    for (uint32_t ch = 0; ch < channels; ++ch, ptr += 2)
+        WriteInt16(ptr, deltas[ch]);
+
+    for (uint32_t ch = 0; ch < channels; ++ch, ptr += 2)
+        WriteInt16(ptr, history[ch][0]);
+
+    for (uint32_t ch = 0; ch < channels; ++ch, ptr += 2)
+        WriteInt16(ptr, history[ch][1]);
+
+    // Nibbles interleaved by channel, high nibble first.
+    const uint8_t* end = block + blockAlign;
+    uint32_t ch = 0;
+    size_t index = 0;
+
+    for (; ptr < end; ++ptr)
+    {
+        uint8_t high = nibbles[size_t(ch) * samplesPerBlock + index];
+        if (++ch == channels)
+        {
+            ch = 0;
+            ++index;
+        }
+
+        uint8_t low = nibbles[size_t(ch) * samplesPerBlock + index];
+        if (++ch == channels)
+        {
+            ch = 0;
+            ++index;
+        }
+
+        *ptr = static_cast<uint8_t>((high << 4) | low);
+    }
+
+    return true;
+}
+
+std::vector<uint8_t> MSADPCM::Encode(const int16_t* input, size_t frames, uint32_t channels, uint32_t blockAlign, EncodeMode mode, uint32_t threadCount)
+{
+    const uint32_t samplesPerBlock = SamplesPerBlock(blockAlign, channels);
+    if (!input || samplesPerBlock < 2 || channels > c_maxChannels)
+        throw std::invalid_argument("MSADPCM::Encode");
+
+    const size_t blockCount = (frames + samplesPerBlock - 1) / samplesPerBlock;
+    std::vector<uint8_t> output(blockCount * blockAlign);
+
+    // Workers cannot throw across the join, so a failed block is reported through a flag.
+    std::atomic<bool> failed(false);
+
+    auto encodeRange = [&](size_t first, size_t last)
+    {
+        EncodeScratch scratch;
+        for (size_t b = first; b < last && !failed.load(std::memory_order_relaxed); ++b)
+        {
+            size_t start = b * samplesPerBlock;
+            size_t count = std::min(size_t(samplesPerBlock), frames - start);
+            if (!EncodeBlock(input + start * channels, count, channels, blockAlign, &output[b * blockAlign], scratch, mode))
+                failed.store(true, std::memory_order_relaxed);
+        }
+    };
+
+    if (!threadCount)
+        threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+    // Contiguous ranges keep each thread's writes in separate cache lines.
+    size_t workers = std::min(size_t(threadCount), blockCount);
+    if (workers <= 1)
+    {
+        encodeRange(0, blockCount);
+    }
+    else
+    {
+
+        std::vector<std::thread> threads;
+        threads.reserve(workers - 1);
+
+        size_t perWorker = (blockCount + workers - 1) / workers;
+        for (size_t w = 1; w < workers; ++w)
+        {
+            size_t first = w * perWorker;
+            size_t last = std::min(first + perWorker, blockCount);
+            if (first < last)
+                threads.emplace_back(encodeRange, first, last);
+        }
+
+        encodeRange(0, std::min(perWorker, blockCount));
+
+        for (auto& thread : threads)
+            thread.join();
+    }
+
+    if (failed)
+        throw std::runtime_error("MSADPCM::Encode: failed to encode a block");
+
+    return output;
+}
@@ -0,0 +1,70 @@
+//
+// MSADPCM.h - Software codec for Microsoft ADPCM (WAVE_FORMAT_ADPCM) audio
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace DX
+{
+    namespace MSADPCM
+    {
+        // The standard coefficient pairs every MS-ADPCM stream uses.
+        const uint32_t NumCoefficients = 7;
+        extern const int16_t Coefficients[NumCoefficients][2];
+
+        // Step size adaptation table indexed by the 4-bit code.
+        extern const int16_t AdaptationTable[16];
+
+        // Size of the per-channel block preamble (predictor, delta, and two history samples).
+        const uint32_t BlockHeaderSize = 7;
+
+        // Number of PCM frames produced by one block.
+        inline uint32_t SamplesPerBlock(uint32_t blockAlign, uint32_t channels)
+        {
+            if (!channels || blockAlign < BlockHeaderSize * channels)
+                return 0;
+
+            return ((blockAlign - BlockHeaderSize * channels) * 2) / channels + 2;
+        }
+
+        // Decodes one complete block into interleaved 16-bit PCM. 'output' must hold
+        // SamplesPerBlock(blockAlign, channels) * channels samples. Returns false if
+        // the block is malformed.
+        bool DecodeBlock(const uint8_t* block, size_t blockAlign, uint32_t channels, int16_t* output);
+
+        enum class EncodeMode
+        {
+            // Picks each channel's predictor from the open-loop prediction error of all seven
+            // coefficient pairs at once, then encodes a single pass.
+            Fast,
+
+            // Trial-encodes every predictor against several initial step sizes and keeps the
+            // one with the lowest reconstruction error. Roughly 30x the work of Fast.
+            Quality,
+        };
+
+        // Working memory for EncodeBlock. Keep one per thread and reuse it for every block, so
+        // encoding a stream allocates only while the buffers grow to the block size.
+        struct EncodeScratch
+        {
+            std::vector<int32_t>    samples;
+            std::vector<uint8_t>    nibbles;
+        };
+
+        // Encodes up to SamplesPerBlock(blockAlign, channels) interleaved frames into one block;
+        // a short final block is padded with silence. Returns false on invalid parameters.
+        bool EncodeBlock(const int16_t* input, size_t frames, uint32_t channels, size_t blockAlign, uint8_t* block,
+            EncodeScratch& scratch, EncodeMode mode = EncodeMode::Fast);
+
+        // Encodes a whole interleaved PCM buffer. Blocks are independent so they are spread
+        // across 'threadCount' threads (0 uses one per hardware thread). The result is a whole
+        // number of blocks. Throws std::invalid_argument on invalid parameters and
+        // std::runtime_error if a block fails to encode.
+        std::vector<uint8_t> Encode(const int16_t* input, size_t frames, uint32_t channels, uint32_t blockAlign,
+            EncodeMode mode = EncodeMode::Fast, uint32_t threadCount = 0);
+    }
+}
@@ -313,16 +313,22 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
     case WM_XBUTTONDOWN:
     case WM_XBUTTONUP:
     case WM_MOUSEHOVER:
+        if (game)
+            game->OnInputMessage(message, wParam, lParam);
         Mouse::ProcessMessage(message, wParam, lParam);
         break;
 
     case WM_KEYDOWN:
     case WM_KEYUP:
     case WM_SYSKEYUP:
+        if (game)
+            game->OnInputMessage(message, wParam, lParam);
         Keyboard::ProcessMessage(message, wParam, lParam);
         break;
 
     case WM_SYSKEYDOWN:
+        if (game)
+            game->OnInputMessage(message, wParam, lParam);
         if (wParam == VK_RETURN && (lParam & 0x60000000) == 0x20000000)
         {
             // Implements the classic ALT+ENTER fullscreen toggle
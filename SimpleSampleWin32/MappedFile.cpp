@@ -0,0 +1,88 @@
+//
+// MappedFile.cpp
+//
+
+#include "pch.h"
+#include "MappedFile.h"
+
+using namespace DX;
+
+MappedFile::MappedFile(const wchar_t* szFileName) noexcept(false) :
+    m_data(nullptr),
+    m_size(0)
+{
+    Open(szFileName);
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+MappedFile::MappedFile(MappedFile&& moveFrom) noexcept :
+    m_data(moveFrom.m_data),
+    m_size(moveFrom.m_size)
+{
+    moveFrom.m_data = nullptr;
+    moveFrom.m_size = 0;
+}
+
+MappedFile& MappedFile::operator= (MappedFile&& moveFrom) noexcept
+{
+    if (this != &moveFrom)
+    {
+        Close();
+        m_data = moveFrom.m_data;
+        m_size = moveFrom.m_size;
+        moveFrom.m_data = nullptr;
+        moveFrom.m_size = 0;
+    }
+    return *this;
+}
+
+void MappedFile::Open(const wchar_t* szFileName)
+{
+    Close();
+
+    HANDLE hFile = CreateFileW(szFileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE)
+        throw std::runtime_error("MappedFile: failed to open file");
+
+    LARGE_INTEGER fileSize = {};
+    if (!GetFileSizeEx(hFile, &fileSize))
+    {
+        CloseHandle(hFile);
+        throw std::runtime_error("MappedFile: GetFileSizeEx");
+    }
+
+    if (fileSize.QuadPart > 0)
+    {
+        HANDLE hMapping = CreateFileMappingW(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(hFile);
+        if (!hMapping)
+            throw std::runtime_error("MappedFile: CreateFileMapping");
+
+        void* view = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(hMapping);
+        if (!view)
+            throw std::runtime_error("MappedFile: MapViewOfFile");
+
+        m_data = static_cast<const uint8_t*>(view);
+        m_size = static_cast<size_t>(fileSize.QuadPart);
+    }
+    else
+    {
+        CloseHandle(hFile);
+    }
+}
+
+void MappedFile::Close() noexcept
+{
+    if (m_data)
+    {
+        UnmapViewOfFile(m_data);
+        m_data = nullptr;
+    }
+    m_size = 0;
+}
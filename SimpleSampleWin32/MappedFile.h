@@ -0,0 +1,37 @@
+//
+// MappedFile.h - Read-only memory-mapped view of a file
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace DX
+{
+    // Maps an entire file into the address space so it can be parsed and used in place.
+    // The handles are released as soon as the view exists; only the view is kept.
+    class MappedFile
+    {
+    public:
+        MappedFile() noexcept : m_data(nullptr), m_size(0) {}
+        explicit MappedFile(const wchar_t* szFileName) noexcept(false);
+        ~MappedFile();
+
+        MappedFile(MappedFile&& moveFrom) noexcept;
+        MappedFile& operator= (MappedFile&& moveFrom) noexcept;
+
+        MappedFile(MappedFile const&) = delete;
+        MappedFile& operator= (MappedFile const&) = delete;
+
+        void Open(const wchar_t* szFileName);
+        void Close() noexcept;
+
+        const uint8_t* GetData() const { return m_data; }
+        size_t GetSize() const { return m_size; }
+
+    private:
+        const uint8_t*  m_data;
+        size_t          m_size;
+    };
+}
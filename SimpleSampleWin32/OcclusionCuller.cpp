@@ -0,0 +1,457 @@
+//
+// OcclusionCuller.cpp
+//
+
+#include "pch.h"
+#include "OcclusionCuller.h"
+
+#include <math.h>
+
+#if defined(_XM_SSE_INTRINSICS_) && !defined(_XM_NO_INTRINSICS_)
+#include <emmintrin.h>
+#endif
+
+using namespace DX;
+using namespace DirectX;
+
+namespace
+{
+    // Vertices closer to the eye plane than this cannot be projected safely.
+    const float c_minW = 1e-4f;
+
+    const uint32_t c_fullTile = 0xFFFFFFFFu;
+
+    // Coverage bits of the columns [x0, x1) in every row [y0, y1) of a tile.
+    uint32_t RectMask(unsigned int x0, unsigned int x1, unsigned int y0, unsigned int y1)
+    {
+        uint32_t row = ((1u << (x1 - x0)) - 1u) << x0;
+        uint32_t mask = 0;
+        for (unsigned int y = y0; y < y1; ++y)
+        {
+            mask |= row << (y * OcclusionCuller::TileWidth);
+        }
+        return mask;
+    }
+}
+
+OcclusionCuller::OcclusionCuller(unsigned int width, unsigned int height, WorkerPool& workers) noexcept(false) :
+    m_width(width),
+    m_height(height),
+    m_tilesX(width / TileWidth),
+    m_tilesY(height / TileHeight),
+    m_blocksX(m_tilesX / BlockTiles),
+    m_blocksY(m_tilesY / BlockTiles),
+    m_stats{},
+    m_workers(workers)
+{
+    static_assert(TileWidth * TileHeight == 32, "A tile's coverage must fit in 32 bits");
+
+    if (!width || !height || (width % (TileWidth * BlockTiles)) || (height % (TileHeight * BlockTiles)))
+        throw std::invalid_argument("OcclusionCuller size must be a non-zero multiple of 32x16");
+
+    XMStoreFloat4x4(&m_viewProjection, XMMatrixIdentity());
+
+    m_tiles.resize(size_t(m_tilesX) * m_tilesY);
+    m_blocks.resize(size_t(m_blocksX) * m_blocksY);
+
+    BeginFrame(XMMatrixIdentity());
+}
+
+void XM_CALLCONV OcclusionCuller::BeginFrame(FXMMATRIX viewProjection)
+{
+    XMStoreFloat4x4(&m_viewProjection, viewProjection);
+
+    for (auto& tile : m_tiles)
+    {
+        tile.zMax0 = 1.f;
+        tile.zMax1 = 0.f;
+        tile.mask = 0;
+    }
+
+    for (auto& block : m_blocks)
+    {
+        block = 1.f;
+    }
+
+    m_triangles.clear();
+    m_stats = {};
+}
+
+void XM_CALLCONV OcclusionCuller::AddOccluder(const XMFLOAT3* positions, size_t stride, size_t vertexCount,
+    const uint16_t* indices, size_t indexCount, FXMMATRIX world, CullMode cullMode)
+{
+    if (!positions || !indices || !stride)
+        throw std::invalid_argument("OcclusionCuller::AddOccluder needs positions and indices");
+
+    XMMATRIX transform = XMMatrixMultiply(world, XMLoadFloat4x4(&m_viewProjection));
+
+    m_clipPositions.resize(vertexCount);
+    auto source = reinterpret_cast<const uint8_t*>(positions);
+    for (size_t i = 0; i < vertexCount; ++i, source += stride)
+    {
+        XMVECTOR position = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(source));
+        XMStoreFloat4(&m_clipPositions[i], XMVector3Transform(position, transform));
+    }
+
+    for (size_t i = 0; i + 2 < indexCount; i += 3)
+    {
+        ++m_stats.occluderTriangles;
+
+        if (indices[i] >= vertexCount || indices[i + 1] >= vertexCount || indices[i + 2] >= vertexCount)
+            throw std::out_of_range("OcclusionCuller::AddOccluder index out of range");
+
+        SetupTriangle(XMLoadFloat4(&m_clipPositions[indices[i]]),
+            XMLoadFloat4(&m_clipPositions[indices[i + 1]]),
+            XMLoadFloat4(&m_clipPositions[indices[i + 2]]),
+            cullMode);
+    }
+}
+
+void XM_CALLCONV OcclusionCuller::SetupTriangle(FXMVECTOR v0, FXMVECTOR v1, FXMVECTOR v2, CullMode cullMode)
+{
+    XMFLOAT4 clip[3];
+    XMStoreFloat4(&clip[0], v0);
+    XMStoreFloat4(&clip[1], v1);
+    XMStoreFloat4(&clip[2], v2);
+
+    float x[3], y[3], z[3];
+    for (unsigned int i = 0; i < 3; ++i)
+    {
+        if (clip[i].w < c_minW)
+            return;
+
+        float invW = 1.f / clip[i].w;
+        x[i] = (clip[i].x * invW * 0.5f + 0.5f) * float(m_width);
+        y[i] = (0.5f - clip[i].y * invW * 0.5f) * float(m_height);
+        z[i] = clip[i].z * invW;
+    }
+
+    // Positive when the triangle is clockwise on screen, where y points down.
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (area == 0.f
+        || (cullMode == CullClockwise && area > 0.f)
+        || (cullMode == CullCounterClockwise && area < 0.f))
+    {
+        return;
+    }
+
+    if (area < 0.f)
+    {
+        std::swap(x[1], x[2]);
+        std::swap(y[1], y[2]);
+        std::swap(z[1], z[2]);
+        area = -area;
+    }
+
+    float minX = std::min(std::min(x[0], x[1]), x[2]);
+    float maxX = std::max(std::max(x[0], x[1]), x[2]);
+    float minY = std::min(std::min(y[0], y[1]), y[2]);
+    float maxY = std::max(std::max(y[0], y[1]), y[2]);
+    if (maxX <= 0.f || maxY <= 0.f || minX >= float(m_width) || minY >= float(m_height))
+        return;
+
+    Triangle triangle;
+    for (unsigned int i = 0; i < 3; ++i)
+    {
+        unsigned int j = (i + 1) % 3;
+        float dx = x[j] - x[i];
+        float dy = y[j] - y[i];
+        triangle.edgeA[i] = -dy;
+        triangle.edgeB[i] = dx;
+        triangle.edgeC[i] = x[i] * dy - y[i] * dx;
+    }
+
+    triangle.zA = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+    triangle.zB = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) / area;
+    triangle.zC = z[0] - triangle.zA * x[0] - triangle.zB * y[0];
+    triangle.zMin = std::min(std::min(z[0], z[1]), z[2]);
+    triangle.zMax = std::max(std::max(z[0], z[1]), z[2]);
+
+    triangle.tileX0 = static_cast<uint32_t>(std::max(minX, 0.f)) / TileWidth;
+    triangle.tileY0 = static_cast<uint32_t>(std::max(minY, 0.f)) / TileHeight;
+    triangle.tileX1 = static_cast<uint32_t>(std::min(maxX, float(m_width - 1))) / TileWidth;
+    triangle.tileY1 = static_cast<uint32_t>(std::min(maxY, float(m_height - 1))) / TileHeight;
+
+    m_triangles.push_back(triangle);
+    ++m_stats.rasterizedTriangles;
+}
+
+void OcclusionCuller::Rasterize()
+{
+    // Bands are whole block rows, so each worker also owns the blocks it finishes.
+    unsigned int workers = m_workers.GetWorkerCount();
+    unsigned int blockRows = m_blocksY;
+
+    m_workers.Run([this, workers, blockRows](unsigned int worker)
+    {
+        RasterizeBand(blockRows * worker / workers, blockRows * (worker + 1) / workers);
+    });
+}
+
+void OcclusionCuller::RasterizeBand(unsigned int blockRowBegin, unsigned int blockRowEnd)
+{
+    if (blockRowBegin >= blockRowEnd)
+        return;
+
+    unsigned int rowBegin = blockRowBegin * BlockTiles;
+    unsigned int rowEnd = blockRowEnd * BlockTiles;
+
+    for (auto& triangle : m_triangles)
+    {
+        unsigned int y0 = std::max(triangle.tileY0, rowBegin);
+        unsigned int y1 = std::min(triangle.tileY1 + 1, rowEnd);
+
+        for (unsigned int ty = y0; ty < y1; ++ty)
+        {
+            Tile* row = &m_tiles[size_t(ty) * m_tilesX];
+            float tileY = float(ty * TileHeight);
+
+            for (unsigned int tx = triangle.tileX0; tx <= triangle.tileX1; ++tx)
+            {
+                Tile& tile = row[tx];
+
+                // Nothing behind what the tile already guarantees can help.
+                if (triangle.zMin >= tile.zMax0)
+                    continue;
+
+                float tileX = float(tx * TileWidth);
+                uint32_t coverage = TileCoverage(triangle, tileX, tileY);
+                if (!coverage)
+                    continue;
+
+                // The plane is farthest at one of the tile's corners.
+                float z = triangle.zA * tileX + triangle.zB * tileY + triangle.zC
+                    + std::max(triangle.zA * float(TileWidth), 0.f)
+                    + std::max(triangle.zB * float(TileHeight), 0.f);
+
+                UpdateTile(tile, coverage, std::min(z, triangle.zMax));
+            }
+        }
+    }
+
+    for (unsigned int by = blockRowBegin; by < blockRowEnd; ++by)
+    {
+        for (unsigned int bx = 0; bx < m_blocksX; ++bx)
+        {
+            float farthest = 0.f;
+            for (unsigned int ty = by * BlockTiles; ty < (by + 1) * BlockTiles; ++ty)
+            {
+                const Tile* row = &m_tiles[size_t(ty) * m_tilesX + bx * BlockTiles];
+                for (unsigned int tx = 0; tx < BlockTiles; ++tx)
+                {
+                    farthest = std::max(farthest, row[tx].zMax0);
+                }
+            }
+            m_blocks[size_t(by) * m_blocksX + bx] = farthest;
+        }
+    }
+}
+
+// Returns a bit for each pixel of the tile at (x, y) whose center is inside the triangle.
+uint32_t OcclusionCuller::TileCoverage(const Triangle& triangle, float x, float y)
+{
+#if defined(_XM_SSE_INTRINSICS_) && !defined(_XM_NO_INTRINSICS_)
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 columns = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+
+    __m128 left[3];
+    __m128 right[3];
+    __m128 stepY[3];
+    for (unsigned int i = 0; i < 3; ++i)
+    {
+        __m128 a = _mm_set1_ps(triangle.edgeA[i]);
+        float origin = triangle.edgeA[i] * x + triangle.edgeB[i] * (y + 0.5f) + triangle.edgeC[i];
+        left[i] = _mm_add_ps(_mm_set1_ps(origin), _mm_mul_ps(a, columns));
+        right[i] = _mm_add_ps(left[i], _mm_mul_ps(a, _mm_set1_ps(4.f)));
+        stepY[i] = _mm_set1_ps(triangle.edgeB[i]);
+    }
+
+    uint32_t mask = 0;
+    for (unsigned int row = 0; row < TileHeight; ++row)
+    {
+        __m128 insideLeft = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(left[0], zero), _mm_cmpge_ps(left[1], zero)), _mm_cmpge_ps(left[2], zero));
+        __m128 insideRight = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(right[0], zero), _mm_cmpge_ps(right[1], zero)), _mm_cmpge_ps(right[2], zero));
+
+        uint32_t bits = uint32_t(_mm_movemask_ps(insideLeft)) | (uint32_t(_mm_movemask_ps(insideRight)) << 4);
+        mask |= bits << (row * TileWidth);
+
+        for (unsigned int i = 0; i < 3; ++i)
+        {
+            left[i] = _mm_add_ps(left[i], stepY[i]);
+            right[i] = _mm_add_ps(right[i], stepY[i]);
+        }
+    }
+    return mask;
+#else
+    uint32_t mask = 0;
+    for (unsigned int row = 0; row < TileHeight; ++row)
+    {
+        float py = y + float(row) + 0.5f;
+        for (unsigned int column = 0; column < TileWidth; ++column)
+        {
+            float px = x + float(column) + 0.5f;
+
+            bool inside = true;
+            for (unsigned int i = 0; i < 3; ++i)
+            {
+                inside = inside && (triangle.edgeA[i] * px + triangle.edgeB[i] * py + triangle.edgeC[i] >= 0.f);
+            }
+
+            if (inside)
+                mask |= 1u << (row * TileWidth + column);
+        }
+    }
+    return mask;
+#endif
+}
+
+// Merges a triangle's coverage into a tile. When the triangle's depth is closer to the tile
+// depth than to the working layer's, the working layer is dropped and started over, rather
+// than pushing its depth back to cover both.
+void OcclusionCuller::UpdateTile(Tile& tile, uint32_t coverage, float z)
+{
+    if (z >= tile.zMax0)
+        return;
+
+    if (fabsf(z - tile.zMax1) > tile.zMax0 - z)
+    {
+        tile.mask = 0;
+        tile.zMax1 = 0.f;
+    }
+
+    tile.zMax1 = tile.mask ? std::max(tile.zMax1, z) : z;
+    tile.mask |= coverage;
+
+    if (tile.mask == c_fullTile)
+    {
+        tile.zMax0 = tile.zMax1;
+        tile.zMax1 = 0.f;
+        tile.mask = 0;
+    }
+}
+
+bool XM_CALLCONV OcclusionCuller::IsVisible(const BoundingBox& box, FXMMATRIX world) const
+{
+    XMMATRIX transform = XMMatrixMultiply(world, XMLoadFloat4x4(&m_viewProjection));
+
+    XMVECTOR center = XMLoadFloat3(&box.Center);
+    XMVECTOR extents = XMLoadFloat3(&box.Extents);
+
+    float minX = float(m_width);
+    float minY = float(m_height);
+    float maxX = 0.f;
+    float maxY = 0.f;
+    float zNear = 1.f;
+    for (unsigned int corner = 0; corner < 8; ++corner)
+    {
+        XMVECTOR sign = XMVectorSet((corner & 1) ? 1.f : -1.f, (corner & 2) ? 1.f : -1.f, (corner & 4) ? 1.f : -1.f, 0.f);
+        XMFLOAT4 clip;
+        XMStoreFloat4(&clip, XMVector3Transform(XMVectorMultiplyAdd(sign, extents, center), transform));
+
+        // Anything reaching behind the camera can cover any part of the screen.
+        if (clip.w < c_minW)
+            return true;
+
+        float invW = 1.f / clip.w;
+        float x = (clip.x * invW * 0.5f + 0.5f) * float(m_width);
+        float y = (0.5f - clip.y * invW * 0.5f) * float(m_height);
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+        zNear = std::min(zNear, clip.z * invW);
+    }
+
+    // Every pixel the box touches, not just those whose centers it covers.
+    int x0 = std::max(int(floorf(minX)), 0);
+    int y0 = std::max(int(floorf(minY)), 0);
+    int x1 = std::min(int(ceilf(maxX)), int(m_width));
+    int y1 = std::min(int(ceilf(maxY)), int(m_height));
+    if (x0 >= x1 || y0 >= y1)
+        return false;
+
+    const unsigned int blockWidth = TileWidth * BlockTiles;
+    const unsigned int blockHeight = TileHeight * BlockTiles;
+
+    for (unsigned int by = unsigned(y0) / blockHeight; by <= unsigned(y1 - 1) / blockHeight; ++by)
+    {
+        for (unsigned int bx = unsigned(x0) / blockWidth; bx <= unsigned(x1 - 1) / blockWidth; ++bx)
+        {
+            if (zNear >= m_blocks[size_t(by) * m_blocksX + bx])
+                continue;
+
+            unsigned int tx0 = std::max(unsigned(x0) / TileWidth, bx * BlockTiles);
+            unsigned int tx1 = std::min(unsigned(x1 - 1) / TileWidth, (bx + 1) * BlockTiles - 1);
+            unsigned int ty0 = std::max(unsigned(y0) / TileHeight, by * BlockTiles);
+            unsigned int ty1 = std::min(unsigned(y1 - 1) / TileHeight, (by + 1) * BlockTiles - 1);
+
+            for (unsigned int ty = ty0; ty <= ty1; ++ty)
+            {
+                for (unsigned int tx = tx0; tx <= tx1; ++tx)
+                {
+                    const Tile& tile = m_tiles[size_t(ty) * m_tilesX + tx];
+                    if (zNear >= tile.zMax0)
+                        continue;
+
+                    // Pixels under the working layer are bounded by its depth instead.
+                    if (tile.mask && zNear >= tile.zMax1)
+                    {
+                        int left = int(tx * TileWidth);
+                        int top = int(ty * TileHeight);
+                        uint32_t query = RectMask(
+                            unsigned(std::max(x0 - left, 0)), unsigned(std::min(x1 - left, int(TileWidth))),
+                            unsigned(std::max(y0 - top, 0)), unsigned(std::min(y1 - top, int(TileHeight))));
+
+                        if (!(query & ~tile.mask))
+                            continue;
+                    }
+
+                    return true;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+size_t OcclusionCuller::TestVisibility(const BoundingBox* boxes, const XMFLOAT4X4* worlds, size_t count, bool* visible)
+{
+    if (!count)
+        return 0;
+
+    if (!boxes || !worlds || !visible)
+        throw std::invalid_argument("OcclusionCuller::TestVisibility needs boxes, worlds and results");
+
+    unsigned int workers = m_workers.GetWorkerCount();
+    std::vector<size_t> hidden(workers, 0);
+
+    m_workers.Run([&](unsigned int worker)
+    {
+        size_t begin = count * worker / workers;
+        size_t end = count * (worker + 1) / workers;
+        for (size_t i = begin; i < end; ++i)
+        {
+            visible[i] = IsVisible(boxes[i], XMLoadFloat4x4(&worlds[i]));
+            if (!visible[i])
+                ++hidden[worker];
+        }
+    });
+
+    size_t total = 0;
+    for (auto value : hidden)
+    {
+        total += value;
+    }
+    return total;
+}
+
+float OcclusionCuller::GetDepth(unsigned int x, unsigned int y) const
+{
+    if (x >= m_width || y >= m_height)
+        throw std::out_of_range("OcclusionCuller::GetDepth pixel is outside the buffer");
+
+    const Tile& tile = m_tiles[size_t(y / TileHeight) * m_tilesX + x / TileWidth];
+    uint32_t bit = 1u << ((y % TileHeight) * TileWidth + x % TileWidth);
+    return (tile.mask & bit) ? std::min(tile.zMax0, tile.zMax1) : tile.zMax0;
+}
@@ -0,0 +1,124 @@
+//
+// OcclusionCuller.h - CPU occlusion culling against a low-resolution masked depth buffer
+//
+
+#pragma once
+
+#include "WorkerPool.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace DX
+{
+    // Rasterizes occluder triangles on the CPU into a small depth buffer and tests bounding
+    // boxes against it, so objects hidden behind them need not be drawn at all.
+    //
+    // The buffer is stored as 8x4 pixel tiles in the style of masked occlusion culling: each
+    // tile keeps a depth that holds for all of its pixels, plus a working layer of partially
+    // covered pixels with their own farthest depth and a coverage bit per pixel. Triangles
+    // merge into the working layer, which replaces the tile depth once it covers the whole
+    // tile. Every depth is an upper bound, so a box is only reported hidden when it is behind
+    // everything already drawn over it. Tiles are grouped into 4x4 blocks holding their
+    // farthest depth, which box tests check before looking at single tiles.
+    //
+    // Depth is z/w after projection, with 0 at the near plane. Occluders are rasterized in
+    // bands of tile rows, one band per worker of a pool that must outlive the culler.
+    class OcclusionCuller
+    {
+    public:
+        static const unsigned int TileWidth = 8;
+        static const unsigned int TileHeight = 4;
+        static const unsigned int BlockTiles = 4;
+
+        // Which occluder triangles to skip, by their winding on screen as in CommonStates.
+        enum CullMode
+        {
+            CullNone,
+            CullClockwise,
+            CullCounterClockwise,
+        };
+
+        struct Statistics
+        {
+            uint32_t    occluderTriangles;      // Submitted since BeginFrame
+            uint32_t    rasterizedTriangles;    // Left after back faces, near plane crossings and off-screen ones
+        };
+
+        // The size must be a multiple of a block, 32x16 pixels.
+        OcclusionCuller(unsigned int width, unsigned int height, WorkerPool& workers) noexcept(false);
+
+        OcclusionCuller(OcclusionCuller const&) = delete;
+        OcclusionCuller& operator= (OcclusionCuller const&) = delete;
+
+        unsigned int GetWidth() const { return m_width; }
+        unsigned int GetHeight() const { return m_height; }
+        const Statistics& GetStatistics() const { return m_stats; }
+
+        // Clears the depth buffer and sets the camera for this frame's occluders and tests.
+        void XM_CALLCONV BeginFrame(DirectX::FXMMATRIX viewProjection);
+
+        // Queues an indexed triangle list for Rasterize. Triangles that reach behind the near
+        // plane are dropped rather than clipped, which only makes the occluder smaller.
+        void XM_CALLCONV AddOccluder(const DirectX::XMFLOAT3* positions, size_t stride, size_t vertexCount,
+            const uint16_t* indices, size_t indexCount, DirectX::FXMMATRIX world, CullMode cullMode = CullCounterClockwise);
+
+        void Rasterize();
+
+        // False only if the box is hidden by the occluders or entirely off screen. Safe to call
+        // from several threads once Rasterize has returned.
+        bool XM_CALLCONV IsVisible(const DirectX::BoundingBox& box, DirectX::FXMMATRIX world) const;
+
+        // Tests a batch of boxes on the workers and returns how many are hidden.
+        size_t TestVisibility(const DirectX::BoundingBox* boxes, const DirectX::XMFLOAT4X4* worlds, size_t count, bool* visible);
+
+        // The depth a pixel is known to be no farther than.
+        float GetDepth(unsigned int x, unsigned int y) const;
+
+    private:
+        struct Tile
+        {
+            float       zMax0;      // Holds for the whole tile
+            float       zMax1;      // Holds for the pixels in 'mask'
+            uint32_t    mask;       // One bit per pixel, row by row
+        };
+
+        // Edge functions are A * x + B * y + C, inside when all three are at least 0. Depth is
+        // the plane zA * x + zB * y + zC.
+        struct Triangle
+        {
+            float       edgeA[3];
+            float       edgeB[3];
+            float       edgeC[3];
+            float       zA;
+            float       zB;
+            float       zC;
+            float       zMin;
+            float       zMax;
+            uint32_t    tileX0;
+            uint32_t    tileY0;
+            uint32_t    tileX1;     // Inclusive
+            uint32_t    tileY1;
+        };
+
+        void RasterizeBand(unsigned int blockRowBegin, unsigned int blockRowEnd);
+        void XM_CALLCONV SetupTriangle(DirectX::FXMVECTOR v0, DirectX::FXMVECTOR v1, DirectX::FXMVECTOR v2, CullMode cullMode);
+        static uint32_t TileCoverage(const Triangle& triangle, float x, float y);
+        static void UpdateTile(Tile& tile, uint32_t coverage, float z);
+
+        unsigned int                    m_width;
+        unsigned int                    m_height;
+        unsigned int                    m_tilesX;
+        unsigned int                    m_tilesY;
+        unsigned int                    m_blocksX;
+        unsigned int                    m_blocksY;
+        DirectX::XMFLOAT4X4             m_viewProjection;
+        std::vector<Tile>               m_tiles;
+        std::vector<float>              m_blocks;       // Farthest zMax0 of each block's tiles
+        std::vector<Triangle>           m_triangles;
+        std::vector<DirectX::XMFLOAT4>  m_clipPositions;
+        Statistics                      m_stats;
+        WorkerPool&                     m_workers;
+    };
+}
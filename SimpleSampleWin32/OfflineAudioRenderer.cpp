@@ -0,0 +1,220 @@
+//
+// OfflineAudioRenderer.cpp
+//
+
+#include "pch.h"
+#include "OfflineAudioRenderer.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+using namespace DX;
+
+namespace
+{
+    // Streams 16-bit PCM to a .wav file, fixing up the sizes when closed.
+    class WaveFileWriter
+    {
+    public:
+        WaveFileWriter() noexcept : m_file(nullptr), m_dataBytes(0), m_channels(0), m_sampleRate(0) {}
+
+        ~WaveFileWriter()
+        {
+            if (m_file)
+            {
+                fclose(m_file);
+            }
+        }
+
+        WaveFileWriter(WaveFileWriter const&) = delete;
+        WaveFileWriter& operator= (WaveFileWriter const&) = delete;
+
+        void Open(const wchar_t* szFileName, uint32_t sampleRate, uint32_t channels)
+        {
+            if (_wfopen_s(&m_file, szFileName, L"wb") != 0)
+                m_file = nullptr;
+            if (!m_file)
+                throw std::runtime_error("OfflineAudioRenderer: failed to create output file");
+
+            m_sampleRate = sampleRate;
+            m_channels = channels;
+            WriteHeader();
+        }
+
+        void Write(const int16_t* samples, size_t count)
+        {
+            if (fwrite(samples, sizeof(int16_t), count, m_file) != count)
+                throw std::runtime_error("OfflineAudioRenderer: write failed");
+
+            m_dataBytes += static_cast<uint32_t>(count * sizeof(int16_t));
+        }
+
+        void Close()
+        {
+            if (!m_file)
+                return;
+
+            fseek(m_file, 0, SEEK_SET);
+            WriteHeader();
+            fclose(m_file);
+            m_file = nullptr;
+        }
+
+    private:
+        void WriteHeader()
+        {
+            const uint16_t blockAlign = static_cast<uint16_t>(m_channels * sizeof(int16_t));
+
+            uint8_t header[44];
+            uint8_t* ptr = header;
+            auto put32 = [&ptr](uint32_t v) { memcpy(ptr, &v, 4); ptr += 4; };
+            auto put16 = [&ptr](uint16_t v) { memcpy(ptr, &v, 2); ptr += 2; };
+
+            put32(0x46464952);                          // 'RIFF'
+            put32(36 + m_dataBytes);
+            put32(0x45564157);                          // 'WAVE'
+            put32(0x20746d66);                          // 'fmt '
+            put32(16);
+            put16(1);                                   // WAVE_FORMAT_PCM
+            put16(static_cast<uint16_t>(m_channels));
+            put32(m_sampleRate);
+            put32(m_sampleRate * blockAlign);
+            put16(blockAlign);
+            put16(16);
+            put32(0x61746164);                          // 'data'
+            put32(m_dataBytes);
+
+            if (fwrite(header, sizeof(header), 1, m_file) != 1)
+                throw std::runtime_error("OfflineAudioRenderer: write failed");
+        }
+
+        FILE*       m_file;
+        uint32_t    m_dataBytes;
+        uint32_t    m_channels;
+        uint32_t    m_sampleRate;
+    };
+}
+
+OfflineAudioRenderer::OfflineAudioRenderer(uint32_t sampleRate, uint32_t channels) noexcept(false) :
+    m_mixer(sampleRate, channels),
+    m_deviceLossPending(false),
+    m_devicePresent(true),
+    m_criticalError(false),
+    m_silent(false),
+    m_resets(0)
+{
+}
+
+bool OfflineAudioRenderer::Update()
+{
+    if (m_deviceLossPending)
+    {
+        m_deviceLossPending = false;
+        m_devicePresent = false;
+        m_criticalError = true;
+        m_silent = true;
+        m_mixer.StopAll();
+    }
+
+    return !m_silent;
+}
+
+bool OfflineAudioRenderer::Reset()
+{
+    if (!m_devicePresent)
+        return false;
+
+    m_deviceLossPending = false;
+    m_criticalError = false;
+    m_silent = false;
+    m_mixer.StopAll();
+    ++m_resets;
+    return true;
+}
+
+OfflineAudioRenderer::Statistics OfflineAudioRenderer::Run(double seconds, double updateRate, const UpdateFunction& update, const wchar_t* szOutputFile)
+{
+    if (seconds <= 0 || updateRate <= 0)
+        throw std::invalid_argument("OfflineAudioRenderer: invalid duration or update rate");
+
+    WaveFileWriter writer;
+    if (szOutputFile)
+    {
+        writer.Open(szOutputFile, m_mixer.GetSampleRate(), m_mixer.GetChannels());
+    }
+
+    const uint32_t channels = m_mixer.GetChannels();
+    const uint64_t totalFrames = static_cast<uint64_t>(seconds * m_mixer.GetSampleRate());
+    const double framesPerUpdate = m_mixer.GetSampleRate() / updateRate;
+
+    std::vector<float> mix;
+    std::vector<int16_t> pcm;
+
+    Statistics stats = {};
+    uint32_t startResets = m_resets;
+
+    auto start = std::chrono::steady_clock::now();
+
+    uint64_t rendered = 0;
+    double frameClock = 0;
+    while (rendered < totalFrames)
+    {
+        double total = double(rendered) / m_mixer.GetSampleRate();
+        if (update)
+        {
+            update(*this, total, 1.0 / updateRate);
+        }
+        ++stats.updates;
+
+        // Accumulate fractional frames so the update rate need not divide the sample rate.
+        frameClock += framesPerUpdate;
+        uint64_t frames = std::min<uint64_t>(static_cast<uint64_t>(frameClock), totalFrames - rendered);
+        frameClock -= double(static_cast<uint64_t>(frameClock));
+        if (!frames)
+            continue;
+
+        size_t count = size_t(frames) * channels;
+        mix.resize(count);
+        pcm.resize(count);
+
+        if (m_silent)
+        {
+            std::fill(mix.begin(), mix.end(), 0.f);
+        }
+        else
+        {
+            m_mixer.Render(mix.data(), size_t(frames));
+        }
+
+        for (size_t j = 0; j < count; ++j)
+        {
+            float s = mix[j];
+            stats.peak = std::max(stats.peak, std::fabs(s));
+
+            if (s > 1.f || s < -1.f)
+            {
+                ++stats.clippedSamples;
+                s = std::max(-1.f, std::min(1.f, s));
+            }
+            pcm[j] = static_cast<int16_t>(std::lrint(s * 32767.f));
+        }
+
+        if (szOutputFile)
+        {
+            writer.Write(pcm.data(), count);
+        }
+
+        rendered += frames;
+    }
+
+    writer.Close();
+
+    stats.renderSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stats.audioSeconds = double(rendered) / m_mixer.GetSampleRate();
+    stats.realtimeFactor = (stats.renderSeconds > 0) ? stats.audioSeconds / stats.renderSeconds : 0;
+    stats.resets = m_resets - startResets;
+
+    return stats;
+}
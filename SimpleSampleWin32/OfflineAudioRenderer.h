@@ -0,0 +1,65 @@
+//
+// OfflineAudioRenderer.h - Renders audio without a device, as fast as possible
+//
+
+#pragma once
+
+#include "AudioDeviceState.h"
+#include "SoftwareMixer.h"
+
+#include <functional>
+
+namespace DX
+{
+    // Drives a SoftwareMixer from a simulated game loop and optionally writes the result to
+    // a 16-bit .wav file. It also acts as a simulated device: loss and arrival can be injected
+    // to exercise AudioDeviceStateMachine, so audio behaviour can be checked in CI.
+    class OfflineAudioRenderer : public IAudioDevice
+    {
+    public:
+        struct Statistics
+        {
+            double      audioSeconds;
+            double      renderSeconds;      // Wall clock time spent in Run
+            double      realtimeFactor;     // Seconds of audio per second of rendering
+            uint32_t    updates;
+            uint32_t    resets;
+            uint32_t    clippedSamples;
+            float       peak;
+        };
+
+        // Called once per simulated frame before that frame's audio is mixed.
+        using UpdateFunction = std::function<void(OfflineAudioRenderer& renderer, double totalSeconds, double elapsedSeconds)>;
+
+        OfflineAudioRenderer(uint32_t sampleRate = 44100, uint32_t channels = 2) noexcept(false);
+
+        OfflineAudioRenderer(OfflineAudioRenderer const&) = delete;
+        OfflineAudioRenderer& operator= (OfflineAudioRenderer const&) = delete;
+
+        SoftwareMixer& GetMixer() { return m_mixer; }
+
+        // Loss takes effect on the next Update, which then reports a critical error. Output is
+        // silent and voices are gone until a Reset after the device has arrived again.
+        void SimulateDeviceLoss() { m_deviceLossPending = true; }
+        void SimulateDeviceArrival() { m_devicePresent = true; }
+
+        // IAudioDevice
+        bool Update() override;
+        bool Reset() override;
+        bool IsAudioDevicePresent() const override { return m_devicePresent; }
+        bool IsCriticalError() const override { return m_criticalError; }
+
+        bool IsSilent() const { return m_silent; }
+
+        // Runs the simulated loop for 'seconds' at 'updateRate' frames per second.
+        Statistics Run(double seconds, double updateRate, const UpdateFunction& update, const wchar_t* szOutputFile = nullptr);
+
+    private:
+        SoftwareMixer   m_mixer;
+        bool            m_deviceLossPending;
+        bool            m_devicePresent;
+        bool            m_criticalError;
+        bool            m_silent;
+        uint32_t        m_resets;
+    };
+}
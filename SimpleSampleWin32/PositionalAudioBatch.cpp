@@ -0,0 +1,286 @@
+//
+// PositionalAudioBatch.cpp
+//
+
+#include "pch.h"
+#include "PositionalAudioBatch.h"
+
+using namespace DirectX;
+using namespace DX;
+
+namespace
+{
+    // Emitters closer than this to the listener are treated as centered with no doppler shift.
+    const float c_minDistanceSq = 1.0e-8f;
+
+    struct ListenerVectors
+    {
+        XMVECTOR posX, posY, posZ;
+        XMVECTOR velX, velY, velZ;
+        XMVECTOR rightX, rightY, rightZ;
+    };
+
+    struct Constants
+    {
+        XMVECTOR curveScaler;
+        XMVECTOR dopplerScaler;
+        XMVECTOR speedOfSound;
+        XMVECTOR minDoppler;
+        XMVECTOR maxDoppler;
+        XMVECTOR minDenominator;
+        XMVECTOR halfOuter;
+        XMVECTOR invConeRange;
+        XMVECTOR outerVolume;
+        XMVECTOR innerMinusOuter;
+        XMVECTOR minDistanceSq;
+        XMVECTOR panScale;
+        XMVECTOR one;
+        XMVECTOR negativeOne;
+    };
+
+    // Views one batch of emitters; every pointer addresses 8 readable floats.
+    struct BatchInput
+    {
+        const float* px; const float* py; const float* pz;
+        const float* vx; const float* vy; const float* vz;
+        const float* fx; const float* fy; const float* fz;
+    };
+
+    struct BatchOutput
+    {
+        float* attenuation;
+        float* coneGain;
+        float* doppler;
+        float* left;
+        float* right;
+    };
+
+    inline XMVECTOR XM_CALLCONV Load4(const float* ptr)
+    {
+        return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(ptr));
+    }
+
+    inline void XM_CALLCONV Store4(float* ptr, FXMVECTOR v)
+    {
+        XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(ptr), v);
+    }
+
+    inline XMVECTOR XM_CALLCONV Dot3(FXMVECTOR ax, FXMVECTOR ay, FXMVECTOR az, GXMVECTOR bx, HXMVECTOR by, HXMVECTOR bz)
+    {
+        return XMVectorMultiplyAdd(az, bz, XMVectorMultiplyAdd(ay, by, XMVectorMultiply(ax, bx)));
+    }
+
+    // Evaluates four emitters starting at 'offset' within the batch.
+    inline void Evaluate4(const ListenerVectors& l, const Constants& k, const BatchInput& in, const BatchOutput& out, size_t offset)
+    {
+        // Listener to emitter.
+        XMVECTOR dx = XMVectorSubtract(Load4(in.px + offset), l.posX);
+        XMVECTOR dy = XMVectorSubtract(Load4(in.py + offset), l.posY);
+        XMVECTOR dz = XMVectorSubtract(Load4(in.pz + offset), l.posZ);
+
+        XMVECTOR distSq = Dot3(dx, dy, dz, dx, dy, dz);
+        XMVECTOR nearby = XMVectorLess(distSq, k.minDistanceSq);
+
+        XMVECTOR invDist = XMVectorReciprocalSqrt(XMVectorMax(distSq, k.minDistanceSq));
+        XMVECTOR dist = XMVectorMultiply(distSq, invDist);
+
+        XMVECTOR nx = XMVectorMultiply(dx, invDist);
+        XMVECTOR ny = XMVectorMultiply(dy, invDist);
+        XMVECTOR nz = XMVectorMultiply(dz, invDist);
+
+        // Inverse distance curve: unity inside the scaler distance, scaler / distance beyond it.
+        XMVECTOR attenuation = XMVectorDivide(k.curveScaler, XMVectorMax(dist, k.curveScaler));
+
+        // Cone: angle between the emitter's front and the direction to the listener (-n). As in
+        // X3DAudio the gain is interpolated linearly in the angle between the inner and outer cones.
+        XMVECTOR cone = k.one;
+        if (in.fx)
+        {
+            XMVECTOR cosAngle = XMVectorNegate(Dot3(Load4(in.fx + offset), Load4(in.fy + offset), Load4(in.fz + offset), nx, ny, nz));
+            XMVECTOR angle = XMVectorACos(XMVectorClamp(cosAngle, k.negativeOne, k.one));
+            XMVECTOR t = XMVectorSaturate(XMVectorMultiply(XMVectorSubtract(k.halfOuter, angle), k.invConeRange));
+            cone = XMVectorSelect(XMVectorMultiplyAdd(t, k.innerMinusOuter, k.outerVolume), k.one, nearby);
+        }
+
+        // Doppler: velocities projected onto the emitter-to-listener axis (-n).
+        XMVECTOR doppler = k.one;
+        if (in.vx)
+        {
+            XMVECTOR listenerSpeed = XMVectorNegate(Dot3(l.velX, l.velY, l.velZ, nx, ny, nz));
+            XMVECTOR emitterSpeed = XMVectorNegate(Dot3(Load4(in.vx + offset), Load4(in.vy + offset), Load4(in.vz + offset), nx, ny, nz));
+
+            XMVECTOR numerator = XMVectorNegativeMultiplySubtract(k.dopplerScaler, listenerSpeed, k.speedOfSound);
+            XMVECTOR denominator = XMVectorNegativeMultiplySubtract(k.dopplerScaler, emitterSpeed, k.speedOfSound);
+            denominator = XMVectorMax(denominator, k.minDenominator);
+
+            doppler = XMVectorClamp(XMVectorDivide(numerator, denominator), k.minDoppler, k.maxDoppler);
+            doppler = XMVectorSelect(doppler, k.one, nearby);
+        }
+
+        // Constant power pan from the lateral component of the direction in listener space.
+        XMVECTOR lateral = XMVectorSelect(Dot3(nx, ny, nz, l.rightX, l.rightY, l.rightZ), XMVectorZero(), nearby);
+        XMVECTOR panAngle = XMVectorMultiplyAdd(lateral, k.panScale, k.panScale);
+
+        XMVECTOR sinPan, cosPan;
+        XMVectorSinCos(&sinPan, &cosPan, panAngle);
+
+        XMVECTOR gain = XMVectorMultiply(attenuation, cone);
+
+        Store4(out.attenuation + offset, attenuation);
+        Store4(out.coneGain + offset, cone);
+        Store4(out.doppler + offset, doppler);
+        Store4(out.left + offset, XMVectorMultiply(cosPan, gain));
+        Store4(out.right + offset, XMVectorMultiply(sinPan, gain));
+    }
+
+    inline void EvaluateBatch(const ListenerVectors& l, const Constants& k, const BatchInput& in, const BatchOutput& out)
+    {
+        Evaluate4(l, k, in, out, 0);
+        Evaluate4(l, k, in, out, 4);
+    }
+}
+
+PositionalAudioBatch::Settings PositionalAudioBatch::DefaultSettings()
+{
+    Settings settings = {};
+    settings.curveDistanceScaler = 1.f;
+    settings.dopplerScaler = 1.f;
+    settings.speedOfSound = 343.5f;
+    settings.maxDoppler = 2.f;
+    settings.coneInnerAngle = XM_2PI;
+    settings.coneOuterAngle = XM_2PI;
+    settings.coneOuterVolume = 1.f;
+    return settings;
+}
+
+PositionalAudioBatch::PositionalAudioBatch(const Settings& settings) :
+    m_settings{},
+    m_halfInner(XM_PI),
+    m_halfOuter(XM_PI),
+    m_invConeRange(0.f),
+    m_coneEnabled(false)
+{
+    SetSettings(settings);
+}
+
+void PositionalAudioBatch::SetSettings(const Settings& settings)
+{
+    if (settings.curveDistanceScaler <= 0.f || settings.speedOfSound <= 0.f || settings.maxDoppler < 1.f)
+        throw std::invalid_argument("PositionalAudioBatch settings");
+
+    m_settings = settings;
+
+    float inner = std::min(std::max(settings.coneInnerAngle, 0.f), XM_2PI);
+    float outer = std::min(std::max(settings.coneOuterAngle, inner), XM_2PI);
+
+    m_coneEnabled = inner < XM_2PI;
+    m_halfInner = inner * 0.5f;
+    m_halfOuter = outer * 0.5f;
+
+    // A zero width transition is a hard edge at the inner angle.
+    float range = m_halfOuter - m_halfInner;
+    m_invConeRange = (range > 1.0e-6f) ? 1.f / range : 1.0e6f;
+}
+
+void PositionalAudioBatch::Evaluate(const Listener& listener, const Emitters& emitters, size_t count, const Results& results) const
+{
+    if (!count)
+        return;
+
+    if (!emitters.positionX || !emitters.positionY || !emitters.positionZ
+        || !results.attenuation || !results.coneGain || !results.doppler || !results.matrixLeft || !results.matrixRight)
+        throw std::invalid_argument("PositionalAudioBatch::Evaluate");
+
+    bool hasVelocity = emitters.velocityX && emitters.velocityY && emitters.velocityZ && m_settings.dopplerScaler > 0.f;
+    bool hasCone = emitters.frontX && emitters.frontY && emitters.frontZ && m_coneEnabled;
+
+    // Listener basis; right = front x top in a right-handed system.
+    XMVECTOR front = XMVector3Normalize(XMLoadFloat3(&listener.orientFront));
+    XMVECTOR top = XMVector3Normalize(XMLoadFloat3(&listener.orientTop));
+    XMVECTOR right = XMVector3Normalize(XMVector3Cross(front, top));
+
+    ListenerVectors l;
+    l.posX = XMVectorReplicate(listener.position.x);
+    l.posY = XMVectorReplicate(listener.position.y);
+    l.posZ = XMVectorReplicate(listener.position.z);
+    l.velX = XMVectorReplicate(listener.velocity.x);
+    l.velY = XMVectorReplicate(listener.velocity.y);
+    l.velZ = XMVectorReplicate(listener.velocity.z);
+    l.rightX = XMVectorSplatX(right);
+    l.rightY = XMVectorSplatY(right);
+    l.rightZ = XMVectorSplatZ(right);
+
+    // Component speeds are limited so the doppler denominator cannot reach zero or go negative.
+    float speed = m_settings.speedOfSound;
+
+    Constants k;
+    k.curveScaler = XMVectorReplicate(m_settings.curveDistanceScaler);
+    k.dopplerScaler = XMVectorReplicate(m_settings.dopplerScaler);
+    k.speedOfSound = XMVectorReplicate(speed);
+    k.minDoppler = XMVectorReplicate(1.f / m_settings.maxDoppler);
+    k.maxDoppler = XMVectorReplicate(m_settings.maxDoppler);
+    k.minDenominator = XMVectorReplicate(speed / m_settings.maxDoppler);
+    k.halfOuter = XMVectorReplicate(m_halfOuter);
+    k.invConeRange = XMVectorReplicate(m_invConeRange);
+    k.outerVolume = XMVectorReplicate(m_settings.coneOuterVolume);
+    k.innerMinusOuter = XMVectorReplicate(1.f - m_settings.coneOuterVolume);
+    k.minDistanceSq = XMVectorReplicate(c_minDistanceSq);
+    k.panScale = XMVectorReplicate(XM_PIDIV4);
+    k.one = XMVectorSplatOne();
+    k.negativeOne = XMVectorNegate(k.one);
+
+    size_t whole = count - (count % BatchSize);
+
+    for (size_t i = 0; i < whole; i += BatchSize)
+    {
+        BatchInput in =
+        {
+            emitters.positionX + i, emitters.positionY + i, emitters.positionZ + i,
+            hasVelocity ? emitters.velocityX + i : nullptr, hasVelocity ? emitters.velocityY + i : nullptr, hasVelocity ? emitters.velocityZ + i : nullptr,
+            hasCone ? emitters.frontX + i : nullptr, hasCone ? emitters.frontY + i : nullptr, hasCone ? emitters.frontZ + i : nullptr,
+        };
+
+        BatchOutput out =
+        {
+            results.attenuation + i, results.coneGain + i, results.doppler + i, results.matrixLeft + i, results.matrixRight + i,
+        };
+
+        EvaluateBatch(l, k, in, out);
+    }
+
+    // Tail: copy the remaining emitters into a zero padded batch so the same code path applies.
+    size_t remaining = count - whole;
+    if (remaining)
+    {
+        float input[9][BatchSize] = {};
+        float output[5][BatchSize];
+
+        const float* sources[9] =
+        {
+            emitters.positionX, emitters.positionY, emitters.positionZ,
+            emitters.velocityX, emitters.velocityY, emitters.velocityZ,
+            emitters.frontX, emitters.frontY, emitters.frontZ,
+        };
+
+        for (size_t j = 0; j < 9; ++j)
+        {
+            if (sources[j])
+                std::copy(sources[j] + whole, sources[j] + count, input[j]);
+        }
+
+        BatchInput in =
+        {
+            input[0], input[1], input[2],
+            hasVelocity ? input[3] : nullptr, hasVelocity ? input[4] : nullptr, hasVelocity ? input[5] : nullptr,
+            hasCone ? input[6] : nullptr, hasCone ? input[7] : nullptr, hasCone ? input[8] : nullptr,
+        };
+
+        BatchOutput out = { output[0], output[1], output[2], output[3], output[4] };
+
+        EvaluateBatch(l, k, in, out);
+
+        float* destinations[5] = { results.attenuation, results.coneGain, results.doppler, results.matrixLeft, results.matrixRight };
+        for (size_t j = 0; j < 5; ++j)
+            std::copy(output[j], output[j] + remaining, destinations[j] + whole);
+    }
+}
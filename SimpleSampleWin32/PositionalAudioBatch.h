@@ -0,0 +1,85 @@
+//
+// PositionalAudioBatch.h - Evaluates 3D audio parameters for many emitters at once
+//
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <stddef.h>
+
+namespace DX
+{
+    // Batch counterpart to DirectXTK's AudioListener/AudioEmitter + Apply3D. Emitters are given as
+    // structure-of-arrays so each component loads straight into a SIMD register; eight emitters are
+    // evaluated per iteration as two interleaved 4-wide DirectXMath vectors. Positions use the same
+    // right-handed convention as the rest of the sample.
+    class PositionalAudioBatch
+    {
+    public:
+        struct Settings
+        {
+            float   curveDistanceScaler;    // Distance at which attenuation starts (inverse distance beyond it)
+            float   dopplerScaler;          // 0 disables doppler
+            float   speedOfSound;           // World units per second
+            float   maxDoppler;             // Doppler factors are clamped to [1/maxDoppler, maxDoppler]
+            float   coneInnerAngle;         // Radians, full angle; full gain inside
+            float   coneOuterAngle;         // Radians, full angle; coneOuterVolume outside
+            float   coneOuterVolume;
+        };
+
+        struct Listener
+        {
+            DirectX::XMFLOAT3   position;
+            DirectX::XMFLOAT3   velocity;
+            DirectX::XMFLOAT3   orientFront;
+            DirectX::XMFLOAT3   orientTop;
+        };
+
+        // Each array holds 'count' floats. The front arrays may be null, in which case emitters are
+        // omnidirectional and coneGain is 1. Velocities may be null for stationary emitters.
+        struct Emitters
+        {
+            const float*    positionX;
+            const float*    positionY;
+            const float*    positionZ;
+            const float*    velocityX;
+            const float*    velocityY;
+            const float*    velocityZ;
+            const float*    frontX;
+            const float*    frontY;
+            const float*    frontZ;
+        };
+
+        // Outputs, one float per emitter. matrixLeft/matrixRight are the mono-to-stereo output
+        // matrix coefficients and already include attenuation and cone gain.
+        struct Results
+        {
+            float*  attenuation;
+            float*  coneGain;
+            float*  doppler;
+            float*  matrixLeft;
+            float*  matrixRight;
+        };
+
+        static const size_t BatchSize = 8;
+
+        static Settings DefaultSettings();
+
+        explicit PositionalAudioBatch(const Settings& settings);
+
+        void SetSettings(const Settings& settings);
+        const Settings& GetSettings() const { return m_settings; }
+
+        // Any count is accepted; a trailing partial batch is padded internally.
+        void Evaluate(const Listener& listener, const Emitters& emitters, size_t count, const Results& results) const;
+
+    private:
+        Settings    m_settings;
+
+        // Half angles, as the cone is measured from the emitter's front to the listener.
+        float       m_halfInner;
+        float       m_halfOuter;
+        float       m_invConeRange;
+        bool        m_coneEnabled;
+    };
+}
@@ -0,0 +1,323 @@
+//
+// RiffParser.cpp
+//
+
+#include "pch.h"
+#include "RiffParser.h"
+#include "MSADPCM.h"
+
+#include <cstring>
+
+using namespace DX;
+
+namespace
+{
+    const uint32_t FOURCC_RIFF = 0x46464952;    // 'RIFF'
+    const uint32_t FOURCC_WAVE = 0x45564157;    // 'WAVE'
+    const uint32_t FOURCC_FMT = 0x20746d66;     // 'fmt '
+    const uint32_t FOURCC_DATA = 0x61746164;    // 'data'
+    const uint32_t FOURCC_SMPL = 0x6c706d73;    // 'smpl'
+    const uint32_t FOURCC_WSMP = 0x706d7377;    // 'wsmp'
+
+#pragma pack(push, 1)
+    struct RiffChunkHeader
+    {
+        uint32_t    tag;
+        uint32_t    size;
+    };
+
+    struct WaveFormatExtensible
+    {
+        Riff::WaveFormatEx  wfx;
+        uint16_t            validBitsPerSample;
+        uint32_t            channelMask;
+        uint32_t            subFormat[4];   // GUID whose first DWORD is the format tag
+    };
+
+    struct SamplerChunk
+    {
+        uint32_t    manufacturer;
+        uint32_t    product;
+        uint32_t    samplePeriod;
+        uint32_t    midiUnityNote;
+        uint32_t    midiPitchFraction;
+        uint32_t    smpteFormat;
+        uint32_t    smpteOffset;
+        uint32_t    sampleLoops;
+        uint32_t    samplerData;
+    };
+
+    struct SamplerLoop
+    {
+        uint32_t    cuePointId;
+        uint32_t    type;
+        uint32_t    start;
+        uint32_t    end;
+        uint32_t    fraction;
+        uint32_t    playCount;
+    };
+
+    struct WaveSampleChunk
+    {
+        uint32_t    size;
+        uint16_t    unityNote;
+        int16_t     fineTune;
+        int32_t     gain;
+        uint32_t    options;
+        uint32_t    sampleLoops;
+    };
+
+    struct WaveSampleLoop
+    {
+        uint32_t    size;
+        uint32_t    loopType;
+        uint32_t    loopStart;
+        uint32_t    loopLength;
+    };
+#pragma pack(pop)
+
+    const uint32_t LOOP_TYPE_FORWARD = 0;
+
+    // Returns the end of the RIFF form, after validating the outer header.
+    const uint8_t* GetFormEnd(const uint8_t* image, size_t imageSize, uint32_t formType)
+    {
+        if (!image || imageSize < sizeof(RiffChunkHeader) + sizeof(uint32_t))
+            throw std::runtime_error("RIFF: image is too small");
+
+        RiffChunkHeader riff;
+        memcpy(&riff, image, sizeof(riff));
+
+        uint32_t form;
+        memcpy(&form, image + sizeof(riff), sizeof(form));
+
+        if (riff.tag != FOURCC_RIFF || form != formType)
+            throw std::runtime_error("RIFF: not a RIFF WAVE image");
+
+        // Some writers leave the RIFF size as zero or too large; trust the image size then.
+        uint64_t formEnd = uint64_t(riff.size) + sizeof(riff);
+        if (riff.size < sizeof(uint32_t) || formEnd > imageSize)
+            formEnd = imageSize;
+
+        return image + formEnd;
+    }
+
+    void ValidateFormat(const Riff::WaveFormatEx* wfx, size_t formatSize, uint16_t& formatTag)
+    {
+        if (!wfx->channels || !wfx->samplesPerSec || !wfx->blockAlign)
+            throw std::runtime_error("RIFF: invalid format parameters");
+
+        formatTag = wfx->formatTag;
+
+        switch (wfx->formatTag)
+        {
+        case Riff::FormatPCM:
+        case Riff::FormatIEEEFloat:
+            break;
+
+        case Riff::FormatExtensible:
+            if (formatSize < sizeof(WaveFormatExtensible) || wfx->cbSize < sizeof(WaveFormatExtensible) - sizeof(Riff::WaveFormatEx))
+                throw std::runtime_error("RIFF: truncated WAVEFORMATEXTENSIBLE");
+            else
+            {
+                WaveFormatExtensible wfex;
+                memcpy(&wfex, wfx, sizeof(wfex));
+
+                formatTag = static_cast<uint16_t>(wfex.subFormat[0]);
+                if (formatTag != Riff::FormatPCM && formatTag != Riff::FormatIEEEFloat)
+                    throw std::runtime_error("RIFF: unsupported extensible subformat");
+
+                if (wfex.validBitsPerSample > wfx->bitsPerSample)
+                    throw std::runtime_error("RIFF: invalid valid bits per sample");
+            }
+            break;
+
+        case Riff::FormatADPCM:
+            if (formatSize < sizeof(Riff::ADPCMWaveFormat) || wfx->cbSize < sizeof(Riff::ADPCMWaveFormat) - sizeof(Riff::WaveFormatEx))
+                throw std::runtime_error("RIFF: truncated ADPCMWAVEFORMAT");
+            else
+            {
+                Riff::ADPCMWaveFormat adpcm;
+                memcpy(&adpcm, wfx, sizeof(adpcm));
+
+                if (wfx->channels > 2 || wfx->bitsPerSample != 4)
+                    throw std::runtime_error("RIFF: invalid ADPCM channels or bit depth");
+
+                if (adpcm.samplesPerBlock != MSADPCM::SamplesPerBlock(wfx->blockAlign, wfx->channels))
+                    throw std::runtime_error("RIFF: ADPCM samples per block does not match block size");
+
+                if (adpcm.numCoef != MSADPCM::NumCoefficients)
+                    throw std::runtime_error("RIFF: non-standard ADPCM coefficient count");
+
+                for (uint32_t j = 0; j < MSADPCM::NumCoefficients; ++j)
+                {
+                    if (adpcm.coef[j].coef1 != MSADPCM::Coefficients[j][0]
+                        || adpcm.coef[j].coef2 != MSADPCM::Coefficients[j][1])
+                        throw std::runtime_error("RIFF: non-standard ADPCM coefficients");
+                }
+            }
+            return;
+
+        default:
+            throw std::runtime_error("RIFF: unsupported format tag");
+        }
+
+        // PCM and float share the same layout rules.
+        uint32_t bits = wfx->bitsPerSample;
+        if (formatTag == Riff::FormatIEEEFloat ? (bits != 32) : (bits != 8 && bits != 16 && bits != 24 && bits != 32))
+            throw std::runtime_error("RIFF: unsupported bits per sample");
+
+        if (wfx->blockAlign != wfx->channels * (bits / 8))
+            throw std::runtime_error("RIFF: block align does not match channels and bit depth");
+    }
+}
+
+const uint8_t* Riff::FindChunk(const uint8_t* image, size_t imageSize, uint32_t tag, uint32_t* chunkSize)
+{
+    const uint8_t* end = GetFormEnd(image, imageSize, FOURCC_WAVE);
+    const uint8_t* ptr = image + sizeof(RiffChunkHeader) + sizeof(uint32_t);
+
+    while (end - ptr >= ptrdiff_t(sizeof(RiffChunkHeader)))
+    {
+        RiffChunkHeader header;
+        memcpy(&header, ptr, sizeof(header));
+        ptr += sizeof(header);
+
+        if (uint64_t(header.size) > uint64_t(end - ptr))
+            throw std::runtime_error("RIFF: chunk extends past end of image");
+
+        if (header.tag == tag)
+        {
+            if (chunkSize)
+                *chunkSize = header.size;
+            return ptr;
+        }
+
+        // Chunks are padded to an even size, but a missing final pad byte is tolerated.
+        size_t advance = (size_t(header.size) + 1) & ~size_t(1);
+        if (advance > size_t(end - ptr))
+            break;
+        ptr += advance;
+    }
+
+    return nullptr;
+}
+
+void Riff::ParseWave(const uint8_t* image, size_t imageSize, WaveData& result)
+{
+    memset(&result, 0, sizeof(result));
+
+    const uint8_t* end = GetFormEnd(image, imageSize, FOURCC_WAVE);
+    const uint8_t* ptr = image + sizeof(RiffChunkHeader) + sizeof(uint32_t);
+
+    const uint8_t* smpl = nullptr;
+    uint32_t smplSize = 0;
+    const uint8_t* wsmp = nullptr;
+    uint32_t wsmpSize = 0;
+
+    // One pass over the chunk list; the format may legally follow the data.
+    while (end - ptr >= ptrdiff_t(sizeof(RiffChunkHeader)))
+    {
+        RiffChunkHeader header;
+        memcpy(&header, ptr, sizeof(header));
+        ptr += sizeof(header);
+
+        if (uint64_t(header.size) > uint64_t(end - ptr))
+            throw std::runtime_error("RIFF: chunk extends past end of image");
+
+        switch (header.tag)
+        {
+        case FOURCC_FMT:
+            if (header.size < sizeof(WaveFormatEx) - sizeof(uint16_t))
+                throw std::runtime_error("RIFF: fmt chunk is too small");
+            result.format = reinterpret_cast<const WaveFormatEx*>(ptr);
+            result.formatSize = header.size;
+            break;
+
+        case FOURCC_DATA:
+            result.sampleData = ptr;
+            result.sampleBytes = header.size;
+            break;
+
+        case FOURCC_SMPL:
+            smpl = ptr;
+            smplSize = header.size;
+            break;
+
+        case FOURCC_WSMP:
+            wsmp = ptr;
+            wsmpSize = header.size;
+            break;
+        }
+
+        size_t advance = (size_t(header.size) + 1) & ~size_t(1);
+        if (advance > size_t(end - ptr))
+            break;
+        ptr += advance;
+    }
+
+    if (!result.format || !result.sampleData)
+        throw std::runtime_error("RIFF: missing fmt or data chunk");
+
+    // A bare PCMWAVEFORMAT omits cbSize; only read it when present.
+    if (result.formatSize < sizeof(WaveFormatEx) && result.format->formatTag != FormatPCM)
+        throw std::runtime_error("RIFF: fmt chunk is too small");
+
+    ValidateFormat(result.format, result.formatSize, result.formatTag);
+
+    // Prefer the sampler chunk's first forward loop, then the DLS wave sample loop.
+    if (smpl && smplSize >= sizeof(SamplerChunk))
+    {
+        SamplerChunk sampler;
+        memcpy(&sampler, smpl, sizeof(sampler));
+
+        uint64_t loopBytes = uint64_t(sampler.sampleLoops) * sizeof(SamplerLoop);
+        if (sampler.sampleLoops && loopBytes <= smplSize - sizeof(SamplerChunk))
+        {
+            SamplerLoop loop;
+            memcpy(&loop, smpl + sizeof(SamplerChunk), sizeof(loop));
+
+            if (loop.type == LOOP_TYPE_FORWARD && loop.end >= loop.start)
+            {
+                result.loopStart = loop.start;
+                result.loopLength = loop.end - loop.start + 1;
+            }
+        }
+    }
+
+    if (!result.loopLength && wsmp && wsmpSize >= sizeof(WaveSampleChunk))
+    {
+        WaveSampleChunk sample;
+        memcpy(&sample, wsmp, sizeof(sample));
+
+        if (sample.sampleLoops && sample.size <= wsmpSize
+            && uint64_t(sample.size) + sizeof(WaveSampleLoop) <= wsmpSize)
+        {
+            WaveSampleLoop loop;
+            memcpy(&loop, wsmp + sample.size, sizeof(loop));
+
+            if (loop.loopType == LOOP_TYPE_FORWARD)
+            {
+                result.loopStart = loop.loopStart;
+                result.loopLength = loop.loopLength;
+            }
+        }
+    }
+
+    uint32_t frames = GetFrameCount(result);
+    if (result.loopLength
+        && (result.loopStart >= frames || uint64_t(result.loopStart) + result.loopLength > frames))
+        throw std::runtime_error("RIFF: loop region is outside the sample data");
+}
+
+uint32_t Riff::GetFrameCount(const WaveData& wave)
+{
+    if (!wave.format || !wave.format->blockAlign)
+        return 0;
+
+    uint64_t blocks = wave.sampleBytes / wave.format->blockAlign;
+
+    if (wave.formatTag == FormatADPCM)
+        blocks *= MSADPCM::SamplesPerBlock(wave.format->blockAlign, wave.format->channels);
+
+    return static_cast<uint32_t>(blocks);
+}
@@ -0,0 +1,72 @@
+//
+// RiffParser.h - Zero-copy parser for RIFF WAVE images
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace DX
+{
+    namespace Riff
+    {
+        const uint16_t FormatPCM = 0x0001;
+        const uint16_t FormatADPCM = 0x0002;
+        const uint16_t FormatIEEEFloat = 0x0003;
+        const uint16_t FormatExtensible = 0xFFFE;
+
+#pragma pack(push, 1)
+        // Layouts of WAVEFORMATEX and ADPCMWAVEFORMAT as stored in the 'fmt ' chunk.
+        struct WaveFormatEx
+        {
+            uint16_t    formatTag;
+            uint16_t    channels;
+            uint32_t    samplesPerSec;
+            uint32_t    avgBytesPerSec;
+            uint16_t    blockAlign;
+            uint16_t    bitsPerSample;
+            uint16_t    cbSize;
+        };
+
+        struct ADPCMCoefficient
+        {
+            int16_t     coef1;
+            int16_t     coef2;
+        };
+
+        struct ADPCMWaveFormat
+        {
+            WaveFormatEx        wfx;
+            uint16_t            samplesPerBlock;
+            uint16_t            numCoef;
+            ADPCMCoefficient    coef[7];
+        };
+#pragma pack(pop)
+
+        // Everything points into the image passed to ParseWave; nothing is copied, so the
+        // image (typically a MappedFile) must outlive this structure.
+        struct WaveData
+        {
+            const WaveFormatEx* format;
+            size_t              formatSize;
+            const uint8_t*      sampleData;
+            size_t              sampleBytes;
+            uint32_t            loopStart;      // In frames, from a 'smpl' or 'wsmp' chunk
+            uint32_t            loopLength;     // Zero if the file does not loop
+
+            // Effective format tag, resolving WAVE_FORMAT_EXTENSIBLE to its subformat.
+            uint16_t            formatTag;
+        };
+
+        // Locates a top-level chunk of a RIFF form. Returns nullptr if it is not present.
+        const uint8_t* FindChunk(const uint8_t* image, size_t imageSize, uint32_t tag, uint32_t* chunkSize);
+
+        // Validates the RIFF structure and format headers, and locates the fmt, data, and loop
+        // chunks in place. Throws std::runtime_error for malformed or unsupported files.
+        void ParseWave(const uint8_t* image, size_t imageSize, WaveData& result);
+
+        // Number of whole frames in the sample data.
+        uint32_t GetFrameCount(const WaveData& wave);
+    }
+}
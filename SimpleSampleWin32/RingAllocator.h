@@ -0,0 +1,80 @@
+//
+// RingAllocator.h - Offset bookkeeping for a dynamic buffer mapped with discard/no-overwrite
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace DX
+{
+    // Hands out ranges of a fixed-size buffer for a Direct3D 11 style dynamic resource. Data
+    // is appended with no-overwrite maps; the first allocation of each frame, and any that no
+    // longer fits, restarts at offset 0 and must be mapped with discard so the driver renames
+    // the buffer instead of stalling on data the GPU may still be reading.
+    class RingAllocator
+    {
+    public:
+        struct Statistics
+        {
+            uint64_t    allocations;
+            uint32_t    discards;           // Includes the one per frame
+            uint32_t    wraps;              // Discards forced by running out of space mid-frame
+            size_t      peakFrameBytes;     // Most bytes used between two discards
+        };
+
+        explicit RingAllocator(size_t capacity) :
+            m_capacity(capacity),
+            m_position(0),
+            m_needsDiscard(true),
+            m_stats{}
+        {
+        }
+
+        size_t GetCapacity() const { return m_capacity; }
+        size_t GetPosition() const { return m_position; }
+        const Statistics& GetStatistics() const { return m_stats; }
+
+        // The next allocation starts the buffer over.
+        void BeginFrame() { m_needsDiscard = true; }
+
+        // Reserves 'size' bytes at a multiple of 'alignment', which need not be a power of two
+        // so vertex strides can be used directly. Returns false if the request can never fit.
+        bool Allocate(size_t size, size_t alignment, size_t& offset, bool& discard)
+        {
+            if (size > m_capacity || !alignment)
+                return false;
+
+            size_t aligned = ((m_position + alignment - 1) / alignment) * alignment;
+
+            discard = m_needsDiscard || aligned > m_capacity - size;
+            if (discard)
+            {
+                if (!m_needsDiscard)
+                {
+                    ++m_stats.wraps;
+                }
+                ++m_stats.discards;
+                m_needsDiscard = false;
+                aligned = 0;
+            }
+
+            offset = aligned;
+            m_position = aligned + size;
+            ++m_stats.allocations;
+
+            if (m_position > m_stats.peakFrameBytes)
+            {
+                m_stats.peakFrameBytes = m_position;
+            }
+            return true;
+        }
+
+    private:
+        size_t      m_capacity;
+        size_t      m_position;
+        bool        m_needsDiscard;
+        Statistics  m_stats;
+    };
+}
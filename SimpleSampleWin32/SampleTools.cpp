@@ -0,0 +1,479 @@
+//
+// SampleTools.cpp - Command line tools for the sample's content and audio
+//
+
+#include "pch.h"
+#include "ConvolutionReverb.h"
+#include "MappedFile.h"
+#include "OfflineAudioRenderer.h"
+#include "RiffParser.h"
+#include "SceneBuilder.h"
+#include "WaveBankBuilder.h"
+#include "WaveBankStream.h"
+
+#include <psapi.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wctype.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+using namespace DX;
+
+namespace
+{
+    // The audio the sample's Game plays, and when it plays it.
+    const wchar_t* c_musicFile = L"MusicMono_adpcm.wav";
+    const wchar_t* c_effectsBank = L"droidsfx.xwb";
+    const wchar_t* c_streamBank = L"adpcmdroid.xwb";
+
+    const double c_firstEffectSeconds = 10.0;
+    const double c_effectIntervalSeconds = 4.0;
+
+    // A lost device comes back this long after it went away.
+    const double c_deviceAbsentSeconds = 0.5;
+
+    void PrintUsage()
+    {
+        wprintf(L"Usage: SampleTools <command> [options]\n\n");
+        wprintf(L"  render-audio <output.wav> [options]\n");
+        wprintf(L"      Plays the sample's audio sequence without an audio device, as fast as possible.\n");
+        wprintf(L"      -seconds <n>        Length of audio to render (default 30)\n");
+        wprintf(L"      -rate <n>           Simulated frames per second (default 60)\n");
+        wprintf(L"      -lose-device <t>    Lose the device at t seconds; it returns %.1f seconds later\n", c_deviceAbsentSeconds);
+        wprintf(L"      -reverb <decay>     Add a synthetic reverb that decays over 'decay' seconds\n\n");
+        wprintf(L"  wavebank <output.xwb> [options] <input>...\n");
+        wprintf(L"      Builds a wave bank. Inputs are PCM or MS-ADPCM .wav files, or bank.xwb:first[-last]\n");
+        wprintf(L"      to copy entries of an existing bank without re-encoding them.\n");
+        wprintf(L"      -name <name>        Bank name (default: the output file name)\n");
+        wprintf(L"      -align <n>          Entry alignment, a power of two (default 4096)\n");
+        wprintf(L"      -inmemory           Build an in-memory bank rather than a streaming one\n");
+        wprintf(L"      -compact            Use 4-byte entries; needs one shared format\n");
+        wprintf(L"      -nonames            Leave out the entry names\n");
+        wprintf(L"      -adpcm              Encode 16-bit PCM inputs to MS-ADPCM\n");
+        wprintf(L"      -block <n>          MS-ADPCM frames per block (default 128)\n");
+        wprintf(L"      -quality            Search every predictor when encoding, rather than estimating\n\n");
+        wprintf(L"  scene <output.dxsc> <input.txt>...\n");
+        wprintf(L"      Builds a scene file from text descriptions. Labels carry over from one input to the next.\n\n");
+        wprintf(L"  parse-wav [file.wav] [options]\n");
+        wprintf(L"      Times the zero-copy RIFF parser and measures the working set it costs, against copying\n");
+        wprintf(L"      the samples out as a loader would. The file defaults to the sample's music.\n");
+        wprintf(L"      -iterations <n>     Parses to time (default 100000)\n");
+    }
+
+    // Parses the numeric value following option argv[j].
+    double ParseValue(int argc, wchar_t* argv[], int& j)
+    {
+        if (j + 1 >= argc)
+            throw std::invalid_argument("missing value after option");
+
+        wchar_t* end = nullptr;
+        double value = wcstod(argv[++j], &end);
+        if (end == argv[j] || *end)
+            throw std::invalid_argument("option value is not a number");
+
+        return value;
+    }
+
+    // Wave banks hold names in UTF-8.
+    std::string Narrow(const wchar_t* value)
+    {
+        int length = WideCharToMultiByte(CP_UTF8, 0, value, -1, nullptr, 0, nullptr, nullptr);
+        if (length <= 0)
+            throw std::invalid_argument("invalid name");
+
+        std::string result(size_t(length), '\0');
+        WideCharToMultiByte(CP_UTF8, 0, value, -1, &result[0], length, nullptr, nullptr);
+        result.resize(size_t(length - 1));
+        return result;
+    }
+
+    // Replays what Game does with audio: the looping music, the wave bank sequencer that
+    // starts after 10 seconds and fires every 4, and the long entry the sample streams, all
+    // through the software mixer. Device loss is recovered through the same state machine
+    // the sample's audio thread uses, restarting the music as RestartOnReset does.
+    int RenderAudio(int argc, wchar_t* argv[])
+    {
+        if (argc < 1)
+        {
+            PrintUsage();
+            return 1;
+        }
+
+        const wchar_t* outputFile = argv[0];
+        double seconds = 30.0;
+        double updateRate = 60.0;
+        double loseDeviceAt = -1.0;
+        double reverbDecay = 0.0;
+
+        for (int j = 1; j < argc; ++j)
+        {
+            if (!_wcsicmp(argv[j], L"-seconds"))
+                seconds = ParseValue(argc, argv, j);
+            else if (!_wcsicmp(argv[j], L"-rate"))
+                updateRate = ParseValue(argc, argv, j);
+            else if (!_wcsicmp(argv[j], L"-lose-device"))
+                loseDeviceAt = ParseValue(argc, argv, j);
+            else if (!_wcsicmp(argv[j], L"-reverb"))
+                reverbDecay = ParseValue(argc, argv, j);
+            else
+            {
+                wprintf(L"Unknown option: %ls\n\n", argv[j]);
+                PrintUsage();
+                return 1;
+            }
+        }
+
+        OfflineAudioRenderer renderer;
+        AudioDeviceStateMachine device(renderer);
+
+        WaveBankStream stream;
+
+        stream.Open(c_musicFile);
+        auto music = SoftwareMixer::DecodeEntry(stream, 0);
+
+        stream.Open(c_effectsBank);
+        std::vector<SoftwareMixer::SourceHandle> effects;
+        for (size_t j = 0; j < stream.GetEntryCount(); ++j)
+        {
+            effects.push_back(SoftwareMixer::DecodeEntry(stream, j));
+        }
+
+        stream.Open(c_streamBank);
+        size_t streamEntry = 0;
+        for (size_t j = 1; j < stream.GetEntryCount(); ++j)
+        {
+            if (stream.GetEntry(j).dataLength > stream.GetEntry(streamEntry).dataLength)
+                streamEntry = j;
+        }
+        auto streamed = SoftwareMixer::DecodeEntry(stream, streamEntry);
+        stream.Close();
+
+        SoftwareMixer& mixer = renderer.GetMixer();
+        if (reverbDecay > 0)
+        {
+            auto impulse = ConvolutionReverb::CreateSyntheticImpulse(mixer.GetSampleRate(), float(reverbDecay));
+            mixer.SetReverb(std::make_shared<ConvolutionReverb>(impulse.data(), impulse.size()));
+        }
+
+        mixer.Play(music, true);
+        mixer.Play(streamed);
+
+        double effectTimer = c_firstEffectSeconds;
+        size_t effectIndex = 0;
+        bool deviceLost = false;
+        bool deviceReturned = false;
+
+        auto update = [&](OfflineAudioRenderer& audio, double totalSeconds, double elapsedSeconds)
+        {
+            if (loseDeviceAt >= 0)
+            {
+                if (!deviceLost && totalSeconds >= loseDeviceAt)
+                {
+                    audio.SimulateDeviceLoss();
+                    deviceLost = true;
+                }
+                else if (deviceLost && !deviceReturned && totalSeconds >= loseDeviceAt + c_deviceAbsentSeconds)
+                {
+                    audio.SimulateDeviceArrival();
+                    device.NotifyDeviceChange();
+                    deviceReturned = true;
+                }
+            }
+
+            if (device.Tick(float(elapsedSeconds)))
+            {
+                mixer.Play(music, true);
+            }
+
+            effectTimer -= elapsedSeconds;
+            if (effectTimer < 0)
+            {
+                effectTimer = c_effectIntervalSeconds;
+
+                if (!audio.IsSilent() && !effects.empty())
+                {
+                    mixer.Play(effects[effectIndex]);
+                }
+
+                if (++effectIndex >= effects.size())
+                    effectIndex = 0;
+            }
+        };
+
+        auto stats = renderer.Run(seconds, updateRate, update, outputFile);
+
+        wprintf(L"Rendered %.2f seconds of audio in %.3f seconds (%.1fx realtime)\n",
+            stats.audioSeconds, stats.renderSeconds, stats.realtimeFactor);
+        wprintf(L"  updates %u, device resets %u, failed resets %u\n",
+            stats.updates, stats.resets, device.GetFailedResetCount());
+        wprintf(L"  peak %.3f, clipped samples %u\n", stats.peak, stats.clippedSamples);
+
+        return 0;
+    }
+
+    // Splits "bank.xwb:first[-last]" into the file name and entry range. Returns false for any
+    // other input, which is then taken to be a .wav file.
+    bool ParseBankEntries(const wchar_t* input, std::wstring& fileName, size_t& first, size_t& last)
+    {
+        const wchar_t* colon = wcsrchr(input, L':');
+        if (!colon || colon == input || !iswdigit(colon[1]))
+            return false;
+
+        wchar_t* end = nullptr;
+        first = wcstoul(colon + 1, &end, 10);
+        last = first;
+        if (*end == L'-' && iswdigit(end[1]))
+            last = wcstoul(end + 1, &end, 10);
+
+        if (*end)
+            return false;
+
+        if (last < first)
+            throw std::invalid_argument("wave bank entry range is reversed");
+
+        fileName.assign(input, colon);
+        return true;
+    }
+
+    int BuildWaveBank(int argc, wchar_t* argv[])
+    {
+        if (argc < 1)
+        {
+            PrintUsage();
+            return 1;
+        }
+
+        const wchar_t* outputFile = argv[0];
+
+        auto options = WaveBankBuilder::DefaultOptions();
+        bool hasName = false;
+
+        WaveBankBuilder builder;
+
+        for (int j = 1; j < argc; ++j)
+        {
+            if (argv[j][0] == L'-')
+            {
+                if (!_wcsicmp(argv[j], L"-name"))
+                {
+                    if (j + 1 >= argc)
+                        throw std::invalid_argument("missing value after option");
+
+                    options.bankName = Narrow(argv[++j]);
+                    hasName = true;
+                }
+                else if (!_wcsicmp(argv[j], L"-align"))
+                    options.alignment = uint32_t(ParseValue(argc, argv, j));
+                else if (!_wcsicmp(argv[j], L"-inmemory"))
+                    options.streaming = false;
+                else if (!_wcsicmp(argv[j], L"-compact"))
+                    options.compact = true;
+                else if (!_wcsicmp(argv[j], L"-nonames"))
+                    options.entryNames = false;
+                else if (!_wcsicmp(argv[j], L"-adpcm"))
+                    options.encodeADPCM = true;
+                else if (!_wcsicmp(argv[j], L"-block"))
+                    options.samplesPerBlock = uint32_t(ParseValue(argc, argv, j));
+                else if (!_wcsicmp(argv[j], L"-quality"))
+                    options.encodeMode = MSADPCM::EncodeMode::Quality;
+                else
+                {
+                    wprintf(L"Unknown option: %ls\n\n", argv[j]);
+                    PrintUsage();
+                    return 1;
+                }
+                continue;
+            }
+
+            std::wstring bankFile;
+            size_t first, last;
+            if (ParseBankEntries(argv[j], bankFile, first, last))
+            {
+                // Entries are copied as they are stored, loop regions and bank flags included, so
+                // nothing is decoded or re-encoded.
+                WaveBankStream bank;
+                bank.Open(bankFile.c_str());
+                MappedFile data(bankFile.c_str());
+                options.flags |= bank.GetBankFlags();
+
+                if (last >= bank.GetEntryCount())
+                    throw std::invalid_argument("entry range lies outside the wave bank");
+
+                for (size_t index = first; index <= last; ++index)
+                {
+                    const auto& entry = bank.GetEntry(index);
+                    if (entry.dataOffset > data.GetSize() || entry.dataLength > data.GetSize() - entry.dataOffset)
+                        throw std::runtime_error("wave bank entry lies outside the file");
+
+                    builder.AddEntry("", entry.formatTag, entry.channels, entry.sampleRate, entry.blockAlign, entry.bitsPerSample,
+                        data.GetData() + entry.dataOffset, entry.dataLength, entry.loopStart, entry.loopLength);
+                }
+            }
+            else
+            {
+                builder.AddWaveFile(argv[j]);
+            }
+        }
+
+        if (!builder.GetEntryCount())
+            throw std::invalid_argument("no inputs given");
+
+        if (!hasName)
+        {
+            // The output file name without its folder or extension.
+            const wchar_t* name = outputFile;
+            for (const wchar_t* ptr = outputFile; *ptr; ++ptr)
+            {
+                if (*ptr == L'\\' || *ptr == L'/' || *ptr == L':')
+                    name = ptr + 1;
+            }
+
+            std::wstring stem(name);
+            size_t dot = stem.rfind(L'.');
+            if (dot != std::wstring::npos && dot > 0)
+                stem.resize(dot);
+
+            options.bankName = Narrow(stem.c_str());
+        }
+
+        auto order = builder.Build(outputFile, options);
+
+        wprintf(L"Wrote %zu entries to %ls\n", order.size(), outputFile);
+        for (size_t j = 0; j < order.size(); ++j)
+        {
+            if (order[j] != j)
+                wprintf(L"  entry %zu is input entry %zu\n", j, order[j]);
+        }
+
+        return 0;
+    }
+
+    int BuildScene(int argc, wchar_t* argv[])
+    {
+        if (argc < 2)
+        {
+            PrintUsage();
+            return 1;
+        }
+
+        const wchar_t* outputFile = argv[0];
+
+        SceneBuilder builder;
+        for (int j = 1; j < argc; ++j)
+        {
+            builder.AddTextFile(argv[j]);
+        }
+
+        builder.Build(outputFile);
+
+        wprintf(L"Wrote %zu objects to %ls\n", builder.GetObjectCount(), outputFile);
+        return 0;
+    }
+
+    size_t GetWorkingSet()
+    {
+        PROCESS_MEMORY_COUNTERS counters = {};
+        counters.cb = sizeof(counters);
+        if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+            throw std::runtime_error("GetProcessMemoryInfo");
+
+        return counters.WorkingSetSize;
+    }
+
+    // Parsing a mapped image only touches the pages holding chunk headers; the sample data
+    // stays on disk until something reads it. The copy shows what owning the samples costs.
+    int ParseWavBenchmark(int argc, wchar_t* argv[])
+    {
+        const wchar_t* inputFile = c_musicFile;
+        double iterations = 100000.0;
+
+        for (int j = 0; j < argc; ++j)
+        {
+            if (argv[j][0] == L'-')
+            {
+                if (!_wcsicmp(argv[j], L"-iterations"))
+                    iterations = ParseValue(argc, argv, j);
+                else
+                {
+                    wprintf(L"Unknown option: %ls\n\n", argv[j]);
+                    PrintUsage();
+                    return 1;
+                }
+            }
+            else
+            {
+                inputFile = argv[j];
+            }
+        }
+
+        if (iterations < 1.0)
+            throw std::invalid_argument("iterations must be at least 1");
+
+        // Measured from after the mapping exists, so one-off costs of opening files are not
+        // counted; mapping a file does not bring any of it in.
+        MappedFile file(inputFile);
+        const size_t baseline = GetWorkingSet();
+
+        Riff::WaveData wave = {};
+        Riff::ParseWave(file.GetData(), file.GetSize(), wave);
+        const size_t parsed = GetWorkingSet();
+
+        const auto count = static_cast<unsigned long long>(iterations);
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned long long j = 0; j < count; ++j)
+        {
+            Riff::ParseWave(file.GetData(), file.GetSize(), wave);
+        }
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::vector<uint8_t> samples(wave.sampleData, wave.sampleData + wave.sampleBytes);
+        const size_t copied = GetWorkingSet();
+
+        wprintf(L"%ls: %zu bytes, format %u, %u channels, %u Hz, %u frames",
+            inputFile, file.GetSize(), wave.formatTag, wave.format->channels, wave.format->samplesPerSec, Riff::GetFrameCount(wave));
+        if (wave.loopLength)
+            wprintf(L", loop %u+%u", wave.loopStart, wave.loopLength);
+        wprintf(L"\n");
+
+        wprintf(L"  parse %.1f ns (%llu iterations)\n", elapsed * 1e9 / double(count), count);
+        wprintf(L"  working set: +%zu KB once parsed, +%zu KB once the %zu sample bytes are copied\n",
+            (parsed - std::min(parsed, baseline)) / 1024, (copied - std::min(copied, baseline)) / 1024, samples.size());
+
+        return 0;
+    }
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+    if (argc < 2)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    try
+    {
+        if (!_wcsicmp(argv[1], L"render-audio"))
+            return RenderAudio(argc - 2, argv + 2);
+
+        if (!_wcsicmp(argv[1], L"wavebank"))
+            return BuildWaveBank(argc - 2, argv + 2);
+
+        if (!_wcsicmp(argv[1], L"scene"))
+            return BuildScene(argc - 2, argv + 2);
+
+        if (!_wcsicmp(argv[1], L"parse-wav"))
+            return ParseWavBenchmark(argc - 2, argv + 2);
+
+        wprintf(L"Unknown command: %ls\n\n", argv[1]);
+        PrintUsage();
+        return 1;
+    }
+    catch (const std::exception& e)
+    {
+        wprintf(L"ERROR: %hs\n", e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,322 @@
+//
+// SceneBuilder.cpp
+//
+
+#include "pch.h"
+#include "SceneBuilder.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace DirectX;
+using namespace DX;
+
+namespace
+{
+    inline uint64_t AlignUp(uint64_t value, uint32_t alignment)
+    {
+        return (value + alignment - 1) & ~uint64_t(alignment - 1);
+    }
+
+    FILE* CreateOutputFile(const wchar_t* szFileName)
+    {
+        FILE* file = nullptr;
+        if (_wfopen_s(&file, szFileName, L"wb") != 0)
+            file = nullptr;
+        if (!file)
+            throw std::runtime_error("SceneBuilder: failed to create output file");
+
+        return file;
+    }
+
+    [[noreturn]] void ThrowParseError(size_t lineNumber, const char* message)
+    {
+        throw std::runtime_error("SceneBuilder: line " + std::to_string(lineNumber) + ": " + message);
+    }
+
+    inline bool IsSpace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    // Splits 'line' in place on whitespace, stopping at a comment.
+    size_t Tokenize(char* line, const char** tokens, size_t maxTokens)
+    {
+        size_t count = 0;
+        char* ptr = line;
+        for (;;)
+        {
+            while (IsSpace(*ptr))
+                ++ptr;
+
+            if (!*ptr || *ptr == '#' || count == maxTokens)
+                break;
+
+            tokens[count++] = ptr;
+            while (*ptr && !IsSpace(*ptr) && *ptr != '#')
+                ++ptr;
+
+            if (*ptr == '#')
+            {
+                *ptr = 0;
+                break;
+            }
+
+            if (*ptr)
+                *ptr++ = 0;
+        }
+
+        return count;
+    }
+
+    float ParseFloat(const char* token, size_t lineNumber)
+    {
+        char* end = nullptr;
+        float value = strtof(token, &end);
+        if (end == token || *end)
+            ThrowParseError(lineNumber, "expected a number");
+
+        return value;
+    }
+}
+
+uint32_t SceneBuilder::AddMesh(Scene::MeshKind kind, const char* name)
+{
+    if (kind > Scene::MeshKind_Model || !name || !*name)
+        throw std::invalid_argument("SceneBuilder: invalid mesh");
+
+    if (m_meshes.size() >= UINT32_MAX)
+        throw std::runtime_error("SceneBuilder: too many meshes");
+
+    m_meshes.push_back(Scene::Mesh{ static_cast<uint32_t>(kind), AddString(name) });
+    return static_cast<uint32_t>(m_meshes.size() - 1);
+}
+
+uint32_t XM_CALLCONV SceneBuilder::AddMaterial(FXMVECTOR color, const char* texture)
+{
+    if (m_materials.size() >= UINT32_MAX)
+        throw std::runtime_error("SceneBuilder: too many materials");
+
+    Scene::Material material = {};
+    XMStoreFloat4(&material.color, color);
+    material.texture = (texture && *texture) ? AddString(texture) : Scene::NoString;
+
+    m_materials.push_back(material);
+    return static_cast<uint32_t>(m_materials.size() - 1);
+}
+
+void XM_CALLCONV SceneBuilder::AddObject(FXMMATRIX transform, uint32_t mesh, uint32_t material)
+{
+    if (mesh >= m_meshes.size() || material >= m_materials.size())
+        throw std::invalid_argument("SceneBuilder: object refers to a missing mesh or material");
+
+    XMFLOAT4X4 value;
+    XMStoreFloat4x4(&value, transform);
+
+    m_transforms.push_back(value);
+    m_meshIndices.push_back(mesh);
+    m_materialIndices.push_back(material);
+}
+
+void SceneBuilder::AddText(const char* text, size_t length)
+{
+    std::string line;
+    size_t lineNumber = 0;
+
+    const char* end = text + length;
+    while (text < end)
+    {
+        auto newline = static_cast<const char*>(memchr(text, '\n', size_t(end - text)));
+        const char* lineEnd = newline ? newline : end;
+
+        line.assign(text, lineEnd);
+        ParseLine(&line[0], ++lineNumber);
+
+        text = newline ? newline + 1 : end;
+    }
+}
+
+void SceneBuilder::AddTextFile(const wchar_t* szFileName)
+{
+    MappedFile file(szFileName);
+    AddText(reinterpret_cast<const char*>(file.GetData()), file.GetSize());
+}
+
+std::vector<uint8_t> SceneBuilder::Serialize() const
+{
+    Scene::Header header = {};
+    header.magic = Scene::Magic;
+    header.version = Scene::Version;
+    header.objectCount = m_transforms.size();
+
+    uint64_t offset = AlignUp(sizeof(Scene::Header), Scene::ArrayAlignment);
+    uint64_t end = offset;
+    auto place = [&](Scene::Array& array, size_t count, size_t stride)
+    {
+        array.offset = offset;
+        array.count = count;
+        end = offset + uint64_t(count) * stride;
+        offset = AlignUp(end, Scene::ArrayAlignment);
+    };
+
+    place(header.transforms, m_transforms.size(), sizeof(XMFLOAT4X4));
+    place(header.objectMeshes, m_meshIndices.size(), sizeof(uint32_t));
+    place(header.objectMaterials, m_materialIndices.size(), sizeof(uint32_t));
+    place(header.meshes, m_meshes.size(), sizeof(Scene::Mesh));
+    place(header.materials, m_materials.size(), sizeof(Scene::Material));
+    place(header.strings, m_strings.size(), sizeof(char));
+    header.fileSize = end;
+
+    if (end > SIZE_MAX)
+        throw std::runtime_error("SceneBuilder: scene too large");
+
+    std::vector<uint8_t> image(static_cast<size_t>(end), 0);
+    auto copy = [&](const Scene::Array& array, const void* data, size_t bytes)
+    {
+        if (bytes)
+            memcpy(image.data() + array.offset, data, bytes);
+    };
+
+    copy(Scene::Array{ 0, 1 }, &header, sizeof(header));
+    copy(header.transforms, m_transforms.data(), m_transforms.size() * sizeof(XMFLOAT4X4));
+    copy(header.objectMeshes, m_meshIndices.data(), m_meshIndices.size() * sizeof(uint32_t));
+    copy(header.objectMaterials, m_materialIndices.data(), m_materialIndices.size() * sizeof(uint32_t));
+    copy(header.meshes, m_meshes.data(), m_meshes.size() * sizeof(Scene::Mesh));
+    copy(header.materials, m_materials.data(), m_materials.size() * sizeof(Scene::Material));
+    copy(header.strings, m_strings.data(), m_strings.size());
+
+    return image;
+}
+
+void SceneBuilder::Build(const wchar_t* szOutputFile) const
+{
+    std::vector<uint8_t> image = Serialize();
+
+    FILE* file = CreateOutputFile(szOutputFile);
+
+    bool ok = fwrite(image.data(), 1, image.size(), file) == image.size();
+
+    if (fclose(file) != 0)
+        ok = false;
+
+    if (!ok)
+        throw std::runtime_error("SceneBuilder: write failed");
+}
+
+uint32_t SceneBuilder::AddString(const char* value)
+{
+    size_t length = strlen(value) + 1;
+    if (m_strings.size() + length >= UINT32_MAX)
+        throw std::runtime_error("SceneBuilder: too much string data");
+
+    uint32_t offset = static_cast<uint32_t>(m_strings.size());
+    m_strings.insert(m_strings.end(), value, value + length);
+    return offset;
+}
+
+void SceneBuilder::ParseLine(char* line, size_t lineNumber)
+{
+    const size_t c_maxTokens = 24;
+    const char* tokens[c_maxTokens];
+    size_t count = Tokenize(line, tokens, c_maxTokens);
+    if (!count)
+        return;
+
+    if (count == c_maxTokens)
+        ThrowParseError(lineNumber, "too many values");
+
+    if (!strcmp(tokens[0], "mesh"))
+    {
+        if (count != 4)
+            ThrowParseError(lineNumber, "expected 'mesh <label> primitive|model <name>'");
+
+        Scene::MeshKind kind;
+        if (!strcmp(tokens[2], "primitive"))
+            kind = Scene::MeshKind_Primitive;
+        else if (!strcmp(tokens[2], "model"))
+            kind = Scene::MeshKind_Model;
+        else
+            ThrowParseError(lineNumber, "mesh kind must be 'primitive' or 'model'");
+
+        if (m_meshLabels.count(tokens[1]))
+            ThrowParseError(lineNumber, "mesh label already used");
+
+        m_meshLabels[tokens[1]] = AddMesh(kind, tokens[3]);
+    }
+    else if (!strcmp(tokens[0], "material"))
+    {
+        if (count != 6 && count != 7)
+            ThrowParseError(lineNumber, "expected 'material <label> <r> <g> <b> <a> [texture]'");
+
+        XMVECTOR color = XMVectorSet(ParseFloat(tokens[2], lineNumber), ParseFloat(tokens[3], lineNumber),
+            ParseFloat(tokens[4], lineNumber), ParseFloat(tokens[5], lineNumber));
+
+        if (m_materialLabels.count(tokens[1]))
+            ThrowParseError(lineNumber, "material label already used");
+
+        m_materialLabels[tokens[1]] = AddMaterial(color, (count == 7) ? tokens[6] : nullptr);
+    }
+    else if (!strcmp(tokens[0], "object"))
+    {
+        if (count < 3)
+            ThrowParseError(lineNumber, "expected 'object <mesh> <material> ...'");
+
+        auto mesh = m_meshLabels.find(tokens[1]);
+        if (mesh == m_meshLabels.end())
+            ThrowParseError(lineNumber, "unknown mesh");
+
+        auto material = m_materialLabels.find(tokens[2]);
+        if (material == m_materialLabels.end())
+            ThrowParseError(lineNumber, "unknown material");
+
+        float position[3] = {};
+        float rotation[3] = {};
+        float scale[3] = { 1.f, 1.f, 1.f };
+
+        for (size_t j = 3; j < count; )
+        {
+            const char* keyword = tokens[j++];
+            size_t values = count - j;
+
+            if (!strcmp(keyword, "position") && values >= 3)
+            {
+                for (auto& value : position)
+                    value = ParseFloat(tokens[j++], lineNumber);
+            }
+            else if (!strcmp(keyword, "rotation") && values >= 3)
+            {
+                for (auto& value : rotation)
+                    value = XMConvertToRadians(ParseFloat(tokens[j++], lineNumber));
+            }
+            else if (!strcmp(keyword, "scale") && values >= 1)
+            {
+                // One value scales uniformly; three are per axis.
+                bool uniform = values < 3 || !strcmp(tokens[j + 1], "position") || !strcmp(tokens[j + 1], "rotation");
+                if (uniform)
+                {
+                    scale[0] = scale[1] = scale[2] = ParseFloat(tokens[j++], lineNumber);
+                }
+                else
+                {
+                    for (auto& value : scale)
+                        value = ParseFloat(tokens[j++], lineNumber);
+                }
+            }
+            else
+            {
+                ThrowParseError(lineNumber, "expected 'position x y z', 'rotation yaw pitch roll' or 'scale s'");
+            }
+        }
+
+        XMMATRIX transform = XMMatrixScaling(scale[0], scale[1], scale[2])
+            * XMMatrixRotationRollPitchYaw(rotation[1], rotation[0], rotation[2])
+            * XMMatrixTranslation(position[0], position[1], position[2]);
+
+        AddObject(transform, mesh->second, material->second);
+    }
+    else
+    {
+        ThrowParseError(lineNumber, "expected 'mesh', 'material' or 'object'");
+    }
+}
@@ -0,0 +1,65 @@
+//
+// SceneBuilder.h - Converts text scene descriptions into SceneFile images
+//
+
+#pragma once
+
+#include "SceneFile.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace DX
+{
+    // Collects meshes, materials and objects, from code or from text, and writes them in the
+    // layout SceneFile maps. The text format has one statement per line; '#' starts a comment:
+    //
+    //     mesh <label> primitive <name>
+    //     mesh <label> model <file.sdkmesh>
+    //     material <label> <r> <g> <b> <a> [texture.dds]
+    //     object <mesh label> <material label> [position x y z] [rotation yaw pitch roll] [scale s | scale x y z]
+    //
+    // Rotations are in degrees and applied after the scale; the position is applied last.
+    class SceneBuilder
+    {
+    public:
+        SceneBuilder() = default;
+
+        SceneBuilder(SceneBuilder const&) = delete;
+        SceneBuilder& operator= (SceneBuilder const&) = delete;
+
+        // Return the new mesh or material index.
+        uint32_t AddMesh(Scene::MeshKind kind, const char* name);
+        uint32_t XM_CALLCONV AddMaterial(DirectX::FXMVECTOR color, const char* texture = nullptr);
+
+        void XM_CALLCONV AddObject(DirectX::FXMMATRIX transform, uint32_t mesh, uint32_t material);
+
+        // Labels persist between calls, so a scene can be split over several texts. Throws
+        // std::runtime_error naming the line of the first error.
+        void AddText(const char* text, size_t length);
+        void AddTextFile(const wchar_t* szFileName);
+
+        size_t GetObjectCount() const { return m_meshIndices.size(); }
+
+        // The image SceneFile::Attach accepts, once copied to 64-byte aligned memory.
+        std::vector<uint8_t> Serialize() const;
+
+        void Build(const wchar_t* szOutputFile) const;
+
+    private:
+        uint32_t AddString(const char* value);
+        void ParseLine(char* line, size_t lineNumber);
+
+        std::vector<DirectX::XMFLOAT4X4>                m_transforms;
+        std::vector<uint32_t>                           m_meshIndices;
+        std::vector<uint32_t>                           m_materialIndices;
+        std::vector<Scene::Mesh>                        m_meshes;
+        std::vector<Scene::Material>                    m_materials;
+        std::vector<char>                               m_strings;
+        std::unordered_map<std::string, uint32_t>       m_meshLabels;
+        std::unordered_map<std::string, uint32_t>       m_materialLabels;
+    };
+}
@@ -0,0 +1,153 @@
+//
+// SceneFile.cpp
+//
+
+#include "pch.h"
+#include "SceneFile.h"
+
+using namespace DirectX;
+using namespace DX;
+
+namespace
+{
+    template<typename T>
+    const T* GetArray(const uint8_t* image, size_t size, const Scene::Array& array)
+    {
+        if (array.offset % Scene::ArrayAlignment)
+            throw std::runtime_error("SceneFile: misaligned array");
+
+        if (array.offset > size || array.count > (size - array.offset) / sizeof(T))
+            throw std::runtime_error("SceneFile: array outside the file");
+
+        return reinterpret_cast<const T*>(image + array.offset);
+    }
+
+    // Branch-free, so the scan over every object runs at memory speed.
+    bool AllBelow(const uint32_t* values, size_t count, uint64_t limit)
+    {
+        uint32_t bound = static_cast<uint32_t>(std::min<uint64_t>(limit, UINT32_MAX));
+        uint32_t outside = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            outside |= (values[i] >= bound) ? 1u : 0u;
+        }
+
+        return !outside;
+    }
+}
+
+SceneFile::SceneFile() noexcept
+{
+    Reset();
+}
+
+SceneFile::SceneFile(const wchar_t* szFileName) noexcept(false)
+{
+    Reset();
+    Open(szFileName);
+}
+
+void SceneFile::Open(const wchar_t* szFileName)
+{
+    Close();
+
+    m_file.Open(szFileName);
+
+    try
+    {
+        Bind(m_file.GetData(), m_file.GetSize());
+    }
+    catch (...)
+    {
+        m_file.Close();
+        throw;
+    }
+}
+
+void SceneFile::Close() noexcept
+{
+    Reset();
+    m_file.Close();
+}
+
+void SceneFile::Attach(const uint8_t* image, size_t size)
+{
+    Close();
+    Bind(image, size);
+}
+
+void SceneFile::Bind(const uint8_t* image, size_t size)
+{
+    if (!image || size < sizeof(Scene::Header))
+        throw std::runtime_error("SceneFile: not a scene file");
+
+    if (reinterpret_cast<uintptr_t>(image) % Scene::ArrayAlignment)
+        throw std::runtime_error("SceneFile: image is not aligned");
+
+    auto header = reinterpret_cast<const Scene::Header*>(image);
+    if (header->magic != Scene::Magic)
+        throw std::runtime_error("SceneFile: not a scene file");
+
+    if (header->version != Scene::Version)
+        throw std::runtime_error("SceneFile: unsupported version");
+
+    if (header->fileSize != size)
+        throw std::runtime_error("SceneFile: file size does not match the header");
+
+    if (header->transforms.count != header->objectCount
+        || header->objectMeshes.count != header->objectCount
+        || header->objectMaterials.count != header->objectCount)
+        throw std::runtime_error("SceneFile: object arrays differ in length");
+
+    auto transforms = GetArray<XMFLOAT4X4>(image, size, header->transforms);
+    auto objectMeshes = GetArray<uint32_t>(image, size, header->objectMeshes);
+    auto objectMaterials = GetArray<uint32_t>(image, size, header->objectMaterials);
+    auto meshes = GetArray<Scene::Mesh>(image, size, header->meshes);
+    auto materials = GetArray<Scene::Material>(image, size, header->materials);
+    auto strings = GetArray<char>(image, size, header->strings);
+
+    // With a terminator at the very end, every offset inside the array starts a valid string.
+    uint64_t stringBytes = header->strings.count;
+    if (stringBytes && strings[stringBytes - 1] != 0)
+        throw std::runtime_error("SceneFile: unterminated string");
+
+    for (uint64_t j = 0; j < header->meshes.count; ++j)
+    {
+        if (meshes[j].kind > Scene::MeshKind_Model || meshes[j].name >= stringBytes)
+            throw std::runtime_error("SceneFile: invalid mesh");
+    }
+
+    for (uint64_t j = 0; j < header->materials.count; ++j)
+    {
+        if (materials[j].texture != Scene::NoString && materials[j].texture >= stringBytes)
+            throw std::runtime_error("SceneFile: invalid material");
+    }
+
+    size_t objectCount = static_cast<size_t>(header->objectCount);
+    if (!AllBelow(objectMeshes, objectCount, header->meshes.count)
+        || !AllBelow(objectMaterials, objectCount, header->materials.count))
+        throw std::runtime_error("SceneFile: object refers to a missing mesh or material");
+
+    m_objectCount = objectCount;
+    m_transforms = transforms;
+    m_objectMeshes = objectMeshes;
+    m_objectMaterials = objectMaterials;
+    m_meshCount = static_cast<size_t>(header->meshes.count);
+    m_meshes = meshes;
+    m_materialCount = static_cast<size_t>(header->materials.count);
+    m_materials = materials;
+    m_strings = strings;
+}
+
+void SceneFile::Reset() noexcept
+{
+    m_objectCount = 0;
+    m_transforms = nullptr;
+    m_objectMeshes = nullptr;
+    m_objectMaterials = nullptr;
+    m_meshCount = 0;
+    m_meshes = nullptr;
+    m_materialCount = 0;
+    m_materials = nullptr;
+    m_strings = nullptr;
+}
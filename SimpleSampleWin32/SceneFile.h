@@ -0,0 +1,119 @@
+//
+// SceneFile.h - Relocatable binary scene description, used in place from a mapped file
+//
+
+#pragma once
+
+#include "MappedFile.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace DX
+{
+    namespace Scene
+    {
+        const uint32_t Magic = 0x43535844;      // 'DXSC'
+        const uint32_t Version = 1;
+
+        // Every array starts on a cache line, so the mapped arrays can be read with aligned loads.
+        const uint32_t ArrayAlignment = 64;
+
+        // String offset for "none".
+        const uint32_t NoString = UINT32_MAX;
+
+        enum MeshKind : uint32_t
+        {
+            MeshKind_Primitive,     // Built by the application; the name says which one
+            MeshKind_Model,         // The name is an SDKMESH file
+        };
+
+        // Little-endian throughout. Nothing in the file holds a pointer: arrays are located by
+        // their offset from the start of the file and strings by their offset into the string
+        // array, so the file works wherever it is mapped.
+        struct Array
+        {
+            uint64_t    offset;
+            uint64_t    count;
+        };
+
+        struct Mesh
+        {
+            uint32_t    kind;           // MeshKind
+            uint32_t    name;           // Offset into the strings
+        };
+
+        struct Material
+        {
+            DirectX::XMFLOAT4   color;
+            uint32_t            texture;    // Offset into the strings, or NoString
+            uint32_t            reserved[3];
+        };
+
+        // Objects are stored as parallel arrays of 'objectCount' entries.
+        struct Header
+        {
+            uint32_t    magic;
+            uint32_t    version;
+            uint64_t    fileSize;
+            uint64_t    objectCount;
+            Array       transforms;         // XMFLOAT4X4, row-major object to world
+            Array       objectMeshes;       // uint32_t index into meshes
+            Array       objectMaterials;    // uint32_t index into materials
+            Array       meshes;             // Mesh
+            Array       materials;          // Material
+            Array       strings;            // char, each string terminated by a 0
+        };
+    }
+
+    // Maps a scene written by SceneBuilder and hands out its arrays where they lie in the
+    // mapping; nothing is parsed or copied. Open checks the header, that every array lies
+    // within the file, and that every index and string offset is in range, so the accessors
+    // can be trusted without further checks.
+    class SceneFile
+    {
+    public:
+        SceneFile() noexcept;
+        explicit SceneFile(const wchar_t* szFileName) noexcept(false);
+
+        SceneFile(SceneFile const&) = delete;
+        SceneFile& operator= (SceneFile const&) = delete;
+
+        // Throws std::runtime_error if the file cannot be mapped or is not a valid scene.
+        void Open(const wchar_t* szFileName);
+        void Close() noexcept;
+
+        // Validates an in-memory image the same way. 'image' must be 64-byte aligned and
+        // outlive the view; this does not take ownership.
+        void Attach(const uint8_t* image, size_t size);
+
+        size_t GetObjectCount() const { return m_objectCount; }
+        const DirectX::XMFLOAT4X4* GetTransforms() const { return m_transforms; }
+        const uint32_t* GetObjectMeshes() const { return m_objectMeshes; }
+        const uint32_t* GetObjectMaterials() const { return m_objectMaterials; }
+
+        size_t GetMeshCount() const { return m_meshCount; }
+        const Scene::Mesh* GetMeshes() const { return m_meshes; }
+
+        size_t GetMaterialCount() const { return m_materialCount; }
+        const Scene::Material* GetMaterials() const { return m_materials; }
+
+        // Null for NoString.
+        const char* GetString(uint32_t offset) const { return (offset != Scene::NoString) ? m_strings + offset : nullptr; }
+
+    private:
+        void Bind(const uint8_t* image, size_t size);
+        void Reset() noexcept;
+
+        MappedFile                  m_file;
+        size_t                      m_objectCount;
+        const DirectX::XMFLOAT4X4*  m_transforms;
+        const uint32_t*             m_objectMeshes;
+        const uint32_t*             m_objectMaterials;
+        size_t                      m_meshCount;
+        const Scene::Mesh*          m_meshes;
+        size_t                      m_materialCount;
+        const Scene::Material*      m_materials;
+        const char*                 m_strings;
+    };
+}
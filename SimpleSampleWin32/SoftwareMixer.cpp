@@ -0,0 +1,213 @@
+//
+// SoftwareMixer.cpp
+//
+
+#include "pch.h"
+#include "SoftwareMixer.h"
+#include "ConvolutionReverb.h"
+#include "WaveBankStream.h"
+
+#include <cstring>
+
+using namespace DX;
+
+namespace
+{
+    const float c_sampleScale = 1.f / 32768.f;
+}
+
+SoftwareMixer::SoftwareMixer(uint32_t sampleRate, uint32_t channels) noexcept(false) :
+    m_sampleRate(sampleRate),
+    m_channels(channels),
+    m_nextId(InvalidVoice + 1),
+    m_reverbLevel(0.f)
+{
+    if (!sampleRate || channels < 1 || channels > 2)
+        throw std::invalid_argument("SoftwareMixer: output must be mono or stereo");
+}
+
+SoftwareMixer::SourceHandle SoftwareMixer::DecodeEntry(WaveBankStream& stream, size_t index)
+{
+    const auto& entry = stream.GetEntry(index);
+
+    auto source = std::make_shared<Source>();
+    source->channels = entry.channels;
+    source->sampleRate = entry.sampleRate;
+    source->loopStart = 0;
+    source->loopLength = 0;
+
+    const size_t c_chunkFrames = 4096;
+
+    stream.Start(index);
+    for (;;)
+    {
+        size_t used = source->samples.size();
+        source->samples.resize(used + c_chunkFrames * entry.channels);
+
+        size_t frames = stream.Read(source->samples.data() + used, c_chunkFrames, true);
+        source->samples.resize(used + frames * entry.channels);
+
+        if (!frames)
+            break;
+    }
+    stream.Stop();
+
+    return source;
+}
+
+uint32_t SoftwareMixer::Play(const SourceHandle& source, bool loop, float volume)
+{
+    if (!source || !source->channels || !source->GetFrameCount())
+        throw std::invalid_argument("SoftwareMixer: empty source");
+
+    Voice voice = {};
+    voice.id = m_nextId++;
+    if (m_nextId == InvalidVoice)
+        m_nextId = InvalidVoice + 1;
+    voice.source = source;
+    voice.position = 0;
+    voice.step = (uint64_t(source->sampleRate) << 32) / m_sampleRate;
+    voice.volume = volume;
+    voice.loop = loop;
+
+    m_voices.push_back(voice);
+    return voice.id;
+}
+
+void SoftwareMixer::Stop(uint32_t voice)
+{
+    m_voices.erase(std::remove_if(m_voices.begin(), m_voices.end(),
+        [voice](const Voice& v) { return v.id == voice; }), m_voices.end());
+}
+
+void SoftwareMixer::StopAll()
+{
+    m_voices.clear();
+}
+
+bool SoftwareMixer::IsPlaying(uint32_t voice) const
+{
+    return std::any_of(m_voices.cbegin(), m_voices.cend(),
+        [voice](const Voice& v) { return v.id == voice; });
+}
+
+void SoftwareMixer::Render(float* output, size_t frames)
+{
+    memset(output, 0, frames * m_channels * sizeof(float));
+
+    for (size_t j = 0; j < m_voices.size(); )
+    {
+        if (MixVoice(m_voices[j], output, frames))
+        {
+            ++j;
+        }
+        else
+        {
+            m_voices.erase(m_voices.begin() + ptrdiff_t(j));
+        }
+    }
+
+    if (!m_reverb)
+        return;
+
+    // The reverb keeps running with no voices so tails ring out naturally.
+    if (m_reverbBuffer.size() < frames)
+        m_reverbBuffer.resize(frames);
+
+    const float downmix = 1.f / float(m_channels);
+    for (size_t f = 0; f < frames; ++f)
+    {
+        float sum = 0.f;
+        for (uint32_t ch = 0; ch < m_channels; ++ch)
+            sum += output[f * m_channels + ch];
+        m_reverbBuffer[f] = sum * downmix;
+    }
+
+    m_reverb->Process(m_reverbBuffer.data(), m_reverbBuffer.data(), frames);
+
+    for (size_t f = 0; f < frames; ++f)
+    {
+        float wet = m_reverbBuffer[f] * m_reverbLevel;
+        for (uint32_t ch = 0; ch < m_channels; ++ch)
+            output[f * m_channels + ch] += wet;
+    }
+}
+
+void SoftwareMixer::SetReverb(const std::shared_ptr<ConvolutionReverb>& reverb, float wetLevel)
+{
+    m_reverb = reverb;
+    m_reverbLevel = wetLevel;
+
+    if (m_reverb)
+        m_reverb->Reset();
+}
+
+// Returns false once a non-looping voice has played to the end.
+bool SoftwareMixer::MixVoice(Voice& voice, float* output, size_t frames)
+{
+    const Source& src = *voice.source;
+    const size_t srcFrames = src.GetFrameCount();
+    const uint32_t srcChannels = src.channels;
+    const int16_t* samples = src.samples.data();
+
+    uint64_t loopStart = 0;
+    uint64_t loopEnd = srcFrames;
+    if (src.loopLength && uint64_t(src.loopStart) + src.loopLength <= srcFrames)
+    {
+        loopStart = src.loopStart;
+        loopEnd = uint64_t(src.loopStart) + src.loopLength;
+    }
+
+    const uint64_t end = voice.loop ? loopEnd : srcFrames;
+    const float scale = voice.volume * c_sampleScale;
+
+    for (size_t f = 0; f < frames; ++f)
+    {
+        uint64_t index = voice.position >> 32;
+        if (index >= end)
+        {
+            if (!voice.loop || loopEnd == loopStart)
+                return false;
+
+            // A step can be longer than a short loop, so wrap by whole loops.
+            const uint64_t loopStart32 = loopStart << 32;
+            voice.position = loopStart32 + (voice.position - loopStart32) % ((loopEnd - loopStart) << 32);
+            index = voice.position >> 32;
+        }
+
+        // Interpolate toward the next frame, wrapping to the loop start at the loop point.
+        uint64_t next = index + 1;
+        if (next >= end)
+            next = voice.loop ? loopStart : index;
+
+        float t = float(voice.position & 0xffffffff) * (1.f / 4294967296.f);
+
+        const int16_t* a = samples + index * srcChannels;
+        const int16_t* b = samples + next * srcChannels;
+
+        float* out = output + f * m_channels;
+        if (srcChannels == m_channels)
+        {
+            for (uint32_t ch = 0; ch < m_channels; ++ch)
+                out[ch] += (float(a[ch]) + (float(b[ch]) - float(a[ch])) * t) * scale;
+        }
+        else
+        {
+            // Fold any source layout to mono, then spread across the output channels.
+            float sa = 0.f;
+            float sb = 0.f;
+            for (uint32_t ch = 0; ch < srcChannels; ++ch)
+            {
+                sa += a[ch];
+                sb += b[ch];
+            }
+            float s = (sa + (sb - sa) * t) * scale / float(srcChannels);
+            for (uint32_t ch = 0; ch < m_channels; ++ch)
+                out[ch] += s;
+        }
+
+        voice.position += voice.step;
+    }
+
+    return true;
+}
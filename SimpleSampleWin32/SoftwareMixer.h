@@ -0,0 +1,85 @@
+//
+// SoftwareMixer.h - Device-independent mixer for decoded audio sources
+//
+
+#pragma once
+
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace DX
+{
+    class ConvolutionReverb;
+    class WaveBankStream;
+
+    // Mixes 16-bit PCM sources into interleaved float output entirely on the CPU, with
+    // linear resampling to the output rate. Used where no audio device is available.
+    class SoftwareMixer
+    {
+    public:
+        struct Source
+        {
+            std::vector<int16_t>    samples;        // Interleaved
+            uint32_t                channels;
+            uint32_t                sampleRate;
+            uint32_t                loopStart;      // In frames
+            uint32_t                loopLength;     // Zero loops the whole source
+
+            size_t GetFrameCount() const { return channels ? samples.size() / channels : 0; }
+        };
+
+        using SourceHandle = std::shared_ptr<const Source>;
+
+        static const uint32_t InvalidVoice = 0;
+
+        SoftwareMixer(uint32_t sampleRate, uint32_t channels) noexcept(false);
+
+        SoftwareMixer(SoftwareMixer const&) = delete;
+        SoftwareMixer& operator= (SoftwareMixer const&) = delete;
+
+        // Fully decodes an entry of a wave bank or .wav file into memory.
+        static SourceHandle DecodeEntry(WaveBankStream& stream, size_t index);
+
+        // Returns a voice id, which is never InvalidVoice.
+        uint32_t Play(const SourceHandle& source, bool loop = false, float volume = 1.f);
+        void Stop(uint32_t voice);
+        void StopAll();
+
+        bool IsPlaying(uint32_t voice) const;
+        size_t GetActiveVoiceCount() const { return m_voices.size(); }
+
+        // Mixes the next 'frames' frames of all active voices. Finished voices are retired.
+        void Render(float* output, size_t frames);
+
+        // Sends a mono downmix of the whole mix through 'reverb' and adds the result to every
+        // output channel at 'wetLevel'. Pass nullptr to remove it.
+        void SetReverb(const std::shared_ptr<ConvolutionReverb>& reverb, float wetLevel = 0.3f);
+
+        uint32_t GetSampleRate() const { return m_sampleRate; }
+        uint32_t GetChannels() const { return m_channels; }
+
+    private:
+        struct Voice
+        {
+            uint32_t        id;
+            SourceHandle    source;
+            uint64_t        position;   // 32.32 fixed point, in source frames
+            uint64_t        step;
+            float           volume;
+            bool            loop;
+        };
+
+        bool MixVoice(Voice& voice, float* output, size_t frames);
+
+        uint32_t            m_sampleRate;
+        uint32_t            m_channels;
+        uint32_t            m_nextId;
+        std::vector<Voice>  m_voices;
+
+        std::shared_ptr<ConvolutionReverb>  m_reverb;
+        float                               m_reverbLevel;
+        std::vector<float>                  m_reverbBuffer;
+    };
+}
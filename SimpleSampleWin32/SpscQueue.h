@@ -0,0 +1,91 @@
+//
+// SpscQueue.h - Bounded lock-free single-producer/single-consumer queue
+//
+
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+
+namespace DX
+{
+    // Fixed-capacity ring where exactly one thread pushes and one thread pops. Neither side
+    // ever takes a lock or allocates. Each side caches the other's index so the shared
+    // cache line is only read when the ring looks full (producer) or empty (consumer).
+    template<typename T, size_t Capacity>
+    class SpscQueue
+    {
+        static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+    public:
+        SpscQueue() noexcept :
+            m_head(0),
+            m_cachedTail(0),
+            m_tail(0),
+            m_cachedHead(0)
+        {
+        }
+
+        SpscQueue(SpscQueue const&) = delete;
+        SpscQueue& operator= (SpscQueue const&) = delete;
+
+        // Producer thread only. Returns false if the queue is full.
+        bool TryPush(const T& item)
+        {
+            const size_t tail = m_tail.load(std::memory_order_relaxed);
+            if (tail - m_cachedHead >= Capacity)
+            {
+                m_cachedHead = m_head.load(std::memory_order_acquire);
+                if (tail - m_cachedHead >= Capacity)
+                    return false;
+            }
+
+            m_items[tail & (Capacity - 1)] = item;
+            m_tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer thread only. Returns false if the queue is empty.
+        bool TryPop(T& item)
+        {
+            const size_t head = m_head.load(std::memory_order_relaxed);
+            if (head == m_cachedTail)
+            {
+                m_cachedTail = m_tail.load(std::memory_order_acquire);
+                if (head == m_cachedTail)
+                    return false;
+            }
+
+            item = m_items[head & (Capacity - 1)];
+            m_head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Approximate when called while the other side is active.
+        size_t GetSize() const
+        {
+            return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+        }
+
+        static size_t GetCapacity() { return Capacity; }
+
+    private:
+        // Padding keeps the consumer and producer indices on separate cache lines without
+        // over-aligning the type, which would need aligned allocation on older compilers.
+        static const size_t c_cacheLine = 64;
+
+        char                    m_pad0[c_cacheLine];
+
+        // Consumer side.
+        std::atomic<size_t>     m_head;
+        size_t                  m_cachedTail;
+        char                    m_pad1[c_cacheLine - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+
+        // Producer side.
+        std::atomic<size_t>     m_tail;
+        size_t                  m_cachedHead;
+        char                    m_pad2[c_cacheLine - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+
+        T                       m_items[Capacity];
+    };
+}
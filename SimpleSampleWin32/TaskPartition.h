@@ -0,0 +1,51 @@
+//
+// TaskPartition.h - Splits an ordered list of tasks into cost-balanced contiguous ranges
+//
+
+#pragma once
+
+#include <stddef.h>
+
+namespace DX
+{
+    // Divides 'count' tasks into 'parts' contiguous ranges of roughly equal total cost, so
+    // each worker records a run of consecutive tasks and the results can still be submitted
+    // in task order. Part i covers [bounds[i], bounds[i + 1]); 'bounds' must hold parts + 1
+    // entries. A task goes to the part its cost midpoint falls in, so a single expensive task
+    // does not drag its neighbors along with it. Parts may be empty when there are fewer
+    // tasks than parts.
+    inline void PartitionByCost(const float* costs, size_t count, size_t parts, size_t* bounds)
+    {
+        if (!parts)
+            return;
+
+        float total = 0.f;
+        for (size_t i = 0; i < count; ++i)
+        {
+            total += (costs[i] > 0.f) ? costs[i] : 0.f;
+        }
+
+        bounds[0] = 0;
+
+        size_t part = 1;
+        float start = 0.f;
+        for (size_t i = 0; i < count && part < parts; ++i)
+        {
+            float cost = (costs[i] > 0.f) ? costs[i] : 0.f;
+            float midpoint = (total > 0.f) ? (start + cost * 0.5f) / total : (float(i) + 0.5f) / float(count);
+
+            // Close every part whose share ends before this task's midpoint.
+            while (part < parts && midpoint * float(parts) >= float(part))
+            {
+                bounds[part++] = i;
+            }
+
+            start += cost;
+        }
+
+        while (part <= parts)
+        {
+            bounds[part++] = count;
+        }
+    }
+}
@@ -0,0 +1,185 @@
+//
+// TextureCache.cpp
+//
+
+#include "pch.h"
+#include "TextureCache.h"
+#include "ContentHash.h"
+#include "MappedFile.h"
+
+#include "WICTextureLoader.h"
+
+using namespace DX;
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+    const uint32_t c_ddsMagic = 0x20534444; // "DDS "
+
+    // Whether the file an entry was loaded from still holds exactly the bytes of 'file'. A file
+    // that can no longer be read does not match.
+    bool SameContents(const std::wstring& fileName, const MappedFile& file)
+    {
+        try
+        {
+            MappedFile other(fileName.c_str());
+            return other.GetSize() == file.GetSize()
+                && (!file.GetSize() || memcmp(other.GetData(), file.GetData(), file.GetSize()) == 0);
+        }
+        catch (const std::exception&)
+        {
+            return false;
+        }
+    }
+}
+
+TextureCache::TextureCache(ID3D11Device* device) noexcept(false) :
+    m_device(device),
+    m_stats{}
+{
+    if (!device)
+        throw std::invalid_argument("TextureCache needs a device");
+}
+
+void TextureCache::CreateTexture(const wchar_t* fileName, ID3D11ShaderResourceView** textureView)
+{
+    if (!fileName || !textureView)
+        throw std::invalid_argument("TextureCache::CreateTexture");
+
+    *textureView = nullptr;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto name = m_names.find(fileName);
+    if (name != m_names.end())
+    {
+        Entry& entry = *name->second;
+        ++entry.references;
+        ++m_stats.requests;
+        m_stats.bytesRequested += entry.fileSize;
+        entry.view.CopyTo(textureView);
+        return;
+    }
+
+    MappedFile file(fileName);
+    uint64_t hash = HashContent(file.GetData(), file.GetSize());
+
+    // The hash only finds candidates; a texture is shared only for identical bytes.
+    Entry* match = nullptr;
+    auto range = m_entries.equal_range(hash);
+    for (auto it = range.first; it != range.second && !match; ++it)
+    {
+        if (it->second.fileSize == file.GetSize() && SameContents(it->second.fileName, file))
+            match = &it->second;
+    }
+
+    if (!match)
+    {
+        uint32_t magic = 0;
+        if (file.GetSize() >= sizeof(magic))
+        {
+            memcpy(&magic, file.GetData(), sizeof(magic));
+        }
+
+        ComPtr<ID3D11ShaderResourceView> view;
+        DX::ThrowIfFailed((magic == c_ddsMagic)
+            ? DirectX::CreateDDSTextureFromMemory(m_device.Get(), file.GetData(), file.GetSize(), nullptr, view.GetAddressOf())
+            : DirectX::CreateWICTextureFromMemory(m_device.Get(), file.GetData(), file.GetSize(), nullptr, view.GetAddressOf()));
+
+        Entry entry;
+        entry.view = view;
+        entry.fileName = fileName;
+        entry.fileSize = file.GetSize();
+        entry.references = 0;
+
+        // Elements of an unordered container keep their address when it rehashes.
+        match = &m_entries.emplace(hash, std::move(entry))->second;
+
+        ++m_stats.texturesCreated;
+        m_stats.bytesLoaded += match->fileSize;
+    }
+
+    m_names[fileName] = match;
+
+    ++match->references;
+    ++m_stats.requests;
+    m_stats.bytesRequested += match->fileSize;
+    match->view.CopyTo(textureView);
+}
+
+void TextureCache::ReleaseTexture(ID3D11ShaderResourceView* textureView)
+{
+    if (!textureView)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+    {
+        if (it->second.view.Get() != textureView)
+            continue;
+
+        if (--it->second.references == 0)
+        {
+            const Entry* entry = &it->second;
+            for (auto name = m_names.begin(); name != m_names.end(); )
+            {
+                name = (name->second == entry) ? m_names.erase(name) : std::next(name);
+            }
+
+            m_entries.erase(it);
+        }
+        return;
+    }
+}
+
+size_t TextureCache::GetTextureCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_entries.size();
+}
+
+TextureCache::Statistics TextureCache::GetStatistics() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+uint64_t TextureCache::GetBytesSaved() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats.bytesRequested - m_stats.bytesLoaded;
+}
+
+TextureCacheEffectFactory::TextureCacheEffectFactory(ID3D11Device* device, TextureCache& cache, const wchar_t* directory) noexcept(false) :
+    EffectFactory(device),
+    m_cache(cache)
+{
+    if (directory && *directory)
+    {
+        m_directory = directory;
+        if (m_directory.back() != L'\\' && m_directory.back() != L'/')
+        {
+            m_directory += L'\\';
+        }
+    }
+}
+
+TextureCacheEffectFactory::~TextureCacheEffectFactory()
+{
+    for (auto& texture : m_textures)
+    {
+        m_cache.ReleaseTexture(texture.Get());
+    }
+}
+
+void TextureCacheEffectFactory::CreateTexture(const wchar_t* name, ID3D11DeviceContext*, ID3D11ShaderResourceView** textureView)
+{
+    std::wstring fileName = m_directory + name;
+    m_cache.CreateTexture(fileName.c_str(), textureView);
+
+    // Every reference this factory took is given back when it goes away.
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_textures.emplace_back(*textureView);
+}
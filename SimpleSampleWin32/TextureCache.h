@@ -0,0 +1,85 @@
+//
+// TextureCache.h - Textures shared by content, so identical image files are loaded once
+//
+
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace DX
+{
+    // Loads DDS and WIC image files into shader resource views and hands out the same view
+    // for every file with the same bytes, whatever it is called, so models, effects and
+    // sprites that use identical images share one texture. Files are found by HashContent
+    // over the whole file, and a match is only shared once the file it was loaded from has
+    // the same size and bytes. A file name that was already loaded is not read again.
+    //
+    // Entries are reference counted: every CreateTexture is balanced by a ReleaseTexture, and
+    // the last release drops the cache's entry. Views already handed out stay valid either
+    // way. Safe to use from several threads.
+    class TextureCache
+    {
+    public:
+        struct Statistics
+        {
+            uint32_t    requests;
+            uint32_t    texturesCreated;
+            uint64_t    bytesRequested;     // File bytes of every request
+            uint64_t    bytesLoaded;        // File bytes of the requests that created a texture
+        };
+
+        explicit TextureCache(ID3D11Device* device) noexcept(false);
+
+        TextureCache(TextureCache const&) = delete;
+        TextureCache& operator= (TextureCache const&) = delete;
+
+        // Returns the texture for 'fileName', loading it only if no file with the same
+        // contents has been loaded. Throws if the file cannot be read or decoded.
+        void CreateTexture(const wchar_t* fileName, ID3D11ShaderResourceView** textureView);
+
+        void ReleaseTexture(ID3D11ShaderResourceView* textureView);
+
+        size_t GetTextureCount() const;
+        Statistics GetStatistics() const;
+
+        // File bytes that did not have to be turned into another texture.
+        uint64_t GetBytesSaved() const;
+
+    private:
+        struct Entry
+        {
+            Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>    view;
+            std::wstring                                        fileName;   // Loaded from, for comparing contents
+            uint64_t                                            fileSize;
+            uint32_t                                            references;
+        };
+
+        Microsoft::WRL::ComPtr<ID3D11Device>            m_device;
+
+        mutable std::mutex                              m_mutex;
+        std::unordered_multimap<uint64_t, Entry>        m_entries;  // By content hash; files that collide get one each
+        std::unordered_map<std::wstring, Entry*>        m_names;    // File name to its entry
+        Statistics                                      m_stats;
+    };
+
+    // An EffectFactory that takes its textures from a TextureCache rather than its own cache
+    // keyed by name. Texture names are opened relative to 'directory', if given. The cache
+    // must outlive the factory.
+    class TextureCacheEffectFactory : public DirectX::EffectFactory
+    {
+    public:
+        TextureCacheEffectFactory(ID3D11Device* device, TextureCache& cache, const wchar_t* directory = nullptr) noexcept(false);
+        virtual ~TextureCacheEffectFactory() override;
+
+        virtual void __cdecl CreateTexture(_In_z_ const wchar_t* name, _In_opt_ ID3D11DeviceContext* deviceContext, _Outptr_ ID3D11ShaderResourceView** textureView) override;
+
+    private:
+        TextureCache&                                                   m_cache;
+        std::wstring                                                    m_directory;
+        std::mutex                                                      m_mutex;
+        std::vector<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>>   m_textures;
+    };
+}
@@ -0,0 +1,453 @@
+//
+// WaveBankBuilder.cpp
+//
+
+#include "pch.h"
+#include "WaveBankBuilder.h"
+#include "MappedFile.h"
+#include "RiffParser.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <numeric>
+
+using namespace DX;
+
+namespace
+{
+    // Must match the layout WaveBankStream and DirectXTK's WaveBankReader expect.
+    const uint32_t XWB_SIGNATURE = 0x444E4257;  // 'WBND'
+    const uint32_t XWB_CONTENT_VERSION = 46;
+    const uint32_t XWB_HEADER_VERSION = 44;
+
+    const uint32_t XWB_TYPE_STREAMING = 0x00000001;
+    const uint32_t XWB_FLAGS_ENTRYNAMES = 0x00010000;
+    const uint32_t XWB_FLAGS_COMPACT = 0x00020000;
+
+    const size_t XWB_SEGMENT_COUNT = 5;
+    const size_t XWB_HEADER_SIZE = 12 + XWB_SEGMENT_COUNT * 8;
+    const size_t XWB_BANKDATA_SIZE = 96;
+    const size_t XWB_ENTRY_SIZE = 24;
+    const size_t XWB_COMPACT_ENTRY_SIZE = 4;
+    const size_t XWB_NAME_SIZE = 64;
+
+    const uint32_t XWB_MIN_STREAMING_ALIGNMENT = 2048;
+    const uint32_t XWB_MAX_COMPACT_ALIGNMENT = 2048;
+    const uint32_t XWB_MAX_DURATION = 0x0fffffff;
+    const uint32_t XWB_MAX_COMPACT_OFFSET = 0x1fffff;
+
+    const uint32_t MINIFORMAT_TAG_PCM = 0;
+    const uint32_t MINIFORMAT_TAG_ADPCM = 2;
+    const uint32_t ADPCM_BLOCKALIGN_CONVERSION_OFFSET = 22;
+
+    // Seconds between the FILETIME epoch (1601) and the Unix epoch.
+    const uint64_t c_fileTimeEpochOffset = 11644473600ull;
+
+    inline bool IsPowerOfTwo(uint32_t n)
+    {
+        return n && !(n & (n - 1));
+    }
+
+    inline uint64_t AlignUp(uint64_t value, uint32_t alignment)
+    {
+        return (value + alignment - 1) & ~uint64_t(alignment - 1);
+    }
+
+    class ByteWriter
+    {
+    public:
+        explicit ByteWriter(std::vector<uint8_t>& buffer) : m_buffer(buffer) {}
+
+        void Put32(uint32_t value)
+        {
+            uint8_t bytes[4] = { uint8_t(value), uint8_t(value >> 8), uint8_t(value >> 16), uint8_t(value >> 24) };
+            m_buffer.insert(m_buffer.end(), bytes, bytes + 4);
+        }
+
+        void Put64(uint64_t value)
+        {
+            Put32(static_cast<uint32_t>(value));
+            Put32(static_cast<uint32_t>(value >> 32));
+        }
+
+        void PutString(const std::string& value, size_t size)
+        {
+            size_t count = std::min(value.size(), size - 1);
+            m_buffer.insert(m_buffer.end(), value.begin(), value.begin() + ptrdiff_t(count));
+            m_buffer.insert(m_buffer.end(), size - count, 0);
+        }
+
+    private:
+        std::vector<uint8_t>& m_buffer;
+    };
+
+    // MINIWAVEFORMAT packing: tag:2, channels:3, rate:18, blockAlign:8, bits:1
+    uint32_t MakeMiniFormat(uint32_t formatTag, uint32_t channels, uint32_t sampleRate, uint32_t blockAlign, uint32_t bitsPerSample)
+    {
+        if (!channels || channels > 7 || sampleRate > 0x3ffff)
+            throw std::runtime_error("WaveBankBuilder: channel count or sample rate out of range");
+
+        uint32_t tag;
+        uint32_t align;
+        uint32_t bits = 0;
+
+        if (formatTag == Riff::FormatPCM)
+        {
+            if ((bitsPerSample != 8 && bitsPerSample != 16) || blockAlign != channels * bitsPerSample / 8)
+                throw std::runtime_error("WaveBankBuilder: unsupported PCM format");
+
+            tag = MINIFORMAT_TAG_PCM;
+            align = blockAlign;
+            bits = (bitsPerSample == 16) ? 1u : 0u;
+        }
+        else if (formatTag == Riff::FormatADPCM)
+        {
+            uint32_t perChannel = blockAlign / channels;
+            if (blockAlign % channels || perChannel < ADPCM_BLOCKALIGN_CONVERSION_OFFSET
+                || perChannel - ADPCM_BLOCKALIGN_CONVERSION_OFFSET > 0xff)
+                throw std::runtime_error("WaveBankBuilder: ADPCM block size not representable");
+
+            tag = MINIFORMAT_TAG_ADPCM;
+            align = perChannel - ADPCM_BLOCKALIGN_CONVERSION_OFFSET;
+        }
+        else
+        {
+            throw std::runtime_error("WaveBankBuilder: only PCM and MS-ADPCM entries are supported");
+        }
+
+        return tag | (channels << 2) | (sampleRate << 5) | (align << 23) | (bits << 31);
+    }
+
+    uint32_t GetDuration(uint32_t formatTag, uint32_t channels, uint32_t blockAlign, size_t bytes)
+    {
+        uint64_t frames = (formatTag == Riff::FormatADPCM)
+            ? uint64_t(bytes / blockAlign) * MSADPCM::SamplesPerBlock(blockAlign, channels)
+            : bytes / blockAlign;
+
+        if (frames > XWB_MAX_DURATION)
+            throw std::runtime_error("WaveBankBuilder: entry too long");
+
+        return static_cast<uint32_t>(frames);
+    }
+
+    std::string MakeEntryName(const wchar_t* szFileName)
+    {
+        const wchar_t* start = szFileName;
+        for (const wchar_t* ptr = szFileName; *ptr; ++ptr)
+        {
+            if (*ptr == L'\\' || *ptr == L'/' || *ptr == L':')
+                start = ptr + 1;
+        }
+
+        // Names are stored as 8-bit strings; anything outside ASCII is replaced.
+        std::string name;
+        for (const wchar_t* ptr = start; *ptr && *ptr != L'.'; ++ptr)
+            name += (*ptr < 0x80) ? static_cast<char>(*ptr) : '_';
+
+        return name;
+    }
+
+    FILE* CreateOutputFile(const wchar_t* szFileName)
+    {
+        FILE* file = nullptr;
+        if (_wfopen_s(&file, szFileName, L"wb") != 0)
+            file = nullptr;
+        if (!file)
+            throw std::runtime_error("WaveBankBuilder: failed to create output file");
+
+        return file;
+    }
+}
+
+WaveBankBuilder::Options WaveBankBuilder::DefaultOptions()
+{
+    Options options;
+    options.bankName = "WaveBank";
+    options.alignment = 4096;
+    options.streaming = true;
+    options.compact = false;
+    options.entryNames = true;
+    options.encodeADPCM = false;
+    options.samplesPerBlock = 128;
+    options.encodeMode = MSADPCM::EncodeMode::Fast;
+    options.flags = 0;
+    return options;
+}
+
+size_t WaveBankBuilder::AddWaveFile(const wchar_t* szFileName, uint32_t accessRank)
+{
+    MappedFile image(szFileName);
+
+    Riff::WaveData wave;
+    Riff::ParseWave(image.GetData(), image.GetSize(), wave);
+
+    if (wave.formatTag == Riff::FormatADPCM)
+    {
+        // Wave banks cannot carry custom coefficient sets.
+        auto adpcm = reinterpret_cast<const Riff::ADPCMWaveFormat*>(wave.format);
+        if (wave.formatSize < sizeof(Riff::ADPCMWaveFormat) || adpcm->numCoef != MSADPCM::NumCoefficients)
+            throw std::runtime_error("WaveBankBuilder: ADPCM file does not use the standard coefficients");
+
+        for (uint32_t j = 0; j < MSADPCM::NumCoefficients; ++j)
+        {
+            if (adpcm->coef[j].coef1 != MSADPCM::Coefficients[j][0] || adpcm->coef[j].coef2 != MSADPCM::Coefficients[j][1])
+                throw std::runtime_error("WaveBankBuilder: ADPCM file does not use the standard coefficients");
+        }
+    }
+
+    std::string name = MakeEntryName(szFileName);
+
+    return AddEntry(name.c_str(), wave.formatTag, wave.format->channels, wave.format->samplesPerSec,
+        wave.format->blockAlign, wave.format->bitsPerSample, wave.sampleData, wave.sampleBytes,
+        wave.loopStart, wave.loopLength, accessRank);
+}
+
+size_t WaveBankBuilder::AddEntry(const char* name, uint32_t formatTag, uint32_t channels, uint32_t sampleRate,
+    uint32_t blockAlign, uint32_t bitsPerSample, const uint8_t* data, size_t bytes,
+    uint32_t loopStart, uint32_t loopLength, uint32_t accessRank)
+{
+    // Validates the format up front so Build only fails on layout limits.
+    (void)MakeMiniFormat(formatTag, channels, sampleRate, blockAlign, bitsPerSample);
+
+    if (!data || !bytes)
+        throw std::invalid_argument("WaveBankBuilder: empty entry");
+
+    Entry entry;
+    entry.name = name ? name : "";
+    entry.formatTag = formatTag;
+    entry.channels = channels;
+    entry.sampleRate = sampleRate;
+    entry.blockAlign = blockAlign;
+    entry.bitsPerSample = (formatTag == Riff::FormatADPCM) ? 4 : bitsPerSample;
+
+    // Only whole frames or blocks are kept.
+    entry.data.assign(data, data + (bytes - bytes % blockAlign));
+    if (entry.data.empty())
+        throw std::invalid_argument("WaveBankBuilder: entry shorter than one block");
+
+    entry.loopStart = loopStart;
+    entry.loopLength = loopLength;
+    entry.accessRank = accessRank;
+
+    m_entries.push_back(std::move(entry));
+    return m_entries.size() - 1;
+}
+
+WaveBankBuilder::Entry WaveBankBuilder::EncodeEntry(const Entry& entry, const Options& options)
+{
+    const uint32_t channels = entry.channels;
+
+    std::vector<int16_t> pcm;
+    if (entry.bitsPerSample == 8)
+    {
+        pcm.resize(entry.data.size());
+        for (size_t j = 0; j < pcm.size(); ++j)
+            pcm[j] = static_cast<int16_t>((int(entry.data[j]) - 128) << 8);
+    }
+    else
+    {
+        pcm.resize(entry.data.size() / sizeof(int16_t));
+        memcpy(pcm.data(), entry.data.data(), pcm.size() * sizeof(int16_t));
+    }
+
+    Entry result = entry;
+    result.formatTag = Riff::FormatADPCM;
+    result.bitsPerSample = 4;
+    result.blockAlign = MSADPCM::BlockHeaderSize * channels + (options.samplesPerBlock - 2) * channels / 2;
+    result.data = MSADPCM::Encode(pcm.data(), pcm.size() / channels, channels, result.blockAlign, options.encodeMode);
+
+    return result;
+}
+
+std::vector<size_t> WaveBankBuilder::Build(const wchar_t* szOutputFile, const Options& options) const
+{
+    if (m_entries.empty())
+        throw std::runtime_error("WaveBankBuilder: no entries");
+
+    if (!IsPowerOfTwo(options.alignment) || options.alignment < 4)
+        throw std::runtime_error("WaveBankBuilder: alignment must be a power of two");
+
+    if (options.streaming && options.alignment < XWB_MIN_STREAMING_ALIGNMENT)
+        throw std::runtime_error("WaveBankBuilder: streaming banks need at least 2048 byte alignment");
+
+    if (options.encodeADPCM && (options.samplesPerBlock < 4 || (options.samplesPerBlock & 1)))
+        throw std::runtime_error("WaveBankBuilder: samplesPerBlock must be even");
+
+    const size_t count = m_entries.size();
+
+    // Encode 16-bit PCM entries if requested; everything else is written as is.
+    std::vector<Entry> encoded;
+    encoded.reserve(count);
+
+    std::vector<const Entry*> entries(count);
+    for (size_t j = 0; j < count; ++j)
+    {
+        const Entry& entry = m_entries[j];
+        if (options.encodeADPCM && entry.formatTag == Riff::FormatPCM)
+        {
+            encoded.push_back(EncodeEntry(entry, options));
+            entries[j] = &encoded.back();
+        }
+        else
+        {
+            entries[j] = &entry;
+        }
+    }
+
+    std::vector<uint32_t> formats(count);
+    for (size_t j = 0; j < count; ++j)
+    {
+        const Entry& e = *entries[j];
+        formats[j] = MakeMiniFormat(e.formatTag, e.channels, e.sampleRate, e.blockAlign, e.bitsPerSample);
+    }
+
+    // Data is laid out by access rank so entries needed together are read together.
+    std::vector<size_t> layout(count);
+    std::iota(layout.begin(), layout.end(), size_t(0));
+    std::stable_sort(layout.begin(), layout.end(),
+        [&](size_t a, size_t b) { return m_entries[a].accessRank < m_entries[b].accessRank; });
+
+    std::vector<size_t> bankOrder(count);
+    if (options.compact)
+    {
+        if (options.alignment > XWB_MAX_COMPACT_ALIGNMENT)
+            throw std::runtime_error("WaveBankBuilder: compact banks need alignment of 2048 or less");
+
+        for (size_t j = 0; j < count; ++j)
+        {
+            if (formats[j] != formats[0])
+                throw std::runtime_error("WaveBankBuilder: compact banks need one format for every entry");
+
+            if (entries[j]->loopLength)
+                throw std::runtime_error("WaveBankBuilder: compact banks cannot store loop regions");
+        }
+
+        bankOrder = layout;
+    }
+    else
+    {
+        std::iota(bankOrder.begin(), bankOrder.end(), size_t(0));
+    }
+
+    // Offsets of each source entry within the wave data segment.
+    std::vector<uint64_t> offsets(count);
+    uint64_t waveLength = 0;
+    for (size_t j : layout)
+    {
+        offsets[j] = waveLength;
+        waveLength = AlignUp(waveLength + entries[j]->data.size(), options.alignment);
+    }
+
+    if (waveLength > UINT32_MAX)
+        throw std::runtime_error("WaveBankBuilder: bank too large");
+
+    // Everything except the wave data goes in one contiguous block at the front.
+    const size_t metaSize = count * (options.compact ? XWB_COMPACT_ENTRY_SIZE : XWB_ENTRY_SIZE);
+    const size_t namesSize = options.entryNames ? count * XWB_NAME_SIZE : 0;
+
+    const uint32_t bankOffset = uint32_t(XWB_HEADER_SIZE);
+    const uint32_t metaOffset = uint32_t(bankOffset + XWB_BANKDATA_SIZE);
+    const uint32_t seekOffset = uint32_t(metaOffset + metaSize);
+    const uint32_t namesOffset = seekOffset;
+    const uint32_t waveOffset = uint32_t(AlignUp(namesOffset + namesSize, options.alignment));
+
+    std::vector<uint8_t> header;
+    header.reserve(waveOffset);
+    ByteWriter writer(header);
+
+    writer.Put32(XWB_SIGNATURE);
+    writer.Put32(XWB_CONTENT_VERSION);
+    writer.Put32(XWB_HEADER_VERSION);
+
+    writer.Put32(bankOffset);
+    writer.Put32(uint32_t(XWB_BANKDATA_SIZE));
+    writer.Put32(metaOffset);
+    writer.Put32(uint32_t(metaSize));
+    writer.Put32(seekOffset);
+    writer.Put32(0);
+    writer.Put32(options.entryNames ? namesOffset : 0);
+    writer.Put32(uint32_t(namesSize));
+    writer.Put32(waveOffset);
+    writer.Put32(uint32_t(waveLength));
+
+    uint32_t flags = (options.flags & ~(XWB_TYPE_STREAMING | XWB_FLAGS_ENTRYNAMES | XWB_FLAGS_COMPACT))
+        | (options.streaming ? XWB_TYPE_STREAMING : 0)
+        | (options.entryNames ? XWB_FLAGS_ENTRYNAMES : 0)
+        | (options.compact ? XWB_FLAGS_COMPACT : 0);
+
+    auto now = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch());
+    uint64_t buildTime = (uint64_t(now.count()) + c_fileTimeEpochOffset) * 10000000ull;
+
+    writer.Put32(flags);
+    writer.Put32(uint32_t(count));
+    writer.PutString(options.bankName, 64);
+    writer.Put32(uint32_t(options.compact ? XWB_COMPACT_ENTRY_SIZE : XWB_ENTRY_SIZE));
+    writer.Put32(uint32_t(XWB_NAME_SIZE));
+    writer.Put32(options.alignment);
+    writer.Put32(options.compact ? formats[0] : 0);
+    writer.Put64(buildTime);
+
+    for (size_t j : bankOrder)
+    {
+        const Entry& e = *entries[j];
+
+        if (options.compact)
+        {
+            // Aligned offset (21 bits) and the padding after the data (11 bits).
+            uint64_t unit = offsets[j] / options.alignment;
+            uint64_t padding = AlignUp(e.data.size(), options.alignment) - e.data.size();
+            if (unit > XWB_MAX_COMPACT_OFFSET)
+                throw std::runtime_error("WaveBankBuilder: bank too large for compact entries");
+
+            writer.Put32(uint32_t(unit) | (uint32_t(padding) << 21));
+        }
+        else
+        {
+            writer.Put32(GetDuration(e.formatTag, e.channels, e.blockAlign, e.data.size()) << 4);
+            writer.Put32(formats[j]);
+            writer.Put32(uint32_t(offsets[j]));
+            writer.Put32(uint32_t(e.data.size()));
+            writer.Put32(e.loopStart);
+            writer.Put32(e.loopLength);
+        }
+    }
+
+    if (options.entryNames)
+    {
+        for (size_t j : bankOrder)
+            writer.PutString(entries[j]->name, XWB_NAME_SIZE);
+    }
+
+    header.resize(waveOffset, 0);
+
+    FILE* file = CreateOutputFile(szOutputFile);
+
+    bool ok = fwrite(header.data(), 1, header.size(), file) == header.size();
+
+    static const uint8_t s_zero[4096] = {};
+    for (size_t j : layout)
+    {
+        if (!ok)
+            break;
+
+        const auto& data = entries[j]->data;
+        ok = fwrite(data.data(), 1, data.size(), file) == data.size();
+
+        size_t padding = size_t(AlignUp(data.size(), options.alignment) - data.size());
+        while (ok && padding)
+        {
+            size_t chunk = std::min(padding, sizeof(s_zero));
+            ok = fwrite(s_zero, 1, chunk, file) == chunk;
+            padding -= chunk;
+        }
+    }
+
+    if (fclose(file) != 0)
+        ok = false;
+
+    if (!ok)
+        throw std::runtime_error("WaveBankBuilder: write failed");
+
+    return bankOrder;
+}
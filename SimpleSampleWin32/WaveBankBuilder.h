@@ -0,0 +1,83 @@
+//
+// WaveBankBuilder.h - Builds XACT-compatible wave banks (.xwb) from .wav files
+//
+
+#pragma once
+
+#include "MSADPCM.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace DX
+{
+    // Writes wave banks readable by DirectXTK's WaveBank and by WaveBankStream. All metadata
+    // is packed at the front of the file so opening a bank touches only its first sectors, and
+    // each entry's data starts on an 'alignment' boundary so it can be read unbuffered.
+    class WaveBankBuilder
+    {
+    public:
+        struct Options
+        {
+            std::string         bankName;
+            uint32_t            alignment;          // Power of two; at least 2048 for streaming banks
+            bool                streaming;          // Sets the streaming bank type
+            bool                compact;            // 4-byte entries; needs one shared format and alignment <= 2048
+            bool                entryNames;
+            bool                encodeADPCM;        // Encodes 16-bit PCM entries to MS-ADPCM
+            uint32_t            samplesPerBlock;    // ADPCM frames per block when encoding
+            MSADPCM::EncodeMode encodeMode;
+            uint32_t            flags;              // Further XACT bank flags, such as those of a copied bank;
+                                                    // bits the options above control are ignored
+        };
+
+        // Layout order for entries added without an explicit access rank.
+        static const uint32_t DefaultAccessRank = UINT32_MAX;
+
+        static Options DefaultOptions();
+
+        WaveBankBuilder() = default;
+
+        WaveBankBuilder(WaveBankBuilder const&) = delete;
+        WaveBankBuilder& operator= (WaveBankBuilder const&) = delete;
+
+        // Adds a PCM or MS-ADPCM .wav file, named after the file. Entries with a lower access
+        // rank are placed earlier in the file; ties keep the order they were added. Returns
+        // the entry index.
+        size_t AddWaveFile(const wchar_t* szFileName, uint32_t accessRank = DefaultAccessRank);
+
+        // Adds already-encoded sample data. formatTag is WAVE_FORMAT_PCM or WAVE_FORMAT_ADPCM.
+        size_t AddEntry(const char* name, uint32_t formatTag, uint32_t channels, uint32_t sampleRate,
+            uint32_t blockAlign, uint32_t bitsPerSample, const uint8_t* data, size_t bytes,
+            uint32_t loopStart = 0, uint32_t loopLength = 0, uint32_t accessRank = DefaultAccessRank);
+
+        size_t GetEntryCount() const { return m_entries.size(); }
+
+        // Writes the bank. Compact banks derive each entry's length from the next entry's
+        // offset, so their entries are renumbered into layout order; the result lists the
+        // index passed to Add* for each entry of the written bank. Throws std::runtime_error
+        // if an entry cannot be represented.
+        std::vector<size_t> Build(const wchar_t* szOutputFile, const Options& options) const;
+
+    private:
+        struct Entry
+        {
+            std::string             name;
+            uint32_t                formatTag;
+            uint32_t                channels;
+            uint32_t                sampleRate;
+            uint32_t                blockAlign;
+            uint32_t                bitsPerSample;
+            std::vector<uint8_t>    data;
+            uint32_t                loopStart;
+            uint32_t                loopLength;
+            uint32_t                accessRank;
+        };
+
+        static Entry EncodeEntry(const Entry& entry, const Options& options);
+
+        std::vector<Entry>  m_entries;
+    };
+}
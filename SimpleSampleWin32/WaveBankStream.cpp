@@ -0,0 +1,760 @@
+//
+// WaveBankStream.cpp
+//
+
+#include "pch.h"
+#include "WaveBankStream.h"
+#include "MappedFile.h"
+#include "MSADPCM.h"
+#include "RiffParser.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace DX;
+
+namespace
+{
+    // Unbuffered reads require sector-aligned offsets, sizes, and memory.
+    const size_t c_sectorSize = 4096;
+
+    static_assert((WaveBankStream::ChunkSize % c_sectorSize) == 0, "ChunkSize must be a multiple of the sector size");
+
+#pragma pack(push, 1)
+    // XACT wave bank layout, as written by xwbtool and the legacy XACT tools.
+    const uint32_t XWB_SIGNATURE = 0x444E4257;  // 'WBND'
+    const uint32_t XWB_FLAGS_COMPACT = 0x00020000;
+
+    enum XwbSegment
+    {
+        XWB_SEGIDX_BANKDATA = 0,
+        XWB_SEGIDX_ENTRYMETADATA,
+        XWB_SEGIDX_SEEKTABLES,
+        XWB_SEGIDX_ENTRYNAMES,
+        XWB_SEGIDX_ENTRYWAVEDATA,
+        XWB_SEGIDX_COUNT
+    };
+
+    struct XwbRegion
+    {
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    struct XwbHeader
+    {
+        uint32_t    signature;
+        uint32_t    version;
+        uint32_t    headerVersion;
+        XwbRegion   segments[XWB_SEGIDX_COUNT];
+    };
+
+    struct XwbBankData
+    {
+        uint32_t    flags;
+        uint32_t    entryCount;
+        char        bankName[64];
+        uint32_t    entryMetaDataElementSize;
+        uint32_t    entryNameElementSize;
+        uint32_t    alignment;
+        uint32_t    compactFormat;
+        uint64_t    buildTime;
+    };
+
+    struct XwbEntry
+    {
+        uint32_t    flagsAndDuration;
+        uint32_t    format;
+        XwbRegion   playRegion;
+        XwbRegion   loopRegion;
+    };
+
+#pragma pack(pop)
+
+    const uint32_t FOURCC_RIFF = 0x46464952;    // 'RIFF'
+
+    // MINIWAVEFORMAT packing: tag:2, channels:3, rate:18, blockAlign:8, bits:1
+    const uint32_t MINIFORMAT_TAG_PCM = 0;
+    const uint32_t MINIFORMAT_TAG_ADPCM = 2;
+    const uint32_t ADPCM_BLOCKALIGN_CONVERSION_OFFSET = 22;
+
+    WaveBankStream::EntryInfo DecodeMiniFormat(uint32_t format, uint64_t dataOffset, uint32_t dataLength)
+    {
+        uint32_t tag = format & 0x3;
+        uint32_t channels = (format >> 2) & 0x7;
+        uint32_t rate = (format >> 5) & 0x3ffff;
+        uint32_t blockAlign = (format >> 23) & 0xff;
+        uint32_t bits = (format >> 31) & 0x1;
+
+        WaveBankStream::EntryInfo info = {};
+        info.channels = channels;
+        info.sampleRate = rate;
+        info.dataOffset = dataOffset;
+        info.dataLength = dataLength;
+
+        switch (tag)
+        {
+        case MINIFORMAT_TAG_PCM:
+            info.formatTag = WaveBankStream::FormatPCM;
+            info.bitsPerSample = bits ? 16u : 8u;
+            info.blockAlign = channels * (info.bitsPerSample / 8);
+            break;
+
+        case MINIFORMAT_TAG_ADPCM:
+            info.formatTag = WaveBankStream::FormatADPCM;
+            info.bitsPerSample = 4;
+            info.blockAlign = (blockAlign + ADPCM_BLOCKALIGN_CONVERSION_OFFSET) * channels;
+            break;
+
+        default:
+            // xWMA and XMA2 require a platform decoder and are listed but cannot be streamed.
+            info.formatTag = 0;
+            break;
+        }
+
+        return info;
+    }
+
+    struct aligned_deleter
+    {
+        void operator()(void* p) noexcept
+        {
+            _aligned_free(p);
+        }
+    };
+
+    std::unique_ptr<uint8_t, aligned_deleter> AllocateAligned(size_t bytes)
+    {
+        void* ptr = _aligned_malloc(bytes, c_sectorSize);
+        if (!ptr)
+            throw std::bad_alloc();
+
+        return std::unique_ptr<uint8_t, aligned_deleter>(static_cast<uint8_t*>(ptr));
+    }
+
+    // Minimal positional reader over an unbuffered file handle.
+    class UnbufferedFile
+    {
+    public:
+        UnbufferedFile() noexcept :
+            m_handle(INVALID_HANDLE_VALUE),
+            m_size(0)
+        {
+        }
+
+        ~UnbufferedFile() { Close(); }
+
+        UnbufferedFile(UnbufferedFile const&) = delete;
+        UnbufferedFile& operator= (UnbufferedFile const&) = delete;
+
+        void Open(const wchar_t* szFileName)
+        {
+            Close();
+
+            m_handle = CreateFileW(szFileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                FILE_FLAG_NO_BUFFERING | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            if (m_handle == INVALID_HANDLE_VALUE)
+                throw std::runtime_error("WaveBankStream: failed to open file");
+
+            LARGE_INTEGER size;
+            if (!GetFileSizeEx(m_handle, &size))
+                throw std::runtime_error("WaveBankStream: GetFileSizeEx");
+
+            m_size = static_cast<uint64_t>(size.QuadPart);
+        }
+
+        void Close() noexcept
+        {
+            if (m_handle != INVALID_HANDLE_VALUE)
+            {
+                CloseHandle(m_handle);
+                m_handle = INVALID_HANDLE_VALUE;
+            }
+            m_size = 0;
+        }
+
+        uint64_t GetSize() const { return m_size; }
+
+        // 'offset' and 'bytes' must be sector multiples and 'buffer' sector aligned.
+        // Returns the number of bytes read, which is short at the end of the file.
+        size_t ReadAligned(uint64_t offset, uint8_t* buffer, size_t bytes) const
+        {
+            OVERLAPPED ov = {};
+            ov.Offset = static_cast<DWORD>(offset);
+            ov.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+            DWORD bytesRead = 0;
+            if (!ReadFile(m_handle, buffer, static_cast<DWORD>(bytes), &bytesRead, &ov))
+            {
+                if (GetLastError() != ERROR_HANDLE_EOF)
+                    throw std::runtime_error("WaveBankStream: ReadFile");
+            }
+            return bytesRead;
+        }
+
+        // Convenience for small header reads at arbitrary offsets.
+        void Read(uint64_t offset, void* dest, size_t bytes) const
+        {
+            uint64_t alignedOffset = offset & ~static_cast<uint64_t>(c_sectorSize - 1);
+            size_t skip = static_cast<size_t>(offset - alignedOffset);
+            size_t alignedBytes = (skip + bytes + c_sectorSize - 1) & ~(c_sectorSize - 1);
+
+            auto temp = AllocateAligned(alignedBytes);
+            if (ReadAligned(alignedOffset, temp.get(), alignedBytes) < skip + bytes)
+                throw std::runtime_error("WaveBankStream: unexpected end of file");
+
+            memcpy(dest, temp.get() + skip, bytes);
+        }
+
+    private:
+        HANDLE      m_handle;
+        uint64_t    m_size;
+    };
+}
+
+class WaveBankStream::Impl
+{
+public:
+    Impl() noexcept(false) :
+        m_bankFlags(0),
+        m_current(nullptr),
+        m_loop(false),
+        m_stop(false),
+        m_ioDone(false),
+        m_ioPosition(0),
+        m_readIndex(0),
+        m_writeIndex(0),
+        m_filled(0),
+        m_slotCursor(0),
+        m_scratchSize(0),
+        m_pcmCursor(0),
+        m_pcmFrames(0),
+        m_finished(true),
+        m_stats{}
+    {
+        for (size_t j = 0; j < ChunkCount; ++j)
+        {
+            m_slots[j].buffer = AllocateAligned(ChunkSize);
+            m_slots[j].data = nullptr;
+            m_slots[j].size = 0;
+            m_slots[j].endOfEntry = false;
+        }
+    }
+
+    ~Impl()
+    {
+        Stop();
+    }
+
+    void Open(const wchar_t* szFileName)
+    {
+        Close();
+        m_file.Open(szFileName);
+
+        uint32_t signature = 0;
+        m_file.Read(0, &signature, sizeof(signature));
+
+        if (signature == XWB_SIGNATURE)
+        {
+            ParseWaveBank();
+        }
+        else if (signature == FOURCC_RIFF)
+        {
+            ParseWaveFile(szFileName);
+        }
+        else
+        {
+            throw std::runtime_error("WaveBankStream: not a wave bank or RIFF file");
+        }
+
+        for (auto& it : m_entries)
+        {
+            if (it.dataOffset + it.dataLength > m_file.GetSize())
+                throw std::runtime_error("WaveBankStream: entry extends past end of file");
+        }
+    }
+
+    void Close()
+    {
+        Stop();
+
+        // Nothing may still refer to the entries or to data decoded from the old file.
+        m_current = nullptr;
+        m_pcmCursor = m_pcmFrames = 0;
+
+        m_entries.clear();
+        m_bankFlags = 0;
+        m_file.Close();
+    }
+
+    void Start(size_t index, bool loop)
+    {
+        Stop();
+
+        if (index >= m_entries.size())
+            throw std::out_of_range("WaveBankStream: invalid entry index");
+
+        const EntryInfo& entry = m_entries[index];
+        bool supported = (entry.formatTag == FormatADPCM)
+            || (entry.formatTag == FormatPCM && (entry.bitsPerSample == 8 || entry.bitsPerSample == 16));
+        if (!supported || !entry.channels || !entry.blockAlign)
+            throw std::runtime_error("WaveBankStream: entry format cannot be streamed");
+
+        uint32_t framesPerUnit = (entry.formatTag == FormatADPCM)
+            ? MSADPCM::SamplesPerBlock(entry.blockAlign, entry.channels)
+            : 1u;
+        if (!framesPerUnit)
+            throw std::runtime_error("WaveBankStream: invalid block alignment");
+
+        m_current = &entry;
+        m_loop = loop;
+        m_stop = false;
+        m_ioDone = false;
+        m_ioPosition = 0;
+        m_readIndex = m_writeIndex = m_filled = 0;
+        m_slotCursor = 0;
+        m_scratch.resize(entry.blockAlign);
+        m_scratchSize = 0;
+        m_pcm.resize(size_t(framesPerUnit) * entry.channels);
+        m_pcmCursor = m_pcmFrames = 0;
+        m_finished = false;
+        m_stats = {};
+
+        m_thread = std::thread(&Impl::ReaderThread, this);
+    }
+
+    void Stop()
+    {
+        if (m_thread.joinable())
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stop = true;
+            }
+            m_spaceAvailable.notify_all();
+            m_thread.join();
+        }
+
+        m_finished = true;
+    }
+
+    size_t Read(int16_t* output, size_t maxFrames, bool wait)
+    {
+        if (!m_current || !output)
+            return 0;
+
+        const uint32_t channels = m_current->channels;
+        size_t frames = 0;
+
+        while (frames < maxFrames)
+        {
+            if (m_pcmCursor < m_pcmFrames)
+            {
+                size_t count = std::min(maxFrames - frames, m_pcmFrames - m_pcmCursor);
+                memcpy(output + frames * channels, m_pcm.data() + m_pcmCursor * channels, count * channels * sizeof(int16_t));
+                m_pcmCursor += count;
+                frames += count;
+                continue;
+            }
+
+            if (m_finished || !DecodeNextUnit(wait))
+                break;
+        }
+
+        m_stats.framesDecoded += frames;
+        return frames;
+    }
+
+    bool IsFinished() const { return m_finished && m_pcmCursor >= m_pcmFrames; }
+
+    Statistics GetStatistics()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_stats;
+    }
+
+    std::vector<EntryInfo> m_entries;
+    uint32_t m_bankFlags;
+
+private:
+    struct Slot
+    {
+        std::unique_ptr<uint8_t, aligned_deleter>   buffer;
+        const uint8_t*                              data;       // First valid byte within buffer
+        size_t                                      size;       // Valid bytes
+        bool                                        endOfEntry;
+    };
+
+    void ParseWaveBank()
+    {
+        XwbHeader header;
+        m_file.Read(0, &header, sizeof(header));
+
+        const XwbRegion& bankRegion = header.segments[XWB_SEGIDX_BANKDATA];
+        if (bankRegion.length < sizeof(XwbBankData))
+            throw std::runtime_error("WaveBankStream: invalid bank data segment");
+
+        XwbBankData bank;
+        m_file.Read(bankRegion.offset, &bank, sizeof(bank));
+        m_bankFlags = bank.flags;
+
+        const XwbRegion& metaRegion = header.segments[XWB_SEGIDX_ENTRYMETADATA];
+        const XwbRegion& waveRegion = header.segments[XWB_SEGIDX_ENTRYWAVEDATA];
+
+        if (!bank.entryCount)
+            return;
+
+        std::vector<uint8_t> meta(metaRegion.length);
+        m_file.Read(metaRegion.offset, meta.data(), meta.size());
+
+        if (bank.flags & XWB_FLAGS_COMPACT)
+        {
+            // Compact entries pack an aligned offset (21 bits) and a length deviation (11 bits).
+            if (bank.entryMetaDataElementSize != sizeof(uint32_t)
+                || size_t(bank.entryCount) * sizeof(uint32_t) > meta.size())
+                throw std::runtime_error("WaveBankStream: invalid compact entry table");
+
+            auto compact = reinterpret_cast<const uint32_t*>(meta.data());
+            for (uint32_t j = 0; j < bank.entryCount; ++j)
+            {
+                uint32_t offset = (compact[j] & 0x1fffff) * bank.alignment;
+                uint32_t deviation = compact[j] >> 21;
+                uint32_t end = (j + 1 < bank.entryCount)
+                    ? (compact[j + 1] & 0x1fffff) * bank.alignment
+                    : waveRegion.length;
+                if (end < offset + deviation)
+                    throw std::runtime_error("WaveBankStream: invalid compact entry");
+
+                m_entries.push_back(DecodeMiniFormat(bank.compactFormat,
+                    uint64_t(waveRegion.offset) + offset, end - offset - deviation));
+            }
+        }
+        else
+        {
+            if (bank.entryMetaDataElementSize < sizeof(XwbEntry)
+                || size_t(bank.entryCount) * bank.entryMetaDataElementSize > meta.size())
+                throw std::runtime_error("WaveBankStream: invalid entry table");
+
+            for (uint32_t j = 0; j < bank.entryCount; ++j)
+            {
+                XwbEntry entry;
+                memcpy(&entry, meta.data() + size_t(j) * bank.entryMetaDataElementSize, sizeof(entry));
+
+                auto info = DecodeMiniFormat(entry.format, uint64_t(waveRegion.offset) + entry.playRegion.offset, entry.playRegion.length);
+                info.loopStart = entry.loopRegion.offset;
+                info.loopLength = entry.loopRegion.length;
+                m_entries.push_back(info);
+            }
+        }
+    }
+
+    void ParseWaveFile(const wchar_t* szFileName)
+    {
+        // Only the headers are touched through the mapping; sample data is read by the stream.
+        MappedFile image(szFileName);
+
+        Riff::WaveData wave;
+        Riff::ParseWave(image.GetData(), image.GetSize(), wave);
+
+        EntryInfo info = {};
+        info.formatTag = wave.formatTag;
+        info.channels = wave.format->channels;
+        info.sampleRate = wave.format->samplesPerSec;
+        info.blockAlign = wave.format->blockAlign;
+        info.bitsPerSample = wave.format->bitsPerSample;
+        info.dataOffset = static_cast<uint64_t>(wave.sampleData - image.GetData());
+        info.dataLength = static_cast<uint32_t>(wave.sampleBytes);
+        info.loopStart = wave.loopStart;
+        info.loopLength = wave.loopLength;
+
+        m_entries.push_back(info);
+    }
+
+    void ReaderThread()
+    {
+        const EntryInfo& entry = *m_current;
+
+        for (;;)
+        {
+            size_t index;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_spaceAvailable.wait(lock, [this] { return m_stop || m_filled < ChunkCount; });
+                if (m_stop)
+                    return;
+                index = m_writeIndex;
+            }
+
+            // The slot at m_writeIndex is not visible to the consumer until m_filled is bumped.
+            Slot& slot = m_slots[index];
+
+            uint64_t absolute = entry.dataOffset + m_ioPosition;
+            uint64_t aligned = absolute & ~static_cast<uint64_t>(c_sectorSize - 1);
+            size_t skip = static_cast<size_t>(absolute - aligned);
+
+            auto start = std::chrono::steady_clock::now();
+            size_t bytesRead = 0;
+            bool failed = false;
+            try
+            {
+                bytesRead = m_file.ReadAligned(aligned, slot.buffer.get(), ChunkSize);
+            }
+            catch (...)
+            {
+                failed = true;
+            }
+            auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+            size_t valid = 0;
+            if (!failed && bytesRead > skip)
+            {
+                valid = std::min<size_t>(bytesRead - skip, entry.dataLength - m_ioPosition);
+            }
+
+            slot.data = slot.buffer.get() + skip;
+            slot.size = valid;
+            m_ioPosition += valid;
+            slot.endOfEntry = (m_ioPosition >= entry.dataLength) || !valid;
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            m_stats.bytesRead += bytesRead;
+            ++m_stats.chunksRead;
+            m_stats.slowestReadMicroseconds = std::max(m_stats.slowestReadMicroseconds, static_cast<uint32_t>(elapsed.count()));
+
+            m_writeIndex = (m_writeIndex + 1) % ChunkCount;
+            ++m_filled;
+            m_dataAvailable.notify_one();
+
+            if (slot.endOfEntry)
+            {
+                if (m_loop && valid)
+                {
+                    m_ioPosition = 0;
+                }
+                else
+                {
+                    m_ioDone = true;
+                    return;
+                }
+            }
+        }
+    }
+
+    // Returns the slot currently being consumed, waiting for the reader if requested.
+    Slot* AcquireSlot(bool wait)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        if (!m_filled)
+        {
+            if (m_ioDone || m_stop)
+            {
+                m_finished = true;
+                return nullptr;
+            }
+
+            if (!wait)
+            {
+                ++m_stats.underruns;
+                return nullptr;
+            }
+
+            m_dataAvailable.wait(lock, [this] { return m_filled > 0 || m_ioDone || m_stop; });
+            if (!m_filled)
+            {
+                m_finished = true;
+                return nullptr;
+            }
+        }
+
+        return &m_slots[m_readIndex];
+    }
+
+    void ReleaseSlot()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_readIndex = (m_readIndex + 1) % ChunkCount;
+            --m_filled;
+        }
+        m_slotCursor = 0;
+        m_spaceAvailable.notify_one();
+    }
+
+    // Gathers one block (or PCM frame) from the ring and decodes it into m_pcm.
+    bool DecodeNextUnit(bool wait)
+    {
+        const size_t unit = m_current->blockAlign;
+        const uint8_t* source = nullptr;
+        bool release = false;
+
+        while (!source)
+        {
+            Slot* slot = AcquireSlot(wait);
+            if (!slot)
+                return false;
+
+            size_t remaining = slot->size - m_slotCursor;
+
+            if (!m_scratchSize && remaining >= unit)
+            {
+                // Common case: the whole unit is inside this chunk, so decode in place.
+                source = slot->data + m_slotCursor;
+                m_slotCursor += unit;
+            }
+            else
+            {
+                size_t count = std::min(unit - m_scratchSize, remaining);
+                memcpy(m_scratch.data() + m_scratchSize, slot->data + m_slotCursor, count);
+                m_scratchSize += count;
+                m_slotCursor += count;
+
+                if (m_scratchSize == unit)
+                {
+                    source = m_scratch.data();
+                    m_scratchSize = 0;
+                }
+            }
+
+            if (m_slotCursor >= slot->size)
+            {
+                // A trailing partial unit cannot be decoded, and must not merge with the loop start.
+                if (slot->endOfEntry)
+                    m_scratchSize = 0;
+
+                // When decoding in place, the slot must not be handed back to the reader until afterwards.
+                if (source && source != m_scratch.data())
+                {
+                    release = true;
+                }
+                else
+                {
+                    ReleaseSlot();
+                }
+            }
+        }
+
+        if (m_current->formatTag == FormatADPCM)
+        {
+            if (!MSADPCM::DecodeBlock(source, unit, m_current->channels, m_pcm.data()))
+                throw std::runtime_error("WaveBankStream: corrupt ADPCM block");
+
+            m_pcmFrames = MSADPCM::SamplesPerBlock(m_current->blockAlign, m_current->channels);
+        }
+        else if (m_current->bitsPerSample == 8)
+        {
+            for (uint32_t ch = 0; ch < m_current->channels; ++ch)
+                m_pcm[ch] = static_cast<int16_t>((int(source[ch]) - 128) << 8);
+
+            m_pcmFrames = 1;
+        }
+        else
+        {
+            memcpy(m_pcm.data(), source, m_current->channels * sizeof(int16_t));
+            m_pcmFrames = 1;
+        }
+
+        if (release)
+        {
+            ReleaseSlot();
+        }
+
+        m_pcmCursor = 0;
+        return true;
+    }
+
+    UnbufferedFile              m_file;
+    const EntryInfo*            m_current;
+    bool                        m_loop;
+
+    // Shared between the reader thread and the consumer; guarded by m_mutex.
+    std::mutex                  m_mutex;
+    std::condition_variable     m_dataAvailable;
+    std::condition_variable     m_spaceAvailable;
+    std::thread                 m_thread;
+    bool                        m_stop;
+    bool                        m_ioDone;
+    uint64_t                    m_ioPosition;   // Reader thread only
+    size_t                      m_readIndex;
+    size_t                      m_writeIndex;
+    size_t                      m_filled;
+    Slot                        m_slots[ChunkCount];
+
+    // Consumer state.
+    size_t                      m_slotCursor;
+    std::vector<uint8_t>        m_scratch;
+    size_t                      m_scratchSize;
+    std::vector<int16_t>        m_pcm;
+    size_t                      m_pcmCursor;
+    size_t                      m_pcmFrames;
+    bool                        m_finished;
+    Statistics                  m_stats;
+};
+
+WaveBankStream::WaveBankStream() noexcept(false) :
+    pImpl(std::make_unique<Impl>())
+{
+}
+
+WaveBankStream::~WaveBankStream()
+{
+}
+
+void WaveBankStream::Open(const wchar_t* szFileName)
+{
+    pImpl->Open(szFileName);
+}
+
+void WaveBankStream::Close()
+{
+    pImpl->Close();
+}
+
+size_t WaveBankStream::GetEntryCount() const
+{
+    return pImpl->m_entries.size();
+}
+
+const WaveBankStream::EntryInfo& WaveBankStream::GetEntry(size_t index) const
+{
+    if (index >= pImpl->m_entries.size())
+        throw std::out_of_range("WaveBankStream: invalid entry index");
+
+    return pImpl->m_entries[index];
+}
+
+uint32_t WaveBankStream::GetBankFlags() const
+{
+    return pImpl->m_bankFlags;
+}
+
+void WaveBankStream::Start(size_t index, bool loop)
+{
+    pImpl->Start(index, loop);
+}
+
+void WaveBankStream::Stop()
+{
+    pImpl->Stop();
+}
+
+size_t WaveBankStream::Read(int16_t* output, size_t maxFrames, bool wait)
+{
+    return pImpl->Read(output, maxFrames, wait);
+}
+
+bool WaveBankStream::IsFinished() const
+{
+    return pImpl->IsFinished();
+}
+
+WaveBankStream::Statistics WaveBankStream::GetStatistics() const
+{
+    return pImpl->GetStatistics();
+}
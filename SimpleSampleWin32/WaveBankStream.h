@@ -0,0 +1,84 @@
+//
+// WaveBankStream.h - Streams wave bank (.xwb) or .wav entries from disk
+//
+
+#pragma once
+
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace DX
+{
+    // Plays an entry of a wave bank or .wav file by reading its data in sector-aligned chunks
+    // on a background I/O thread into a small ring of buffers, decoding to 16-bit PCM on demand.
+    // Only a few chunks are ever resident, regardless of the size of the bank.
+    class WaveBankStream
+    {
+    public:
+        // WAVE_FORMAT_PCM and WAVE_FORMAT_ADPCM entries can be streamed.
+        static const uint32_t FormatPCM = 1;
+        static const uint32_t FormatADPCM = 2;
+
+        struct EntryInfo
+        {
+            uint32_t    formatTag;
+            uint32_t    channels;
+            uint32_t    sampleRate;
+            uint32_t    blockAlign;
+            uint32_t    bitsPerSample;
+            uint64_t    dataOffset;     // Absolute file offset of the first byte of wave data
+            uint32_t    dataLength;
+            uint32_t    loopStart;      // In frames
+            uint32_t    loopLength;     // Zero if the entry has no loop region
+        };
+
+        struct Statistics
+        {
+            uint64_t    bytesRead;
+            uint64_t    framesDecoded;
+            uint32_t    chunksRead;
+            uint32_t    underruns;      // Read calls that found no data ready and had to return early
+            uint32_t    slowestReadMicroseconds;
+        };
+
+        // Each ring slot holds one aligned read. Both must be multiples of the sector size.
+        static const size_t ChunkSize = 64 * 1024;
+        static const size_t ChunkCount = 4;
+
+        WaveBankStream() noexcept(false);
+        ~WaveBankStream();
+
+        WaveBankStream(WaveBankStream const&) = delete;
+        WaveBankStream& operator= (WaveBankStream const&) = delete;
+
+        // Opens a .xwb wave bank or a .wav file (which is exposed as a single entry).
+        void Open(const wchar_t* szFileName);
+        void Close();
+
+        size_t GetEntryCount() const;
+        const EntryInfo& GetEntry(size_t index) const;
+
+        // The bank's XACT flags, or 0 for a .wav file.
+        uint32_t GetBankFlags() const;
+
+        // Starts the background reader at the beginning of the given entry.
+        void Start(size_t index, bool loop = false);
+        void Stop();
+
+        // Decodes up to maxFrames interleaved PCM frames into output. Without 'wait' this never
+        // blocks on I/O: if the next chunk has not arrived yet it records an underrun and returns
+        // what it has. Returns 0 once a non-looping entry has been fully consumed.
+        size_t Read(int16_t* output, size_t maxFrames, bool wait = false);
+
+        bool IsFinished() const;
+
+        // Call from the same thread that calls Read.
+        Statistics GetStatistics() const;
+
+    private:
+        class Impl;
+
+        std::unique_ptr<Impl> pImpl;
+    };
+}
@@ -0,0 +1,402 @@
+//
+// ClusteredLights.cpp
+//
+
+#include "pch.h"
+#include "ClusteredLights.h"
+#include "TaskPartition.h"
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#if defined(_XM_SSE_INTRINSICS_) && !defined(_XM_NO_INTRINSICS_)
+#include <emmintrin.h>
+#endif
+
+using namespace DirectX;
+using namespace DX;
+
+ClusteredLights::ClusteredLights(unsigned int tilesX, unsigned int tilesY, unsigned int slices, WorkerPool& workers) noexcept(false) :
+    m_tilesX(tilesX),
+    m_tilesY(tilesY),
+    m_slices(slices),
+    m_rowStride((tilesX + 3) & ~3u),
+    m_xScale(1.f),
+    m_yScale(1.f),
+    m_near(0.f),
+    m_far(0.f),
+    m_sliceScale(0.f),
+    m_sliceBias(0.f),
+    m_lightCount(0),
+    m_stats{},
+    m_workers(workers)
+{
+    if (!tilesX || !tilesY || !slices || slices > UINT16_MAX)
+        throw std::invalid_argument("ClusteredLights needs at least one tile and 1 to 65535 slices");
+
+    if (uint64_t(tilesX) * tilesY * slices > UINT32_MAX)
+        throw std::invalid_argument("ClusteredLights has too many clusters");
+
+    m_clusters.resize(size_t(tilesX) * tilesY * slices);
+    m_workerStates.resize(m_workers.GetWorkerCount());
+    m_sliceCosts.resize(slices);
+    m_bounds.resize(m_workers.GetWorkerCount() + 1);
+    m_bases.resize(m_workers.GetWorkerCount());
+}
+
+void XM_CALLCONV ClusteredLights::SetProjection(FXMMATRIX projection)
+{
+    XMFLOAT4X4 m;
+    XMStoreFloat4x4(&m, projection);
+
+    // A right-handed perspective maps depth d = -z to w = d, with _33 = f / (n - f) and
+    // _43 = n * f / (n - f).
+    if (m._34 != -1.f || m._44 != 0.f || m._11 <= 0.f || m._22 <= 0.f)
+        throw std::invalid_argument("ClusteredLights needs a right-handed perspective projection");
+
+    float nearPlane = m._43 / m._33;
+    float farPlane = m._43 / (m._33 + 1.f);
+    if (!(nearPlane > 0.f) || !(farPlane > nearPlane) || farPlane > FLT_MAX)
+        throw std::invalid_argument("ClusteredLights needs finite near and far planes");
+
+    m_xScale = m._11;
+    m_yScale = m._22;
+    m_near = nearPlane;
+    m_far = farPlane;
+    m_sliceScale = float(m_slices) / logf(farPlane / nearPlane);
+    m_sliceBias = -logf(nearPlane) * m_sliceScale;
+
+    m_sliceDepth.resize(m_slices + 1);
+    for (unsigned int slice = 0; slice <= m_slices; ++slice)
+    {
+        m_sliceDepth[slice] = nearPlane * powf(farPlane / nearPlane, float(slice) / float(m_slices));
+    }
+    m_sliceDepth[m_slices] = farPlane;
+
+    // Padding tiles get an empty range so the SIMD test never reports them.
+    m_tileMinX.assign(size_t(m_slices) * m_rowStride, FLT_MAX);
+    m_tileMaxX.assign(size_t(m_slices) * m_rowStride, -FLT_MAX);
+    m_tileMinY.resize(size_t(m_slices) * m_tilesY);
+    m_tileMaxY.resize(size_t(m_slices) * m_tilesY);
+
+    // The side planes spread out with depth, so each box spans a tile's screen range at both
+    // ends of its slice.
+    for (unsigned int slice = 0; slice < m_slices; ++slice)
+    {
+        float d0 = m_sliceDepth[slice];
+        float d1 = m_sliceDepth[slice + 1];
+
+        for (unsigned int x = 0; x < m_tilesX; ++x)
+        {
+            float left = -1.f + 2.f * float(x) / float(m_tilesX);
+            float right = -1.f + 2.f * float(x + 1) / float(m_tilesX);
+            m_tileMinX[slice * m_rowStride + x] = std::min(left * d0, left * d1) / m_xScale;
+            m_tileMaxX[slice * m_rowStride + x] = std::max(right * d0, right * d1) / m_xScale;
+        }
+
+        // Tile rows run from the top of the screen down.
+        for (unsigned int y = 0; y < m_tilesY; ++y)
+        {
+            float top = 1.f - 2.f * float(y) / float(m_tilesY);
+            float bottom = 1.f - 2.f * float(y + 1) / float(m_tilesY);
+            m_tileMinY[slice * m_tilesY + y] = std::min(bottom * d0, bottom * d1) / m_yScale;
+            m_tileMaxY[slice * m_tilesY + y] = std::max(top * d0, top * d1) / m_yScale;
+        }
+    }
+}
+
+unsigned int ClusteredLights::GetSlice(float depth) const
+{
+    if (!(depth > m_near))
+        return 0;
+
+    float slice = logf(depth) * m_sliceScale + m_sliceBias;
+    if (!(slice < float(m_slices)))
+        return m_slices - 1;
+
+    return std::min(static_cast<unsigned int>(slice), m_slices - 1);
+}
+
+uint32_t XM_CALLCONV ClusteredLights::FindCluster(FXMVECTOR viewPosition) const
+{
+    XMFLOAT3 p;
+    XMStoreFloat3(&p, viewPosition);
+
+    float depth = -p.z;
+    if (!(depth >= m_near) || !(depth < m_far))
+        return InvalidCluster;
+
+    float tx = (p.x * m_xScale / depth + 1.f) * 0.5f * float(m_tilesX);
+    float ty = (1.f - p.y * m_yScale / depth) * 0.5f * float(m_tilesY);
+    if (!(tx >= 0.f) || !(tx < float(m_tilesX)) || !(ty >= 0.f) || !(ty < float(m_tilesY)))
+        return InvalidCluster;
+
+    return GetClusterIndex(std::min(static_cast<unsigned int>(tx), m_tilesX - 1), std::min(static_cast<unsigned int>(ty), m_tilesY - 1), GetSlice(depth));
+}
+
+void XM_CALLCONV ClusteredLights::Build(const Light* lights, size_t count, FXMMATRIX view)
+{
+    if (count > MaxLights)
+        throw std::invalid_argument("ClusteredLights supports at most 65535 lights");
+
+    if (m_sliceDepth.empty())
+        throw std::logic_error("ClusteredLights::SetProjection must be called before Build");
+
+    m_lightCount = count;
+    m_lightX.resize(count);
+    m_lightY.resize(count);
+    m_lightDepth.resize(count);
+    m_lightRadius.resize(count);
+    m_firstSlice.resize(count);
+    m_lastSlice.resize(count);
+
+    const unsigned int workerCount = m_workers.GetWorkerCount();
+
+    // Move the lights into view space and find the slices each one reaches.
+    XMMATRIX viewMatrix = view;
+    m_workers.Run([&](unsigned int worker)
+    {
+        size_t begin = count * worker / workerCount;
+        size_t end = count * (worker + 1) / workerCount;
+        PrepareLights(lights, begin, end, viewMatrix, m_workerStates[worker]);
+    });
+
+    // Hand out slices by the number of lights reaching them.
+    uint32_t visibleLights = 0;
+    for (unsigned int slice = 0; slice < m_slices; ++slice)
+    {
+        uint32_t total = 0;
+        for (auto& state : m_workerStates)
+        {
+            total += state.sliceLights[slice];
+        }
+        m_sliceCosts[slice] = float(total) + 1.f;
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (m_firstSlice[i] <= m_lastSlice[i])
+            ++visibleLights;
+    }
+
+    PartitionByCost(m_sliceCosts.data(), m_slices, workerCount, m_bounds.data());
+
+    m_workers.Run([&](unsigned int worker)
+    {
+        BinSlices(static_cast<unsigned int>(m_bounds[worker]), static_cast<unsigned int>(m_bounds[worker + 1]), m_workerStates[worker]);
+    });
+
+    // Join the workers' lists in slice order.
+    size_t total = 0;
+    uint32_t maxPerCluster = 0;
+    for (unsigned int worker = 0; worker < workerCount; ++worker)
+    {
+        m_bases[worker] = total;
+        total += m_workerStates[worker].indices.size();
+        maxPerCluster = std::max(maxPerCluster, m_workerStates[worker].maxPerCluster);
+    }
+
+    if (total > UINT32_MAX)
+        throw std::overflow_error("ClusteredLights produced too many light indices");
+
+    m_indices.resize(total);
+
+    m_workers.Run([&](unsigned int worker)
+    {
+        auto& state = m_workerStates[worker];
+        if (!state.indices.empty())
+            memcpy(&m_indices[m_bases[worker]], state.indices.data(), state.indices.size() * sizeof(uint16_t));
+
+        uint32_t base = uint32_t(m_bases[worker]);
+        size_t clusterBegin = m_bounds[worker] * m_tilesX * m_tilesY;
+        size_t clusterEnd = m_bounds[worker + 1] * m_tilesX * m_tilesY;
+        for (size_t cluster = clusterBegin; cluster < clusterEnd; ++cluster)
+        {
+            m_clusters[cluster].offset += base;
+        }
+    });
+
+    m_stats.lights = uint32_t(count);
+    m_stats.visibleLights = visibleLights;
+    m_stats.indices = uint32_t(total);
+    m_stats.maxPerCluster = maxPerCluster;
+}
+
+void ClusteredLights::PrepareLights(const Light* lights, size_t begin, size_t end, FXMMATRIX view, WorkerState& state)
+{
+    state.sliceLights.assign(m_slices, 0);
+
+    for (size_t i = begin; i < end; ++i)
+    {
+        const Light& light = lights[i];
+
+        XMVECTOR center = XMLoadFloat3(&light.position);
+        float radius = std::max(light.range, 0.f);
+
+        // Bound a spot light's cone by the smallest sphere around it: the circle at its far
+        // end for wide cones, or the sphere through its tip and that circle for narrow ones.
+        if (light.spotCosAngle > 0.f && light.spotCosAngle < 1.f)
+        {
+            XMVECTOR direction = XMVector3Normalize(XMLoadFloat3(&light.direction));
+            float cosAngle = light.spotCosAngle;
+            float offset;
+            if (cosAngle < 0.70710678f)
+            {
+                offset = radius * cosAngle;
+                radius *= sqrtf(1.f - cosAngle * cosAngle);
+            }
+            else
+            {
+                offset = radius / (2.f * cosAngle);
+                radius = offset;
+            }
+            center = XMVectorMultiplyAdd(direction, XMVectorReplicate(offset), center);
+        }
+
+        XMFLOAT3 p;
+        XMStoreFloat3(&p, XMVector3Transform(center, view));
+
+        float depth = -p.z;
+        m_lightX[i] = p.x;
+        m_lightY[i] = p.y;
+        m_lightDepth[i] = depth;
+        m_lightRadius[i] = radius;
+
+        if (!(depth + radius >= m_near) || !(depth - radius < m_far) || !(radius > 0.f))
+        {
+            m_firstSlice[i] = 1;
+            m_lastSlice[i] = 0;
+            continue;
+        }
+
+        unsigned int first = GetSlice(depth - radius);
+        unsigned int last = GetSlice(depth + radius);
+        m_firstSlice[i] = uint16_t(first);
+        m_lastSlice[i] = uint16_t(last);
+
+        for (unsigned int slice = first; slice <= last; ++slice)
+        {
+            ++state.sliceLights[slice];
+        }
+    }
+}
+
+void ClusteredLights::BinSlices(unsigned int sliceBegin, unsigned int sliceEnd, WorkerState& state)
+{
+    state.hits.clear();
+    state.maxPerCluster = 0;
+    state.indices.clear();
+
+    if (sliceBegin >= sliceEnd)
+        return;
+
+    const size_t sliceClusters = size_t(m_tilesX) * m_tilesY;
+    Cluster* clusters = m_clusters.data() + sliceBegin * sliceClusters;
+    const size_t clusterCount = (sliceEnd - sliceBegin) * sliceClusters;
+
+    for (size_t i = 0; i < clusterCount; ++i)
+    {
+        clusters[i].count = 0;
+    }
+
+    for (size_t i = 0; i < m_lightCount; ++i)
+    {
+        unsigned int first = std::max<unsigned int>(m_firstSlice[i], sliceBegin);
+        unsigned int last = std::min<unsigned int>(m_lastSlice[i], sliceEnd - 1);
+        if (first > last)
+            continue;
+
+        float radiusSq = m_lightRadius[i] * m_lightRadius[i];
+        float depth = m_lightDepth[i];
+        float y = m_lightY[i];
+
+        // The squared distance to a box is the sum of the distances along each axis, so the
+        // depth and row terms are shared by every tile behind them. Rows and tiles are sorted
+        // along their axis, so the ones a light reaches are contiguous.
+        for (unsigned int slice = first; slice <= last; ++slice)
+        {
+            float dz = std::max(std::max(m_sliceDepth[slice] - depth, depth - m_sliceDepth[slice + 1]), 0.f);
+            float remainingZ = radiusSq - dz * dz;
+            if (remainingZ < 0.f)
+                continue;
+
+            const float* minY = &m_tileMinY[slice * m_tilesY];
+            const float* maxY = &m_tileMaxY[slice * m_tilesY];
+            bool reached = false;
+            for (unsigned int row = 0; row < m_tilesY; ++row)
+            {
+                float dy = std::max(std::max(minY[row] - y, y - maxY[row]), 0.f);
+                float remaining = remainingZ - dy * dy;
+                if (remaining >= 0.f)
+                {
+                    BinRow(slice, row, uint16_t(i), m_lightX[i], remaining, state);
+                    reached = true;
+                }
+                else if (reached)
+                {
+                    break;
+                }
+            }
+        }
+    }
+
+    // Lay the lists out back to back, then fill them from the end so each keeps light order.
+    uint32_t offset = 0;
+    for (size_t i = 0; i < clusterCount; ++i)
+    {
+        offset += clusters[i].count;
+        clusters[i].offset = offset;
+        state.maxPerCluster = std::max(state.maxPerCluster, clusters[i].count);
+    }
+
+    state.indices.resize(offset);
+    for (size_t hit = state.hits.size(); hit-- > 0; )
+    {
+        state.indices[--m_clusters[state.hits[hit].cluster].offset] = uint16_t(state.hits[hit].light);
+    }
+}
+
+void ClusteredLights::BinRow(unsigned int slice, unsigned int y, uint16_t light, float x, float remaining, WorkerState& state)
+{
+    const float* minX = &m_tileMinX[slice * m_rowStride];
+    const float* maxX = &m_tileMaxX[slice * m_rowStride];
+    const uint32_t rowCluster = GetClusterIndex(0, y, slice);
+
+#if defined(_XM_SSE_INTRINSICS_) && !defined(_XM_NO_INTRINSICS_)
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 lightX = _mm_set1_ps(x);
+    const __m128 limit = _mm_set1_ps(remaining);
+
+    for (unsigned int tile = 0; tile < m_rowStride; tile += 4)
+    {
+        __m128 below = _mm_sub_ps(_mm_loadu_ps(minX + tile), lightX);
+        __m128 above = _mm_sub_ps(lightX, _mm_loadu_ps(maxX + tile));
+        __m128 dx = _mm_max_ps(_mm_max_ps(below, above), zero);
+        int hits = _mm_movemask_ps(_mm_cmple_ps(_mm_mul_ps(dx, dx), limit));
+
+        while (hits)
+        {
+            unsigned int bit = 0;
+            while (!(hits & (1 << bit)))
+                ++bit;
+            hits &= hits - 1;
+
+            Hit entry = { rowCluster + tile + bit, light };
+            state.hits.push_back(entry);
+            ++m_clusters[entry.cluster].count;
+        }
+    }
+#else
+    for (unsigned int tile = 0; tile < m_tilesX; ++tile)
+    {
+        float dx = std::max(std::max(minX[tile] - x, x - maxX[tile]), 0.f);
+        if (dx * dx <= remaining)
+        {
+            Hit entry = { rowCluster + tile, light };
+            state.hits.push_back(entry);
+            ++m_clusters[entry.cluster].count;
+        }
+    }
+#endif
+}
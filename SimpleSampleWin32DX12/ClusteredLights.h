@@ -0,0 +1,149 @@
+//
+// ClusteredLights.h - Bins point and spot lights into view-space clusters on the CPU
+//
+
+#pragma once
+
+#include "WorkerPool.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace DX
+{
+    // Splits the view frustum into tilesX x tilesY screen tiles and 'slices' depth slices,
+    // spaced exponentially so near clusters stay small, and builds a compact list of the
+    // lights touching each cluster every frame. A shader, or the CPU for effects with a
+    // fixed number of lights, then only has to look at the lights of the cluster a point
+    // falls in.
+    //
+    // Each light is bounded by a sphere and tested against the view-space box around each
+    // cluster, so the lists are conservative: a light may be listed for a cluster it just
+    // misses near the box corners, but never left out of one it reaches. Lights keep their
+    // submission order within every list.
+    //
+    // Build transforms the lights on the workers, then gives each worker a contiguous run of
+    // depth slices balanced by how many lights reach them, so every cluster is written by a
+    // single worker without any locking.
+    class ClusteredLights
+    {
+    public:
+        static const size_t MaxLights = 65535;
+        static const uint32_t InvalidCluster = UINT32_MAX;
+
+        // A light with spotCosAngle <= 0 is a point light and ignores 'direction'.
+        struct Light
+        {
+            DirectX::XMFLOAT3   position;
+            float               range;
+            DirectX::XMFLOAT3   direction;
+            float               spotCosAngle;   // Cosine of the half angle of the cone
+        };
+
+        // The cluster's lights are GetLightIndices()[offset] to [offset + count - 1].
+        struct Cluster
+        {
+            uint32_t    offset;
+            uint32_t    count;
+        };
+
+        struct Statistics
+        {
+            uint32_t    lights;             // Submitted to the last Build
+            uint32_t    visibleLights;      // Reaching at least one slice
+            uint32_t    indices;
+            uint32_t    maxPerCluster;
+        };
+
+        // 'workers' must outlive the binner; it may be shared with other work between builds.
+        ClusteredLights(unsigned int tilesX, unsigned int tilesY, unsigned int slices, WorkerPool& workers) noexcept(false);
+
+        ClusteredLights(ClusteredLights const&) = delete;
+        ClusteredLights& operator= (ClusteredLights const&) = delete;
+
+        // Takes a right-handed perspective projection such as Matrix::CreatePerspectiveFieldOfView.
+        void XM_CALLCONV SetProjection(DirectX::FXMMATRIX projection);
+
+        // Light positions and directions are in world space.
+        void XM_CALLCONV Build(const Light* lights, size_t count, DirectX::FXMMATRIX view);
+
+        unsigned int GetTilesX() const { return m_tilesX; }
+        unsigned int GetTilesY() const { return m_tilesY; }
+        unsigned int GetSlices() const { return m_slices; }
+        size_t GetClusterCount() const { return m_clusters.size(); }
+        float GetNearPlane() const { return m_near; }
+        float GetFarPlane() const { return m_far; }
+
+        const Cluster* GetClusters() const { return m_clusters.data(); }
+        const uint16_t* GetLightIndices() const { return m_indices.data(); }
+        size_t GetLightIndexCount() const { return m_indices.size(); }
+        const Statistics& GetStatistics() const { return m_stats; }
+
+        uint32_t GetClusterIndex(unsigned int x, unsigned int y, unsigned int slice) const
+        {
+            return (slice * m_tilesY + y) * m_tilesX + x;
+        }
+
+        // 'depth' is the distance in front of the camera, -z in view space.
+        unsigned int GetSlice(float depth) const;
+
+        // The cluster holding a view-space point, or InvalidCluster outside the frustum.
+        uint32_t XM_CALLCONV FindCluster(DirectX::FXMVECTOR viewPosition) const;
+
+    private:
+        struct Hit
+        {
+            uint32_t    cluster;
+            uint32_t    light;
+        };
+
+        struct WorkerState
+        {
+            std::vector<Hit>        hits;           // In light order
+            std::vector<uint16_t>   indices;        // This worker's clusters' lists, back to back
+            std::vector<uint32_t>   sliceLights;    // Lights reaching each slice
+            uint32_t                maxPerCluster;
+        };
+
+        void PrepareLights(const Light* lights, size_t begin, size_t end, DirectX::FXMMATRIX view, WorkerState& state);
+        void BinSlices(unsigned int sliceBegin, unsigned int sliceEnd, WorkerState& state);
+        void BinRow(unsigned int slice, unsigned int y, uint16_t light, float x, float remaining, WorkerState& state);
+
+        unsigned int                m_tilesX;
+        unsigned int                m_tilesY;
+        unsigned int                m_slices;
+        unsigned int                m_rowStride;        // tilesX rounded up to a multiple of 4
+        float                       m_xScale;
+        float                       m_yScale;
+        float                       m_near;
+        float                       m_far;
+        float                       m_sliceScale;       // Slices per unit of log(depth)
+        float                       m_sliceBias;
+
+        // View-space box of each cluster, separable by axis. Depth is -z.
+        std::vector<float>          m_sliceDepth;       // slices + 1 boundaries
+        std::vector<float>          m_tileMinX;         // [slice][x], padded to m_rowStride
+        std::vector<float>          m_tileMaxX;
+        std::vector<float>          m_tileMinY;         // [slice][y]
+        std::vector<float>          m_tileMaxY;
+
+        // The lights of the current Build in view space.
+        std::vector<float>          m_lightX;
+        std::vector<float>          m_lightY;
+        std::vector<float>          m_lightDepth;
+        std::vector<float>          m_lightRadius;
+        std::vector<uint16_t>       m_firstSlice;       // Empty range when first > last
+        std::vector<uint16_t>       m_lastSlice;
+        size_t                      m_lightCount;
+
+        std::vector<Cluster>        m_clusters;
+        std::vector<uint16_t>       m_indices;
+        std::vector<WorkerState>    m_workerStates;
+        std::vector<float>          m_sliceCosts;
+        std::vector<size_t>         m_bounds;           // First slice of each worker
+        std::vector<size_t>         m_bases;            // First index of each worker
+        Statistics                  m_stats;
+        WorkerPool&                 m_workers;
+    };
+}
@@ -0,0 +1,384 @@
+//
+// EntityWorld.cpp
+//
+
+#include "pch.h"
+#include "EntityWorld.h"
+
+#include <atomic>
+#include <string.h>
+
+using namespace DX;
+
+namespace
+{
+    // Chunks start on a cache line and every array on at least a 16 byte boundary, so
+    // systems can use aligned SIMD loads on float4 components.
+    const size_t c_chunkAlignment = 64;
+    const size_t c_arrayAlignment = 16;
+
+    const uint32_t c_freeRecord = UINT32_MAX;
+
+    inline size_t AlignUp(size_t value, size_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+}
+
+EntityWorld::EntityWorld(WorkerPool& workers) noexcept(false) :
+    m_entityCount(0),
+    m_version(0),
+    m_workers(workers)
+{
+}
+
+EntityWorld::~EntityWorld()
+{
+}
+
+unsigned int EntityWorld::RegisterComponent(size_t size, size_t alignment)
+{
+    if (m_components.size() >= MaxComponents)
+        throw std::overflow_error("EntityWorld supports at most 32 components");
+
+    if (!alignment || (alignment & (alignment - 1)) || alignment > c_chunkAlignment)
+        throw std::invalid_argument("EntityWorld component alignment must be a power of 2 up to 64");
+
+    m_components.push_back(ComponentInfo{ size, alignment });
+    return static_cast<unsigned int>(m_components.size() - 1);
+}
+
+Entity EntityWorld::Create(ComponentMask components)
+{
+    uint32_t archetype = FindArchetype(components);
+
+    uint32_t index;
+    if (!m_freeRecords.empty())
+    {
+        index = m_freeRecords.back();
+        m_freeRecords.pop_back();
+    }
+    else
+    {
+        if (m_records.size() >= UINT32_MAX)
+            throw std::overflow_error("EntityWorld has too many entities");
+
+        index = static_cast<uint32_t>(m_records.size());
+        m_records.push_back(Record{ 1, c_freeRecord, 0, 0 });
+    }
+
+    Allocate(archetype, index);
+    ++m_entityCount;
+
+    return Entity{ index, m_records[index].generation };
+}
+
+void EntityWorld::Destroy(Entity entity)
+{
+    uint32_t index = GetLiveIndex(entity);
+
+    Release(m_records[index]);
+
+    Record& record = m_records[index];
+    record.archetype = c_freeRecord;
+    if (!++record.generation)
+        record.generation = 1;
+
+    m_freeRecords.push_back(index);
+    --m_entityCount;
+}
+
+bool EntityWorld::IsAlive(Entity entity) const
+{
+    return entity.index < m_records.size()
+        && m_records[entity.index].archetype != c_freeRecord
+        && m_records[entity.index].generation == entity.generation;
+}
+
+void EntityWorld::SetComponents(Entity entity, ComponentMask components)
+{
+    uint32_t index = GetLiveIndex(entity);
+    const Record previous = m_records[index];
+
+    if (m_archetypes[previous.archetype].mask == components)
+        return;
+
+    // Adding an archetype can move the others, so only hold on to them after this.
+    uint32_t archetype = FindArchetype(components);
+    Allocate(archetype, index);
+
+    const Archetype& source = m_archetypes[previous.archetype];
+    const Archetype& target = m_archetypes[archetype];
+    const Record& record = m_records[index];
+    const uint8_t* sourceData = source.chunks[previous.chunk]->data;
+    uint8_t* targetData = target.chunks[record.chunk]->data;
+
+    ComponentMask kept = source.mask & target.mask;
+    for (unsigned int c = 0; c < m_components.size(); ++c)
+    {
+        if (kept & (1u << c))
+        {
+            size_t size = m_components[c].size;
+            memcpy(targetData + target.offsets[c] + record.row * size, sourceData + source.offsets[c] + previous.row * size, size);
+        }
+    }
+
+    Release(previous);
+}
+
+ComponentMask EntityWorld::GetComponents(Entity entity) const
+{
+    return m_archetypes[m_records[GetLiveIndex(entity)].archetype].mask;
+}
+
+void* EntityWorld::GetComponent(Entity entity, unsigned int component)
+{
+    const Record& record = m_records[GetLiveIndex(entity)];
+
+    if (component >= MaxComponents)
+        return nullptr;
+
+    const Archetype& archetype = m_archetypes[record.archetype];
+    size_t offset = archetype.offsets[component];
+    if (offset == NoOffset)
+        return nullptr;
+
+    Chunk& chunk = *archetype.chunks[record.chunk];
+    chunk.versions[component] = m_version + 1;
+
+    return chunk.data + offset + record.row * m_components[component].size;
+}
+
+uint32_t EntityWorld::ForEach(const Query& query, const ChunkJob& job)
+{
+    uint32_t version = ++m_version;
+    CollectChunks(query, version);
+
+    for (const auto& view : m_views)
+    {
+        job(view, 0);
+    }
+
+    return version;
+}
+
+uint32_t EntityWorld::ForEachParallel(const Query& query, const ChunkJob& job)
+{
+    uint32_t version = ++m_version;
+    CollectChunks(query, version);
+
+    if (m_views.size() < 2 || m_workers.GetWorkerCount() < 2)
+    {
+        for (const auto& view : m_views)
+        {
+            job(view, 0);
+        }
+
+        return version;
+    }
+
+    // Chunks are handed out one at a time, so a worker that gets cheap chunks simply takes
+    // more of them.
+    std::atomic<size_t> next(0);
+    m_workers.Run([&](unsigned int worker)
+    {
+        for (;;)
+        {
+            size_t i = next.fetch_add(1, std::memory_order_relaxed);
+            if (i >= m_views.size())
+                break;
+
+            job(m_views[i], worker);
+        }
+    });
+
+    return version;
+}
+
+size_t EntityWorld::GetChunkCount() const
+{
+    size_t count = 0;
+    for (const auto& archetype : m_archetypes)
+    {
+        count += archetype.chunks.size();
+    }
+
+    return count;
+}
+
+uint32_t EntityWorld::FindArchetype(ComponentMask mask)
+{
+    if (m_components.size() < MaxComponents && (mask >> m_components.size()))
+        throw std::invalid_argument("EntityWorld component is not registered");
+
+    for (size_t j = 0; j < m_archetypes.size(); ++j)
+    {
+        if (m_archetypes[j].mask == mask)
+            return static_cast<uint32_t>(j);
+    }
+
+    Archetype archetype;
+    archetype.mask = mask;
+
+    // The entity handles come first, then one array per component.
+    auto layout = [&](size_t capacity) -> size_t
+    {
+        for (auto& offset : archetype.offsets)
+        {
+            offset = NoOffset;
+        }
+
+        archetype.offsets[MaxComponents] = 0;
+        size_t offset = capacity * sizeof(Entity);
+        for (unsigned int c = 0; c < m_components.size(); ++c)
+        {
+            if (mask & (1u << c))
+            {
+                offset = AlignUp(offset, std::max(m_components[c].alignment, c_arrayAlignment));
+                archetype.offsets[c] = offset;
+                offset += capacity * m_components[c].size;
+            }
+        }
+
+        return offset;
+    };
+
+    size_t entityBytes = sizeof(Entity);
+    for (unsigned int c = 0; c < m_components.size(); ++c)
+    {
+        if (mask & (1u << c))
+            entityBytes += m_components[c].size;
+    }
+
+    // Padding can push the first guess over the chunk size, and a very large archetype gets
+    // a bigger chunk holding a single entity.
+    size_t capacity = std::max<size_t>(1, ChunkBytes / entityBytes);
+    while (capacity > 1 && layout(capacity) > ChunkBytes)
+    {
+        --capacity;
+    }
+
+    size_t chunkBytes = layout(capacity);
+    archetype.capacity = capacity;
+    archetype.chunkBytes = (chunkBytes > ChunkBytes) ? chunkBytes : ChunkBytes;
+
+    m_archetypes.push_back(std::move(archetype));
+    return static_cast<uint32_t>(m_archetypes.size() - 1);
+}
+
+void EntityWorld::Allocate(uint32_t archetypeIndex, uint32_t index)
+{
+    Archetype& archetype = m_archetypes[archetypeIndex];
+
+    if (archetype.chunks.empty() || archetype.chunks.back()->count == archetype.capacity)
+    {
+        std::unique_ptr<Chunk> chunk(new Chunk);
+        chunk->storage.reset(new uint8_t[archetype.chunkBytes + c_chunkAlignment - 1]);
+        chunk->data = reinterpret_cast<uint8_t*>(AlignUp(reinterpret_cast<uintptr_t>(chunk->storage.get()), c_chunkAlignment));
+        chunk->count = 0;
+        memset(chunk->versions, 0, sizeof(chunk->versions));
+        archetype.chunks.push_back(std::move(chunk));
+    }
+
+    Chunk& chunk = *archetype.chunks.back();
+    size_t row = chunk.count++;
+
+    Record& record = m_records[index];
+    record.archetype = archetypeIndex;
+    record.chunk = static_cast<uint32_t>(archetype.chunks.size() - 1);
+    record.row = static_cast<uint32_t>(row);
+
+    reinterpret_cast<Entity*>(chunk.data + archetype.offsets[MaxComponents])[row] = Entity{ index, record.generation };
+
+    for (unsigned int c = 0; c < m_components.size(); ++c)
+    {
+        if (archetype.mask & (1u << c))
+        {
+            size_t size = m_components[c].size;
+            memset(chunk.data + archetype.offsets[c] + row * size, 0, size);
+            chunk.versions[c] = m_version + 1;
+        }
+    }
+}
+
+void EntityWorld::Release(const Record& record)
+{
+    Archetype& archetype = m_archetypes[record.archetype];
+    Chunk& last = *archetype.chunks.back();
+    size_t lastRow = last.count - 1;
+
+    // Keep the archetype's chunks packed by moving its last entity into the hole.
+    Chunk& chunk = *archetype.chunks[record.chunk];
+    if (&chunk != &last || record.row != lastRow)
+    {
+        auto entities = reinterpret_cast<Entity*>(chunk.data + archetype.offsets[MaxComponents]);
+        const Entity moved = reinterpret_cast<const Entity*>(last.data + archetype.offsets[MaxComponents])[lastRow];
+        entities[record.row] = moved;
+
+        for (unsigned int c = 0; c < m_components.size(); ++c)
+        {
+            if (archetype.mask & (1u << c))
+            {
+                size_t size = m_components[c].size;
+                memcpy(chunk.data + archetype.offsets[c] + record.row * size, last.data + archetype.offsets[c] + lastRow * size, size);
+                chunk.versions[c] = m_version + 1;
+            }
+        }
+
+        m_records[moved.index].chunk = record.chunk;
+        m_records[moved.index].row = record.row;
+    }
+
+    if (!--last.count)
+        archetype.chunks.pop_back();
+}
+
+uint32_t EntityWorld::GetLiveIndex(Entity entity) const
+{
+    if (!IsAlive(entity))
+        throw std::invalid_argument("EntityWorld entity has been destroyed");
+
+    return entity.index;
+}
+
+void EntityWorld::CollectChunks(const Query& query, uint32_t version)
+{
+    m_views.clear();
+
+    for (auto& archetype : m_archetypes)
+    {
+        if ((archetype.mask & query.required) != query.required)
+            continue;
+
+        ComponentMask written = archetype.mask & query.written;
+        ComponentMask changed = archetype.mask & query.changed;
+
+        for (auto& chunk : archetype.chunks)
+        {
+            if (query.changed)
+            {
+                bool skip = true;
+                for (unsigned int c = 0; c < m_components.size() && skip; ++c)
+                {
+                    if ((changed & (1u << c)) && chunk->versions[c] > query.sinceVersion)
+                        skip = false;
+                }
+
+                if (skip)
+                    continue;
+            }
+
+            for (unsigned int c = 0; c < m_components.size(); ++c)
+            {
+                if (written & (1u << c))
+                    chunk->versions[c] = version;
+            }
+
+            ChunkView view;
+            view.m_count = chunk->count;
+            view.m_data = chunk->data;
+            view.m_offsets = archetype.offsets;
+            m_views.push_back(view);
+        }
+    }
+}
@@ -0,0 +1,165 @@
+//
+// EntityWorld.h - Archetype-based entity storage with chunked component arrays
+//
+
+#pragma once
+
+#include "WorkerPool.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace DX
+{
+    // Handle to an entity. Stays invalid once the entity is destroyed, even after its slot
+    // has been reused.
+    struct Entity
+    {
+        uint32_t    index;
+        uint32_t    generation;
+    };
+
+    // One bit per component id.
+    typedef uint32_t ComponentMask;
+
+    // Stores entities grouped by archetype, the exact set of components they have. Each
+    // archetype fills fixed-size chunks, and a chunk keeps every component as its own array,
+    // so systems walk tightly packed data of just the components they use.
+    //
+    // Every chunk also records, per component, the version at which it was last written.
+    // A query can skip the chunks whose components have not changed since it last ran, so
+    // work on entities that stand still costs nothing.
+    //
+    // Entities may not be created, destroyed or changed in shape while a query is running.
+    class EntityWorld
+    {
+    public:
+        static const unsigned int MaxComponents = 32;
+        static const size_t ChunkBytes = 16 * 1024;
+        static const size_t NoOffset = SIZE_MAX;
+
+        // One chunk's entities, seen by a query's job.
+        class ChunkView
+        {
+        public:
+            size_t GetCount() const { return m_count; }
+            const Entity* GetEntities() const { return reinterpret_cast<const Entity*>(m_data + m_offsets[MaxComponents]); }
+
+            // Null unless the chunk's archetype has the component.
+            template<typename T> T* GetArray(unsigned int component) const
+            {
+                size_t offset = m_offsets[component];
+                return (offset != NoOffset) ? reinterpret_cast<T*>(m_data + offset) : nullptr;
+            }
+
+        private:
+            friend class EntityWorld;
+
+            size_t          m_count;
+            uint8_t*        m_data;
+            const size_t*   m_offsets;
+        };
+
+        struct Query
+        {
+            ComponentMask   required;       // Chunks must have all of these
+            ComponentMask   written;        // Marked as changed in every chunk visited
+            ComponentMask   changed;        // If not 0, skip chunks where none of these changed...
+            uint32_t        sinceVersion;   // ...after this version
+        };
+
+        typedef std::function<void(const ChunkView& chunk, unsigned int worker)> ChunkJob;
+
+        // 'workers' must outlive the world; it may be shared with other work between runs.
+        explicit EntityWorld(WorkerPool& workers) noexcept(false);
+        ~EntityWorld();
+
+        EntityWorld(EntityWorld const&) = delete;
+        EntityWorld& operator= (EntityWorld const&) = delete;
+
+        // Ids are handed out from 0 in registration order. Components are moved between
+        // chunks as raw bytes, so they have to be trivially copyable.
+        template<typename T> unsigned int RegisterComponent()
+        {
+            static_assert(std::is_trivially_copyable<T>::value, "Components must be trivially copyable");
+            return RegisterComponent(sizeof(T), alignof(T));
+        }
+
+        unsigned int RegisterComponent(size_t size, size_t alignment);
+
+        // New components are zero-filled.
+        Entity Create(ComponentMask components);
+        void Destroy(Entity entity);
+        bool IsAlive(Entity entity) const;
+
+        // Moves the entity to the archetype for 'components', keeping the ones it still has.
+        void SetComponents(Entity entity, ComponentMask components);
+        ComponentMask GetComponents(Entity entity) const;
+
+        // Marks the component as changed in the entity's chunk. Null if it does not have it.
+        void* GetComponent(Entity entity, unsigned int component);
+        template<typename T> T* Get(Entity entity, unsigned int component) { return static_cast<T*>(GetComponent(entity, component)); }
+
+        // Run 'job' on every matching chunk, on the calling thread or spread across the
+        // workers. Both return the version the run wrote, which the caller can pass back as
+        // 'sinceVersion' to only see later changes.
+        uint32_t ForEach(const Query& query, const ChunkJob& job);
+        uint32_t ForEachParallel(const Query& query, const ChunkJob& job);
+
+        size_t GetEntityCount() const { return m_entityCount; }
+        size_t GetArchetypeCount() const { return m_archetypes.size(); }
+        size_t GetChunkCount() const;
+        uint32_t GetVersion() const { return m_version; }
+        unsigned int GetWorkerCount() const { return m_workers.GetWorkerCount(); }
+
+    private:
+        struct ComponentInfo
+        {
+            size_t  size;
+            size_t  alignment;
+        };
+
+        struct Chunk
+        {
+            std::unique_ptr<uint8_t[]>  storage;
+            uint8_t*                    data;       // 'storage' aligned to a cache line
+            size_t                      count;
+            uint32_t                    versions[MaxComponents];
+        };
+
+        struct Archetype
+        {
+            ComponentMask                       mask;
+            size_t                              capacity;   // Entities per chunk
+            size_t                              chunkBytes;
+            size_t                              offsets[MaxComponents + 1];     // NoOffset if missing; the last is the entities
+            std::vector<std::unique_ptr<Chunk>> chunks;
+        };
+
+        struct Record
+        {
+            uint32_t    generation;
+            uint32_t    archetype;      // UINT32_MAX while the slot is free
+            uint32_t    chunk;
+            uint32_t    row;
+        };
+
+        uint32_t FindArchetype(ComponentMask mask);
+        void Allocate(uint32_t archetype, uint32_t index);
+        void Release(const Record& record);
+        uint32_t GetLiveIndex(Entity entity) const;
+        void CollectChunks(const Query& query, uint32_t version);
+
+        std::vector<ComponentInfo>      m_components;
+        std::vector<Archetype>          m_archetypes;
+        std::vector<Record>             m_records;
+        std::vector<uint32_t>           m_freeRecords;
+        size_t                          m_entityCount;
+        uint32_t                        m_version;
+        std::vector<ChunkView>          m_views;        // Chunks matched by the running query
+        WorkerPool&                     m_workers;
+    };
+}
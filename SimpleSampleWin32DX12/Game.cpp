@@ -4,6 +4,9 @@
 
 #include "pch.h"
 #include "Game.h"
+#include "SDKMeshGeometry.h"
+
+#include <float.h>
 
 extern void ExitGame();
 
@@ -12,10 +15,60 @@ using namespace DirectX::SimpleMath;
 
 using Microsoft::WRL::ComPtr;
 
-Game::Game() noexcept(false)
+namespace
+{
+    // Far more lights than BasicEffect can shade at once; each object picks from its cluster.
+    const size_t c_lightCount = 1024;
+
+    // 16x9 screen tiles by 24 depth slices.
+    const unsigned int c_clusterTilesX = 16;
+    const unsigned int c_clusterTilesY = 9;
+    const unsigned int c_clusterSlices = 24;
+
+    // A field of small teapots under the grid; every other one spins, the rest never move.
+    const unsigned int c_teapotColumns = 16;
+    const unsigned int c_teapotRows = 16;
+    const float c_teapotSpacing = 1.f;
+    const float c_teapotScale = 0.2f;
+
+    // Added to the lighting of the teapot under the cursor.
+    const XMVECTORF32 c_pickedGlow = { 0.4f, 0.3f, 0.f, 0.f };
+
+    // Where the picking rays cross the cursor's pixel, on each axis: a 2x2 grid, one ray per
+    // lane of a TriangleBVH packet.
+    const float c_pickOffsets[2] = { 0.25f, 0.75f };
+
+    // Shared by the light binning and the entity systems.
+    unsigned int GetWorkerCount()
+    {
+        unsigned int count = std::thread::hardware_concurrency();
+        return std::max(1u, std::min(count, 4u));
+    }
+}
+
+Game::Game() noexcept(false) :
+    m_boundsVersion(0),
+    m_picked{},
+    m_pickedMesh(0),
+    m_pickedTriangle(DX::TriangleBVH::NoHit),
+    m_pickedDistance(0.f)
 {
     m_deviceResources = std::make_unique<DX::DeviceResources>();
     m_deviceResources->RegisterDeviceNotify(this);
+
+    m_workers = std::make_unique<DX::WorkerPool>(GetWorkerCount());
+
+    m_clusteredLights = std::make_unique<DX::ClusteredLights>(c_clusterTilesX, c_clusterTilesY, c_clusterSlices, *m_workers);
+    CreateLights();
+
+    // In Components order.
+    m_entities = std::make_unique<DX::EntityWorld>(*m_workers);
+    m_entities->RegisterComponent<Transform>();
+    m_entities->RegisterComponent<Spin>();
+    m_entities->RegisterComponent<Bounds>();
+    m_entities->RegisterComponent<RenderMesh>();
+    m_entities->RegisterComponent<Material>();
+    CreateEntities();
 }
 
 Game::~Game()
@@ -101,7 +154,10 @@ void Game::Update(DX::StepTimer const& timer)
 
     m_view = Matrix::CreateLookAt(eye, at, Vector3::UnitY);
 
-    m_world = Matrix::CreateRotationY(float(timer.GetTotalSeconds() * XM_PIDIV4));
+    UpdateEntities(float(timer.GetTotalSeconds()));
+
+    UpdateLights(float(timer.GetTotalSeconds()));
+    m_clusteredLights->Build(m_lights.data(), m_lights.size(), m_view);
 
     m_lineEffect->SetView(m_view);
     m_lineEffect->SetWorld(Matrix::Identity);
@@ -134,7 +190,7 @@ void Game::Update(DX::StepTimer const& timer)
     auto pad = m_gamePad->GetState(0);
     if (pad.IsConnected())
     {
-        m_gamePadButtons.Update(pad);
+        m_buttons.SetGamePad(0, pad);
 
         if (pad.IsViewPressed())
         {
@@ -143,11 +199,12 @@ void Game::Update(DX::StepTimer const& timer)
     }
     else
     {
-        m_gamePadButtons.Reset();
+        m_buttons.ResetGamePad(0);
     }
 
     auto kb = m_keyboard->GetState();
-    m_keyboardButtons.Update(kb);
+    m_buttons.SetKeyboard(0, kb);
+    m_buttons.Update();
 
     if (kb.Escape)
     {
@@ -155,7 +212,7 @@ void Game::Update(DX::StepTimer const& timer)
     }
 
     auto mouse = m_mouse->GetState();
-    mouse;
+    PickEntity(float(mouse.x), float(mouse.y));
 
     PIXEndEvent();
 }
@@ -183,6 +240,8 @@ void Game::Render()
     const XMVECTORF32 yaxis = { 0.f, 0.f, 20.f };
     DrawGrid(xaxis, yaxis, g_XMZero, 20, 20, Colors::Gray);
 
+    DrawLights();
+
     // Set the descriptor heaps
     ID3D12DescriptorHeap* heaps[] = { m_resourceDescriptors->Heap(), m_states->Heap() };
     commandList->SetDescriptorHeaps(_countof(heaps), heaps);
@@ -194,29 +253,20 @@ void Game::Render()
         XMFLOAT2(10, 75));
 
     m_font->DrawString(m_sprites.get(), L"DirectXTK Simple Sample", XMFLOAT2(100, 10), Colors::Yellow);
-    m_sprites->End();
-    PIXEndEvent(commandList);
 
-    // Draw 3D object
-    PIXBeginEvent(commandList, PIX_COLOR_DEFAULT, L"Draw teapot");
-    XMMATRIX local = m_world * Matrix::CreateTranslation(-2.f, -2.f, -4.f);
-    m_shapeEffect->SetWorld(local);
-    m_shapeEffect->Apply(commandList);
-    m_shape->Draw(commandList);
-    PIXEndEvent(commandList);
+    if (m_pickedTriangle != DX::TriangleBVH::NoHit)
+    {
+        wchar_t text[128] = {};
+        swprintf_s(text, L"Cursor: %ls, triangle %u at %.2f", (m_pickedMesh == TinyMesh) ? L"model" : L"teapot",
+            m_pickedTriangle, m_pickedDistance);
+        m_font->DrawString(m_sprites.get(), text, XMFLOAT2(100, 40), Colors::White);
+    }
 
-    // Draw model
-    PIXBeginEvent(commandList, PIX_COLOR_DEFAULT, L"Draw model");
-    const XMVECTORF32 scale = { 0.01f, 0.01f, 0.01f };
-    const XMVECTORF32 translate = { 3.f, -2.f, -4.f };
-    XMVECTOR rotate = Quaternion::CreateFromYawPitchRoll(XM_PI / 2.f, 0.f, -XM_PI / 2.f);
-    local = m_world * XMMatrixTransformation(g_XMZero, Quaternion::Identity, scale, g_XMZero, rotate, translate);
-    Model::UpdateEffectMatrices(m_modelEffects, local, m_view, m_projection);
-    heaps[0] = m_modelResources->Heap();
-    commandList->SetDescriptorHeaps(_countof(heaps), heaps);
-    m_model->Draw(commandList, m_modelEffects.begin());
+    m_sprites->End();
     PIXEndEvent(commandList);
 
+    DrawEntities();
+
     PIXEndEvent(commandList);
 
     // Show the new frame.
@@ -289,6 +339,396 @@ void XM_CALLCONV Game::DrawGrid(FXMVECTOR xAxis, FXMVECTOR yAxis, FXMVECTOR orig
 
     PIXEndEvent(commandList);
 }
+
+void Game::DrawLights()
+{
+    auto commandList = m_deviceResources->GetCommandList();
+    PIXBeginEvent(commandList, PIX_COLOR_DEFAULT, L"Draw lights");
+
+    m_lineEffect->Apply(commandList);
+
+    m_batch->Begin(commandList);
+
+    const XMVECTORF32 axes[] =
+    {
+        { 0.05f, 0.f, 0.f },
+        { 0.f, 0.05f, 0.f },
+        { 0.f, 0.f, 0.05f },
+    };
+
+    for (size_t i = 0; i < m_lights.size(); ++i)
+    {
+        XMVECTOR position = XMLoadFloat3(&m_lights[i].position);
+        XMVECTOR color = XMLoadFloat3(&m_lightColors[i]);
+
+        for (auto& axis : axes)
+        {
+            VertexPositionColor v1(XMVectorSubtract(position, axis), color);
+            VertexPositionColor v2(XMVectorAdd(position, axis), color);
+            m_batch->DrawLine(v1, v2);
+        }
+    }
+
+    m_batch->End();
+
+    PIXEndEvent(commandList);
+}
+
+void Game::DrawEntities()
+{
+    auto commandList = m_deviceResources->GetCommandList();
+    PIXBeginEvent(commandList, PIX_COLOR_DEFAULT, L"Draw entities");
+
+    ID3D12DescriptorHeap* heaps[] = { m_resourceDescriptors->Heap(), m_states->Heap() };
+
+    DX::EntityWorld::Query query = {};
+    query.required = (1u << TransformComponent) | (1u << BoundsComponent) | (1u << RenderMeshComponent);
+
+    m_entities->ForEach(query, [&](const DX::EntityWorld::ChunkView& chunk, unsigned int)
+    {
+        auto entities = chunk.GetEntities();
+        auto transforms = chunk.GetArray<const Transform>(TransformComponent);
+        auto bounds = chunk.GetArray<const Bounds>(BoundsComponent);
+        auto meshes = chunk.GetArray<const RenderMesh>(RenderMeshComponent);
+        auto materials = chunk.GetArray<const Material>(MaterialComponent);
+
+        for (size_t i = 0; i < chunk.GetCount(); ++i)
+        {
+            XMMATRIX world = XMLoadFloat4x4(&transforms[i].world);
+
+            if (meshes[i].mesh == TinyMesh)
+            {
+                Model::UpdateEffectMatrices(m_modelEffects, world, m_view, m_projection);
+                if (heaps[0] != m_modelResources->Heap())
+                {
+                    heaps[0] = m_modelResources->Heap();
+                    commandList->SetDescriptorHeaps(_countof(heaps), heaps);
+                }
+                m_model->Draw(commandList, m_modelEffects.begin());
+                continue;
+            }
+
+            if (heaps[0] != m_resourceDescriptors->Heap())
+            {
+                heaps[0] = m_resourceDescriptors->Heap();
+                commandList->SetDescriptorHeaps(_countof(heaps), heaps);
+            }
+
+            ApplyClusteredLights(m_shapeEffect.get(), XMLoadFloat3(&bounds[i].box.Center));
+            m_shapeEffect->SetDiffuseColor(materials ? XMLoadFloat4(&materials[i].diffuse) : g_XMOne.v);
+            m_shapeEffect->SetEmissiveColor(IsPicked(entities[i]) ? c_pickedGlow.v : g_XMZero.v);
+            m_shapeEffect->SetWorld(world);
+            m_shapeEffect->Apply(commandList);
+            m_shape->Draw(commandList);
+        }
+    });
+
+    PIXEndEvent(commandList);
+}
+#pragma endregion
+
+#pragma region Entities
+// The big teapot and the model turn as they always have, over a grid of small teapots.
+void Game::CreateEntities()
+{
+    const DX::ComponentMask spinning = (1u << TransformComponent) | (1u << SpinComponent) | (1u << BoundsComponent) | (1u << RenderMeshComponent);
+    const DX::ComponentMask fixed = (1u << TransformComponent) | (1u << BoundsComponent) | (1u << RenderMeshComponent);
+
+    DX::Entity teapot = m_entities->Create(spinning | (1u << MaterialComponent));
+    XMStoreFloat4x4(&m_entities->Get<Spin>(teapot, SpinComponent)->local, XMMatrixTranslation(-2.f, -2.f, -4.f));
+    m_entities->Get<Spin>(teapot, SpinComponent)->rate = XM_PIDIV4;
+    m_entities->Get<Material>(teapot, MaterialComponent)->diffuse = XMFLOAT4(1.f, 1.f, 1.f, 1.f);
+
+    DX::Entity model = m_entities->Create(spinning);
+    const XMVECTORF32 scale = { 0.01f, 0.01f, 0.01f };
+    const XMVECTORF32 translate = { 3.f, -2.f, -4.f };
+    XMVECTOR rotate = Quaternion::CreateFromYawPitchRoll(XM_PI / 2.f, 0.f, -XM_PI / 2.f);
+    XMStoreFloat4x4(&m_entities->Get<Spin>(model, SpinComponent)->local,
+        XMMatrixTransformation(g_XMZero, Quaternion::Identity, scale, g_XMZero, rotate, translate));
+    m_entities->Get<Spin>(model, SpinComponent)->rate = XM_PIDIV4;
+    m_entities->Get<RenderMesh>(model, RenderMeshComponent)->mesh = TinyMesh;
+
+    for (unsigned int y = 0; y < c_teapotRows; ++y)
+    {
+        for (unsigned int x = 0; x < c_teapotColumns; ++x)
+        {
+            bool spins = ((x + y) & 1) != 0;
+            DX::Entity entity = m_entities->Create((spins ? spinning : fixed) | (1u << MaterialComponent));
+
+            float fx = (float(x) - float(c_teapotColumns - 1) * 0.5f) * c_teapotSpacing;
+            float fz = -4.f + (float(y) - float(c_teapotRows - 1) * 0.5f) * c_teapotSpacing;
+            XMMATRIX local = XMMatrixScaling(c_teapotScale, c_teapotScale, c_teapotScale) * XMMatrixTranslation(fx, -3.f, fz);
+
+            float a = fmodf(float(y * c_teapotColumns + x) * 0.6180340f, 1.f);
+            if (spins)
+            {
+                auto spin = m_entities->Get<Spin>(entity, SpinComponent);
+                XMStoreFloat4x4(&spin->local, local);
+                spin->rate = (a - 0.5f) * XM_PI;
+                spin->phase = a * XM_2PI;
+            }
+            else
+            {
+                XMStoreFloat4x4(&m_entities->Get<Transform>(entity, TransformComponent)->world, local);
+            }
+
+            float hue = XM_2PI * a;
+            m_entities->Get<Material>(entity, MaterialComponent)->diffuse =
+                XMFLOAT4(0.6f + 0.4f * cosf(hue), 0.6f + 0.4f * cosf(hue - XM_2PI / 3.f), 0.6f + 0.4f * cosf(hue + XM_2PI / 3.f), 1.f);
+        }
+    }
+}
+
+void Game::UpdateEntities(float totalSeconds)
+{
+    // Spin: every chunk with a spin gets new transforms.
+    DX::EntityWorld::Query spin = {};
+    spin.required = (1u << TransformComponent) | (1u << SpinComponent);
+    spin.written = 1u << TransformComponent;
+
+    m_entities->ForEachParallel(spin, [totalSeconds](const DX::EntityWorld::ChunkView& chunk, unsigned int)
+    {
+        auto transforms = chunk.GetArray<Transform>(TransformComponent);
+        auto spins = chunk.GetArray<const Spin>(SpinComponent);
+
+        for (size_t i = 0; i < chunk.GetCount(); ++i)
+        {
+            XMMATRIX rotation = XMMatrixRotationY(spins[i].phase + spins[i].rate * totalSeconds);
+            XMStoreFloat4x4(&transforms[i].world, rotation * XMLoadFloat4x4(&spins[i].local));
+        }
+    });
+
+    // Bounds: only chunks whose transforms changed since the last pass, so the fixed teapots
+    // are done once.
+    DX::EntityWorld::Query bounds = {};
+    bounds.required = (1u << TransformComponent) | (1u << BoundsComponent) | (1u << RenderMeshComponent);
+    bounds.written = 1u << BoundsComponent;
+    bounds.changed = 1u << TransformComponent;
+    bounds.sinceVersion = m_boundsVersion;
+
+    m_boundsVersion = m_entities->ForEachParallel(bounds, [this](const DX::EntityWorld::ChunkView& chunk, unsigned int)
+    {
+        auto transforms = chunk.GetArray<const Transform>(TransformComponent);
+        auto boxes = chunk.GetArray<Bounds>(BoundsComponent);
+        auto meshes = chunk.GetArray<const RenderMesh>(RenderMeshComponent);
+
+        for (size_t i = 0; i < chunk.GetCount(); ++i)
+        {
+            m_meshBounds[meshes[i].mesh].Transform(boxes[i].box, XMLoadFloat4x4(&transforms[i].world));
+        }
+    });
+}
+
+// Casts a packet of rays through the cursor's pixel, so thin parts of a mesh that fall
+// between pixel centers can still be picked; the nearest hit of any ray wins. World bounds
+// reject most entities; the rest are tested against their mesh's BVH, with the rays moved
+// into mesh space. Directions are left unnormalized there, so hit distances stay in world
+// units and compare across rays and entities.
+void Game::PickEntity(float x, float y)
+{
+    static_assert(DX::TriangleBVH::PacketSize == 4, "Picking casts a 2x2 packet");
+
+    m_pickedTriangle = DX::TriangleBVH::NoHit;
+
+    auto viewport = m_deviceResources->GetScreenViewport();
+    if (viewport.Width <= 0.f || viewport.Height <= 0.f)
+        return;
+
+    XMMATRIX view = m_view;
+    XMMATRIX projection = m_projection;
+
+    XMVECTOR origins[DX::TriangleBVH::PacketSize];
+    XMVECTOR directions[DX::TriangleBVH::PacketSize];
+    for (size_t lane = 0; lane < DX::TriangleBVH::PacketSize; ++lane)
+    {
+        float px = x + c_pickOffsets[lane & 1];
+        float py = y + c_pickOffsets[lane >> 1];
+        XMVECTOR nearPoint = XMVector3Unproject(XMVectorSet(px, py, 0.f, 0.f), viewport.TopLeftX, viewport.TopLeftY,
+            viewport.Width, viewport.Height, viewport.MinDepth, viewport.MaxDepth, projection, view, XMMatrixIdentity());
+        XMVECTOR farPoint = XMVector3Unproject(XMVectorSet(px, py, 1.f, 0.f), viewport.TopLeftX, viewport.TopLeftY,
+            viewport.Width, viewport.Height, viewport.MinDepth, viewport.MaxDepth, projection, view, XMMatrixIdentity());
+
+        origins[lane] = nearPoint;
+        directions[lane] = XMVector3Normalize(XMVectorSubtract(farPoint, nearPoint));
+    }
+
+    float closest = FLT_MAX;
+
+    DX::EntityWorld::Query query = {};
+    query.required = (1u << TransformComponent) | (1u << BoundsComponent) | (1u << RenderMeshComponent);
+
+    m_entities->ForEach(query, [&](const DX::EntityWorld::ChunkView& chunk, unsigned int)
+    {
+        auto entities = chunk.GetEntities();
+        auto transforms = chunk.GetArray<const Transform>(TransformComponent);
+        auto bounds = chunk.GetArray<const Bounds>(BoundsComponent);
+        auto meshes = chunk.GetArray<const RenderMesh>(RenderMeshComponent);
+
+        for (size_t i = 0; i < chunk.GetCount(); ++i)
+        {
+            // Rays that miss the bounds, or only reach them beyond the best hit so far, ride
+            // along with no length.
+            bool reached[DX::TriangleBVH::PacketSize];
+            bool any = false;
+            for (size_t lane = 0; lane < DX::TriangleBVH::PacketSize; ++lane)
+            {
+                float distance;
+                reached[lane] = bounds[i].box.Intersects(origins[lane], directions[lane], distance) && distance < closest;
+                any |= reached[lane];
+            }
+
+            if (!any)
+                continue;
+
+            XMMATRIX toMesh = XMMatrixInverse(nullptr, XMLoadFloat4x4(&transforms[i].world));
+
+            DX::TriangleBVH::RayPacket packet;
+            for (size_t lane = 0; lane < DX::TriangleBVH::PacketSize; ++lane)
+            {
+                XMFLOAT3 origin;
+                XMFLOAT3 direction;
+                XMStoreFloat3(&origin, XMVector3TransformCoord(origins[lane], toMesh));
+                XMStoreFloat3(&direction, XMVector3TransformNormal(directions[lane], toMesh));
+
+                packet.originX[lane] = origin.x;
+                packet.originY[lane] = origin.y;
+                packet.originZ[lane] = origin.z;
+                packet.directionX[lane] = direction.x;
+                packet.directionY[lane] = direction.y;
+                packet.directionZ[lane] = direction.z;
+                packet.maxDistance[lane] = reached[lane] ? closest : 0.f;
+            }
+
+            DX::TriangleBVH::Hit hits[DX::TriangleBVH::PacketSize];
+            if (!m_meshBVHs[meshes[i].mesh].IntersectPacket(packet, hits))
+                continue;
+
+            for (const auto& hit : hits)
+            {
+                if (hit.triangle != DX::TriangleBVH::NoHit && hit.distance < closest)
+                {
+                    closest = hit.distance;
+                    m_picked = entities[i];
+                    m_pickedMesh = meshes[i].mesh;
+                    m_pickedTriangle = hit.triangle;
+                }
+            }
+        }
+    });
+
+    m_pickedDistance = closest;
+}
+
+bool Game::IsPicked(DX::Entity entity) const
+{
+    return m_pickedTriangle != DX::TriangleBVH::NoHit && entity.index == m_picked.index && entity.generation == m_picked.generation;
+}
+#pragma endregion
+
+#pragma region Lighting
+// Scatters the lights on rings around the scene, each with its own color and speed.
+void Game::CreateLights()
+{
+    m_lights.resize(c_lightCount);
+    m_lightOrbits.resize(c_lightCount);
+    m_lightColors.resize(c_lightCount);
+
+    for (size_t i = 0; i < c_lightCount; ++i)
+    {
+        // Low-discrepancy fractions spread the lights evenly without a random generator.
+        float a = fmodf(float(i) * 0.6180340f, 1.f);
+        float b = fmodf(float(i) * 0.7548777f, 1.f);
+        float c = fmodf(float(i) * 0.5698403f, 1.f);
+
+        m_lightOrbits[i] = XMFLOAT4(0.5f + 6.5f * a, -2.5f + 3.f * b, float(i) * 2.3999632f, (c - 0.5f) * 1.5f);
+
+        float hue = XM_2PI * c;
+        m_lightColors[i] = XMFLOAT3(0.5f + 0.5f * cosf(hue), 0.5f + 0.5f * cosf(hue - XM_2PI / 3.f), 0.5f + 0.5f * cosf(hue + XM_2PI / 3.f));
+
+        auto& light = m_lights[i];
+        light.range = 0.75f + 1.25f * b;
+        light.direction = XMFLOAT3(0.f, -1.f, 0.f);
+        light.spotCosAngle = 0.f;
+    }
+
+    UpdateLights(0.f);
+}
+
+void Game::UpdateLights(float totalSeconds)
+{
+    for (size_t i = 0; i < m_lights.size(); ++i)
+    {
+        const auto& orbit = m_lightOrbits[i];
+        float angle = orbit.z + orbit.w * totalSeconds;
+        m_lights[i].position = XMFLOAT3(orbit.x * cosf(angle), orbit.y, -4.f + orbit.x * sinf(angle));
+    }
+}
+
+// BasicEffect shades with at most three directional lights, so this stands in for a
+// clustered shader: it takes the strongest lights of the cluster holding 'position' and
+// points them at it, scaled by their falloff there.
+void XM_CALLCONV Game::ApplyClusteredLights(IEffectLights* effect, FXMVECTOR position)
+{
+    int chosen[IEffectLights::MaxDirectionalLights];
+    float weights[IEffectLights::MaxDirectionalLights] = {};
+    for (auto& light : chosen)
+    {
+        light = -1;
+    }
+
+    uint32_t cluster = m_clusteredLights->FindCluster(XMVector3Transform(position, m_view));
+    if (cluster != DX::ClusteredLights::InvalidCluster)
+    {
+        const auto& entry = m_clusteredLights->GetClusters()[cluster];
+        const uint16_t* indices = m_clusteredLights->GetLightIndices() + entry.offset;
+
+        for (uint32_t j = 0; j < entry.count; ++j)
+        {
+            const auto& light = m_lights[indices[j]];
+            float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(position, XMLoadFloat3(&light.position))));
+            if (distance >= light.range)
+                continue;
+
+            float falloff = 1.f - (distance * distance) / (light.range * light.range);
+            float weight = falloff * falloff;
+
+            // Keep the strongest lights sorted by weight.
+            int slot = IEffectLights::MaxDirectionalLights;
+            while (slot > 0 && weight > weights[slot - 1])
+            {
+                if (slot < IEffectLights::MaxDirectionalLights)
+                {
+                    weights[slot] = weights[slot - 1];
+                    chosen[slot] = chosen[slot - 1];
+                }
+                --slot;
+            }
+
+            if (slot < IEffectLights::MaxDirectionalLights)
+            {
+                weights[slot] = weight;
+                chosen[slot] = int(indices[j]);
+            }
+        }
+    }
+
+    for (int i = 0; i < IEffectLights::MaxDirectionalLights; ++i)
+    {
+        if (chosen[i] < 0)
+        {
+            effect->SetLightEnabled(i, false);
+            continue;
+        }
+
+        XMVECTOR direction = XMVector3Normalize(XMVectorSubtract(position, XMLoadFloat3(&m_lights[chosen[i]].position)));
+        XMVECTOR color = XMVectorScale(XMLoadFloat3(&m_lightColors[chosen[i]]), weights[i]);
+
+        effect->SetLightEnabled(i, true);
+        effect->SetLightDirection(i, direction);
+        effect->SetLightDiffuseColor(i, color);
+        effect->SetLightSpecularColor(i, color);
+    }
+}
 #pragma endregion
 
 #pragma region Message Handlers
@@ -309,8 +749,7 @@ void Game::OnSuspending()
 void Game::OnResuming()
 {
     m_timer.ResetElapsedTime();
-    m_gamePadButtons.Reset();
-    m_keyboardButtons.Reset();
+    m_buttons.Reset();
     m_audEngine->Resume();
 }
 
@@ -363,11 +802,45 @@ void Game::CreateDeviceDependentResources()
 
     m_batch = std::make_unique<PrimitiveBatch<VertexPositionColor>>(device);
 
-    m_shape = GeometricPrimitive::CreateTeapot(4.f, 8);
+    {
+        // Built from its vertices so the entity bounds can be taken from them.
+        GeometricPrimitive::VertexCollection vertices;
+        GeometricPrimitive::IndexCollection indices;
+        GeometricPrimitive::CreateTeapot(vertices, indices, 4.f, 8);
+
+        BoundingBox::CreateFromPoints(m_meshBounds[TeapotMesh], vertices.size(), &vertices[0].position, sizeof(GeometricPrimitive::VertexType));
+
+        std::vector<XMFLOAT3> positions;
+        positions.reserve(vertices.size());
+        for (const auto& vertex : vertices)
+        {
+            positions.push_back(vertex.position);
+        }
+
+        std::vector<uint32_t> triangles(indices.begin(), indices.end());
+        m_meshBVHs[TeapotMesh].Build(positions.data(), positions.size(), triangles.data(), triangles.size() / 3);
+
+        m_shape = GeometricPrimitive::CreateCustom(vertices, indices);
+    }
 
     // SDKMESH has to use clockwise winding with right-handed coordinates, so textures are flipped in U
     m_model = Model::CreateFromSDKMESH(L"tiny.sdkmesh");
 
+    m_meshBounds[TinyMesh] = m_model->meshes[0]->boundingBox;
+    for (auto& mesh : m_model->meshes)
+    {
+        BoundingBox::CreateMerged(m_meshBounds[TinyMesh], m_meshBounds[TinyMesh], mesh->boundingBox);
+    }
+
+    {
+        // The model's geometry only exists on the GPU, so picking reads the positions again.
+        std::vector<XMFLOAT3> positions;
+        std::vector<uint32_t> triangles;
+        DX::ReadSDKMESHTriangles(L"tiny.sdkmesh", positions, triangles);
+
+        m_meshBVHs[TinyMesh].Build(positions.data(), positions.size(), triangles.data(), triangles.size() / 3);
+    }
+
     {
         ResourceUploadBatch resourceUpload(device);
 
@@ -474,6 +947,8 @@ void Game::CreateWindowSizeDependentResources()
     m_lineEffect->SetProjection(m_projection);
     m_shapeEffect->SetProjection(m_projection);
 
+    m_clusteredLights->SetProjection(m_projection);
+
     auto viewport = m_deviceResources->GetScreenViewport();
     m_sprites->SetViewport(viewport);
 }
@@ -4,8 +4,13 @@
 
 #pragma once
 
+#include "ClusteredLights.h"
 #include "DeviceResources.h"
+#include "EntityWorld.h"
+#include "InputEdgeTracker.h"
 #include "StepTimer.h"
+#include "TriangleBVH.h"
+#include "WorkerPool.h"
 
 
 // A basic game implementation that creates a D3D12 device and
@@ -45,6 +50,17 @@ private:
     void Render();
 
     void Clear();
+    void CreateLights();
+    void UpdateLights(float totalSeconds);
+    void XM_CALLCONV ApplyClusteredLights(DirectX::IEffectLights* effect, DirectX::FXMVECTOR position);
+    void DrawLights();
+
+    void CreateEntities();
+    void UpdateEntities(float totalSeconds);
+    void DrawEntities();
+
+    void PickEntity(float x, float y);
+    bool IsPicked(DX::Entity entity) const;
 
     void CreateDeviceDependentResources();
     void CreateWindowSizeDependentResources();
@@ -62,8 +78,8 @@ private:
     std::unique_ptr<DirectX::Keyboard>          m_keyboard;
     std::unique_ptr<DirectX::Mouse>             m_mouse;
 
-    DirectX::GamePad::ButtonStateTracker        m_gamePadButtons;
-    DirectX::Keyboard::KeyboardStateTracker     m_keyboardButtons;
+    // Pressed/released edges for the local player's keyboard and gamepad.
+    DX::InputEdgeTracker                        m_buttons;
 
     // DirectXTK objects.
     std::unique_ptr<DirectX::GraphicsMemory>                                m_graphicsMemory;
@@ -93,10 +109,78 @@ private:
 
     bool                                                                    m_retryDefault;
 
-    DirectX::SimpleMath::Matrix                                             m_world;
     DirectX::SimpleMath::Matrix                                             m_view;
     DirectX::SimpleMath::Matrix                                             m_projection;
 
+    // Worker threads shared by the light binning and the entity systems, which take turns.
+    std::unique_ptr<DX::WorkerPool>                                         m_workers;
+
+    // Animated point lights, binned into view-space clusters every frame.
+    std::unique_ptr<DX::ClusteredLights>                                    m_clusteredLights;
+    std::vector<DX::ClusteredLights::Light>                                 m_lights;
+    std::vector<DirectX::XMFLOAT4>                                          m_lightOrbits;      // Radius, height, phase, angular speed
+    std::vector<DirectX::XMFLOAT3>                                          m_lightColors;
+
+    // Everything drawn in 3D is an entity; the systems in UpdateEntities animate them and keep
+    // their bounds current.
+    std::unique_ptr<DX::EntityWorld>                                        m_entities;
+    uint32_t                                                                m_boundsVersion;
+
+    // Components, registered in this order.
+    enum Components
+    {
+        TransformComponent,
+        SpinComponent,
+        BoundsComponent,
+        RenderMeshComponent,
+        MaterialComponent,
+    };
+
+    struct Transform
+    {
+        DirectX::XMFLOAT4X4     world;
+    };
+
+    // World is RotationY(phase + rate * seconds) * local.
+    struct Spin
+    {
+        DirectX::XMFLOAT4X4     local;
+        float                   rate;
+        float                   phase;
+    };
+
+    // World space, updated from the mesh bounds whenever the transform changes.
+    struct Bounds
+    {
+        DirectX::BoundingBox    box;
+    };
+
+    struct RenderMesh
+    {
+        uint32_t                mesh;
+    };
+
+    struct Material
+    {
+        DirectX::XMFLOAT4       diffuse;
+    };
+
+    enum Meshes
+    {
+        TeapotMesh,
+        TinyMesh,
+        MeshCount
+    };
+
+    DirectX::BoundingBox                                                    m_meshBounds[MeshCount];
+
+    // Mouse picking: a BVH per mesh, in mesh space, and the nearest entity under the cursor.
+    DX::TriangleBVH                                                         m_meshBVHs[MeshCount];
+    DX::Entity                                                              m_picked;
+    uint32_t                                                                m_pickedMesh;
+    uint32_t                                                                m_pickedTriangle;   // NoHit if nothing is under the cursor
+    float                                                                   m_pickedDistance;
+
     // Descriptors
     enum Descriptors
     {
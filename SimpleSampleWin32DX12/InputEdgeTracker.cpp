@@ -0,0 +1,143 @@
+//
+// InputEdgeTracker.cpp - Pressed/released edge detection for many players on packed bitsets
+//
+
+#include "pch.h"
+#include "InputEdgeTracker.h"
+
+#include <string.h>
+
+using namespace DirectX;
+
+static_assert(sizeof(Keyboard::State) == DX::InputEdgeTracker::KeyboardWords * sizeof(uint32_t), "Keyboard::State is expected to be a 256-bit bitset");
+
+namespace
+{
+    const float ButtonThreshold = 0.5f;
+
+    // pressed = current & ~previous, released = previous & ~current, then previous = current.
+    // Every array holds 'words' entries, a multiple of four.
+    void DiffWords(const uint32_t* current, uint32_t* previous, uint32_t* pressed, uint32_t* released, size_t words)
+    {
+        for (size_t i = 0; i < words; i += 4)
+        {
+            XMVECTOR cur = XMLoadInt4(current + i);
+            XMVECTOR prev = XMLoadInt4(previous + i);
+
+            XMStoreInt4(pressed + i, XMVectorAndCInt(cur, prev));
+            XMStoreInt4(released + i, XMVectorAndCInt(prev, cur));
+            XMStoreInt4(previous + i, cur);
+        }
+    }
+
+    inline size_t RoundUp4(size_t value)
+    {
+        return (value + 3) & ~size_t(3);
+    }
+}
+
+DX::InputEdgeTracker::InputEdgeTracker(size_t playerCount) :
+    m_playerCount(playerCount),
+    m_keyboardCurrent(playerCount * KeyboardWords),
+    m_keyboardPrevious(playerCount * KeyboardWords),
+    m_keyboardPressed(playerCount * KeyboardWords),
+    m_keyboardReleased(playerCount * KeyboardWords),
+    m_gamePadCurrent(RoundUp4(playerCount)),
+    m_gamePadPrevious(RoundUp4(playerCount)),
+    m_gamePadPressed(RoundUp4(playerCount)),
+    m_gamePadReleased(RoundUp4(playerCount))
+{
+    if (!playerCount)
+    {
+        throw std::invalid_argument("InputEdgeTracker needs at least one player");
+    }
+}
+
+uint32_t DX::InputEdgeTracker::PackGamePad(const GamePad::State& state)
+{
+    if (!state.connected)
+        return 0;
+
+    // Branch-free: button states are close to random from frame to frame.
+    uint32_t bits = uint32_t(state.buttons.a)
+        | (uint32_t(state.buttons.b) << 1)
+        | (uint32_t(state.buttons.x) << 2)
+        | (uint32_t(state.buttons.y) << 3)
+        | (uint32_t(state.buttons.leftStick) << 4)
+        | (uint32_t(state.buttons.rightStick) << 5)
+        | (uint32_t(state.buttons.leftShoulder) << 6)
+        | (uint32_t(state.buttons.rightShoulder) << 7)
+        | (uint32_t(state.buttons.view) << 8)
+        | (uint32_t(state.buttons.menu) << 9)
+        | (uint32_t(state.dpad.up) << 10)
+        | (uint32_t(state.dpad.down) << 11)
+        | (uint32_t(state.dpad.left) << 12)
+        | (uint32_t(state.dpad.right) << 13)
+        | (uint32_t(state.thumbSticks.leftY > ButtonThreshold) << 14)
+        | (uint32_t(state.thumbSticks.leftY < -ButtonThreshold) << 15)
+        | (uint32_t(state.thumbSticks.leftX < -ButtonThreshold) << 16)
+        | (uint32_t(state.thumbSticks.leftX > ButtonThreshold) << 17)
+        | (uint32_t(state.thumbSticks.rightY > ButtonThreshold) << 18)
+        | (uint32_t(state.thumbSticks.rightY < -ButtonThreshold) << 19)
+        | (uint32_t(state.thumbSticks.rightX < -ButtonThreshold) << 20)
+        | (uint32_t(state.thumbSticks.rightX > ButtonThreshold) << 21)
+        | (uint32_t(state.triggers.left > ButtonThreshold) << 22)
+        | (uint32_t(state.triggers.right > ButtonThreshold) << 23);
+
+    return bits;
+}
+
+void DX::InputEdgeTracker::SetKeyboard(size_t player, const Keyboard::State& state)
+{
+    // The state's bitfields are laid out by virtual-key code, so it already is the bitset.
+    uint32_t bits[KeyboardWords];
+    memcpy(bits, &state, sizeof(bits));
+    SetKeyboardBits(player, bits);
+}
+
+void DX::InputEdgeTracker::SetKeyboardBits(size_t player, const uint32_t bits[KeyboardWords])
+{
+    memcpy(&m_keyboardCurrent[player * KeyboardWords], bits, KeyboardWords * sizeof(uint32_t));
+}
+
+void DX::InputEdgeTracker::SetGamePad(size_t player, const GamePad::State& state)
+{
+    SetGamePadBits(player, PackGamePad(state));
+}
+
+void DX::InputEdgeTracker::SetGamePadBits(size_t player, uint32_t buttons)
+{
+    m_gamePadCurrent[player] = buttons;
+}
+
+void DX::InputEdgeTracker::Update()
+{
+    DiffWords(m_keyboardCurrent.data(), m_keyboardPrevious.data(), m_keyboardPressed.data(), m_keyboardReleased.data(), m_keyboardCurrent.size());
+    DiffWords(m_gamePadCurrent.data(), m_gamePadPrevious.data(), m_gamePadPressed.data(), m_gamePadReleased.data(), m_gamePadCurrent.size());
+}
+
+void DX::InputEdgeTracker::Reset()
+{
+    for (auto array : { &m_keyboardCurrent, &m_keyboardPrevious, &m_keyboardPressed, &m_keyboardReleased,
+                        &m_gamePadCurrent, &m_gamePadPrevious, &m_gamePadPressed, &m_gamePadReleased })
+    {
+        std::fill(array->begin(), array->end(), 0u);
+    }
+}
+
+void DX::InputEdgeTracker::ResetKeyboard(size_t player)
+{
+    for (auto array : { &m_keyboardCurrent, &m_keyboardPrevious, &m_keyboardPressed, &m_keyboardReleased })
+    {
+        auto first = array->begin() + ptrdiff_t(player * KeyboardWords);
+        std::fill(first, first + KeyboardWords, 0u);
+    }
+}
+
+void DX::InputEdgeTracker::ResetGamePad(size_t player)
+{
+    m_gamePadCurrent[player] = 0;
+    m_gamePadPrevious[player] = 0;
+    m_gamePadPressed[player] = 0;
+    m_gamePadReleased[player] = 0;
+}
@@ -0,0 +1,109 @@
+//
+// InputEdgeTracker.h - Pressed/released edge detection for many players on packed bitsets
+//
+
+#pragma once
+
+#include "GamePad.h"
+#include "Keyboard.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace DX
+{
+    // Replaces per-player Keyboard::KeyboardStateTracker and GamePad::ButtonStateTracker.
+    // Each player's keyboard is kept as its 256-bit key bitset and each gamepad as one
+    // 32-bit word of button bits, with the gamepad words of four players sharing a vector.
+    // Update then finds every edge for every player with two AND-NOT operations per vector.
+    class InputEdgeTracker
+    {
+    public:
+        // Gamepad button bits. The stick directions and triggers use the same 0.5 threshold
+        // as the GamePad::State helpers.
+        enum Buttons : uint32_t
+        {
+            A               = 0x00000001,
+            B               = 0x00000002,
+            X               = 0x00000004,
+            Y               = 0x00000008,
+            LeftStick       = 0x00000010,
+            RightStick      = 0x00000020,
+            LeftShoulder    = 0x00000040,
+            RightShoulder   = 0x00000080,
+            View            = 0x00000100,   // Back
+            Menu            = 0x00000200,   // Start
+            DPadUp          = 0x00000400,
+            DPadDown        = 0x00000800,
+            DPadLeft        = 0x00001000,
+            DPadRight       = 0x00002000,
+            LeftStickUp     = 0x00004000,
+            LeftStickDown   = 0x00008000,
+            LeftStickLeft   = 0x00010000,
+            LeftStickRight  = 0x00020000,
+            RightStickUp    = 0x00040000,
+            RightStickDown  = 0x00080000,
+            RightStickLeft  = 0x00100000,
+            RightStickRight = 0x00200000,
+            LeftTrigger     = 0x00400000,
+            RightTrigger    = 0x00800000,
+        };
+
+        static const size_t KeyboardWords = 256 / 32;
+
+        explicit InputEdgeTracker(size_t playerCount = 1);
+
+        size_t GetPlayerCount() const { return m_playerCount; }
+
+        // Returns the button bits for a gamepad state; 0 if it is not connected.
+        static uint32_t PackGamePad(const DirectX::GamePad::State& state);
+
+        // Record this frame's state for a player. A player that is not set keeps its last state.
+        void SetKeyboard(size_t player, const DirectX::Keyboard::State& state);
+        void SetKeyboardBits(size_t player, const uint32_t bits[KeyboardWords]);
+        void SetGamePad(size_t player, const DirectX::GamePad::State& state);
+        void SetGamePadBits(size_t player, uint32_t buttons);
+
+        // Diffs every player's recorded state against the previous Update.
+        void Update();
+
+        // Forgets all state, so held keys and buttons do not report as pressed until released
+        // and pressed again.
+        void Reset();
+        void ResetKeyboard(size_t player);
+        void ResetGamePad(size_t player);
+
+        bool IsKeyDown(size_t player, DirectX::Keyboard::Keys key) const     { return TestKey(m_keyboardCurrent, player, key); }
+        bool IsKeyPressed(size_t player, DirectX::Keyboard::Keys key) const  { return TestKey(m_keyboardPressed, player, key); }
+        bool IsKeyReleased(size_t player, DirectX::Keyboard::Keys key) const { return TestKey(m_keyboardReleased, player, key); }
+
+        uint32_t GetButtonsDown(size_t player) const        { return m_gamePadCurrent[player]; }
+        uint32_t GetButtonsPressed(size_t player) const     { return m_gamePadPressed[player]; }
+        uint32_t GetButtonsReleased(size_t player) const    { return m_gamePadReleased[player]; }
+
+        bool IsButtonPressed(size_t player, uint32_t buttons) const  { return (m_gamePadPressed[player] & buttons) != 0; }
+        bool IsButtonReleased(size_t player, uint32_t buttons) const { return (m_gamePadReleased[player] & buttons) != 0; }
+
+    private:
+        static bool TestKey(const std::vector<uint32_t>& bits, size_t player, DirectX::Keyboard::Keys key)
+        {
+            auto k = static_cast<unsigned int>(key);
+            return (bits[player * KeyboardWords + (k >> 5)] & (1u << (k & 0x1f))) != 0;
+        }
+
+        size_t                  m_playerCount;
+
+        // Keyboard bitsets are KeyboardWords per player; gamepad words are one per player,
+        // padded to a multiple of four.
+        std::vector<uint32_t>   m_keyboardCurrent;
+        std::vector<uint32_t>   m_keyboardPrevious;
+        std::vector<uint32_t>   m_keyboardPressed;
+        std::vector<uint32_t>   m_keyboardReleased;
+
+        std::vector<uint32_t>   m_gamePadCurrent;
+        std::vector<uint32_t>   m_gamePadPrevious;
+        std::vector<uint32_t>   m_gamePadPressed;
+        std::vector<uint32_t>   m_gamePadReleased;
+    };
+}
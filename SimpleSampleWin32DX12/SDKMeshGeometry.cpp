@@ -0,0 +1,294 @@
+//
+// SDKMeshGeometry.cpp
+//
+
+#include "pch.h"
+#include "SDKMeshGeometry.h"
+
+#include <string>
+#include <string.h>
+
+using namespace DirectX;
+
+namespace
+{
+    // Field offsets in the SDKMESH structures, which the file stores with 8 byte packing.
+    const uint32_t c_version1 = 101;
+    const uint32_t c_version2 = 200;
+
+    const size_t c_headerSize = 104;
+    const size_t c_headerVersion = 0;
+    const size_t c_headerIsBigEndian = 4;
+    const size_t c_headerNumVertexBuffers = 32;
+    const size_t c_headerNumIndexBuffers = 36;
+    const size_t c_headerNumMeshes = 40;
+    const size_t c_headerNumTotalSubsets = 44;
+    const size_t c_headerVertexStreamHeadersOffset = 56;
+    const size_t c_headerIndexStreamHeadersOffset = 64;
+    const size_t c_headerMeshDataOffset = 72;
+    const size_t c_headerSubsetDataOffset = 80;
+
+    const size_t c_vertexHeaderSize = 288;
+    const size_t c_vertexNumVertices = 0;
+    const size_t c_vertexSizeBytes = 8;
+    const size_t c_vertexStrideBytes = 16;
+    const size_t c_vertexDecl = 24;
+    const size_t c_vertexDeclCount = 32;
+    const size_t c_vertexDataOffset = 280;
+
+    const size_t c_indexHeaderSize = 32;
+    const size_t c_indexNumIndices = 0;
+    const size_t c_indexSizeBytes = 8;
+    const size_t c_indexType = 16;
+    const size_t c_indexDataOffset = 24;
+
+    const size_t c_meshSize = 224;
+    const size_t c_meshNumVertexBuffers = 100;
+    const size_t c_meshVertexBuffers = 104;
+    const size_t c_meshIndexBuffer = 168;
+    const size_t c_meshNumSubsets = 172;
+    const size_t c_meshSubsetOffset = 208;
+
+    const size_t c_subsetSize = 144;
+    const size_t c_subsetPrimitiveType = 104;
+    const size_t c_subsetIndexStart = 112;
+    const size_t c_subsetIndexCount = 120;
+    const size_t c_subsetVertexStart = 128;
+
+    // D3DVERTEXELEMENT9 values.
+    const size_t c_elementSize = 8;
+    const uint16_t c_declEnd = 0xFF;
+    const uint8_t c_typeFloat3 = 2;
+    const uint8_t c_usagePosition = 0;
+
+    const uint32_t c_primitiveTriangleList = 0;
+    const uint32_t c_indexType32 = 1;
+
+    [[noreturn]] void ThrowInvalid(const char* message)
+    {
+        throw std::runtime_error(std::string("SDKMESH geometry: ") + message);
+    }
+
+    // Bounds-checked little-endian reads from the image.
+    class Reader
+    {
+    public:
+        Reader(const uint8_t* data, size_t size) : m_data(data), m_size(size) {}
+
+        void Check(uint64_t offset, uint64_t bytes) const
+        {
+            if (offset > m_size || bytes > m_size - offset)
+                ThrowInvalid("data lies outside the file");
+        }
+
+        template<typename T> T Read(uint64_t offset) const
+        {
+            Check(offset, sizeof(T));
+            T value;
+            memcpy(&value, m_data + offset, sizeof(T));
+            return value;
+        }
+
+        const uint8_t* At(uint64_t offset) const { return m_data + offset; }
+
+    private:
+        const uint8_t*  m_data;
+        size_t          m_size;
+    };
+
+    struct VertexBuffer
+    {
+        uint64_t    count;
+        uint64_t    stride;
+        uint64_t    data;       // Offset of the first position
+        uint32_t    base;       // Where the buffer starts in the output positions
+    };
+}
+
+void DX::ReadSDKMESHTriangles(const uint8_t* data, size_t size, std::vector<XMFLOAT3>& positions, std::vector<uint32_t>& indices)
+{
+    positions.clear();
+    indices.clear();
+
+    Reader file(data, size);
+    file.Check(0, c_headerSize);
+
+    uint32_t version = file.Read<uint32_t>(c_headerVersion);
+    if (version != c_version1 && version != c_version2)
+        ThrowInvalid("unsupported version");
+
+    if (file.Read<uint8_t>(c_headerIsBigEndian))
+        ThrowInvalid("big-endian files are not supported");
+
+    const uint32_t vertexBufferCount = file.Read<uint32_t>(c_headerNumVertexBuffers);
+    const uint32_t indexBufferCount = file.Read<uint32_t>(c_headerNumIndexBuffers);
+    const uint32_t meshCount = file.Read<uint32_t>(c_headerNumMeshes);
+    const uint32_t subsetCount = file.Read<uint32_t>(c_headerNumTotalSubsets);
+    const uint64_t vertexHeaders = file.Read<uint64_t>(c_headerVertexStreamHeadersOffset);
+    const uint64_t indexHeaders = file.Read<uint64_t>(c_headerIndexStreamHeadersOffset);
+    const uint64_t meshData = file.Read<uint64_t>(c_headerMeshDataOffset);
+    const uint64_t subsetData = file.Read<uint64_t>(c_headerSubsetDataOffset);
+
+    file.Check(vertexHeaders, uint64_t(vertexBufferCount) * c_vertexHeaderSize);
+    file.Check(indexHeaders, uint64_t(indexBufferCount) * c_indexHeaderSize);
+    file.Check(meshData, uint64_t(meshCount) * c_meshSize);
+    file.Check(subsetData, uint64_t(subsetCount) * c_subsetSize);
+
+    // Copy the positions out of every vertex buffer.
+    std::vector<VertexBuffer> vertexBuffers(vertexBufferCount);
+    uint64_t totalVertices = 0;
+    for (uint32_t j = 0; j < vertexBufferCount; ++j)
+    {
+        const uint64_t header = vertexHeaders + uint64_t(j) * c_vertexHeaderSize;
+
+        VertexBuffer& vb = vertexBuffers[j];
+        vb.count = file.Read<uint64_t>(header + c_vertexNumVertices);
+        vb.stride = file.Read<uint64_t>(header + c_vertexStrideBytes);
+        vb.base = static_cast<uint32_t>(totalVertices);
+
+        uint64_t sizeBytes = file.Read<uint64_t>(header + c_vertexSizeBytes);
+        uint64_t dataOffset = file.Read<uint64_t>(header + c_vertexDataOffset);
+
+        bool hasPosition = false;
+        for (size_t e = 0; e < c_vertexDeclCount && !hasPosition; ++e)
+        {
+            const uint64_t element = header + c_vertexDecl + e * c_elementSize;
+            uint16_t stream = file.Read<uint16_t>(element);
+            if (stream == c_declEnd)
+                break;
+
+            if (stream == 0
+                && file.Read<uint8_t>(element + 4) == c_typeFloat3
+                && file.Read<uint8_t>(element + 6) == c_usagePosition
+                && file.Read<uint8_t>(element + 7) == 0)
+            {
+                uint16_t offset = file.Read<uint16_t>(element + 2);
+                if (uint64_t(offset) + sizeof(XMFLOAT3) > vb.stride)
+                    ThrowInvalid("position lies outside the vertex");
+
+                vb.data = dataOffset + offset;
+                hasPosition = true;
+            }
+        }
+
+        if (!hasPosition)
+            ThrowInvalid("vertex buffer has no float3 position");
+
+        if (!vb.count)
+            continue;
+
+        if (vb.stride > sizeBytes / vb.count)
+            ThrowInvalid("vertex buffer is smaller than its vertices");
+
+        file.Check(dataOffset, sizeBytes);
+
+        totalVertices += vb.count;
+        if (totalVertices >= UINT32_MAX)
+            ThrowInvalid("too many vertices");
+    }
+
+    positions.resize(static_cast<size_t>(totalVertices));
+    for (const auto& vb : vertexBuffers)
+    {
+        for (uint64_t v = 0; v < vb.count; ++v)
+        {
+            memcpy(&positions[vb.base + static_cast<size_t>(v)], file.At(vb.data + v * vb.stride), sizeof(XMFLOAT3));
+        }
+    }
+
+    // Then the triangle-list subsets of every mesh, rebased onto those positions.
+    for (uint32_t m = 0; m < meshCount; ++m)
+    {
+        const uint64_t mesh = meshData + uint64_t(m) * c_meshSize;
+
+        if (!file.Read<uint8_t>(mesh + c_meshNumVertexBuffers))
+            continue;
+
+        uint32_t vbIndex = file.Read<uint32_t>(mesh + c_meshVertexBuffers);
+        uint32_t ibIndex = file.Read<uint32_t>(mesh + c_meshIndexBuffer);
+        uint32_t meshSubsets = file.Read<uint32_t>(mesh + c_meshNumSubsets);
+        uint64_t subsetList = file.Read<uint64_t>(mesh + c_meshSubsetOffset);
+
+        if (vbIndex >= vertexBufferCount || ibIndex >= indexBufferCount)
+            ThrowInvalid("mesh refers to a missing buffer");
+
+        const VertexBuffer& vb = vertexBuffers[vbIndex];
+
+        const uint64_t ibHeader = indexHeaders + uint64_t(ibIndex) * c_indexHeaderSize;
+        uint64_t ibCount = file.Read<uint64_t>(ibHeader + c_indexNumIndices);
+        uint64_t ibBytes = file.Read<uint64_t>(ibHeader + c_indexSizeBytes);
+        uint64_t ibData = file.Read<uint64_t>(ibHeader + c_indexDataOffset);
+        size_t indexSize = (file.Read<uint32_t>(ibHeader + c_indexType) == c_indexType32) ? 4 : 2;
+
+        if (ibCount > ibBytes / indexSize)
+            ThrowInvalid("index buffer is smaller than its indices");
+
+        file.Check(ibData, ibCount * indexSize);
+        file.Check(subsetList, uint64_t(meshSubsets) * sizeof(uint32_t));
+
+        for (uint32_t s = 0; s < meshSubsets; ++s)
+        {
+            uint32_t subsetIndex = file.Read<uint32_t>(subsetList + uint64_t(s) * sizeof(uint32_t));
+            if (subsetIndex >= subsetCount)
+                ThrowInvalid("mesh refers to a missing subset");
+
+            const uint64_t subset = subsetData + uint64_t(subsetIndex) * c_subsetSize;
+            if (file.Read<uint32_t>(subset + c_subsetPrimitiveType) != c_primitiveTriangleList)
+                continue;
+
+            uint64_t indexStart = file.Read<uint64_t>(subset + c_subsetIndexStart);
+            uint64_t indexCount = file.Read<uint64_t>(subset + c_subsetIndexCount);
+            uint64_t vertexStart = file.Read<uint64_t>(subset + c_subsetVertexStart);
+
+            if (indexStart > ibCount || indexCount > ibCount - indexStart || indexCount % 3)
+                ThrowInvalid("subset indices lie outside the index buffer");
+
+            const uint8_t* source = file.At(ibData + indexStart * indexSize);
+            for (uint64_t i = 0; i < indexCount; ++i)
+            {
+                uint32_t index;
+                if (indexSize == 4)
+                {
+                    memcpy(&index, source + i * 4, 4);
+                }
+                else
+                {
+                    uint16_t index16;
+                    memcpy(&index16, source + i * 2, 2);
+                    index = index16;
+                }
+
+                uint64_t vertex = vertexStart + index;
+                if (vertex >= vb.count)
+                    ThrowInvalid("index refers to a missing vertex");
+
+                indices.push_back(vb.base + static_cast<uint32_t>(vertex));
+            }
+        }
+    }
+}
+
+void DX::ReadSDKMESHTriangles(const wchar_t* szFileName, std::vector<XMFLOAT3>& positions, std::vector<uint32_t>& indices)
+{
+    FILE* file = nullptr;
+    if (_wfopen_s(&file, szFileName, L"rb") != 0)
+        file = nullptr;
+    if (!file)
+        ThrowInvalid("failed to open file");
+
+    std::vector<uint8_t> data;
+    uint8_t buffer[65536];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        data.insert(data.end(), buffer, buffer + read);
+    }
+
+    bool failed = ferror(file) != 0;
+    fclose(file);
+
+    if (failed)
+        ThrowInvalid("read failed");
+
+    ReadSDKMESHTriangles(data.data(), data.size(), positions, indices);
+}
@@ -0,0 +1,22 @@
+//
+// SDKMeshGeometry.h - Reads triangle positions from an SDKMESH file for CPU-side queries
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace DX
+{
+    // Model::CreateFromSDKMESH keeps its geometry on the GPU, so picking reads the file a
+    // second time for the positions and triangle-list indices of every mesh. Positions are
+    // copied from each vertex buffer in turn and 'indices' holds three per triangle, already
+    // offset into 'positions'. Subsets that are not triangle lists are skipped.
+    //
+    // Throws std::runtime_error if the image is not a valid SDKMESH.
+    void ReadSDKMESHTriangles(const uint8_t* data, size_t size, std::vector<DirectX::XMFLOAT3>& positions, std::vector<uint32_t>& indices);
+
+    void ReadSDKMESHTriangles(const wchar_t* szFileName, std::vector<DirectX::XMFLOAT3>& positions, std::vector<uint32_t>& indices);
+}
@@ -0,0 +1,619 @@
+//
+// TriangleBVH.cpp
+//
+
+#include "pch.h"
+#include "TriangleBVH.h"
+
+#include <float.h>
+#include <math.h>
+
+#if defined(_XM_SSE_INTRINSICS_) && !defined(_XM_NO_INTRINSICS_)
+#include <emmintrin.h>
+#endif
+
+using namespace DirectX;
+using namespace DX;
+
+namespace
+{
+    // Leaves hold at most this many triangles unless the depth limit forces more; the SAH
+    // usually stops earlier.
+    const uint32_t c_maxLeafTriangles = 4;
+
+    // Traversal keeps a fixed stack, so the build never goes deeper than this.
+    const uint32_t c_maxDepth = 48;
+
+    const unsigned int c_binCount = 16;
+
+    // Relative cost of visiting a node against testing one triangle.
+    const float c_traversalCost = 1.f;
+
+    // Directions are kept this far from zero so that the slab test never sees 0 * inf.
+    const float c_minDirection = 1e-20f;
+
+    struct Box
+    {
+        XMFLOAT3    min;
+        XMFLOAT3    max;
+
+        void Reset()
+        {
+            min = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+            max = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+        }
+
+        void Grow(const XMFLOAT3& p)
+        {
+            min.x = std::min(min.x, p.x); max.x = std::max(max.x, p.x);
+            min.y = std::min(min.y, p.y); max.y = std::max(max.y, p.y);
+            min.z = std::min(min.z, p.z); max.z = std::max(max.z, p.z);
+        }
+
+        void Grow(const Box& b)
+        {
+            Grow(b.min);
+            Grow(b.max);
+        }
+
+        // Half the surface area, which is all the SAH compares.
+        float Area() const
+        {
+            if (min.x > max.x)
+                return 0.f;
+
+            float x = max.x - min.x;
+            float y = max.y - min.y;
+            float z = max.z - min.z;
+            return x * y + y * z + z * x;
+        }
+    };
+
+    inline float Axis(const XMFLOAT3& v, unsigned int axis)
+    {
+        return (&v.x)[axis];
+    }
+
+    inline float SafeInverse(float d)
+    {
+        if (fabsf(d) < c_minDirection)
+            d = (d < 0.f) ? -c_minDirection : c_minDirection;
+
+        return 1.f / d;
+    }
+}
+
+TriangleBVH::TriangleBVH() noexcept :
+    m_stats{}
+{
+}
+
+void TriangleBVH::Build(const XMFLOAT3* positions, size_t vertexCount, const uint32_t* indices, size_t triangleCount)
+{
+    m_nodes.clear();
+    m_triangles.clear();
+    m_stats = {};
+
+    if (!triangleCount)
+        return;
+
+    if (triangleCount >= UINT32_MAX / 2)
+        throw std::invalid_argument("TriangleBVH has too many triangles");
+
+    std::vector<Box> boxes(triangleCount);
+    std::vector<XMFLOAT3> centroids(triangleCount);
+    std::vector<uint32_t> order(triangleCount);
+
+    for (size_t j = 0; j < triangleCount; ++j)
+    {
+        const uint32_t* tri = indices + j * 3;
+        if (tri[0] >= vertexCount || tri[1] >= vertexCount || tri[2] >= vertexCount)
+            throw std::invalid_argument("TriangleBVH triangle index out of range");
+
+        Box& box = boxes[j];
+        box.Reset();
+        box.Grow(positions[tri[0]]);
+        box.Grow(positions[tri[1]]);
+        box.Grow(positions[tri[2]]);
+
+        centroids[j] = XMFLOAT3((box.min.x + box.max.x) * 0.5f, (box.min.y + box.max.y) * 0.5f, (box.min.z + box.max.z) * 0.5f);
+        order[j] = static_cast<uint32_t>(j);
+    }
+
+    m_nodes.reserve(triangleCount * 2);
+    m_nodes.push_back(Node{});
+    m_nodes[0].first = 0;
+    m_nodes[0].count = static_cast<uint32_t>(triangleCount);
+
+    struct Pending
+    {
+        uint32_t    node;
+        uint32_t    depth;
+    };
+
+    std::vector<Pending> pending;
+    pending.push_back(Pending{ 0, 0 });
+
+    while (!pending.empty())
+    {
+        Pending current = pending.back();
+        pending.pop_back();
+
+        // Nodes are appended below, so only index into m_nodes, never hold a reference.
+        const uint32_t first = m_nodes[current.node].first;
+        const uint32_t count = m_nodes[current.node].count;
+
+        Box bounds;
+        Box centroidBounds;
+        bounds.Reset();
+        centroidBounds.Reset();
+        for (uint32_t j = first; j < first + count; ++j)
+        {
+            bounds.Grow(boxes[order[j]]);
+            centroidBounds.Grow(centroids[order[j]]);
+        }
+
+        {
+            Node& node = m_nodes[current.node];
+            node.minX = bounds.min.x; node.minY = bounds.min.y; node.minZ = bounds.min.z;
+            node.maxX = bounds.max.x; node.maxY = bounds.max.y; node.maxZ = bounds.max.z;
+        }
+
+        m_stats.maxDepth = std::max(m_stats.maxDepth, current.depth);
+
+        if (count <= 1 || current.depth >= c_maxDepth)
+        {
+            ++m_stats.leaves;
+            continue;
+        }
+
+        // Binned SAH: drop the centroids into equal bins along each axis and cost every
+        // plane between bins.
+        float bestCost = FLT_MAX;
+        unsigned int bestAxis = 0;
+        unsigned int bestSplit = 0;
+
+        for (unsigned int axis = 0; axis < 3; ++axis)
+        {
+            float lo = Axis(centroidBounds.min, axis);
+            float extent = Axis(centroidBounds.max, axis) - lo;
+            if (!(extent > 0.f))
+                continue;
+
+            float scale = c_binCount / extent;
+
+            Box binBoxes[c_binCount];
+            uint32_t binCounts[c_binCount] = {};
+            for (auto& box : binBoxes)
+            {
+                box.Reset();
+            }
+
+            for (uint32_t j = first; j < first + count; ++j)
+            {
+                unsigned int bin = std::min(static_cast<unsigned int>((Axis(centroids[order[j]], axis) - lo) * scale), c_binCount - 1);
+                ++binCounts[bin];
+                binBoxes[bin].Grow(boxes[order[j]]);
+            }
+
+            float rightArea[c_binCount];
+            uint32_t rightCount[c_binCount];
+            Box right;
+            right.Reset();
+            uint32_t rightTotal = 0;
+            for (unsigned int bin = c_binCount - 1; bin > 0; --bin)
+            {
+                right.Grow(binBoxes[bin]);
+                rightTotal += binCounts[bin];
+                rightArea[bin] = right.Area();
+                rightCount[bin] = rightTotal;
+            }
+
+            Box left;
+            left.Reset();
+            uint32_t leftTotal = 0;
+            for (unsigned int split = 1; split < c_binCount; ++split)
+            {
+                left.Grow(binBoxes[split - 1]);
+                leftTotal += binCounts[split - 1];
+                if (!leftTotal || !rightCount[split])
+                    continue;
+
+                float cost = leftTotal * left.Area() + rightCount[split] * rightArea[split];
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = split;
+                }
+            }
+        }
+
+        float leafCost = count * bounds.Area();
+        bool split = bestSplit && (bestCost + c_traversalCost * bounds.Area() < leafCost || count > c_maxLeafTriangles);
+
+        if (!split && count > c_maxLeafTriangles)
+        {
+            // Every centroid is in the same place; halve the list so the leaf stays small.
+            bestSplit = 0;
+            split = true;
+        }
+
+        if (!split)
+        {
+            ++m_stats.leaves;
+            continue;
+        }
+
+        uint32_t* begin = order.data() + first;
+        uint32_t* end = begin + count;
+        uint32_t* middle;
+
+        if (bestSplit)
+        {
+            float lo = Axis(centroidBounds.min, bestAxis);
+            float scale = c_binCount / (Axis(centroidBounds.max, bestAxis) - lo);
+            middle = std::partition(begin, end, [&](uint32_t tri)
+            {
+                return std::min(static_cast<unsigned int>((Axis(centroids[tri], bestAxis) - lo) * scale), c_binCount - 1) < bestSplit;
+            });
+        }
+        else
+        {
+            middle = begin + count / 2;
+        }
+
+        if (middle == begin || middle == end)
+            middle = begin + count / 2;
+
+        uint32_t leftCount = static_cast<uint32_t>(middle - begin);
+        uint32_t children = static_cast<uint32_t>(m_nodes.size());
+
+        m_nodes.push_back(Node{});
+        m_nodes.push_back(Node{});
+        m_nodes[children].first = first;
+        m_nodes[children].count = leftCount;
+        m_nodes[children + 1].first = first + leftCount;
+        m_nodes[children + 1].count = count - leftCount;
+
+        m_nodes[current.node].first = children;
+        m_nodes[current.node].count = 0;
+
+        pending.push_back(Pending{ children + 1, current.depth + 1 });
+        pending.push_back(Pending{ children, current.depth + 1 });
+    }
+
+    m_triangles.resize(triangleCount);
+    for (size_t j = 0; j < triangleCount; ++j)
+    {
+        const uint32_t* tri = indices + size_t(order[j]) * 3;
+        XMVECTOR v0 = XMLoadFloat3(&positions[tri[0]]);
+
+        Triangle& triangle = m_triangles[j];
+        XMStoreFloat3(&triangle.v0, v0);
+        XMStoreFloat3(&triangle.edge1, XMVectorSubtract(XMLoadFloat3(&positions[tri[1]]), v0));
+        XMStoreFloat3(&triangle.edge2, XMVectorSubtract(XMLoadFloat3(&positions[tri[2]]), v0));
+        triangle.index = order[j];
+    }
+
+    m_nodes.shrink_to_fit();
+
+    m_stats.triangles = static_cast<uint32_t>(triangleCount);
+    m_stats.nodes = static_cast<uint32_t>(m_nodes.size());
+}
+
+bool XM_CALLCONV TriangleBVH::Intersect(FXMVECTOR origin, FXMVECTOR direction, float maxDistance, Hit& hit) const
+{
+    if (m_nodes.empty())
+        return false;
+
+    XMFLOAT3 o;
+    XMFLOAT3 d;
+    XMStoreFloat3(&o, origin);
+    XMStoreFloat3(&d, direction);
+
+    const float invX = SafeInverse(d.x);
+    const float invY = SafeInverse(d.y);
+    const float invZ = SafeInverse(d.z);
+
+    float closest = maxDistance;
+    uint32_t found = NoHit;
+    float foundU = 0.f;
+    float foundV = 0.f;
+
+    // Entry distance, or FLT_MAX if the ray misses the box or only reaches it past 'closest'.
+    auto enter = [&](const Node& node) -> float
+    {
+        float tx0 = (node.minX - o.x) * invX, tx1 = (node.maxX - o.x) * invX;
+        float ty0 = (node.minY - o.y) * invY, ty1 = (node.maxY - o.y) * invY;
+        float tz0 = (node.minZ - o.z) * invZ, tz1 = (node.maxZ - o.z) * invZ;
+
+        float tmin = std::max(std::max(std::min(tx0, tx1), std::min(ty0, ty1)), std::max(std::min(tz0, tz1), 0.f));
+        float tmax = std::min(std::min(std::max(tx0, tx1), std::max(ty0, ty1)), std::min(std::max(tz0, tz1), closest));
+
+        return (tmin <= tmax) ? tmin : FLT_MAX;
+    };
+
+    struct Entry
+    {
+        uint32_t    node;
+        float       distance;
+    };
+
+    Entry stack[c_maxDepth + 2];
+    size_t depth = 0;
+
+    if (enter(m_nodes[0]) == FLT_MAX)
+        return false;
+
+    uint32_t current = 0;
+    for (;;)
+    {
+        const Node& node = m_nodes[current];
+        if (node.count)
+        {
+            for (uint32_t j = node.first; j < node.first + node.count; ++j)
+            {
+                const Triangle& tri = m_triangles[j];
+
+                // p = d x edge2
+                float px = d.y * tri.edge2.z - d.z * tri.edge2.y;
+                float py = d.z * tri.edge2.x - d.x * tri.edge2.z;
+                float pz = d.x * tri.edge2.y - d.y * tri.edge2.x;
+
+                float det = tri.edge1.x * px + tri.edge1.y * py + tri.edge1.z * pz;
+                if (fabsf(det) < FLT_MIN)
+                    continue;
+
+                float invDet = 1.f / det;
+
+                float sx = o.x - tri.v0.x;
+                float sy = o.y - tri.v0.y;
+                float sz = o.z - tri.v0.z;
+
+                float u = (sx * px + sy * py + sz * pz) * invDet;
+                if (u < 0.f || u > 1.f)
+                    continue;
+
+                // q = s x edge1
+                float qx = sy * tri.edge1.z - sz * tri.edge1.y;
+                float qy = sz * tri.edge1.x - sx * tri.edge1.z;
+                float qz = sx * tri.edge1.y - sy * tri.edge1.x;
+
+                float v = (d.x * qx + d.y * qy + d.z * qz) * invDet;
+                if (v < 0.f || u + v > 1.f)
+                    continue;
+
+                float t = (tri.edge2.x * qx + tri.edge2.y * qy + tri.edge2.z * qz) * invDet;
+                if (t > 0.f && t < closest)
+                {
+                    closest = t;
+                    found = tri.index;
+                    foundU = u;
+                    foundV = v;
+                }
+            }
+        }
+        else
+        {
+            // Go to the nearer child first so that its hits can cull the other one.
+            uint32_t a = node.first;
+            uint32_t b = node.first + 1;
+            float ta = enter(m_nodes[a]);
+            float tb = enter(m_nodes[b]);
+            if (tb < ta)
+            {
+                std::swap(a, b);
+                std::swap(ta, tb);
+            }
+
+            if (ta != FLT_MAX)
+            {
+                if (tb != FLT_MAX)
+                    stack[depth++] = Entry{ b, tb };
+
+                current = a;
+                continue;
+            }
+        }
+
+        // A hit found since a node was pushed may have put it out of reach.
+        for (;;)
+        {
+            if (!depth)
+            {
+                if (found == NoHit)
+                    return false;
+
+                hit.distance = closest;
+                hit.u = foundU;
+                hit.v = foundV;
+                hit.triangle = found;
+                return true;
+            }
+
+            const Entry& entry = stack[--depth];
+            if (entry.distance < closest)
+            {
+                current = entry.node;
+                break;
+            }
+        }
+    }
+}
+
+size_t TriangleBVH::IntersectPacket(const RayPacket& rays, Hit* hits) const
+{
+#if defined(_XM_SSE_INTRINSICS_) && !defined(_XM_NO_INTRINSICS_)
+    __m128 closest = _mm_loadu_ps(rays.maxDistance);
+    __m128 foundU = _mm_setzero_ps();
+    __m128 foundV = _mm_setzero_ps();
+    __m128i found = _mm_set1_epi32(-1);
+
+    if (!m_nodes.empty())
+    {
+        const __m128 ox = _mm_loadu_ps(rays.originX);
+        const __m128 oy = _mm_loadu_ps(rays.originY);
+        const __m128 oz = _mm_loadu_ps(rays.originZ);
+        const __m128 dx = _mm_loadu_ps(rays.directionX);
+        const __m128 dy = _mm_loadu_ps(rays.directionY);
+        const __m128 dz = _mm_loadu_ps(rays.directionZ);
+
+        // Keep every lane's direction away from zero, as SafeInverse does.
+        const __m128 signMask = _mm_set1_ps(-0.f);
+        const __m128 minDirection = _mm_set1_ps(c_minDirection);
+        auto safeInverse = [&](__m128 v) -> __m128
+        {
+            __m128 magnitude = _mm_max_ps(_mm_andnot_ps(signMask, v), minDirection);
+            return _mm_div_ps(_mm_set1_ps(1.f), _mm_or_ps(magnitude, _mm_and_ps(v, signMask)));
+        };
+
+        const __m128 invX = safeInverse(dx);
+        const __m128 invY = safeInverse(dy);
+        const __m128 invZ = safeInverse(dz);
+
+        // The packet's average direction orders the children for every lane at once.
+        float meanX = rays.directionX[0] + rays.directionX[1] + rays.directionX[2] + rays.directionX[3];
+        float meanY = rays.directionY[0] + rays.directionY[1] + rays.directionY[2] + rays.directionY[3];
+        float meanZ = rays.directionZ[0] + rays.directionZ[1] + rays.directionZ[2] + rays.directionZ[3];
+
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.f);
+        const __m128 minDet = _mm_set1_ps(FLT_MIN);
+
+        uint32_t stack[c_maxDepth + 2];
+        size_t depth = 0;
+        uint32_t current = 0;
+
+        for (;;)
+        {
+            const Node& node = m_nodes[current];
+
+            __m128 tx0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.minX), ox), invX);
+            __m128 tx1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.maxX), ox), invX);
+            __m128 ty0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.minY), oy), invY);
+            __m128 ty1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.maxY), oy), invY);
+            __m128 tz0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.minZ), oz), invZ);
+            __m128 tz1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.maxZ), oz), invZ);
+
+            __m128 tmin = _mm_max_ps(_mm_max_ps(_mm_min_ps(tx0, tx1), _mm_min_ps(ty0, ty1)), _mm_max_ps(_mm_min_ps(tz0, tz1), zero));
+            __m128 tmax = _mm_min_ps(_mm_min_ps(_mm_max_ps(tx0, tx1), _mm_max_ps(ty0, ty1)), _mm_min_ps(_mm_max_ps(tz0, tz1), closest));
+
+            __m128 active = _mm_cmple_ps(tmin, tmax);
+
+            if (_mm_movemask_ps(active))
+            {
+                if (node.count)
+                {
+                    for (uint32_t j = node.first; j < node.first + node.count; ++j)
+                    {
+                        const Triangle& tri = m_triangles[j];
+                        const __m128 e1x = _mm_set1_ps(tri.edge1.x);
+                        const __m128 e1y = _mm_set1_ps(tri.edge1.y);
+                        const __m128 e1z = _mm_set1_ps(tri.edge1.z);
+                        const __m128 e2x = _mm_set1_ps(tri.edge2.x);
+                        const __m128 e2y = _mm_set1_ps(tri.edge2.y);
+                        const __m128 e2z = _mm_set1_ps(tri.edge2.z);
+
+                        __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+                        __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+                        __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+
+                        __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+                        __m128 valid = _mm_and_ps(active, _mm_cmpge_ps(_mm_andnot_ps(signMask, det), minDet));
+                        __m128 invDet = _mm_div_ps(one, det);
+
+                        __m128 sx = _mm_sub_ps(ox, _mm_set1_ps(tri.v0.x));
+                        __m128 sy = _mm_sub_ps(oy, _mm_set1_ps(tri.v0.y));
+                        __m128 sz = _mm_sub_ps(oz, _mm_set1_ps(tri.v0.z));
+
+                        __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), invDet);
+
+                        __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+                        __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+                        __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+
+                        __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), invDet);
+                        __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), invDet);
+
+                        valid = _mm_and_ps(valid, _mm_cmpge_ps(u, zero));
+                        valid = _mm_and_ps(valid, _mm_cmpge_ps(v, zero));
+                        valid = _mm_and_ps(valid, _mm_cmple_ps(_mm_add_ps(u, v), one));
+                        valid = _mm_and_ps(valid, _mm_cmpgt_ps(t, zero));
+                        valid = _mm_and_ps(valid, _mm_cmplt_ps(t, closest));
+
+                        if (_mm_movemask_ps(valid))
+                        {
+                            closest = _mm_or_ps(_mm_and_ps(valid, t), _mm_andnot_ps(valid, closest));
+                            foundU = _mm_or_ps(_mm_and_ps(valid, u), _mm_andnot_ps(valid, foundU));
+                            foundV = _mm_or_ps(_mm_and_ps(valid, v), _mm_andnot_ps(valid, foundV));
+
+                            __m128i validMask = _mm_castps_si128(valid);
+                            found = _mm_or_si128(_mm_and_si128(validMask, _mm_set1_epi32(static_cast<int>(tri.index))), _mm_andnot_si128(validMask, found));
+                        }
+                    }
+                }
+                else
+                {
+                    const Node& a = m_nodes[node.first];
+                    const Node& b = m_nodes[node.first + 1];
+
+                    float ahead = (b.minX + b.maxX - a.minX - a.maxX) * meanX
+                        + (b.minY + b.maxY - a.minY - a.maxY) * meanY
+                        + (b.minZ + b.maxZ - a.minZ - a.maxZ) * meanZ;
+
+                    if (ahead < 0.f)
+                    {
+                        stack[depth++] = node.first;
+                        current = node.first + 1;
+                    }
+                    else
+                    {
+                        stack[depth++] = node.first + 1;
+                        current = node.first;
+                    }
+                    continue;
+                }
+            }
+
+            if (!depth)
+                break;
+
+            current = stack[--depth];
+        }
+    }
+
+    XM_ALIGNED_DATA(16) float distances[PacketSize];
+    XM_ALIGNED_DATA(16) float us[PacketSize];
+    XM_ALIGNED_DATA(16) float vs[PacketSize];
+    XM_ALIGNED_DATA(16) uint32_t triangles[PacketSize];
+    _mm_store_ps(distances, closest);
+    _mm_store_ps(us, foundU);
+    _mm_store_ps(vs, foundV);
+    _mm_store_si128(reinterpret_cast<__m128i*>(triangles), found);
+
+    size_t count = 0;
+    for (size_t j = 0; j < PacketSize; ++j)
+    {
+        hits[j] = Hit{ distances[j], us[j], vs[j], triangles[j] };
+        if (triangles[j] != NoHit)
+            ++count;
+    }
+
+    return count;
+#else
+    size_t count = 0;
+    for (size_t j = 0; j < PacketSize; ++j)
+    {
+        hits[j] = Hit{ rays.maxDistance[j], 0.f, 0.f, NoHit };
+        if (Intersect(XMVectorSet(rays.originX[j], rays.originY[j], rays.originZ[j], 0.f),
+            XMVectorSet(rays.directionX[j], rays.directionY[j], rays.directionZ[j], 0.f),
+            rays.maxDistance[j], hits[j]))
+        {
+            ++count;
+        }
+    }
+
+    return count;
+#endif
+}
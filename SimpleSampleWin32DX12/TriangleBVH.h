@@ -0,0 +1,103 @@
+//
+// TriangleBVH.h - Bounding volume hierarchy over a triangle mesh for ray queries
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace DX
+{
+    // Sorts a mesh's triangles into a binary tree of boxes, split by the surface area
+    // heuristic, so a ray only tests the few triangles near its path. Built once per mesh in
+    // mesh space; rays in other spaces are moved into it by the caller.
+    //
+    // Rays need not be normalized. Distances are measured in multiples of the direction, so
+    // a ray transformed by an affine matrix still reports the distance along the original
+    // ray. Triangles are hit from either side.
+    class TriangleBVH
+    {
+    public:
+        static const uint32_t NoHit = UINT32_MAX;
+        static const size_t PacketSize = 4;
+
+        struct Hit
+        {
+            float       distance;
+            float       u;              // Barycentric weights of the second and third vertex
+            float       v;
+            uint32_t    triangle;       // Index in the order given to Build, or NoHit
+        };
+
+        // PacketSize rays, one per lane. Lanes not in use can be given a maxDistance of 0.
+        struct RayPacket
+        {
+            float       originX[PacketSize];
+            float       originY[PacketSize];
+            float       originZ[PacketSize];
+            float       directionX[PacketSize];
+            float       directionY[PacketSize];
+            float       directionZ[PacketSize];
+            float       maxDistance[PacketSize];
+        };
+
+        struct Statistics
+        {
+            uint32_t    triangles;
+            uint32_t    nodes;
+            uint32_t    leaves;
+            uint32_t    maxDepth;
+        };
+
+        TriangleBVH() noexcept;
+
+        TriangleBVH(TriangleBVH&&) = default;
+        TriangleBVH& operator= (TriangleBVH&&) = default;
+
+        TriangleBVH(TriangleBVH const&) = delete;
+        TriangleBVH& operator= (TriangleBVH const&) = delete;
+
+        // 'indices' holds three vertex indices per triangle. Throws std::invalid_argument
+        // if one is out of range.
+        void Build(const DirectX::XMFLOAT3* positions, size_t vertexCount, const uint32_t* indices, size_t triangleCount);
+
+        // Finds the nearest hit closer than maxDistance. 'hit' is only written on a hit.
+        bool XM_CALLCONV Intersect(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, float maxDistance, Hit& hit) const;
+
+        // Traces the packet's rays together, so each node and triangle is loaded once for
+        // all of them; worthwhile when the rays are close together, such as neighboring
+        // pixels. Every lane of 'hits' is written; misses have triangle set to NoHit.
+        // Returns the number of rays that hit.
+        size_t IntersectPacket(const RayPacket& rays, Hit* hits) const;
+
+        const Statistics& GetStatistics() const { return m_stats; }
+
+    private:
+        struct Node
+        {
+            float       minX;
+            float       minY;
+            float       minZ;
+            uint32_t    first;      // A leaf's first triangle, or the left child; the right one follows it
+            float       maxX;
+            float       maxY;
+            float       maxZ;
+            uint32_t    count;      // Triangles in a leaf, 0 for an inner node
+        };
+
+        // Stored ready for the Moller-Trumbore test.
+        struct Triangle
+        {
+            DirectX::XMFLOAT3   v0;
+            DirectX::XMFLOAT3   edge1;
+            DirectX::XMFLOAT3   edge2;
+            uint32_t            index;
+        };
+
+        std::vector<Node>       m_nodes;
+        std::vector<Triangle>   m_triangles;
+        Statistics              m_stats;
+    };
+}
@@ -0,0 +1,113 @@
+//
+// WorkerPool.cpp
+//
+
+#include "pch.h"
+#include "WorkerPool.h"
+
+using namespace DX;
+
+WorkerPool::WorkerPool(unsigned int workerCount) noexcept(false) :
+    m_workerCount(std::max(1u, workerCount)),
+    m_job(nullptr),
+    m_generation(0),
+    m_pending(0),
+    m_exit(false)
+{
+    for (unsigned int worker = 1; worker < m_workerCount; ++worker)
+    {
+        m_threads.emplace_back(&WorkerPool::WorkerProc, this, worker);
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_exit = true;
+    }
+    m_start.notify_all();
+
+    for (auto& thread : m_threads)
+    {
+        thread.join();
+    }
+}
+
+void WorkerPool::Run(const Job& job)
+{
+    if (m_threads.empty())
+    {
+        job(0);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_job = &job;
+        m_pending = m_threads.size();
+        m_error = nullptr;
+        ++m_generation;
+    }
+    m_start.notify_all();
+
+    std::exception_ptr error;
+    try
+    {
+        job(0);
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this] { return m_pending == 0; });
+        m_job = nullptr;
+        if (!error)
+            error = m_error;
+    }
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
+void WorkerPool::WorkerProc(unsigned int worker)
+{
+    uint64_t lastGeneration = 0;
+
+    for (;;)
+    {
+        const Job* job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_start.wait(lock, [&] { return m_exit || m_generation != lastGeneration; });
+            if (m_exit)
+                return;
+            lastGeneration = m_generation;
+            job = m_job;
+        }
+
+        std::exception_ptr error;
+        try
+        {
+            (*job)(worker);
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+
+        bool last;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (error && !m_error)
+                m_error = error;
+            last = (--m_pending == 0);
+        }
+
+        if (last)
+            m_done.notify_one();
+    }
+}
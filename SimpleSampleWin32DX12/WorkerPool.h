@@ -0,0 +1,51 @@
+//
+// WorkerPool.h - Runs a job on a fixed set of threads and waits for all of them
+//
+
+#pragma once
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+namespace DX
+{
+    // Keeps workerCount - 1 threads parked between jobs. Run wakes them, runs the same job on
+    // each of them and on the calling thread as worker 0, and returns once every worker has
+    // finished, so the job can split its work by worker index without any further locking.
+    class WorkerPool
+    {
+    public:
+        typedef std::function<void(unsigned int worker)> Job;
+
+        // 'workerCount' includes the calling thread; 0 is treated as 1.
+        explicit WorkerPool(unsigned int workerCount) noexcept(false);
+        ~WorkerPool();
+
+        WorkerPool(WorkerPool const&) = delete;
+        WorkerPool& operator= (WorkerPool const&) = delete;
+
+        unsigned int GetWorkerCount() const { return m_workerCount; }
+
+        // Exceptions thrown by the job are rethrown here once all workers have finished.
+        void Run(const Job& job);
+
+    private:
+        void WorkerProc(unsigned int worker);
+
+        unsigned int                m_workerCount;
+        std::vector<std::thread>    m_threads;
+        std::mutex                  m_mutex;
+        std::condition_variable     m_start;
+        std::condition_variable     m_done;
+        const Job*                  m_job;
+        uint64_t                    m_generation;
+        size_t                      m_pending;
+        bool                        m_exit;
+        std::exception_ptr          m_error;
+    };
+}
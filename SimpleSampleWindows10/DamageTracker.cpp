@@ -0,0 +1,270 @@
+//
+// DamageTracker.cpp
+//
+
+#include "pch.h"
+#include "DamageTracker.h"
+
+using namespace DX;
+
+const float DamageTracker::c_defaultFullFrameCoverage = 0.6f;
+const size_t DamageTracker::c_defaultMaxRects = 16;
+
+namespace
+{
+    // Past this many rectangles in a frame, each new one is folded into an existing one, which
+    // bounds the cost of MergeRects no matter how much is submitted.
+    const size_t c_maxPendingRects = 32;
+
+    inline bool IsEmpty(const RECT& rect)
+    {
+        return rect.right <= rect.left || rect.bottom <= rect.top;
+    }
+
+    inline int64_t Area(const RECT& rect)
+    {
+        return int64_t(rect.right - rect.left) * int64_t(rect.bottom - rect.top);
+    }
+
+    inline RECT Union(const RECT& a, const RECT& b)
+    {
+        RECT result = { std::min(a.left, b.left), std::min(a.top, b.top), std::max(a.right, b.right), std::max(a.bottom, b.bottom) };
+        return result;
+    }
+
+    // Pixels the bounding rectangle of a and b covers that neither of them does.
+    inline int64_t MergeCost(const RECT& a, const RECT& b)
+    {
+        int64_t overlap = 0;
+        LONG width = std::min(a.right, b.right) - std::max(a.left, b.left);
+        LONG height = std::min(a.bottom, b.bottom) - std::max(a.top, b.top);
+        if (width > 0 && height > 0)
+        {
+            overlap = int64_t(width) * int64_t(height);
+        }
+        return Area(Union(a, b)) - Area(a) - Area(b) + overlap;
+    }
+}
+
+DamageTracker::DamageTracker(unsigned int bufferCount, size_t maxRects, float fullFrameCoverage) noexcept(false) :
+    m_maxRects(maxRects),
+    m_fullFrameCoverage(fullFrameCoverage),
+    m_bounds{},
+    m_historyIndex(0),
+    m_redrawBounds{},
+    m_fullFrame(true)
+{
+    if (!bufferCount || !maxRects)
+        throw std::invalid_argument("DamageTracker needs at least one buffer and one rectangle");
+
+    m_history.resize(bufferCount - 1);
+    m_pending.reserve(c_maxPendingRects);
+}
+
+void DamageTracker::Reset(LONG width, LONG height)
+{
+    m_bounds.left = m_bounds.top = 0;
+    m_bounds.right = std::max(width, 0L);
+    m_bounds.bottom = std::max(height, 0L);
+
+    InvalidateAll();
+}
+
+void DamageTracker::InvalidateAll()
+{
+    for (auto& frame : m_history)
+    {
+        frame.assign(1, m_bounds);
+    }
+
+    m_pending.assign(1, m_bounds);
+}
+
+void DamageTracker::AddDirtyRect(const RECT& rect)
+{
+    RECT clipped = { std::max(rect.left, m_bounds.left), std::max(rect.top, m_bounds.top), std::min(rect.right, m_bounds.right), std::min(rect.bottom, m_bounds.bottom) };
+    if (IsEmpty(clipped))
+        return;
+
+    // Consecutive submissions are often the same rectangle, or neighbours such as the glyphs
+    // of a line of text, which merge with the previous one for free.
+    if (!m_pending.empty() && MergeCost(m_pending.back(), clipped) <= 0)
+    {
+        m_pending.back() = Union(m_pending.back(), clipped);
+        return;
+    }
+
+    if (m_pending.size() < c_maxPendingRects)
+    {
+        m_pending.push_back(clipped);
+        return;
+    }
+
+    auto best = m_pending.begin();
+    int64_t bestCost = INT64_MAX;
+    for (auto it = m_pending.begin(); it != m_pending.end(); ++it)
+    {
+        int64_t cost = MergeCost(*it, clipped);
+        if (cost < bestCost)
+        {
+            bestCost = cost;
+            best = it;
+        }
+    }
+    *best = Union(*best, clipped);
+}
+
+void DamageTracker::Resolve()
+{
+    uint64_t fullArea = uint64_t(Area(m_bounds));
+    uint64_t fullFrameArea = uint64_t(double(fullArea) * m_fullFrameCoverage);
+
+    MergeRects(m_pending, m_maxRects);
+    if (!m_pending.empty() && GetCoverage(m_pending) >= fullFrameArea)
+    {
+        m_pending.assign(1, m_bounds);
+    }
+
+    m_redraw = m_pending;
+    for (auto& frame : m_history)
+    {
+        m_redraw.insert(m_redraw.end(), frame.begin(), frame.end());
+    }
+    MergeRects(m_redraw, m_maxRects);
+
+    m_fullFrame = !m_redraw.empty() && GetCoverage(m_redraw) >= fullFrameArea;
+    if (m_fullFrame)
+    {
+        m_redraw.assign(1, m_bounds);
+        m_present.clear();
+    }
+    else if (m_pending.empty())
+    {
+        // Present1 treats no dirty rectangles as the whole buffer, so an unchanged frame names
+        // a single pixel instead.
+        RECT pixel = { m_bounds.left, m_bounds.top, m_bounds.left + 1, m_bounds.top + 1 };
+        m_present.assign(1, pixel);
+    }
+    else
+    {
+        m_present = m_pending;
+    }
+
+    m_redrawBounds = RECT{};
+    if (!m_redraw.empty())
+    {
+        m_redrawBounds = m_redraw.front();
+        for (auto& rect : m_redraw)
+        {
+            m_redrawBounds = Union(m_redrawBounds, rect);
+        }
+    }
+
+    if (!m_history.empty())
+    {
+        m_history[m_historyIndex].swap(m_pending);
+        m_historyIndex = (m_historyIndex + 1) % m_history.size();
+    }
+    m_pending.clear();
+}
+
+uint64_t DamageTracker::GetCoverage(const std::vector<RECT>& rects) const
+{
+    // Overlaps are counted twice, which only makes a full frame more likely.
+    uint64_t area = 0;
+    for (auto& rect : rects)
+    {
+        area += uint64_t(Area(rect));
+    }
+    return area;
+}
+
+void DamageTracker::MergeRects(std::vector<RECT>& rects, size_t maxRects)
+{
+    rects.erase(std::remove_if(rects.begin(), rects.end(), IsEmpty), rects.end());
+
+    size_t count = rects.size();
+    if (count < 2)
+        return;
+
+    // Greedy: merge the pair whose bounding rectangle adds the fewest pixels until few enough
+    // are left. Pairs that add nothing (one inside the other, or neighbours that together form
+    // a rectangle) are always merged. Each rectangle caches its cheapest partner, so a merge
+    // only rescans the rectangles that were paired with one of the two it consumed.
+    std::vector<int64_t> bestCost(count);
+    std::vector<size_t> bestPartner(count);
+    std::vector<bool> alive(count, true);
+
+    auto findPartner = [&](size_t i)
+    {
+        bestCost[i] = INT64_MAX;
+        bestPartner[i] = i;
+        for (size_t j = 0; j < count; ++j)
+        {
+            if (j != i && alive[j])
+            {
+                int64_t cost = MergeCost(rects[i], rects[j]);
+                if (cost < bestCost[i])
+                {
+                    bestCost[i] = cost;
+                    bestPartner[i] = j;
+                }
+            }
+        }
+    };
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        findPartner(i);
+    }
+
+    for (size_t remaining = count; remaining > 1; --remaining)
+    {
+        size_t a = count;
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (alive[i] && (a == count || bestCost[i] < bestCost[a]))
+            {
+                a = i;
+            }
+        }
+
+        if (bestCost[a] > 0 && remaining <= maxRects)
+            break;
+
+        size_t b = bestPartner[a];
+        rects[a] = Union(rects[a], rects[b]);
+        alive[b] = false;
+
+        findPartner(a);
+        for (size_t k = 0; k < count; ++k)
+        {
+            if (!alive[k] || k == a)
+                continue;
+
+            if (bestPartner[k] == a || bestPartner[k] == b)
+            {
+                findPartner(k);
+            }
+            else
+            {
+                int64_t cost = MergeCost(rects[k], rects[a]);
+                if (cost < bestCost[k])
+                {
+                    bestCost[k] = cost;
+                    bestPartner[k] = a;
+                }
+            }
+        }
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (alive[i])
+        {
+            rects[kept++] = rects[i];
+        }
+    }
+    rects.resize(kept);
+}
@@ -0,0 +1,84 @@
+//
+// DamageTracker.h - Accumulates changed screen rectangles for partial redraw and Present1
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace DX
+{
+    // Collects the rectangles of the back buffer that changed this frame and turns them into
+    // a small set to redraw and a small set to hand to Present1 as dirty rectangles.
+    //
+    // With the sequential flip model the back buffer being drawn still holds the frame that
+    // was presented bufferCount frames ago, so the redraw region is this frame's damage plus
+    // that of the previous bufferCount - 1 frames. The dirty rectangles only describe what
+    // changed since the last Present.
+    class DamageTracker
+    {
+    public:
+        // Damage covering more than this fraction of the target is treated as a full frame.
+        static const float c_defaultFullFrameCoverage;
+
+        // Present1 copies every dirty rectangle it is given, so the sets are kept this small.
+        static const size_t c_defaultMaxRects;
+
+        DamageTracker(unsigned int bufferCount, size_t maxRects = c_defaultMaxRects, float fullFrameCoverage = c_defaultFullFrameCoverage) noexcept(false);
+
+        DamageTracker(DamageTracker const&) = delete;
+        DamageTracker& operator= (DamageTracker const&) = delete;
+
+        // Sets the target size and damages all of it, for new or resized buffers.
+        void Reset(LONG width, LONG height);
+
+        // Damages the whole target for the next bufferCount frames.
+        void InvalidateAll();
+
+        // Marks part of the target as changed this frame. Clipped to the target.
+        void AddDirtyRect(const RECT& rect);
+
+        // Call once per frame after all damage is added and before drawing.
+        void Resolve();
+
+        // After Resolve: everything must be drawn, and presented without dirty rectangles.
+        bool IsFullFrame() const                            { return m_fullFrame; }
+
+        // After Resolve: the areas that must be drawn again.
+        const std::vector<RECT>& GetRedrawRects() const     { return m_redraw; }
+
+        // After Resolve: the bounding rectangle of the redraw rectangles, or an empty one. Only
+        // the first scissor rectangle applies unless a geometry shader picks another, so this is
+        // what to clear and scissor against; redrawing an area that did not change is harmless
+        // once it has been cleared.
+        const RECT& GetRedrawBounds() const                 { return m_redrawBounds; }
+
+        // After Resolve: the dirty rectangles for Present1. Empty for a full frame.
+        const std::vector<RECT>& GetPresentRects() const    { return m_present; }
+
+        // Replaces 'rects' with at most 'maxRects' rectangles that cover all of them, choosing
+        // each merge to add as little area as possible. Empty rectangles are dropped.
+        static void MergeRects(std::vector<RECT>& rects, size_t maxRects);
+
+    private:
+        uint64_t GetCoverage(const std::vector<RECT>& rects) const;
+
+        size_t                          m_maxRects;
+        float                           m_fullFrameCoverage;
+        RECT                            m_bounds;
+
+        // This frame's damage, merged down whenever it grows past c_maxPendingRects.
+        std::vector<RECT>               m_pending;
+
+        // Merged damage of the previous bufferCount - 1 frames, oldest overwritten first.
+        std::vector<std::vector<RECT>>  m_history;
+        size_t                          m_historyIndex;
+
+        std::vector<RECT>               m_redraw;
+        RECT                            m_redrawBounds;
+        std::vector<RECT>               m_present;
+        bool                            m_fullFrame;
+    };
+}
@@ -267,6 +267,19 @@ void DeviceResources::CreateDeviceResources()
 
     ThrowIfFailed(device.As(&m_d3dDevice));
     ThrowIfFailed(context.As(&m_d3dContext));
+
+    // Partial presentation redraws only the dirty rectangles, which needs ClearView to clear them.
+    if (m_options & c_PartialPresent)
+    {
+        D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+        if (FAILED(m_d3dDevice->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options))) || !options.ClearView)
+        {
+            m_options &= ~c_PartialPresent;
+#ifdef _DEBUG
+            OutputDebugStringA("WARNING: ClearView not supported, partial presentation disabled\n");
+#endif
+        }
+    }
 }
 
 // These resources need to be recreated every time the window size is changed.
@@ -333,7 +346,9 @@ void DeviceResources::CreateWindowSizeDependentResources()
         swapChainDesc.SampleDesc.Count = 1;
         swapChainDesc.SampleDesc.Quality = 0;
         swapChainDesc.Scaling = DXGI_SCALING_ASPECT_RATIO_STRETCH;
-        swapChainDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
+        // Dirty rectangles promise that the rest of the back buffer still holds what was last
+        // presented from it, which only the sequential flip model preserves.
+        swapChainDesc.SwapEffect = (m_options & c_PartialPresent) ? DXGI_SWAP_EFFECT_FLIP_SEQUENTIAL : DXGI_SWAP_EFFECT_FLIP_DISCARD;
         swapChainDesc.AlphaMode = DXGI_ALPHA_MODE_IGNORE;
         swapChainDesc.Flags = (m_options & c_AllowTearing) ? DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING : 0;
 
@@ -549,27 +564,63 @@ void DeviceResources::Trim()
     }
 }
 
-// Present the contents of the swap chain to the screen.
-void DeviceResources::Present() 
+// Returns the video memory the process is using, local and non-local, or 0 if it cannot be queried.
+UINT64 DeviceResources::GetVideoMemoryUsage() const
 {
+    ComPtr<IDXGIDevice3> dxgiDevice;
+    ComPtr<IDXGIAdapter> adapter;
+    ComPtr<IDXGIAdapter3> adapter3;
+    if (FAILED(m_d3dDevice.As(&dxgiDevice))
+        || FAILED(dxgiDevice->GetAdapter(adapter.GetAddressOf()))
+        || FAILED(adapter.As(&adapter3)))
+    {
+        return 0;
+    }
+
+    UINT64 usage = 0;
+    for (auto group : { DXGI_MEMORY_SEGMENT_GROUP_LOCAL, DXGI_MEMORY_SEGMENT_GROUP_NON_LOCAL })
+    {
+        DXGI_QUERY_VIDEO_MEMORY_INFO info = {};
+        if (SUCCEEDED(adapter3->QueryVideoMemoryInfo(0, group, &info)))
+        {
+            usage += info.CurrentUsage;
+        }
+    }
+    return usage;
+}
+
+// Present the contents of the swap chain to the screen. With c_PartialPresent, the dirty
+// rectangles list everything that changed since the last Present; none means the whole buffer.
+void DeviceResources::Present(const RECT* dirtyRects, UINT dirtyRectCount) 
+{
+    DXGI_PRESENT_PARAMETERS parameters = {};
+    if (m_options & c_PartialPresent)
+    {
+        parameters.DirtyRectsCount = dirtyRectCount;
+        parameters.pDirtyRects = const_cast<RECT*>(dirtyRects);
+    }
+
     HRESULT hr;
     if (m_options & c_AllowTearing)
     {
         // Recommended to always use tearing if supported when using a sync interval of 0.
-        hr = m_swapChain->Present(0, DXGI_PRESENT_ALLOW_TEARING);
+        hr = m_swapChain->Present1(0, DXGI_PRESENT_ALLOW_TEARING, &parameters);
     }
     else
     {
         // The first argument instructs DXGI to block until VSync, putting the application
         // to sleep until the next VSync. This ensures we don't waste any cycles rendering
         // frames that will never be displayed to the screen.
-        hr = m_swapChain->Present(1, 0);
+        hr = m_swapChain->Present1(1, 0, &parameters);
     }
 
-    // Discard the contents of the render target.
-    // This is a valid operation only when the existing contents will be entirely
-    // overwritten. If dirty or scroll rects are used, this call should be removed.
-    m_d3dContext->DiscardView(m_d3dRenderTargetView.Get());
+    if (!(m_options & c_PartialPresent))
+    {
+        // Discard the contents of the render target.
+        // This is a valid operation only when the existing contents will be entirely
+        // overwritten. If dirty or scroll rects are used, this call should be removed.
+        m_d3dContext->DiscardView(m_d3dRenderTargetView.Get());
+    }
 
     if (m_d3dDepthStencilView)
     {
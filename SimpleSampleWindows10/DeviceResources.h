@@ -19,6 +19,7 @@ namespace DX
     public:
         static const unsigned int c_AllowTearing    = 0x1;
         static const unsigned int c_EnableHDR       = 0x2;
+        static const unsigned int c_PartialPresent  = 0x4;
 
         DeviceResources(DXGI_FORMAT backBufferFormat = DXGI_FORMAT_B8G8R8A8_UNORM,
                         DXGI_FORMAT depthBufferFormat = DXGI_FORMAT_D24_UNORM_S8_UINT,
@@ -34,7 +35,8 @@ namespace DX
         void HandleDeviceLost();
         void RegisterDeviceNotify(IDeviceNotify* deviceNotify) { m_deviceNotify = deviceNotify; }
         void Trim();
-        void Present();
+        UINT64 GetVideoMemoryUsage() const;
+        void Present(const RECT* dirtyRects = nullptr, UINT dirtyRectCount = 0);
 
         // Device Accessors.
         RECT GetOutputSize() const             { return m_outputSize; }
@@ -0,0 +1,40 @@
+//
+// DynamicBufferRing.cpp
+//
+
+#include "pch.h"
+#include "DynamicBufferRing.h"
+
+using namespace DX;
+
+DynamicBufferRing::DynamicBufferRing(ID3D11Device* device, size_t capacity, UINT bindFlags) noexcept(false) :
+    m_allocator(capacity)
+{
+    if (!device || !capacity || capacity > UINT32_MAX)
+        throw std::invalid_argument("DynamicBufferRing needs a device and a capacity that fits in a buffer");
+
+    D3D11_BUFFER_DESC desc = {};
+    desc.ByteWidth = static_cast<UINT>(capacity);
+    desc.Usage = D3D11_USAGE_DYNAMIC;
+    desc.BindFlags = bindFlags;
+    desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+    DX::ThrowIfFailed(device->CreateBuffer(&desc, nullptr, m_buffer.ReleaseAndGetAddressOf()));
+}
+
+void* DynamicBufferRing::Map(ID3D11DeviceContext* context, size_t size, size_t alignment, size_t& offset)
+{
+    bool discard;
+    if (!m_allocator.Allocate(size, alignment, offset, discard))
+        throw std::out_of_range("DynamicBufferRing allocation is larger than the buffer");
+
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    DX::ThrowIfFailed(context->Map(m_buffer.Get(), 0, discard ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE, 0, &mapped));
+
+    return static_cast<uint8_t*>(mapped.pData) + offset;
+}
+
+void DynamicBufferRing::Unmap(ID3D11DeviceContext* context)
+{
+    context->Unmap(m_buffer.Get(), 0);
+}
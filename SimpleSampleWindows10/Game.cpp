@@ -12,10 +12,145 @@ using namespace DirectX::SimpleMath;
 
 using Microsoft::WRL::ComPtr;
 
-Game::Game() noexcept(false)
+namespace
 {
-    m_deviceResources = std::make_unique<DX::DeviceResources>();
+    // Record the scene on deferred contexts from worker threads. When false, everything is
+    // drawn on the immediate context by the render thread.
+    const bool c_deferredRendering = true;
+
+    // Room for every dynamic vertex drawn in a frame; running out only costs an extra discard.
+    const size_t c_dynamicVertexBytes = 1024 * 1024;
+
+    // Approximate size of a 2D texture and its mips, for reporting what a trim released.
+    size_t GetTextureBytes(ID3D11ShaderResourceView* view)
+    {
+        if (!view)
+            return 0;
+
+        ComPtr<ID3D11Resource> resource;
+        view->GetResource(resource.GetAddressOf());
+
+        ComPtr<ID3D11Texture2D> texture;
+        if (FAILED(resource.As(&texture)))
+            return 0;
+
+        D3D11_TEXTURE2D_DESC desc;
+        texture->GetDesc(&desc);
+
+        size_t blockBytes = 0;
+        size_t pixelBytes = 4;
+        switch (desc.Format)
+        {
+        case DXGI_FORMAT_BC1_TYPELESS:
+        case DXGI_FORMAT_BC1_UNORM:
+        case DXGI_FORMAT_BC1_UNORM_SRGB:
+        case DXGI_FORMAT_BC4_TYPELESS:
+        case DXGI_FORMAT_BC4_UNORM:
+        case DXGI_FORMAT_BC4_SNORM:
+            blockBytes = 8;
+            break;
+
+        case DXGI_FORMAT_BC2_TYPELESS:
+        case DXGI_FORMAT_BC2_UNORM:
+        case DXGI_FORMAT_BC2_UNORM_SRGB:
+        case DXGI_FORMAT_BC3_TYPELESS:
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC3_UNORM_SRGB:
+        case DXGI_FORMAT_BC5_TYPELESS:
+        case DXGI_FORMAT_BC5_UNORM:
+        case DXGI_FORMAT_BC5_SNORM:
+        case DXGI_FORMAT_BC6H_TYPELESS:
+        case DXGI_FORMAT_BC6H_UF16:
+        case DXGI_FORMAT_BC6H_SF16:
+        case DXGI_FORMAT_BC7_TYPELESS:
+        case DXGI_FORMAT_BC7_UNORM:
+        case DXGI_FORMAT_BC7_UNORM_SRGB:
+            blockBytes = 16;
+            break;
+
+        case DXGI_FORMAT_R8_UNORM:
+        case DXGI_FORMAT_A8_UNORM:
+            pixelBytes = 1;
+            break;
+
+        case DXGI_FORMAT_R8G8_UNORM:
+        case DXGI_FORMAT_B5G6R5_UNORM:
+        case DXGI_FORMAT_B5G5R5A1_UNORM:
+        case DXGI_FORMAT_B4G4R4A4_UNORM:
+            pixelBytes = 2;
+            break;
+
+        case DXGI_FORMAT_R16G16B16A16_FLOAT:
+        case DXGI_FORMAT_R16G16B16A16_UNORM:
+            pixelBytes = 8;
+            break;
+
+        case DXGI_FORMAT_R32G32B32A32_FLOAT:
+            pixelBytes = 16;
+            break;
+
+        default:
+            break;
+        }
+
+        size_t bytes = 0;
+        for (UINT mip = 0; mip < desc.MipLevels; ++mip)
+        {
+            size_t width = std::max<size_t>(1, desc.Width >> mip);
+            size_t height = std::max<size_t>(1, desc.Height >> mip);
+            bytes += blockBytes
+                ? ((width + 3) / 4) * ((height + 3) / 4) * blockBytes
+                : width * height * pixelBytes;
+        }
+        return bytes * desc.ArraySize;
+    }
+
+    // Vertex and index buffer bytes of a model. Parts of a mesh often share buffers.
+    size_t GetModelBufferBytes(const Model& model)
+    {
+        std::vector<ID3D11Buffer*> buffers;
+        for (auto& mesh : model.meshes)
+        {
+            for (auto& part : mesh->meshParts)
+            {
+                for (auto buffer : { part->vertexBuffer.Get(), part->indexBuffer.Get() })
+                {
+                    if (buffer && std::find(buffers.begin(), buffers.end(), buffer) == buffers.end())
+                    {
+                        buffers.push_back(buffer);
+                    }
+                }
+            }
+        }
+
+        size_t bytes = 0;
+        for (auto buffer : buffers)
+        {
+            D3D11_BUFFER_DESC desc;
+            buffer->GetDesc(&desc);
+            bytes += desc.ByteWidth;
+        }
+        return bytes;
+    }
+}
+
+Game::Game() noexcept(false) :
+    m_teapotRect{},
+    m_modelRect{}
+{
+    // Most of the scene is static, so only the parts that change are redrawn and presented.
+    m_deviceResources = std::make_unique<DX::DeviceResources>(DXGI_FORMAT_B8G8R8A8_UNORM, DXGI_FORMAT_D24_UNORM_S8_UINT, 2,
+        D3D_FEATURE_LEVEL_9_3, DX::DeviceResources::c_PartialPresent);
     m_deviceResources->RegisterDeviceNotify(this);
+
+    m_workers = std::make_unique<DX::WorkerPool>(DX::WorkerPool::GetDefaultWorkerCount());
+
+    m_sceneRenderer = std::make_unique<DX::DeferredRenderer>(c_deferredRendering ? m_workers.get() : nullptr);
+
+    m_damage = std::make_unique<DX::DamageTracker>(m_deviceResources->GetBackBufferCount());
+
+    m_trimmer = std::make_unique<DX::MemoryTrimmer>();
+    RegisterTrimTargets();
 }
 
 // Initialize the Direct3D resources required to run.
@@ -49,12 +184,9 @@ void Game::Initialize(IUnknown* window, int width, int height, DXGI_MODE_ROTATIO
     m_audioTimerAcc = 10.f;
     m_retryDefault = false;
 
-    m_waveBank = std::make_unique<WaveBank>(m_audEngine.get(), L"assets\\adpcmdroid.xwb");
-    m_soundEffect = std::make_unique<SoundEffect>(m_audEngine.get(), L"assets\\MusicMono_adpcm.wav");
-    m_effect1 = m_soundEffect->CreateInstance();
-    m_effect2 = m_waveBank->CreateInstance(10);
+    LoadSoundBank();
 
-    m_effect1->Play(true);
+    LoadMusic();
     m_effect2->Play();
 }
 
@@ -67,6 +199,9 @@ void Game::Tick()
         Update(m_timer);
     });
 
+    // The music loops, so it is needed as soon as the app is running again.
+    m_trimmer->Restore(m_trimTargets[TrimTarget_Music]);
+
     // Only update audio engine once per frame
     if (!m_audEngine->IsCriticalError() && m_audEngine->Update())
     {
@@ -90,6 +225,13 @@ void Game::Update(DX::StepTimer const& timer)
 
     m_world = Matrix::CreateRotationY(float(timer.GetTotalSeconds() * XM_PIDIV4));
 
+    m_teapotWorld = m_world * Matrix::CreateTranslation(-2.f, -2.f, -4.f);
+
+    const XMVECTORF32 scale = { 0.01f, 0.01f, 0.01f };
+    const XMVECTORF32 translate = { 3.f, -2.f, -4.f };
+    XMVECTOR rotate = Quaternion::CreateFromYawPitchRoll(XM_PI / 2.f, 0.f, -XM_PI / 2.f);
+    m_modelWorld = m_world * XMMatrixTransformation(g_XMZero, Quaternion::Identity, scale, g_XMZero, rotate, translate);
+
     m_batchEffect->SetView(m_view);
     m_batchEffect->SetWorld(Matrix::Identity);
 
@@ -109,6 +251,7 @@ void Game::Update(DX::StepTimer const& timer)
         {
             m_audioTimerAcc = 4.f;
 
+            m_trimmer->Restore(m_trimTargets[TrimTarget_SoundBank]);
             m_waveBank->Play(m_audioEvent++);
 
             if (m_audioEvent >= 11)
@@ -145,47 +288,184 @@ void Game::Render()
         return;
     }
 
-    Clear();
-
-    auto context = m_deviceResources->GetD3DDeviceContext();
-    PIXBeginEvent(context, PIX_COLOR_DEFAULT, L"Render");
+    // Everything drawn every frame comes back on the first frame after resuming.
+    for (auto target : { TrimTarget_DynamicVertices, TrimTarget_Font, TrimTarget_Textures, TrimTarget_Model })
+    {
+        m_trimmer->Restore(m_trimTargets[target]);
+    }
 
-    // Draw procedurally generated dynamic grid
-    const XMVECTORF32 xaxis = { 20.f, 0.f, 0.f };
-    const XMVECTORF32 yaxis = { 0.f, 0.f, 20.f };
-    DrawGrid(xaxis, yaxis, g_XMZero, 20, 20, Colors::Gray);
+    UpdateDamage();
 
-    // Draw sprite
-    PIXBeginEvent(context, PIX_COLOR_DEFAULT, L"Draw sprite");
-    m_sprites->Begin();
-    m_sprites->Draw(m_texture2.Get(), XMFLOAT2(10, 75), nullptr, Colors::White);
+    Clear();
 
-    m_font->DrawString(m_sprites.get(), L"DirectXTK Simple Sample", XMFLOAT2(100, 10), Colors::Yellow);
-    m_sprites->End();
-    PIXEndEvent(context);
+    m_dynamicVertices->BeginFrame();
 
-    // Draw 3D object
-    PIXBeginEvent(context, PIX_COLOR_DEFAULT, L"Draw teapot");
-    XMMATRIX local = m_world * Matrix::CreateTranslation(-2.f, -2.f, -4.f);
-    m_shape->Draw(local, m_view, m_projection, Colors::White, m_texture1.Get());
-    PIXEndEvent(context);
+    auto context = m_deviceResources->GetD3DDeviceContext();
+    PIXBeginEvent(context, PIX_COLOR_DEFAULT, L"Render");
 
-    PIXBeginEvent(context, PIX_COLOR_DEFAULT, L"Draw model");
-    const XMVECTORF32 scale = { 0.01f, 0.01f, 0.01f };
-    const XMVECTORF32 translate = { 3.f, -2.f, -4.f };
-    XMVECTOR rotate = Quaternion::CreateFromYawPitchRoll(XM_PI / 2.f, 0.f, -XM_PI / 2.f);
-    local = m_world * XMMatrixTransformation(g_XMZero, Quaternion::Identity, scale, g_XMZero, rotate, translate);
-    m_model->Draw(context, *m_states, local, m_view, m_projection);
-    PIXEndEvent(context);
+    m_sceneRenderer->Render([this](size_t chunk, ID3D11DeviceContext* chunkContext)
+    {
+        RenderChunk(chunk, chunkContext);
+    });
 
     PIXEndEvent(context);
 
     // Show the new frame.
     PIXBeginEvent(PIX_COLOR_DEFAULT, L"Present");
-    m_deviceResources->Present();
+    auto& dirtyRects = m_damage->GetPresentRects();
+    m_deviceResources->Present(dirtyRects.data(), static_cast<UINT>(dirtyRects.size()));
     PIXEndEvent();
 }
 
+// Works out which parts of the back buffer must be redrawn this frame. Only the teapot and
+// the model move; the grid, sprite and text are covered when everything is invalidated.
+void Game::UpdateDamage()
+{
+    if (!(m_deviceResources->GetDeviceOptions() & DX::DeviceResources::c_PartialPresent))
+    {
+        m_damage->InvalidateAll();
+    }
+
+    // A moving object damages both where it was and where it is now.
+    RECT teapotRect = GetScreenBounds(m_teapotBounds, m_teapotWorld);
+    m_damage->AddDirtyRect(m_teapotRect);
+    m_damage->AddDirtyRect(teapotRect);
+    m_teapotRect = teapotRect;
+
+    RECT modelRect = GetScreenBounds(m_modelBounds, m_modelWorld);
+    m_damage->AddDirtyRect(m_modelRect);
+    m_damage->AddDirtyRect(modelRect);
+    m_modelRect = modelRect;
+
+    m_damage->Resolve();
+}
+
+// Returns a back buffer rectangle that contains everything inside 'bounds' once transformed.
+RECT XM_CALLCONV Game::GetScreenBounds(const BoundingSphere& bounds, FXMMATRIX world) const
+{
+    auto viewport = m_deviceResources->GetScreenViewport();
+    RECT screen = { 0, 0, static_cast<LONG>(viewport.Width), static_cast<LONG>(viewport.Height) };
+
+    BoundingSphere sphere;
+    bounds.Transform(sphere, world);
+
+    XMMATRIX viewProjection = XMMatrixMultiply(m_view, m_projection);
+    XMVECTOR center = XMLoadFloat3(&sphere.Center);
+    XMVECTOR radius = XMVectorReplicate(sphere.Radius);
+
+    XMVECTOR minimum = g_XMOne;
+    XMVECTOR maximum = g_XMNegativeOne;
+    for (unsigned int corner = 0; corner < 8; ++corner)
+    {
+        XMVECTOR sign = XMVectorSet((corner & 1) ? 1.f : -1.f, (corner & 2) ? 1.f : -1.f, (corner & 4) ? 1.f : -1.f, 0.f);
+        XMVECTOR clip = XMVector3Transform(XMVectorMultiplyAdd(sign, radius, center), viewProjection);
+
+        // Anything reaching behind the camera can cover any part of the screen.
+        if (XMVectorGetW(clip) <= 0.f)
+            return screen;
+
+        XMVECTOR ndc = XMVectorDivide(clip, XMVectorSplatW(clip));
+        minimum = XMVectorMin(minimum, ndc);
+        maximum = XMVectorMax(maximum, ndc);
+    }
+
+    minimum = XMVectorClamp(minimum, g_XMNegativeOne, g_XMOne);
+    maximum = XMVectorClamp(maximum, g_XMNegativeOne, g_XMOne);
+
+    // Clip space y points up while back buffer rows go down. The extra pixel on each side
+    // covers rasterization rules and texture filtering at the edges.
+    RECT rect;
+    rect.left = static_cast<LONG>(floorf((XMVectorGetX(minimum) * 0.5f + 0.5f) * viewport.Width)) - 1;
+    rect.top = static_cast<LONG>(floorf((0.5f - XMVectorGetY(maximum) * 0.5f) * viewport.Height)) - 1;
+    rect.right = static_cast<LONG>(ceilf((XMVectorGetX(maximum) * 0.5f + 0.5f) * viewport.Width)) + 1;
+    rect.bottom = static_cast<LONG>(ceilf((0.5f - XMVectorGetY(minimum) * 0.5f) * viewport.Height)) + 1;
+    return rect;
+}
+
+// Swaps the rasterizer state DirectXTK just set for the same one with scissoring, so draws
+// stay inside the redraw rectangles.
+void Game::SetScissorState(ID3D11DeviceContext* context) const
+{
+    ComPtr<ID3D11RasterizerState> state;
+    context->RSGetState(state.GetAddressOf());
+
+    D3D11_RASTERIZER_DESC desc = {};
+    if (state)
+    {
+        state->GetDesc(&desc);
+    }
+    else
+    {
+        desc.CullMode = D3D11_CULL_BACK;
+    }
+
+    context->RSSetState(m_scissorStates[desc.CullMode - D3D11_CULL_NONE].Get());
+}
+
+// Records one chunk of the scene. This may run on a worker thread, so it only touches
+// objects that were created against 'context' or are never modified while rendering.
+void Game::RenderChunk(size_t chunk, ID3D11DeviceContext* context)
+{
+    if (m_sceneRenderer->IsDeferred())
+    {
+        // Deferred contexts start every command list from default state.
+        auto renderTarget = m_deviceResources->GetRenderTargetView();
+        context->OMSetRenderTargets(1, &renderTarget, m_deviceResources->GetDepthStencilView());
+
+        auto viewport = m_deviceResources->GetScreenViewport();
+        context->RSSetViewports(1, &viewport);
+
+        auto& redrawBounds = m_damage->GetRedrawBounds();
+        context->RSSetScissorRects(1, &redrawBounds);
+    }
+
+    switch (chunk)
+    {
+    case SceneChunk_Grid:
+    {
+        // Draw procedurally generated dynamic grid
+        const XMVECTORF32 xaxis = { 20.f, 0.f, 0.f };
+        const XMVECTORF32 yaxis = { 0.f, 0.f, 20.f };
+        DrawGrid(context, xaxis, yaxis, g_XMZero, 20, 20, Colors::Gray);
+        break;
+    }
+
+    case SceneChunk_Sprites:
+        // Draw sprite
+        PIXBeginEvent(context, PIX_COLOR_DEFAULT, L"Draw sprite");
+        m_sprites->Begin(SpriteSortMode_Deferred, nullptr, nullptr, nullptr, m_scissorStates[D3D11_CULL_BACK - D3D11_CULL_NONE].Get());
+        m_sprites->Draw(m_texture2.Get(), XMFLOAT2(10, 75), nullptr, Colors::White);
+
+        m_font->DrawString(m_sprites.get(), L"DirectXTK Simple Sample", XMFLOAT2(100, 10), Colors::Yellow);
+        m_sprites->End();
+        PIXEndEvent(context);
+        break;
+
+    case SceneChunk_Teapot:
+    {
+        // Draw 3D object
+        PIXBeginEvent(context, PIX_COLOR_DEFAULT, L"Draw teapot");
+        m_shape->Draw(m_teapotWorld, m_view, m_projection, Colors::White, m_texture1.Get(), false, [this, context]
+        {
+            SetScissorState(context);
+        });
+        PIXEndEvent(context);
+        break;
+    }
+
+    case SceneChunk_Model:
+    {
+        PIXBeginEvent(context, PIX_COLOR_DEFAULT, L"Draw model");
+        m_model->Draw(context, *m_states, m_modelWorld, m_view, m_projection, false, [this, context]
+        {
+            SetScissorState(context);
+        });
+        PIXEndEvent(context);
+        break;
+    }
+    }
+}
+
 // Helper method to clear the back buffers.
 void Game::Clear()
 {
@@ -196,35 +476,50 @@ void Game::Clear()
     auto renderTarget = m_deviceResources->GetRenderTargetView();
     auto depthStencil = m_deviceResources->GetDepthStencilView();
 
-    context->ClearRenderTargetView(renderTarget, Colors::CornflowerBlue);
+    // Only the redraw bounds are cleared; the rest of the back buffer is still current. The
+    // whole of it is drawn over, and blended sprites must not land on their old selves.
+    auto& redrawBounds = m_damage->GetRedrawBounds();
+    if (m_damage->IsFullFrame())
+    {
+        context->ClearRenderTargetView(renderTarget, Colors::CornflowerBlue);
+    }
+    else if (!m_damage->GetRedrawRects().empty())
+    {
+        // ClearView with no rectangles would clear the whole view.
+        context->ClearView(renderTarget, Colors::CornflowerBlue, &redrawBounds, 1);
+    }
     context->ClearDepthStencilView(depthStencil, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
     context->OMSetRenderTargets(1, &renderTarget, depthStencil);
 
-    // Set the viewport.
+    // Set the viewport and the scissor rectangle.
     auto viewport = m_deviceResources->GetScreenViewport();
     context->RSSetViewports(1, &viewport);
+    context->RSSetScissorRects(1, &redrawBounds);
 
     PIXEndEvent(context);
 }
 
-void XM_CALLCONV Game::DrawGrid(FXMVECTOR xAxis, FXMVECTOR yAxis, FXMVECTOR origin, size_t xdivs, size_t ydivs, GXMVECTOR color)
+void XM_CALLCONV Game::DrawGrid(ID3D11DeviceContext* context, FXMVECTOR xAxis, FXMVECTOR yAxis, FXMVECTOR origin, size_t xdivs, size_t ydivs, GXMVECTOR color)
 {
-    auto context = m_deviceResources->GetD3DDeviceContext();
     PIXBeginEvent(context, PIX_COLOR_DEFAULT, L"Draw grid");
 
     context->OMSetBlendState(m_states->Opaque(), nullptr, 0xFFFFFFFF);
     context->OMSetDepthStencilState(m_states->DepthNone(), 0);
-    context->RSSetState(m_states->CullCounterClockwise());
+    context->RSSetState(m_scissorStates[D3D11_CULL_BACK - D3D11_CULL_NONE].Get());
 
     m_batchEffect->Apply(context);
 
     context->IASetInputLayout(m_batchInputLayout.Get());
 
-    m_batch->Begin();
-
     xdivs = std::max<size_t>(1, xdivs);
     ydivs = std::max<size_t>(1, ydivs);
 
+    // Write the lines straight into the frame's ring; two vertices per line.
+    size_t vertexCount = (xdivs + ydivs + 2) * 2;
+
+    UINT startVertex;
+    auto vertices = m_dynamicVertices->MapVertices<VertexPositionColor>(context, vertexCount, startVertex);
+
     for (size_t i = 0; i <= xdivs; ++i)
     {
         float fPercent = float(i) / float(xdivs);
@@ -232,9 +527,8 @@ void XM_CALLCONV Game::DrawGrid(FXMVECTOR xAxis, FXMVECTOR yAxis, FXMVECTOR orig
         XMVECTOR vScale = XMVectorScale(xAxis, fPercent);
         vScale = XMVectorAdd(vScale, origin);
 
-        VertexPositionColor v1(XMVectorSubtract(vScale, yAxis), color);
-        VertexPositionColor v2(XMVectorAdd(vScale, yAxis), color);
-        m_batch->DrawLine(v1, v2);
+        *vertices++ = VertexPositionColor(XMVectorSubtract(vScale, yAxis), color);
+        *vertices++ = VertexPositionColor(XMVectorAdd(vScale, yAxis), color);
     }
 
     for (size_t i = 0; i <= ydivs; i++)
@@ -244,12 +538,19 @@ void XM_CALLCONV Game::DrawGrid(FXMVECTOR xAxis, FXMVECTOR yAxis, FXMVECTOR orig
         XMVECTOR vScale = XMVectorScale(yAxis, fPercent);
         vScale = XMVectorAdd(vScale, origin);
 
-        VertexPositionColor v1(XMVectorSubtract(vScale, xAxis), color);
-        VertexPositionColor v2(XMVectorAdd(vScale, xAxis), color);
-        m_batch->DrawLine(v1, v2);
+        *vertices++ = VertexPositionColor(XMVectorSubtract(vScale, xAxis), color);
+        *vertices++ = VertexPositionColor(XMVectorAdd(vScale, xAxis), color);
     }
 
-    m_batch->End();
+    m_dynamicVertices->Unmap(context);
+
+    auto vertexBuffer = m_dynamicVertices->GetBuffer();
+    UINT vertexStride = sizeof(VertexPositionColor);
+    UINT vertexOffset = 0;
+    context->IASetVertexBuffers(0, 1, &vertexBuffer, &vertexStride, &vertexOffset);
+    context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_LINELIST);
+
+    context->Draw(static_cast<UINT>(vertexCount), startVertex);
 
     PIXEndEvent(context);
 }
@@ -269,10 +570,25 @@ void Game::OnSuspending()
 {
     m_audEngine->Suspend();
 
+#ifdef _DEBUG
+    UINT64 videoMemory = m_deviceResources->GetVideoMemoryUsage();
+#endif
+
+    // Release whatever can be rebuilt. Nothing is restored on resume; each part comes back
+    // when it is next used.
+    m_trimmer->Trim();
+
     auto context = m_deviceResources->GetD3DDeviceContext();
     context->ClearState();
 
     m_deviceResources->Trim();
+
+#ifdef _DEBUG
+    char buff[128] = {};
+    sprintf_s(buff, "Suspend: trimmed %zu bytes, video memory %llu -> %llu bytes\n",
+        m_trimmer->GetStatistics().lastTrimBytes, videoMemory, m_deviceResources->GetVideoMemoryUsage());
+    OutputDebugStringA(buff);
+#endif
 }
 
 void Game::OnResuming()
@@ -282,6 +598,116 @@ void Game::OnResuming()
     m_audEngine->Resume();
 }
 
+// Each trim function returns what it released; each restore only rebuilds what is missing,
+// since a device loss while suspended recreates everything anyway.
+void Game::RegisterTrimTargets()
+{
+    m_trimTargets[TrimTarget_DynamicVertices] = m_trimmer->Register(L"Dynamic vertices", DX::MemoryTrimmer::Priority_Staging,
+        [this]() -> size_t
+        {
+            if (!m_dynamicVertices)
+                return 0;
+
+            size_t bytes = m_dynamicVertices->GetCapacity();
+            m_dynamicVertices.reset();
+            return bytes;
+        },
+        [this]()
+        {
+            if (!m_dynamicVertices)
+                m_dynamicVertices = std::make_unique<DX::DynamicBufferRing>(m_deviceResources->GetD3DDevice(), c_dynamicVertexBytes);
+        });
+
+    m_trimTargets[TrimTarget_Font] = m_trimmer->Register(L"Font", DX::MemoryTrimmer::Priority_Cache,
+        [this]() -> size_t
+        {
+            if (!m_font)
+                return 0;
+
+            ComPtr<ID3D11ShaderResourceView> spriteSheet;
+            m_font->GetSpriteSheet(spriteSheet.GetAddressOf());
+            size_t bytes = GetTextureBytes(spriteSheet.Get());
+            m_font.reset();
+            return bytes;
+        },
+        [this]()
+        {
+            if (!m_font)
+                LoadFont();
+        });
+
+    m_trimTargets[TrimTarget_Textures] = m_trimmer->Register(L"Textures", DX::MemoryTrimmer::Priority_Content,
+        [this]() -> size_t
+        {
+            size_t bytes = GetTextureBytes(m_texture1.Get()) + GetTextureBytes(m_texture2.Get());
+            m_texture1.Reset();
+            m_texture2.Reset();
+            return bytes;
+        },
+        [this]()
+        {
+            if (!m_texture1 || !m_texture2)
+                LoadTextures();
+        });
+
+    // The model's textures are held by its effects and the factory's cache; they are freed
+    // with it but only the buffers are counted.
+    m_trimTargets[TrimTarget_Model] = m_trimmer->Register(L"Model", DX::MemoryTrimmer::Priority_Content,
+        [this]() -> size_t
+        {
+            if (!m_model)
+                return 0;
+
+            size_t bytes = GetModelBufferBytes(*m_model);
+            m_model.reset();
+            m_fxFactory->ReleaseCache();
+            return bytes;
+        },
+        [this]()
+        {
+            if (!m_model)
+                LoadModel();
+        });
+
+    // Wave data can only be freed once no voice is reading it.
+    m_trimTargets[TrimTarget_SoundBank] = m_trimmer->Register(L"Sound bank", DX::MemoryTrimmer::Priority_Audio,
+        [this]() -> size_t
+        {
+            // The instance only holds a voice; it is recreated with the bank.
+            m_effect2.reset();
+            if (!m_waveBank || m_waveBank->IsInUse())
+                return 0;
+
+            size_t bytes = m_audEngine->GetStatistics().audioBytes;
+            m_waveBank.reset();
+            m_audEngine->TrimVoicePool();
+            return bytes - m_audEngine->GetStatistics().audioBytes;
+        },
+        [this]()
+        {
+            if (!m_waveBank || !m_effect2)
+                LoadSoundBank();
+        });
+
+    m_trimTargets[TrimTarget_Music] = m_trimmer->Register(L"Music", DX::MemoryTrimmer::Priority_Music,
+        [this]() -> size_t
+        {
+            if (!m_soundEffect)
+                return 0;
+
+            size_t bytes = m_audEngine->GetStatistics().audioBytes;
+            m_effect1.reset();
+            m_soundEffect.reset();
+            m_audEngine->TrimVoicePool();
+            return bytes - m_audEngine->GetStatistics().audioBytes;
+        },
+        [this]()
+        {
+            if (!m_soundEffect)
+                LoadMusic();
+        });
+}
+
 void Game::OnWindowSizeChanged(int width, int height, DXGI_MODE_ROTATION rotation)
 {
     if (!m_deviceResources->WindowSizeChanged(width, height, rotation))
@@ -323,11 +749,27 @@ void Game::CreateDeviceDependentResources()
 
     m_states = std::make_unique<CommonStates>(device);
 
+    for (UINT cullMode = D3D11_CULL_NONE; cullMode <= D3D11_CULL_BACK; ++cullMode)
+    {
+        // Matches CommonStates apart from ScissorEnable.
+        CD3D11_RASTERIZER_DESC desc(D3D11_DEFAULT);
+        desc.CullMode = static_cast<D3D11_CULL_MODE>(cullMode);
+        desc.ScissorEnable = TRUE;
+        desc.MultisampleEnable = TRUE;
+
+        DX::ThrowIfFailed(
+            device->CreateRasterizerState(&desc, m_scissorStates[cullMode - D3D11_CULL_NONE].ReleaseAndGetAddressOf())
+        );
+    }
+
     m_fxFactory = std::make_unique<EffectFactory>(device);
 
-    m_sprites = std::make_unique<SpriteBatch>(context);
+    // Objects a scene chunk draws with are bound to that chunk's context.
+    m_sceneRenderer->CreateDeviceDependentResources(device, context, SceneChunk_Count);
 
-    m_batch = std::make_unique<PrimitiveBatch<VertexPositionColor>>(context);
+    m_sprites = std::make_unique<SpriteBatch>(m_sceneRenderer->GetContext(SceneChunk_Sprites));
+
+    m_dynamicVertices = std::make_unique<DX::DynamicBufferRing>(device, c_dynamicVertexBytes);
 
     m_batchEffect = std::make_unique<BasicEffect>(device);
     m_batchEffect->SetVertexColorEnabled(true);
@@ -346,15 +788,33 @@ void Game::CreateDeviceDependentResources()
         );
     }
 
-    m_font = std::make_unique<SpriteFont>(device, L"assets\\SegoeUI_18.spritefont");
+    LoadFont();
 
-    m_shape = GeometricPrimitive::CreateTeapot(context, 4.f, 8);
+    {
+        // The teapot is built from its vertices so its bounds can be taken from them.
+        std::vector<GeometricPrimitive::VertexType> vertices;
+        std::vector<uint16_t> indices;
+        GeometricPrimitive::CreateTeapot(vertices, indices, 4.f, 8);
 
-    // SDKMESH has to use clockwise winding with right-handed coordinates, so textures are flipped in U
-    m_fxFactory->SetDirectory(L".\\assets");
-    m_model = Model::CreateFromSDKMESH(device, L"assets\\tiny.sdkmesh", *m_fxFactory);
+        BoundingSphere::CreateFromPoints(m_teapotBounds, vertices.size(), &vertices[0].position, sizeof(GeometricPrimitive::VertexType));
+
+        m_shape = GeometricPrimitive::CreateCustom(m_sceneRenderer->GetContext(SceneChunk_Teapot), vertices, indices);
+    }
+
+    LoadModel();
+
+    LoadTextures();
+}
+
+void Game::LoadFont()
+{
+    m_font = std::make_unique<SpriteFont>(m_deviceResources->GetD3DDevice(), L"assets\\SegoeUI_18.spritefont");
+}
+
+void Game::LoadTextures()
+{
+    auto device = m_deviceResources->GetD3DDevice();
 
-    // Load textures
     DX::ThrowIfFailed(
         CreateDDSTextureFromFile(device, L"assets\\seafloor.dds", nullptr, m_texture1.ReleaseAndGetAddressOf())
     );
@@ -364,6 +824,34 @@ void Game::CreateDeviceDependentResources()
     );
 }
 
+void Game::LoadModel()
+{
+    // SDKMESH has to use clockwise winding with right-handed coordinates, so textures are flipped in U
+    m_fxFactory->SetDirectory(L".\\assets");
+    m_model = Model::CreateFromSDKMESH(m_deviceResources->GetD3DDevice(), L"assets\\tiny.sdkmesh", *m_fxFactory);
+
+    m_modelBounds = m_model->meshes.front()->boundingSphere;
+    for (auto& mesh : m_model->meshes)
+    {
+        BoundingSphere::CreateMerged(m_modelBounds, m_modelBounds, mesh->boundingSphere);
+    }
+}
+
+// Keeps a bank that is still in use, so only the instance is created again.
+void Game::LoadSoundBank()
+{
+    if (!m_waveBank)
+        m_waveBank = std::make_unique<WaveBank>(m_audEngine.get(), L"assets\\adpcmdroid.xwb");
+    m_effect2 = m_waveBank->CreateInstance(10);
+}
+
+void Game::LoadMusic()
+{
+    m_soundEffect = std::make_unique<SoundEffect>(m_audEngine.get(), L"assets\\MusicMono_adpcm.wav");
+    m_effect1 = m_soundEffect->CreateInstance();
+    m_effect1->Play(true);
+}
+
 // Allocate all memory resources that change on a window SizeChanged event.
 void Game::CreateWindowSizeDependentResources()
 {
@@ -398,7 +886,14 @@ void Game::CreateWindowSizeDependentResources()
 
     m_batchEffect->SetProjection(m_projection);
 
+    // Deferred contexts cannot report the viewport back to SpriteBatch.
+    m_sprites->SetViewport(m_deviceResources->GetScreenViewport());
+
     m_sprites->SetRotation(m_deviceResources->GetRotation());
+
+    // New or resized buffers hold nothing yet.
+    auto viewport = m_deviceResources->GetScreenViewport();
+    m_damage->Reset(static_cast<LONG>(viewport.Width), static_cast<LONG>(viewport.Height));
 }
 
 void Game::OnDeviceLost()
@@ -406,7 +901,7 @@ void Game::OnDeviceLost()
     m_states.reset();
     m_fxFactory.reset();
     m_sprites.reset();
-    m_batch.reset();
+    m_dynamicVertices.reset();
     m_batchEffect.reset();
     m_font.reset();
     m_shape.reset();
@@ -414,6 +909,11 @@ void Game::OnDeviceLost()
     m_texture1.Reset();
     m_texture2.Reset();
     m_batchInputLayout.Reset();
+    for (auto& state : m_scissorStates)
+    {
+        state.Reset();
+    }
+    m_sceneRenderer->ReleaseDeviceDependentResources();
 }
 
 void Game::OnDeviceRestored()
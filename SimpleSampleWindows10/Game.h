@@ -4,8 +4,13 @@
 
 #pragma once
 
+#include "DamageTracker.h"
+#include "DeferredRenderer.h"
 #include "DeviceResources.h"
+#include "DynamicBufferRing.h"
+#include "MemoryTrimmer.h"
 #include "StepTimer.h"
+#include "WorkerPool.h"
 
 
 // A basic game implementation that creates a D3D11 device and
@@ -40,15 +45,49 @@ public:
 
 private:
 
+    // The scene is recorded as independent chunks, executed in this order.
+    enum SceneChunk
+    {
+        SceneChunk_Grid,
+        SceneChunk_Sprites,
+        SceneChunk_Teapot,
+        SceneChunk_Model,
+        SceneChunk_Count
+    };
+
+    // What is released while the app is suspended, cheapest to rebuild first.
+    enum TrimTarget
+    {
+        TrimTarget_DynamicVertices,
+        TrimTarget_Font,
+        TrimTarget_Textures,
+        TrimTarget_Model,
+        TrimTarget_SoundBank,
+        TrimTarget_Music,
+        TrimTarget_Count
+    };
+
     void Update(DX::StepTimer const& timer);
     void Render();
+    void RenderChunk(size_t chunk, ID3D11DeviceContext* context);
 
     void Clear();
 
+    void UpdateDamage();
+    RECT XM_CALLCONV GetScreenBounds(const DirectX::BoundingSphere& bounds, DirectX::FXMMATRIX world) const;
+    void SetScissorState(ID3D11DeviceContext* context) const;
+
     void CreateDeviceDependentResources();
     void CreateWindowSizeDependentResources();
 
-    void XM_CALLCONV DrawGrid(DirectX::FXMVECTOR xAxis, DirectX::FXMVECTOR yAxis, DirectX::FXMVECTOR origin, size_t xdivs, size_t ydivs, DirectX::GXMVECTOR color);
+    void LoadFont();
+    void LoadTextures();
+    void LoadModel();
+    void LoadMusic();
+    void LoadSoundBank();
+    void RegisterTrimTargets();
+
+    void XM_CALLCONV DrawGrid(ID3D11DeviceContext* context, DirectX::FXMVECTOR xAxis, DirectX::FXMVECTOR yAxis, DirectX::FXMVECTOR origin, size_t xdivs, size_t ydivs, DirectX::GXMVECTOR color);
 
     // Device resources.
     std::unique_ptr<DX::DeviceResources>    m_deviceResources;
@@ -61,13 +100,25 @@ private:
     std::unique_ptr<DirectX::Keyboard>      m_keyboard;
     std::unique_ptr<DirectX::Mouse>         m_mouse;
 
+    // Worker threads the scene renderer records on.
+    std::unique_ptr<DX::WorkerPool>         m_workers;
+
+    // Records scene chunks on deferred contexts from worker threads.
+    std::unique_ptr<DX::DeferredRenderer>   m_sceneRenderer;
+
+    // Parts of the back buffer to redraw and present this frame.
+    std::unique_ptr<DX::DamageTracker>      m_damage;
+
+    // Releases memory on suspend; each target is restored before its next use.
+    std::unique_ptr<DX::MemoryTrimmer>      m_trimmer;
+    DX::MemoryTrimmer::Handle               m_trimTargets[TrimTarget_Count];
+
     // DirectXTK objects.
     std::unique_ptr<DirectX::CommonStates>                                  m_states;
     std::unique_ptr<DirectX::BasicEffect>                                   m_batchEffect;
     std::unique_ptr<DirectX::EffectFactory>                                 m_fxFactory;
     std::unique_ptr<DirectX::GeometricPrimitive>                            m_shape;
     std::unique_ptr<DirectX::Model>                                         m_model;
-    std::unique_ptr<DirectX::PrimitiveBatch<DirectX::VertexPositionColor>>  m_batch;
     std::unique_ptr<DirectX::SpriteBatch>                                   m_sprites;
     std::unique_ptr<DirectX::SpriteFont>                                    m_font;
 
@@ -81,12 +132,26 @@ private:
     Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texture2;
     Microsoft::WRL::ComPtr<ID3D11InputLayout>                               m_batchInputLayout;
 
+    // Scissor-enabled twins of the CommonStates solid rasterizer states, indexed by cull mode - 1.
+    Microsoft::WRL::ComPtr<ID3D11RasterizerState>                           m_scissorStates[3];
+
+    // Dynamic vertices for the grid chunk, discarded once per frame.
+    std::unique_ptr<DX::DynamicBufferRing>                                  m_dynamicVertices;
+
     uint32_t                                                                m_audioEvent;
     float                                                                   m_audioTimerAcc;
 
     bool                                                                    m_retryDefault;
 
     DirectX::SimpleMath::Matrix                                             m_world;
+    DirectX::SimpleMath::Matrix                                             m_teapotWorld;
+    DirectX::SimpleMath::Matrix                                             m_modelWorld;
     DirectX::SimpleMath::Matrix                                             m_view;
     DirectX::SimpleMath::Matrix                                             m_projection;
+
+    // Object bounds in local space, and where each was drawn last frame.
+    DirectX::BoundingSphere                                                 m_teapotBounds;
+    DirectX::BoundingSphere                                                 m_modelBounds;
+    RECT                                                                    m_teapotRect;
+    RECT                                                                    m_modelRect;
 };
\ No newline at end of file
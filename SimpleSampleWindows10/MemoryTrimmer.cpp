@@ -0,0 +1,95 @@
+//
+// MemoryTrimmer.cpp
+//
+
+#include "pch.h"
+#include "MemoryTrimmer.h"
+
+using namespace DX;
+
+MemoryTrimmer::MemoryTrimmer() noexcept :
+    m_stats{}
+{
+}
+
+MemoryTrimmer::Handle MemoryTrimmer::Register(const wchar_t* name, int priority, TrimFunction trim, RestoreFunction restore)
+{
+    if (!trim || !restore)
+        throw std::invalid_argument("MemoryTrimmer needs both a trim and a restore function");
+
+    Entry entry;
+    entry.name = name ? name : L"";
+    entry.priority = priority;
+    entry.trim = std::move(trim);
+    entry.restore = std::move(restore);
+    entry.trimmed = false;
+    entry.bytesReleased = 0;
+
+    Handle handle = m_entries.size();
+    m_entries.push_back(std::move(entry));
+
+    auto position = std::upper_bound(m_order.begin(), m_order.end(), priority,
+        [this](int value, Handle other) { return value < m_entries[other].priority; });
+    m_order.insert(position, handle);
+
+    return handle;
+}
+
+size_t MemoryTrimmer::Trim(size_t targetBytes)
+{
+    size_t released = 0;
+
+    for (Handle handle : m_order)
+    {
+        if (released >= targetBytes)
+            break;
+
+        auto& entry = m_entries[handle];
+        if (entry.trimmed)
+            continue;
+
+        // A subsystem that throws keeps what it had and is not marked as trimmed.
+        size_t bytes = entry.trim();
+
+        entry.trimmed = true;
+        entry.bytesReleased = bytes;
+        released += bytes;
+        ++m_stats.trims;
+    }
+
+    m_stats.lastTrimBytes = released;
+    return released;
+}
+
+bool MemoryTrimmer::Restore(Handle handle)
+{
+    auto& entry = m_entries.at(handle);
+    if (!entry.trimmed)
+        return false;
+
+    entry.restore();
+
+    entry.trimmed = false;
+    entry.bytesReleased = 0;
+    ++m_stats.restores;
+    return true;
+}
+
+void MemoryTrimmer::RestoreAll()
+{
+    for (Handle handle = 0; handle < m_entries.size(); ++handle)
+    {
+        Restore(handle);
+    }
+}
+
+size_t MemoryTrimmer::GetTotalBytesReleased() const
+{
+    size_t total = 0;
+    for (auto& entry : m_entries)
+    {
+        if (entry.trimmed)
+            total += entry.bytesReleased;
+    }
+    return total;
+}
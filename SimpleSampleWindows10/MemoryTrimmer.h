@@ -0,0 +1,87 @@
+//
+// MemoryTrimmer.h - Releases memory the app can rebuild while it is suspended
+//
+
+#pragma once
+
+#include <functional>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace DX
+{
+    // Subsystems register a function that frees whatever they can rebuild and returns how many
+    // bytes that released, and one that rebuilds it. On suspend the trim functions run in
+    // priority order, cheapest to rebuild first, until enough has been released. Nothing is
+    // rebuilt on resume: each subsystem calls Restore before its next use, which only does work
+    // the first time after a trim, so resuming costs only what the following frames touch.
+    //
+    // Use from the game thread.
+    class MemoryTrimmer
+    {
+    public:
+        // Lower priorities are trimmed first. Any value can be used; these are the usual tiers.
+        enum Priority
+        {
+            Priority_Staging = 0,       // Scratch and upload memory that is refilled every frame
+            Priority_Cache = 100,       // Derived data that is cheap to rebuild
+            Priority_Content = 200,     // Assets reloaded from disk
+            Priority_Audio = 300,       // Audible if it is not back in time
+            Priority_Music = 400,       // Looping audio, needed on the first frame after resuming
+        };
+
+        using Handle = size_t;
+        using TrimFunction = std::function<size_t()>;
+        using RestoreFunction = std::function<void()>;
+
+        struct Statistics
+        {
+            uint32_t    trims;              // Trim functions run
+            uint32_t    restores;           // Restore functions run
+            size_t      lastTrimBytes;      // Released by the last call to Trim
+        };
+
+        MemoryTrimmer() noexcept;
+
+        MemoryTrimmer(MemoryTrimmer const&) = delete;
+        MemoryTrimmer& operator= (MemoryTrimmer const&) = delete;
+
+        // Subsystems with the same priority are trimmed in the order they were registered.
+        Handle Register(const wchar_t* name, int priority, TrimFunction trim, RestoreFunction restore);
+
+        // Trims subsystems that are not already trimmed until at least 'targetBytes' have been
+        // released, or all of them by default. Returns the bytes released.
+        size_t Trim(size_t targetBytes = SIZE_MAX);
+
+        // Rebuilds the subsystem if it is trimmed and returns true if it did. Call before each use.
+        bool Restore(Handle handle);
+        void RestoreAll();
+
+        bool IsTrimmed(Handle handle) const { return m_entries.at(handle).trimmed; }
+        size_t GetBytesReleased(Handle handle) const { return m_entries.at(handle).bytesReleased; }
+        const wchar_t* GetName(Handle handle) const { return m_entries.at(handle).name.c_str(); }
+        size_t GetCount() const { return m_entries.size(); }
+
+        // Bytes released by the subsystems that are still trimmed.
+        size_t GetTotalBytesReleased() const;
+
+        const Statistics& GetStatistics() const { return m_stats; }
+
+    private:
+        struct Entry
+        {
+            std::wstring    name;
+            int             priority;
+            TrimFunction    trim;
+            RestoreFunction restore;
+            bool            trimmed;
+            size_t          bytesReleased;
+        };
+
+        std::vector<Entry>  m_entries;
+        std::vector<Handle> m_order;        // Trim order
+        Statistics          m_stats;
+    };
+}
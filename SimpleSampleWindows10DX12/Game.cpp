@@ -12,10 +12,30 @@ using namespace DirectX::SimpleMath;
 
 using Microsoft::WRL::ComPtr;
 
-Game::Game() noexcept(false)
+namespace
+{
+    // BasicEffect's default key light, which the shadows are cast from.
+    const XMVECTORF32 c_lightDirection = { -0.5265408f, -0.5735765f, -0.6275069f };
+
+    const unsigned int c_shadowCascades = 4;
+    const unsigned int c_shadowMapSize = 2048;
+    const float c_shadowDistance = 20.f;
+
+    // The ground grid, which receives shadows but casts none. It is drawn from -axis to +axis
+    // around the origin.
+    const XMVECTORF32 c_gridXAxis = { 20.f, 0.f, 0.f };
+    const XMVECTORF32 c_gridYAxis = { 0.f, 0.f, 20.f };
+    const BoundingBox c_groundBounds(XMFLOAT3(0.f, 0.f, 0.f), XMFLOAT3(c_gridXAxis.f[0], 0.f, c_gridYAxis.f[2]));
+}
+
+Game::Game() noexcept(false) :
+    m_casterMasks{}
 {
     m_deviceResources = std::make_unique<DX::DeviceResources>();
     m_deviceResources->RegisterDeviceNotify(this);
+
+    m_shadowCascades = std::make_unique<DX::ShadowCascades>(c_shadowCascades, c_shadowMapSize);
+    m_shadowCascades->SetShadowDistance(c_shadowDistance);
 }
 
 // Initialize the Direct3D resources required to run.
@@ -90,6 +110,27 @@ void Game::Update(DX::StepTimer const& timer)
 
     m_world = Matrix::CreateRotationY(float(timer.GetTotalSeconds() * XM_PIDIV4));
 
+    m_teapotWorld = m_world * Matrix::CreateTranslation(-2.f, -2.f, -4.f);
+
+    const XMVECTORF32 scale = { 0.01f, 0.01f, 0.01f };
+    const XMVECTORF32 translate = { 3.f, -2.f, -4.f };
+    XMVECTOR rotate = Quaternion::CreateFromYawPitchRoll(XM_PI / 2.f, 0.f, -XM_PI / 2.f);
+    m_modelWorld = m_world * XMMatrixTransformation(g_XMZero, Quaternion::Identity, scale, g_XMZero, rotate, translate);
+
+    // Fit the cascades around everything that casts or receives, then find the cascades
+    // each object has to be drawn into.
+    m_localBounds[TeapotCaster].Transform(m_casterBounds[TeapotCaster], m_teapotWorld);
+    m_localBounds[ModelCaster].Transform(m_casterBounds[ModelCaster], m_modelWorld);
+
+    BoundingBox sceneBounds = c_groundBounds;
+    for (auto& bounds : m_casterBounds)
+    {
+        BoundingBox::CreateMerged(sceneBounds, sceneBounds, bounds);
+    }
+
+    m_shadowCascades->Update(m_view, m_projection, c_lightDirection, sceneBounds);
+    m_shadowCascades->CullCasters(m_casterBounds, CasterCount, m_casterMasks);
+
     m_lineEffect->SetView(m_view);
     m_lineEffect->SetWorld(Matrix::Identity);
 
@@ -121,7 +162,7 @@ void Game::Update(DX::StepTimer const& timer)
     auto pad = m_gamePad->GetState(0);
     if (pad.IsConnected())
     {
-        m_gamePadButtons.Update(pad);
+        m_buttons.SetGamePad(0, pad);
 
         if (pad.IsViewPressed())
         {
@@ -130,11 +171,12 @@ void Game::Update(DX::StepTimer const& timer)
     }
     else
     {
-        m_gamePadButtons.Reset();
+        m_buttons.ResetGamePad(0);
     }
 
     auto kb = m_keyboard->GetState();
-    m_keyboardButtons.Update(kb);
+    m_buttons.SetKeyboard(0, kb);
+    m_buttons.Update();
 
     if (kb.Escape)
     {
@@ -166,9 +208,7 @@ void Game::Render()
     PIXBeginEvent(commandList, PIX_COLOR_DEFAULT, L"Render");
 
     // Draw procedurally generated dynamic grid
-    const XMVECTORF32 xaxis = { 20.f, 0.f, 0.f };
-    const XMVECTORF32 yaxis = { 0.f, 0.f, 20.f };
-    DrawGrid(xaxis, yaxis, g_XMZero, 20, 20, Colors::Gray);
+    DrawGrid(c_gridXAxis, c_gridYAxis, g_XMZero, 20, 20, Colors::Gray);
 
     // Set the descriptor heaps
     ID3D12DescriptorHeap* heaps[] = { m_resourceDescriptors->Heap(), m_states->Heap() };
@@ -181,24 +221,36 @@ void Game::Render()
         XMFLOAT2(10, 75));
 
     m_font->DrawString(m_sprites.get(), L"DirectXTK Simple Sample", XMFLOAT2(100, 10), Colors::Yellow);
+
+    {
+        // Cascade split depths, then a bit per cascade each object casts into. At most eight
+        // cascades keep this well inside the buffer.
+        wchar_t text[128];
+        int length = swprintf_s(text, L"Shadow splits %.2f", m_shadowCascades->GetCascade(0).nearDepth);
+        for (unsigned int i = 0; i < m_shadowCascades->GetCascadeCount(); ++i)
+        {
+            length += swprintf_s(text + length, _countof(text) - length, L" %.2f", m_shadowCascades->GetCascade(i).farDepth);
+        }
+
+        swprintf_s(text + length, _countof(text) - length, L"  casters: teapot %02X model %02X",
+            m_casterMasks[TeapotCaster], m_casterMasks[ModelCaster]);
+
+        m_font->DrawString(m_sprites.get(), text, XMFLOAT2(100, 40), Colors::LightGray, 0.f, g_XMZero, 0.75f);
+    }
+
     m_sprites->End();
     PIXEndEvent(commandList);
 
     // Draw 3D object
     PIXBeginEvent(commandList, PIX_COLOR_DEFAULT, L"Draw teapot");
-    XMMATRIX local = m_world * Matrix::CreateTranslation(-2.f, -2.f, -4.f);
-    m_shapeEffect->SetWorld(local);
+    m_shapeEffect->SetWorld(m_teapotWorld);
     m_shapeEffect->Apply(commandList);
     m_shape->Draw(commandList);
     PIXEndEvent(commandList);
 
     // Draw model
     PIXBeginEvent(commandList, PIX_COLOR_DEFAULT, L"Draw model");
-    const XMVECTORF32 scale = { 0.01f, 0.01f, 0.01f };
-    const XMVECTORF32 translate = { 3.f, -2.f, -4.f };
-    XMVECTOR rotate = Quaternion::CreateFromYawPitchRoll(XM_PI / 2.f, 0.f, -XM_PI / 2.f);
-    local = m_world * XMMatrixTransformation(g_XMZero, Quaternion::Identity, scale, g_XMZero, rotate, translate);
-    Model::UpdateEffectMatrices(m_modelEffects, local, m_view, m_projection);
+    Model::UpdateEffectMatrices(m_modelEffects, m_modelWorld, m_view, m_projection);
     heaps[0] = m_modelResources->Heap();
     commandList->SetDescriptorHeaps(_countof(heaps), heaps);
     m_model->Draw(commandList, m_modelEffects.begin());
@@ -296,8 +348,7 @@ void Game::OnSuspending()
 void Game::OnResuming()
 {
     m_timer.ResetElapsedTime();
-    m_gamePadButtons.Reset();
-    m_keyboardButtons.Reset();
+    m_buttons.Reset();
     m_audEngine->Resume();
 }
 
@@ -349,11 +400,26 @@ void Game::CreateDeviceDependentResources()
 
     m_batch = std::make_unique<PrimitiveBatch<VertexPositionColor>>(device);
 
-    m_shape = GeometricPrimitive::CreateTeapot(4.f, 8);
+    {
+        // Built from its vertices so the shadow caster bounds can be taken from them.
+        GeometricPrimitive::VertexCollection vertices;
+        GeometricPrimitive::IndexCollection indices;
+        GeometricPrimitive::CreateTeapot(vertices, indices, 4.f, 8);
+
+        BoundingBox::CreateFromPoints(m_localBounds[TeapotCaster], vertices.size(), &vertices[0].position, sizeof(GeometricPrimitive::VertexType));
+
+        m_shape = GeometricPrimitive::CreateCustom(vertices, indices);
+    }
 
     // SDKMESH has to use clockwise winding with right-handed coordinates, so textures are flipped in U
     m_model = Model::CreateFromSDKMESH(L"assets\\tiny.sdkmesh");
 
+    m_localBounds[ModelCaster] = m_model->meshes[0]->boundingBox;
+    for (auto& mesh : m_model->meshes)
+    {
+        BoundingBox::CreateMerged(m_localBounds[ModelCaster], m_localBounds[ModelCaster], mesh->boundingBox);
+    }
+
     {
         ResourceUploadBatch resourceUpload(device);
 
@@ -5,6 +5,8 @@
 #pragma once
 
 #include "DeviceResources.h"
+#include "InputEdgeTracker.h"
+#include "ShadowCascades.h"
 #include "StepTimer.h"
 
 
@@ -61,8 +63,8 @@ private:
     std::unique_ptr<DirectX::Keyboard>          m_keyboard;
     std::unique_ptr<DirectX::Mouse>             m_mouse;
 
-    DirectX::GamePad::ButtonStateTracker        m_gamePadButtons;
-    DirectX::Keyboard::KeyboardStateTracker     m_keyboardButtons;
+    // Pressed/released edges for the local player's keyboard and gamepad.
+    DX::InputEdgeTracker                        m_buttons;
 
     // DirectXTK objects.
     std::unique_ptr<DirectX::GraphicsMemory>                                m_graphicsMemory;
@@ -95,6 +97,21 @@ private:
     DirectX::SimpleMath::Matrix                                             m_world;
     DirectX::SimpleMath::Matrix                                             m_view;
     DirectX::SimpleMath::Matrix                                             m_projection;
+    DirectX::SimpleMath::Matrix                                             m_teapotWorld;
+    DirectX::SimpleMath::Matrix                                             m_modelWorld;
+
+    // Shadow cascades for the key light and the cascades each object can cast into.
+    enum Casters
+    {
+        TeapotCaster,
+        ModelCaster,
+        CasterCount
+    };
+
+    std::unique_ptr<DX::ShadowCascades>                                     m_shadowCascades;
+    DirectX::BoundingBox                                                    m_localBounds[CasterCount];
+    DirectX::BoundingBox                                                    m_casterBounds[CasterCount];
+    uint8_t                                                                 m_casterMasks[CasterCount];
 
     // Descriptors
     enum Descriptors
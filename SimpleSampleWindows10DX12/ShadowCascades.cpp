@@ -0,0 +1,303 @@
+//
+// ShadowCascades.cpp
+//
+
+#include "pch.h"
+#include "ShadowCascades.h"
+
+#include <float.h>
+#include <math.h>
+
+#if defined(_XM_SSE_INTRINSICS_) && !defined(_XM_NO_INTRINSICS_)
+#include <emmintrin.h>
+#endif
+
+using namespace DirectX;
+using namespace DX;
+
+namespace
+{
+    // Cascade sizes are rounded up to this step so float noise in the frustum math cannot
+    // change the texel size from one frame to the next.
+    const float c_sizeStep = 1.f / 16.f;
+
+    float RoundUpSize(float size)
+    {
+        return ceilf(size / c_sizeStep) * c_sizeStep;
+    }
+}
+
+ShadowCascades::ShadowCascades(unsigned int cascadeCount, unsigned int resolution) noexcept(false) :
+    m_cascadeCount(cascadeCount),
+    m_resolution(resolution),
+    m_lambda(0.75f),
+    m_shadowDistance(FLT_MAX),
+    m_lightView{},
+    m_cascades{},
+    m_boxes{}
+{
+    if (!cascadeCount || cascadeCount > MaxCascades)
+        throw std::invalid_argument("ShadowCascades supports 1 to 8 cascades");
+
+    if (resolution < 2)
+        throw std::invalid_argument("ShadowCascades needs a shadow map of at least 2x2 texels");
+}
+
+void ShadowCascades::SetSplitLambda(float lambda)
+{
+    m_lambda = std::min(std::max(lambda, 0.f), 1.f);
+}
+
+void ShadowCascades::SetShadowDistance(float distance)
+{
+    if (!(distance > 0.f))
+        throw std::invalid_argument("ShadowCascades needs a positive shadow distance");
+
+    m_shadowDistance = distance;
+}
+
+void XM_CALLCONV ShadowCascades::Update(FXMMATRIX view, CXMMATRIX projection, FXMVECTOR lightDirection, const BoundingBox& sceneBounds)
+{
+    XMFLOAT4X4 p;
+    XMStoreFloat4x4(&p, projection);
+
+    // An orientation transform only turns x and y, so depth still follows _33 = f / (n - f)
+    // and _43 = n * f / (n - f).
+    if (p._34 != -1.f || p._44 != 0.f)
+        throw std::invalid_argument("ShadowCascades needs a right-handed perspective projection");
+
+    float nearPlane = p._43 / p._33;
+    float farPlane = p._43 / (p._33 + 1.f);
+    if (!(nearPlane > 0.f) || !(farPlane > nearPlane))
+        throw std::invalid_argument("ShadowCascades needs a near plane in front of the far plane");
+
+    float lastDepth = std::min(farPlane, m_shadowDistance);
+    if (!(lastDepth > nearPlane))
+        throw std::invalid_argument("ShadowCascades' shadow distance ends inside the near plane");
+
+    // Practical splits: a blend of logarithmic spacing, which keeps the texel density even
+    // across depth, and uniform spacing, which keeps near cascades from getting too thin.
+    float splits[MaxCascades + 1];
+    for (unsigned int i = 0; i <= m_cascadeCount; ++i)
+    {
+        float t = float(i) / float(m_cascadeCount);
+        float logSplit = nearPlane * powf(lastDepth / nearPlane, t);
+        float uniformSplit = nearPlane + (lastDepth - nearPlane) * t;
+        splits[i] = m_lambda * logSplit + (1.f - m_lambda) * uniformSplit;
+    }
+    splits[0] = nearPlane;
+    splits[m_cascadeCount] = lastDepth;
+
+    // The light looks along its direction from the origin, so moving the camera only moves
+    // the projections.
+    XMVECTOR direction = XMVector3Normalize(lightDirection);
+    XMVECTOR up = (fabsf(XMVectorGetY(direction)) > 0.99f) ? g_XMIdentityR0 : g_XMIdentityR1;
+    XMMATRIX lightView = XMMatrixLookToRH(g_XMZero, direction, up);
+    XMStoreFloat4x4(&m_lightView, lightView);
+
+    XMMATRIX viewToLight = XMMatrixMultiply(XMMatrixInverse(nullptr, view), lightView);
+    XMMATRIX inverseProjection = XMMatrixInverse(nullptr, projection);
+
+    // Squared radius of the frustum's cross section per unit of depth. Opposite corners are
+    // mirror images, so two of them cover any orientation.
+    float spreadSq = 0.f;
+    {
+        const XMVECTORF32 corners[] =
+        {
+            { 1.f, 1.f, 1.f, 1.f },
+            { 1.f, -1.f, 1.f, 1.f },
+        };
+
+        for (auto& corner : corners)
+        {
+            XMFLOAT3 v;
+            XMStoreFloat3(&v, XMVector3TransformCoord(corner, inverseProjection));
+            spreadSq = std::max(spreadSq, (v.x * v.x + v.y * v.y) / (v.z * v.z));
+        }
+    }
+
+    // The scene's box around the light's axes.
+    XMFLOAT3 sceneMin(FLT_MAX, FLT_MAX, FLT_MAX);
+    XMFLOAT3 sceneMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (unsigned int i = 0; i < 8; ++i)
+    {
+        XMVECTOR corner = XMVectorSet(
+            sceneBounds.Center.x + ((i & 1) ? sceneBounds.Extents.x : -sceneBounds.Extents.x),
+            sceneBounds.Center.y + ((i & 2) ? sceneBounds.Extents.y : -sceneBounds.Extents.y),
+            sceneBounds.Center.z + ((i & 4) ? sceneBounds.Extents.z : -sceneBounds.Extents.z),
+            1.f);
+
+        XMFLOAT3 v;
+        XMStoreFloat3(&v, XMVector3Transform(corner, lightView));
+        sceneMin = XMFLOAT3(std::min(sceneMin.x, v.x), std::min(sceneMin.y, v.y), std::min(sceneMin.z, v.z));
+        sceneMax = XMFLOAT3(std::max(sceneMax.x, v.x), std::max(sceneMax.y, v.y), std::max(sceneMax.z, v.z));
+    }
+
+    float sceneHalfSize = RoundUpSize(std::max(sceneMax.x - sceneMin.x, sceneMax.y - sceneMin.y) * 0.5f);
+
+    for (unsigned int i = 0; i < m_cascadeCount; ++i)
+    {
+        float d0 = splits[i];
+        float d1 = splits[i + 1];
+
+        // Smallest sphere around the slice with its center on the view axis. It only depends
+        // on the split depths, so it has the same size whichever way the camera faces.
+        float r0Sq = spreadSq * d0 * d0;
+        float r1Sq = spreadSq * d1 * d1;
+        float centerDepth = (d1 * d1 - d0 * d0 + r1Sq - r0Sq) / (2.f * (d1 - d0));
+        centerDepth = std::min(std::max(centerDepth, d0), d1);
+        float radius = sqrtf(std::max(r0Sq + (centerDepth - d0) * (centerDepth - d0), r1Sq + (d1 - centerDepth) * (d1 - centerDepth)));
+        radius = RoundUpSize(radius);
+
+        XMFLOAT3 center;
+        XMStoreFloat3(&center, XMVector3Transform(XMVectorSet(0.f, 0.f, -centerDepth, 1.f), viewToLight));
+
+        float halfSize = radius;
+        float centerX = center.x;
+        float centerY = center.y;
+        if (sceneHalfSize < radius)
+        {
+            halfSize = sceneHalfSize;
+            centerX = (sceneMin.x + sceneMax.x) * 0.5f;
+            centerY = (sceneMin.y + sceneMax.y) * 0.5f;
+        }
+
+        // Snap the corner to whole texels. One texel of the map is spare so the snapped box
+        // still covers the whole square.
+        float texelSize = 2.f * halfSize / float(m_resolution - 1);
+        float size = texelSize * float(m_resolution);
+
+        LightBox& box = m_boxes[i];
+        box.minX = floorf((centerX - halfSize) / texelSize) * texelSize;
+        box.minY = floorf((centerY - halfSize) / texelSize) * texelSize;
+        box.maxX = box.minX + size;
+        box.maxY = box.minY + size;
+
+        // Every caster in the scene may shade the slice, but nothing beyond the slice or the
+        // scene receives a shadow.
+        box.maxZ = sceneMax.z;
+        box.minZ = std::max(sceneMin.z, center.z - radius);
+        if (!(box.maxZ > box.minZ))
+            box.minZ = box.maxZ - texelSize;
+
+        Cascade& cascade = m_cascades[i];
+        cascade.nearDepth = d0;
+        cascade.farDepth = d1;
+        cascade.texelSize = texelSize;
+
+        XMMATRIX cascadeProjection = XMMatrixOrthographicOffCenterRH(box.minX, box.maxX, box.minY, box.maxY, -box.maxZ, -box.minZ);
+        XMStoreFloat4x4(&cascade.projection, cascadeProjection);
+        XMStoreFloat4x4(&cascade.viewProjection, XMMatrixMultiply(lightView, cascadeProjection));
+    }
+}
+
+uint8_t ShadowCascades::CullCaster(const BoundingBox& box) const
+{
+    const XMFLOAT4X4& m = m_lightView;
+
+    float x = box.Center.x * m._11 + box.Center.y * m._21 + box.Center.z * m._31 + m._41;
+    float y = box.Center.x * m._12 + box.Center.y * m._22 + box.Center.z * m._32 + m._42;
+    float z = box.Center.x * m._13 + box.Center.y * m._23 + box.Center.z * m._33 + m._43;
+    float ex = box.Extents.x * fabsf(m._11) + box.Extents.y * fabsf(m._21) + box.Extents.z * fabsf(m._31);
+    float ey = box.Extents.x * fabsf(m._12) + box.Extents.y * fabsf(m._22) + box.Extents.z * fabsf(m._32);
+    float ez = box.Extents.x * fabsf(m._13) + box.Extents.y * fabsf(m._23) + box.Extents.z * fabsf(m._33);
+
+    uint8_t mask = 0;
+    for (unsigned int i = 0; i < m_cascadeCount; ++i)
+    {
+        const LightBox& b = m_boxes[i];
+        if (x + ex >= b.minX && x - ex <= b.maxX
+            && y + ey >= b.minY && y - ey <= b.maxY
+            && z + ez >= b.minZ && z - ez <= b.maxZ)
+        {
+            mask |= uint8_t(1u << i);
+        }
+    }
+
+    return mask;
+}
+
+size_t ShadowCascades::CullCasters(const BoundingBox* boxes, size_t count, uint8_t* casterMasks) const
+{
+    size_t j = 0;
+
+#if defined(_XM_SSE_INTRINSICS_) && !defined(_XM_NO_INTRINSICS_)
+    // Four boxes at a time: move them into light space around its axes, then test them
+    // against every cascade's box.
+    const XMFLOAT4X4& m = m_lightView;
+    const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 r[3][3] =
+    {
+        { _mm_set1_ps(m._11), _mm_set1_ps(m._12), _mm_set1_ps(m._13) },
+        { _mm_set1_ps(m._21), _mm_set1_ps(m._22), _mm_set1_ps(m._23) },
+        { _mm_set1_ps(m._31), _mm_set1_ps(m._32), _mm_set1_ps(m._33) },
+    };
+    const __m128 t[3] = { _mm_set1_ps(m._41), _mm_set1_ps(m._42), _mm_set1_ps(m._43) };
+
+    for (; j + 4 <= count; j += 4)
+    {
+        const BoundingBox* b = boxes + j;
+        __m128 c[3] =
+        {
+            _mm_setr_ps(b[0].Center.x, b[1].Center.x, b[2].Center.x, b[3].Center.x),
+            _mm_setr_ps(b[0].Center.y, b[1].Center.y, b[2].Center.y, b[3].Center.y),
+            _mm_setr_ps(b[0].Center.z, b[1].Center.z, b[2].Center.z, b[3].Center.z),
+        };
+        __m128 e[3] =
+        {
+            _mm_setr_ps(b[0].Extents.x, b[1].Extents.x, b[2].Extents.x, b[3].Extents.x),
+            _mm_setr_ps(b[0].Extents.y, b[1].Extents.y, b[2].Extents.y, b[3].Extents.y),
+            _mm_setr_ps(b[0].Extents.z, b[1].Extents.z, b[2].Extents.z, b[3].Extents.z),
+        };
+
+        __m128 lo[3];
+        __m128 hi[3];
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            __m128 center = t[axis];
+            __m128 extent = _mm_setzero_ps();
+            for (int k = 0; k < 3; ++k)
+            {
+                center = _mm_add_ps(center, _mm_mul_ps(c[k], r[k][axis]));
+                extent = _mm_add_ps(extent, _mm_mul_ps(e[k], _mm_and_ps(r[k][axis], signMask)));
+            }
+            lo[axis] = _mm_sub_ps(center, extent);
+            hi[axis] = _mm_add_ps(center, extent);
+        }
+
+        int masks[4] = {};
+        for (unsigned int i = 0; i < m_cascadeCount; ++i)
+        {
+            const LightBox& box = m_boxes[i];
+            __m128 inside = _mm_and_ps(_mm_cmpge_ps(hi[0], _mm_set1_ps(box.minX)), _mm_cmple_ps(lo[0], _mm_set1_ps(box.maxX)));
+            inside = _mm_and_ps(inside, _mm_and_ps(_mm_cmpge_ps(hi[1], _mm_set1_ps(box.minY)), _mm_cmple_ps(lo[1], _mm_set1_ps(box.maxY))));
+            inside = _mm_and_ps(inside, _mm_and_ps(_mm_cmpge_ps(hi[2], _mm_set1_ps(box.minZ)), _mm_cmple_ps(lo[2], _mm_set1_ps(box.maxZ))));
+
+            int bits = _mm_movemask_ps(inside);
+            for (int k = 0; k < 4; ++k)
+            {
+                masks[k] |= ((bits >> k) & 1) << i;
+            }
+        }
+
+        for (int k = 0; k < 4; ++k)
+        {
+            casterMasks[j + k] = uint8_t(masks[k]);
+        }
+    }
+#endif
+
+    for (; j < count; ++j)
+    {
+        casterMasks[j] = CullCaster(boxes[j]);
+    }
+
+    size_t reached = 0;
+    for (j = 0; j < count; ++j)
+    {
+        if (casterMasks[j])
+            ++reached;
+    }
+
+    return reached;
+}
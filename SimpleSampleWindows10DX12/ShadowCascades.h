@@ -0,0 +1,85 @@
+//
+// ShadowCascades.h - Cascaded shadow map splits, light projections and caster culling
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace DX
+{
+    // Splits the camera frustum by depth into cascades for a directional light and fits an
+    // orthographic light projection around each one, so near receivers get the most shadow
+    // map texels.
+    //
+    // Split distances blend uniform and logarithmic spacing (the "practical" split scheme).
+    // Each cascade covers the bounding sphere of its part of the frustum, whose size does not
+    // change as the camera turns, and its origin is snapped to whole texels, so shadow edges
+    // stay put while the camera moves instead of shimmering. When the scene is smaller than
+    // that sphere across the light, the scene's own square footprint is used instead, which
+    // is just as stable. The depth range is fitted to the scene bounds so casters between the
+    // light and the cascade are kept while the depth precision is not wasted on empty space.
+    class ShadowCascades
+    {
+    public:
+        static const unsigned int MaxCascades = 8;
+
+        struct Cascade
+        {
+            float                   nearDepth;      // Camera depth range covered, -z in view space
+            float                   farDepth;
+            float                   texelSize;      // World units per shadow map texel
+            DirectX::XMFLOAT4X4     projection;     // Orthographic, applied after GetLightView
+            DirectX::XMFLOAT4X4     viewProjection;
+        };
+
+        // 'resolution' is the width and height of each cascade's shadow map.
+        ShadowCascades(unsigned int cascadeCount, unsigned int resolution) noexcept(false);
+
+        ShadowCascades(ShadowCascades const&) = delete;
+        ShadowCascades& operator= (ShadowCascades const&) = delete;
+
+        // 0 spaces the splits evenly, 1 logarithmically. The default is 0.75.
+        void SetSplitLambda(float lambda);
+
+        // Shadows end this far in front of the camera, or at its far plane if that is nearer.
+        void SetShadowDistance(float distance);
+
+        // 'projection' is a right-handed perspective, optionally followed by an orientation
+        // transform; 'lightDirection' points from the light into the scene.
+        void XM_CALLCONV Update(DirectX::FXMMATRIX view, DirectX::CXMMATRIX projection, DirectX::FXMVECTOR lightDirection,
+            const DirectX::BoundingBox& sceneBounds);
+
+        // Sets bit i of casterMasks[j] when world-space box j can cast a shadow into cascade i,
+        // and returns how many boxes reach at least one cascade.
+        size_t CullCasters(const DirectX::BoundingBox* boxes, size_t count, uint8_t* casterMasks) const;
+
+        unsigned int GetCascadeCount() const { return m_cascadeCount; }
+        unsigned int GetResolution() const { return m_resolution; }
+        const Cascade& GetCascade(unsigned int index) const { return m_cascades[index]; }
+        DirectX::XMMATRIX GetLightView() const { return DirectX::XMLoadFloat4x4(&m_lightView); }
+
+    private:
+        // Each cascade's box in light view space.
+        struct LightBox
+        {
+            float   minX;
+            float   maxX;
+            float   minY;
+            float   maxY;
+            float   minZ;       // Farthest from the light
+            float   maxZ;
+        };
+
+        uint8_t CullCaster(const DirectX::BoundingBox& box) const;
+
+        unsigned int            m_cascadeCount;
+        unsigned int            m_resolution;
+        float                   m_lambda;
+        float                   m_shadowDistance;
+        DirectX::XMFLOAT4X4     m_lightView;
+        Cascade                 m_cascades[MaxCascades];
+        LightBox                m_boxes[MaxCascades];
+    };
+}
@@ -78,6 +78,7 @@ DX::DeviceResources::DeviceResources() :
 	m_effectiveDpi(-1.0f),
 	m_compositionScaleX(1.0f),
 	m_compositionScaleY(1.0f),
+	m_resolutionScale(1.0f),
 	m_deviceNotify(nullptr)
 {
 	CreateDeviceIndependentResources();
@@ -385,19 +386,6 @@ void DX::DeviceResources::CreateWindowSizeDependentResources()
 		m_swapChain->SetRotation(displayRotation)
 		);
 
-	// Setup inverse scale on the swap chain
-	DXGI_MATRIX_3X2_F inverseScale = {};
-	inverseScale._11 = 1.0f / m_effectiveCompositionScaleX;
-	inverseScale._22 = 1.0f / m_effectiveCompositionScaleY;
-	ComPtr<IDXGISwapChain2> spSwapChain2;
-	DX::ThrowIfFailed(
-		m_swapChain.As<IDXGISwapChain2>(&spSwapChain2)
-		);
-
-	DX::ThrowIfFailed(
-		spSwapChain2->SetMatrixTransform(&inverseScale)
-		);
-
 	// Create a render target view of the swap chain back buffer.
 	ComPtr<ID3D11Texture2D1> backBuffer;
 	DX::ThrowIfFailed(
@@ -440,16 +428,6 @@ void DX::DeviceResources::CreateWindowSizeDependentResources()
 			)
 		);
 
-	// Set the 3D rendering viewport to target the entire window.
-	m_screenViewport = CD3D11_VIEWPORT(
-		0.0f,
-		0.0f,
-		m_d3dRenderTargetSize.Width,
-		m_d3dRenderTargetSize.Height
-		);
-
-	m_d3dContext->RSSetViewports(1, &m_screenViewport);
-
 	// Create a Direct2D target bitmap associated with the
 	// swap chain back buffer and set it as the current target.
 	D2D1_BITMAP_PROPERTIES1 bitmapProperties = 
@@ -474,10 +452,53 @@ void DX::DeviceResources::CreateWindowSizeDependentResources()
 		);
 
 	m_d2dContext->SetTarget(m_d2dTargetBitmap.Get());
-	m_d2dContext->SetDpi(m_effectiveDpi, m_effectiveDpi);
 
 	// Grayscale text anti-aliasing is recommended for all Windows Store apps.
 	m_d2dContext->SetTextAntialiasMode(D2D1_TEXT_ANTIALIAS_MODE_GRAYSCALE);
+
+	// Sets up the inverse scale on the swap chain, the viewport and the Direct2D DPI.
+	ApplyResolutionScale();
+}
+
+// Renders into the top-left part of the back buffer and has the compositor stretch just that
+// region over the panel. Unlike ResizeBuffers this needs no new views and can change every frame.
+void DX::DeviceResources::ApplyResolutionScale()
+{
+	UINT sourceWidth = std::max<UINT>(1, lround(m_d3dRenderTargetSize.Width * m_resolutionScale));
+	UINT sourceHeight = std::max<UINT>(1, lround(m_d3dRenderTargetSize.Height * m_resolutionScale));
+
+	ComPtr<IDXGISwapChain2> spSwapChain2;
+	DX::ThrowIfFailed(
+		m_swapChain.As<IDXGISwapChain2>(&spSwapChain2)
+		);
+
+	DX::ThrowIfFailed(
+		spSwapChain2->SetSourceSize(sourceWidth, sourceHeight)
+		);
+
+	// Setup inverse scale on the swap chain. The source region is smaller than the panel by
+	// the resolution scale, so it is stretched by that much more.
+	DXGI_MATRIX_3X2_F inverseScale = {};
+	inverseScale._11 = 1.0f / (m_effectiveCompositionScaleX * m_resolutionScale);
+	inverseScale._22 = 1.0f / (m_effectiveCompositionScaleY * m_resolutionScale);
+
+	DX::ThrowIfFailed(
+		spSwapChain2->SetMatrixTransform(&inverseScale)
+		);
+
+	// Set the 3D rendering viewport to target the rendered region.
+	m_screenViewport = CD3D11_VIEWPORT(
+		0.0f,
+		0.0f,
+		static_cast<float>(sourceWidth),
+		static_cast<float>(sourceHeight)
+		);
+
+	m_d3dContext->RSSetViewports(1, &m_screenViewport);
+
+	// Direct2D content is drawn in dips, so scaling the DPI shrinks it into the same region.
+	float dpi = m_effectiveDpi * m_resolutionScale;
+	m_d2dContext->SetDpi(dpi, dpi);
 }
 
 // Determine the dimensions of the render target and whether it will be scaled down.
@@ -575,6 +596,21 @@ void DX::DeviceResources::SetCompositionScale(float compositionScaleX, float com
 	}
 }
 
+// Changes the fraction of the output that is rendered. Must be called on the render thread,
+// between frames.
+void DX::DeviceResources::SetResolutionScale(float scale)
+{
+	scale = std::min<float>(std::max<float>(scale, 0.01f), 1.0f);
+	if (m_resolutionScale != scale)
+	{
+		m_resolutionScale = scale;
+		if (m_swapChain != nullptr)
+		{
+			ApplyResolutionScale();
+		}
+	}
+}
+
 // This method is called in the event handler for the DisplayContentsInvalidated event.
 void DX::DeviceResources::ValidateDevice()
 {
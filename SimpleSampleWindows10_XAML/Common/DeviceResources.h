@@ -19,6 +19,7 @@ namespace DX
 		void SetCurrentOrientation(Windows::Graphics::Display::DisplayOrientations currentOrientation);
 		void SetDpi(float dpi);
 		void SetCompositionScale(float compositionScaleX, float compositionScaleY);
+		void SetResolutionScale(float scale);
 		void ValidateDevice();
 		void HandleDeviceLost();
 		void RegisterDeviceNotify(IDeviceNotify* deviceNotify);
@@ -32,6 +33,10 @@ namespace DX
 		Windows::Foundation::Size	GetLogicalSize() const					{ return m_logicalSize; }
 		float						GetDpi() const							{ return m_effectiveDpi; }
 
+		// Fraction of the output size that is rendered and stretched to fill the panel. The
+		// viewport and the Direct2D DPI follow it; the swap chain buffers keep their size.
+		float						GetResolutionScale() const				{ return m_resolutionScale; }
+
 		// D3D Accessors.
 		ID3D11Device3*				GetD3DDevice() const					{ return m_d3dDevice.Get(); }
 		ID3D11DeviceContext3*		GetD3DDeviceContext() const				{ return m_d3dContext.Get(); }
@@ -58,6 +63,7 @@ namespace DX
 		void CreateDeviceResources();
 		void CreateWindowSizeDependentResources();
 		void UpdateRenderTargetSize();
+		void ApplyResolutionScale();
 
 		// Direct3D objects.
 		Microsoft::WRL::ComPtr<ID3D11Device3>			m_d3dDevice;
@@ -97,6 +103,7 @@ namespace DX
 		float											m_effectiveDpi;
 		float											m_effectiveCompositionScaleX;
 		float											m_effectiveCompositionScaleY;
+		float											m_resolutionScale;
 
 		// Transforms used for display orientation.
 		D2D1::Matrix3x2F	m_orientationTransform2D;
@@ -0,0 +1,143 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+
+namespace DX
+{
+	// Chooses the render resolution scale each frame to hold GPU frame time at a budget.
+	// An incremental PID controller drives a continuous scale from the relative frame-time
+	// error; the applied scale follows it in quantized steps, with a deadband below the
+	// budget, hysteresis between steps and a cooldown after each change, so noise does not
+	// make the resolution flicker. A large overrun skips the cooldown when lowering the scale.
+	class DynamicResolution
+	{
+	public:
+		struct Settings
+		{
+			float		targetMilliseconds;		// GPU time budget per frame
+			float		minScale;
+			float		maxScale;
+			float		step;					// Applied scales are minScale + n * step
+			float		proportionalGain;
+			float		integralGain;
+			float		derivativeGain;
+			float		deadband;				// Relative headroom smaller than this is ignored
+			float		hysteresis;				// Extra fraction of a step needed to change step
+			uint32_t	cooldownFrames;			// Frames to hold a new scale before changing it again
+			float		panicThreshold;			// Relative overrun that lowers the scale immediately
+		};
+
+		// Tuned in simulation against frame-time traces where GPU cost is proportional to the
+		// pixel count, with noise, spikes, sudden load changes and two frames of measurement
+		// latency. On those the proportional and derivative terms only added flicker, so they
+		// default to off.
+		static Settings DefaultSettings(float targetMilliseconds = 14.0f)
+		{
+			Settings settings;
+			settings.targetMilliseconds = targetMilliseconds;
+			settings.minScale = 0.5f;
+			settings.maxScale = 1.0f;
+			settings.step = 0.05f;
+			settings.proportionalGain = 0.0f;
+			settings.integralGain = 0.02f;
+			settings.derivativeGain = 0.0f;
+			settings.deadband = 0.1f;
+			settings.hysteresis = 0.25f;
+			settings.cooldownFrames = 30;
+			settings.panicThreshold = 0.3f;
+			return settings;
+		}
+
+		explicit DynamicResolution(const Settings& settings = DefaultSettings()) :
+			m_settings(settings)
+		{
+			Reset();
+		}
+
+		const Settings& GetSettings() const			{ return m_settings; }
+
+		// The scale to render at, quantized.
+		float GetScale() const						{ return m_scale; }
+
+		// The controller's unquantized output.
+		float GetTargetScale() const				{ return m_targetScale; }
+
+		uint32_t GetChangeCount() const				{ return m_changes; }
+
+		void Reset()
+		{
+			m_scale = m_settings.maxScale;
+			m_targetScale = m_settings.maxScale;
+			m_previousError = 0.0f;
+			m_previousDelta = 0.0f;
+			m_framesSinceChange = m_settings.cooldownFrames;
+			m_changes = 0;
+		}
+
+		// Feeds the measured time of one frame rendered at GetScale() and returns the scale for
+		// the next frame.
+		float Update(float frameMilliseconds)
+		{
+			if (!(frameMilliseconds > 0.0f) || !(m_settings.targetMilliseconds > 0.0f))
+			{
+				return m_scale;
+			}
+
+			// Positive when there is headroom. Cost grows with the pixel count, the square of the
+			// scale, so the error is taken on the square root of the time ratio.
+			float error = std::sqrt(m_settings.targetMilliseconds / frameMilliseconds) - 1.0f;
+			float overrun = frameMilliseconds / m_settings.targetMilliseconds - 1.0f;
+			// Only spare headroom is ignored; any overrun keeps pushing the scale down.
+			if (error > 0.0f && error < m_settings.deadband)
+			{
+				error = 0.0f;
+			}
+
+			float delta = error - m_previousError;
+			float adjustment = m_settings.proportionalGain * delta
+				+ m_settings.integralGain * error
+				+ m_settings.derivativeGain * (delta - m_previousDelta);
+			m_previousError = error;
+			m_previousDelta = delta;
+
+			// Clamping the output is the anti-windup for the incremental form.
+			m_targetScale = std::min<float>(std::max<float>(m_targetScale + adjustment * m_scale, m_settings.minScale), m_settings.maxScale);
+
+			if (m_framesSinceChange < UINT32_MAX)
+			{
+				++m_framesSinceChange;
+			}
+
+			float threshold = m_settings.step * (0.5f + m_settings.hysteresis);
+			bool lower = m_targetScale <= m_scale - threshold;
+			bool raise = m_targetScale >= m_scale + threshold;
+			bool cooledDown = m_framesSinceChange >= m_settings.cooldownFrames;
+			bool panic = overrun > m_settings.panicThreshold;
+
+			if ((lower && (cooledDown || panic)) || (raise && cooledDown))
+			{
+				float steps = std::floor((m_targetScale - m_settings.minScale) / m_settings.step + 0.5f);
+				float scale = std::min<float>(std::max<float>(m_settings.minScale + steps * m_settings.step, m_settings.minScale), m_settings.maxScale);
+				if (scale != m_scale)
+				{
+					m_scale = scale;
+					m_framesSinceChange = 0;
+					++m_changes;
+				}
+			}
+
+			return m_scale;
+		}
+
+	private:
+		Settings	m_settings;
+		float		m_scale;
+		float		m_targetScale;
+		float		m_previousError;
+		float		m_previousDelta;
+		uint32_t	m_framesSinceChange;
+		uint32_t	m_changes;
+	};
+}
@@ -0,0 +1,104 @@
+﻿#pragma once
+
+namespace DX
+{
+	// Measures GPU time between Begin and End with timestamp queries. Results are read back
+	// a few frames later without stalling, so the value returned describes an earlier frame.
+	class GpuTimer
+	{
+	public:
+		// Number of frames that can be in flight before a measurement is dropped.
+		static const UINT QueryLatency = 3;
+
+		GpuTimer() :
+			m_current(0),
+			m_pending()
+		{
+		}
+
+		void CreateDeviceDependentResources(ID3D11Device* device)
+		{
+			D3D11_QUERY_DESC disjointDesc = { D3D11_QUERY_TIMESTAMP_DISJOINT, 0 };
+			D3D11_QUERY_DESC timestampDesc = { D3D11_QUERY_TIMESTAMP, 0 };
+
+			for (UINT i = 0; i < QueryLatency; ++i)
+			{
+				DX::ThrowIfFailed(device->CreateQuery(&disjointDesc, m_disjoint[i].ReleaseAndGetAddressOf()));
+				DX::ThrowIfFailed(device->CreateQuery(&timestampDesc, m_start[i].ReleaseAndGetAddressOf()));
+				DX::ThrowIfFailed(device->CreateQuery(&timestampDesc, m_end[i].ReleaseAndGetAddressOf()));
+				m_pending[i] = false;
+			}
+			m_current = 0;
+		}
+
+		void ReleaseDeviceDependentResources()
+		{
+			for (UINT i = 0; i < QueryLatency; ++i)
+			{
+				m_disjoint[i].Reset();
+				m_start[i].Reset();
+				m_end[i].Reset();
+				m_pending[i] = false;
+			}
+		}
+
+		void Begin(ID3D11DeviceContext* context)
+		{
+			// A measurement nobody read in time is overwritten.
+			m_pending[m_current] = false;
+
+			context->Begin(m_disjoint[m_current].Get());
+			context->End(m_start[m_current].Get());
+		}
+
+		void End(ID3D11DeviceContext* context)
+		{
+			context->End(m_end[m_current].Get());
+			context->End(m_disjoint[m_current].Get());
+
+			m_pending[m_current] = true;
+			m_current = (m_current + 1) % QueryLatency;
+		}
+
+		// Returns true with the oldest outstanding measurement once the GPU has finished it.
+		// Never waits; returns false if it is not ready or the timestamps were unreliable.
+		bool TryGetMilliseconds(ID3D11DeviceContext* context, double& milliseconds)
+		{
+			UINT oldest = m_current;
+			if (!m_pending[oldest])
+			{
+				return false;
+			}
+
+			D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+			if (context->GetData(m_disjoint[oldest].Get(), &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+			{
+				return false;
+			}
+
+			UINT64 start, end;
+			if (context->GetData(m_start[oldest].Get(), &start, sizeof(start), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK ||
+				context->GetData(m_end[oldest].Get(), &end, sizeof(end), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+			{
+				return false;
+			}
+
+			m_pending[oldest] = false;
+
+			if (disjoint.Disjoint || !disjoint.Frequency || end < start)
+			{
+				return false;
+			}
+
+			milliseconds = double(end - start) * 1000.0 / double(disjoint.Frequency);
+			return true;
+		}
+
+	private:
+		Microsoft::WRL::ComPtr<ID3D11Query>	m_disjoint[QueryLatency];
+		Microsoft::WRL::ComPtr<ID3D11Query>	m_start[QueryLatency];
+		Microsoft::WRL::ComPtr<ID3D11Query>	m_end[QueryLatency];
+		UINT								m_current;
+		bool								m_pending[QueryLatency];
+	};
+}
@@ -0,0 +1,98 @@
+﻿#pragma once
+
+#include <atomic>
+#include <stddef.h>
+
+namespace DX
+{
+	// Bounded queue that any number of threads may push to while a single thread pops.
+	// Each slot carries a sequence number: producers claim a slot with one compare-exchange
+	// on the tail and publish it by bumping its sequence, and the consumer never writes
+	// shared state other than handing the slot back. Nothing blocks and nothing allocates.
+	template<typename T, size_t Capacity>
+	class MpscQueue
+	{
+		static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+	public:
+		MpscQueue() :
+			m_tail(0),
+			m_head(0)
+		{
+			for (size_t i = 0; i < Capacity; ++i)
+			{
+				m_cells[i].sequence.store(i, std::memory_order_relaxed);
+			}
+		}
+
+		MpscQueue(MpscQueue const&) = delete;
+		MpscQueue& operator= (MpscQueue const&) = delete;
+
+		// Any thread. Returns false if the queue is full.
+		bool TryPush(const T& item)
+		{
+			Cell* cell;
+			size_t position = m_tail.load(std::memory_order_relaxed);
+			for (;;)
+			{
+				cell = &m_cells[position & (Capacity - 1)];
+				size_t sequence = cell->sequence.load(std::memory_order_acquire);
+				ptrdiff_t difference = static_cast<ptrdiff_t>(sequence - position);
+
+				if (difference == 0)
+				{
+					// The slot is free for this lap; try to claim it.
+					if (m_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+						break;
+				}
+				else if (difference < 0)
+				{
+					// The consumer has not yet released the slot from the previous lap.
+					return false;
+				}
+				else
+				{
+					// Another producer claimed it first.
+					position = m_tail.load(std::memory_order_relaxed);
+				}
+			}
+
+			cell->item = item;
+			cell->sequence.store(position + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Consumer thread only. Returns false if the queue is empty, or if the oldest claimed
+		// slot is still being written; items are always delivered in claim order.
+		bool TryPop(T& item)
+		{
+			Cell& cell = m_cells[m_head & (Capacity - 1)];
+			size_t sequence = cell.sequence.load(std::memory_order_acquire);
+			if (static_cast<ptrdiff_t>(sequence - (m_head + 1)) < 0)
+				return false;
+
+			item = cell.item;
+			cell.sequence.store(m_head + Capacity, std::memory_order_release);
+			++m_head;
+			return true;
+		}
+
+		static size_t GetCapacity() { return Capacity; }
+
+	private:
+		struct Cell
+		{
+			std::atomic<size_t>	sequence;
+			T					item;
+		};
+
+		// Padding keeps the contended producer index off the consumer's cache line.
+		static const size_t c_cacheLine = 64;
+
+		Cell					m_cells[Capacity];
+		char					m_pad0[c_cacheLine];
+		std::atomic<size_t>		m_tail;
+		char					m_pad1[c_cacheLine - sizeof(std::atomic<size_t>)];
+		size_t					m_head;
+	};
+}
@@ -0,0 +1,78 @@
+﻿#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+
+namespace DX
+{
+	// Holds a value that one or more threads update while others read it. Every update
+	// publishes a new immutable copy by swapping a shared_ptr, so a reader gets a consistent
+	// whole value without ever waiting on a writer, and keeps it alive for as long as it
+	// holds the pointer. Writers serialize among themselves only.
+	template<typename T>
+	class Snapshot
+	{
+	public:
+		Snapshot() :
+			m_current(std::make_shared<const T>()),
+			m_version(0)
+		{
+		}
+
+		explicit Snapshot(const T& initial) :
+			m_current(std::make_shared<const T>(initial)),
+			m_version(0)
+		{
+		}
+
+		Snapshot(Snapshot const&) = delete;
+		Snapshot& operator= (Snapshot const&) = delete;
+
+		// Any thread. The returned value never changes; call again to see later updates.
+		std::shared_ptr<const T> Get() const
+		{
+			return std::atomic_load(&m_current);
+		}
+
+		// Any thread. Increases by one with every publish, and is only advanced after the new
+		// value is visible, so a reader that sees a new version will Get at least that value.
+		uint64_t GetVersion() const
+		{
+			return m_version.load(std::memory_order_acquire);
+		}
+
+		// Any thread. Replaces the whole value.
+		void Publish(const T& value)
+		{
+			auto next = std::make_shared<const T>(value);
+
+			std::lock_guard<std::mutex> lock(m_writerMutex);
+			Swap(std::move(next));
+		}
+
+		// Any thread. Calls change(T&) on a copy of the current value and publishes the result.
+		// Concurrent updates to different fields are never lost.
+		template<typename Func>
+		void Update(Func&& change)
+		{
+			std::lock_guard<std::mutex> lock(m_writerMutex);
+
+			auto next = std::make_shared<T>(*std::atomic_load(&m_current));
+			change(*next);
+			Swap(std::move(next));
+		}
+
+	private:
+		void Swap(std::shared_ptr<const T> next)
+		{
+			std::atomic_store(&m_current, std::move(next));
+			m_version.fetch_add(1, std::memory_order_release);
+		}
+
+		std::shared_ptr<const T>	m_current;
+		std::atomic<uint64_t>		m_version;
+		std::mutex					m_writerMutex;
+	};
+}
@@ -26,7 +26,11 @@ using namespace DirectX::SimpleMath;
 using namespace Windows::Foundation;
 
 DirectXTK3DSceneRenderer::DirectXTK3DSceneRenderer(const std::shared_ptr<DX::DeviceResources>& deviceResources) :
-    m_deviceResources(deviceResources)
+    m_deviceResources(deviceResources),
+    m_angle(0.f),
+    m_tracking(false),
+    m_trackingStartX(0.f),
+    m_trackingStartAngle(0.f)
 {
     CreateDeviceDependentResources();
     CreateWindowSizeDependentResources();
@@ -100,7 +104,11 @@ void DirectXTK3DSceneRenderer::Update(DX::StepTimer const& timer)
 
     m_view = Matrix::CreateLookAt(eye, at, Vector3::UnitY);
 
-    m_world = Matrix::CreateRotationY( float(timer.GetTotalSeconds() * XM_PIDIV4) );
+    if (!m_tracking)
+    {
+        m_angle = fmodf(m_angle + float(timer.GetElapsedSeconds() * XM_PIDIV4), XM_2PI);
+    }
+    m_world = Matrix::CreateRotationY(m_angle);
 
     m_batchEffect->SetView(m_view);
     m_batchEffect->SetWorld(Matrix::Identity);
@@ -146,6 +154,31 @@ void DirectXTK3DSceneRenderer::NewAudioDevice()
     }
 }
 
+void DirectXTK3DSceneRenderer::StartTracking(float positionX)
+{
+    m_tracking = true;
+    m_trackingStartX = positionX;
+    m_trackingStartAngle = m_angle;
+}
+
+// A drag across the full width of the window turns the scene around once.
+void DirectXTK3DSceneRenderer::TrackingUpdate(float positionX)
+{
+    if (!m_tracking)
+        return;
+
+    float width = m_deviceResources->GetLogicalSize().Width;
+    if (width > 0.f)
+    {
+        m_angle = m_trackingStartAngle + XM_2PI * (positionX - m_trackingStartX) / width;
+    }
+}
+
+void DirectXTK3DSceneRenderer::StopTracking()
+{
+    m_tracking = false;
+}
+
 void XM_CALLCONV DirectXTK3DSceneRenderer::DrawGrid(FXMVECTOR xAxis, FXMVECTOR yAxis, FXMVECTOR origin, size_t xdivs, size_t ydivs, GXMVECTOR color)
 {
     auto context = m_deviceResources->GetD3DDeviceContext();
@@ -202,8 +235,11 @@ void DirectXTK3DSceneRenderer::Render()
     const XMVECTORF32 yaxis = { 0.f, 0.f, 20.f };
     DrawGrid(xaxis, yaxis, g_XMZero, 20, 20, Colors::Gray);
 
-    // Draw sprite
-    m_sprites->Begin();
+    // Draw sprite. Positions are in full resolution pixels; scaling them with the rendered
+    // region keeps the overlay the same size on screen as the resolution scale changes.
+    float resolutionScale = m_deviceResources->GetResolutionScale();
+    m_sprites->Begin(SpriteSortMode_Deferred, nullptr, nullptr, nullptr, nullptr, nullptr,
+        XMMatrixScaling(resolutionScale, resolutionScale, 1.f));
     m_sprites->Draw(m_texture2.Get(), XMFLOAT2(10, 75), nullptr, Colors::White);
 
     m_font->DrawString(m_sprites.get(), L"DirectXTK Simple Sample", XMFLOAT2(100, 10), Colors::Yellow);
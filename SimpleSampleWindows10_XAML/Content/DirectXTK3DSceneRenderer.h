@@ -32,6 +32,12 @@ namespace SimpleSampleWindows10_XAML
         void Update(DX::StepTimer const& timer);
         void Render();
 
+        // Drags the scene's rotation with a pointer, in DIPs; auto-rotation pauses meanwhile.
+        void StartTracking(float positionX);
+        void TrackingUpdate(float positionX);
+        void StopTracking();
+        bool IsTracking() const { return m_tracking; }
+
         // Signals a new audio device is available
         void NewAudioDevice();
 
@@ -66,6 +72,11 @@ namespace SimpleSampleWindows10_XAML
 
         bool                                                                    m_retryDefault;
 
+        float                                                                   m_angle;
+        bool                                                                    m_tracking;
+        float                                                                   m_trackingStartX;
+        float                                                                   m_trackingStartAngle;
+
         DirectX::SimpleMath::Matrix                                             m_world;
         DirectX::SimpleMath::Matrix                                             m_view;
         DirectX::SimpleMath::Matrix                                             m_projection;
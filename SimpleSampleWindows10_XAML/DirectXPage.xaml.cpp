@@ -58,6 +58,19 @@ DirectXPage::DirectXPage():
 	m_deviceResources = std::make_shared<DX::DeviceResources>();
 	m_deviceResources->SetSwapChainPanel(swapChainPanel);
 
+	// Created before the input worker starts, since pointer handlers forward to it.
+	m_main = std::unique_ptr<SimpleSampleWindows10_XAMLMain>(new SimpleSampleWindows10_XAMLMain(m_deviceResources));
+
+	// Seed the window state with the values SetSwapChainPanel just applied.
+	m_main->UpdateWindowState([this, currentDisplayInformation](WindowState& state)
+	{
+		state.logicalSize = Size(static_cast<float>(swapChainPanel->ActualWidth), static_cast<float>(swapChainPanel->ActualHeight));
+		state.orientation = currentDisplayInformation->CurrentOrientation;
+		state.dpi = currentDisplayInformation->LogicalDpi;
+		state.compositionScaleX = swapChainPanel->CompositionScaleX;
+		state.compositionScaleY = swapChainPanel->CompositionScaleY;
+	});
+
 	// Register our SwapChainPanel to get independent input pointer events
 	auto workItemHandler = ref new WorkItemHandler([this] (IAsyncAction ^)
 	{
@@ -68,6 +81,11 @@ DirectXPage::DirectXPage():
 			Windows::UI::Core::CoreInputDeviceTypes::Pen
 			);
 
+		// Register for pointer events, which will be raised on the background thread.
+		m_coreInput->PointerPressed += ref new TypedEventHandler<Object^, PointerEventArgs^>(this, &DirectXPage::OnPointerPressed);
+		m_coreInput->PointerMoved += ref new TypedEventHandler<Object^, PointerEventArgs^>(this, &DirectXPage::OnPointerMoved);
+		m_coreInput->PointerReleased += ref new TypedEventHandler<Object^, PointerEventArgs^>(this, &DirectXPage::OnPointerReleased);
+
 		// Begin processing input messages as they're delivered.
 		m_coreInput->Dispatcher->ProcessEvents(CoreProcessEventsOption::ProcessUntilQuit);
 	});
@@ -75,7 +93,6 @@ DirectXPage::DirectXPage():
 	// Run task on a dedicated high priority background thread.
 	m_inputLoopWorker = ThreadPool::RunAsync(workItemHandler, WorkItemPriority::High, WorkItemOptions::TimeSliced);
 
-	m_main = std::unique_ptr<SimpleSampleWindows10_XAMLMain>(new SimpleSampleWindows10_XAMLMain(m_deviceResources));
 	m_main->StartRenderLoop();
 }
 
@@ -89,12 +106,12 @@ DirectXPage::~DirectXPage()
 // Saves the current state of the app for suspend and terminate events.
 void DirectXPage::SaveInternalState(IPropertySet^ state)
 {
-	critical_section::scoped_lock lock(m_main->GetCriticalSection());
-	m_deviceResources->Trim();
-
-	// Stop rendering when the app is suspended.
+	// Stop rendering when the app is suspended. This waits for the current frame, after which
+	// the device is not in use by the render thread.
 	m_main->StopRenderLoop();
 
+	m_deviceResources->Trim();
+
 	// Put code to save app state here.
 }
 
@@ -122,30 +139,53 @@ void DirectXPage::OnVisibilityChanged(CoreWindow^ sender, VisibilityChangedEvent
 	}
 }
 
-// DisplayInformation event handlers.
+// DisplayInformation event handlers. These only record the change; the render thread applies
+// it to DeviceResources before its next frame, so the UI thread never waits on rendering.
 
 void DirectXPage::OnDpiChanged(DisplayInformation^ sender, Object^ args)
 {
-	critical_section::scoped_lock lock(m_main->GetCriticalSection());
-	// Note: The value for LogicalDpi retrieved here may not match the effective DPI of the app
-	// if it is being scaled for high resolution devices. Once the DPI is set on DeviceResources,
-	// you should always retrieve it using the GetDpi method.
-	// See DeviceResources.cpp for more details.
-	m_deviceResources->SetDpi(sender->LogicalDpi);
-	m_main->CreateWindowSizeDependentResources();
+	float dpi = sender->LogicalDpi;
+	m_main->UpdateWindowState([dpi](WindowState& state) { state.dpi = dpi; });
 }
 
 void DirectXPage::OnOrientationChanged(DisplayInformation^ sender, Object^ args)
 {
-	critical_section::scoped_lock lock(m_main->GetCriticalSection());
-	m_deviceResources->SetCurrentOrientation(sender->CurrentOrientation);
-	m_main->CreateWindowSizeDependentResources();
+	DisplayOrientations orientation = sender->CurrentOrientation;
+	m_main->UpdateWindowState([orientation](WindowState& state) { state.orientation = orientation; });
 }
 
 void DirectXPage::OnDisplayContentsInvalidated(DisplayInformation^ sender, Object^ args)
 {
-	critical_section::scoped_lock lock(m_main->GetCriticalSection());
-	m_deviceResources->ValidateDevice();
+	m_main->RequestValidateDevice();
+}
+
+// Pointer events are queued rather than applied directly, so the input thread never waits
+// for a frame to finish.
+
+void DirectXPage::OnPointerPressed(Object^ sender, PointerEventArgs^ e)
+{
+	QueuePointerInput(PointerInput::Pressed, e->CurrentPoint);
+}
+
+void DirectXPage::OnPointerMoved(Object^ sender, PointerEventArgs^ e)
+{
+	QueuePointerInput(PointerInput::Moved, e->CurrentPoint);
+}
+
+void DirectXPage::OnPointerReleased(Object^ sender, PointerEventArgs^ e)
+{
+	QueuePointerInput(PointerInput::Released, e->CurrentPoint);
+}
+
+void DirectXPage::QueuePointerInput(PointerInput::Kind kind, PointerPoint^ point)
+{
+	PointerInput input;
+	input.kind = kind;
+	input.pointerId = point->PointerId;
+	input.x = point->Position.X;
+	input.y = point->Position.Y;
+
+	m_main->QueuePointerInput(input);
 }
 
 // Called when the app bar button is clicked.
@@ -157,14 +197,17 @@ void DirectXPage::AppBarButton_Click(Object^ sender, RoutedEventArgs^ e)
 
 void DirectXPage::OnCompositionScaleChanged(SwapChainPanel^ sender, Object^ args)
 {
-	critical_section::scoped_lock lock(m_main->GetCriticalSection());
-	m_deviceResources->SetCompositionScale(sender->CompositionScaleX, sender->CompositionScaleY);
-	m_main->CreateWindowSizeDependentResources();
+	float scaleX = sender->CompositionScaleX;
+	float scaleY = sender->CompositionScaleY;
+	m_main->UpdateWindowState([scaleX, scaleY](WindowState& state)
+	{
+		state.compositionScaleX = scaleX;
+		state.compositionScaleY = scaleY;
+	});
 }
 
 void DirectXPage::OnSwapChainPanelSizeChanged(Object^ sender, SizeChangedEventArgs^ e)
 {
-	critical_section::scoped_lock lock(m_main->GetCriticalSection());
-	m_deviceResources->SetLogicalSize(e->NewSize);
-	m_main->CreateWindowSizeDependentResources();
+	Size size = e->NewSize;
+	m_main->UpdateWindowState([size](WindowState& state) { state.logicalSize = size; });
 }
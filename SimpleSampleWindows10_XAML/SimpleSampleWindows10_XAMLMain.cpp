@@ -9,7 +9,7 @@ using namespace Concurrency;
 
 // Loads and initializes application assets when the application is loaded.
 SimpleSampleWindows10_XAMLMain::SimpleSampleWindows10_XAMLMain(const std::shared_ptr<DX::DeviceResources>& deviceResources) :
-	m_deviceResources(deviceResources), m_pointerLocationX(0.0f)
+	m_deviceResources(deviceResources), m_appliedWindowStateVersion(0), m_validateDeviceRequested(false), m_droppedPointerInputs(0), m_reportedDroppedPointerInputs(0), m_trackingPointerId(0)
 {
 	// Register to be notified if the Device is lost or recreated
 	m_deviceResources->RegisterDeviceNotify(this);
@@ -17,6 +17,8 @@ SimpleSampleWindows10_XAMLMain::SimpleSampleWindows10_XAMLMain(const std::shared
 	// TODO: Replace this with your app's content initialization.
     m_sceneRenderer = std::unique_ptr<DirectXTK3DSceneRenderer>(new DirectXTK3DSceneRenderer(m_deviceResources));
 
+	m_gpuTimer.CreateDeviceDependentResources(m_deviceResources->GetD3DDevice());
+
 	// TODO: Change the timer settings if you want something other than the default variable timestep mode.
 	// e.g. for 60 FPS fixed timestep update logic, call:
 	/*
@@ -52,7 +54,15 @@ void SimpleSampleWindows10_XAMLMain::StartRenderLoop()
 		// Calculate the updated frame and render once per vertical blanking interval.
 		while (action->Status == AsyncStatus::Started)
 		{
-			critical_section::scoped_lock lock(m_criticalSection);
+			critical_section::scoped_lock lock(m_frameLock);
+
+			// Re-check under the lock so no frame starts after StopRenderLoop returns.
+			if (action->Status != AsyncStatus::Started)
+			{
+				break;
+			}
+
+			ApplyWindowState();
 			Update();
 			if (Render())
 			{
@@ -65,14 +75,104 @@ void SimpleSampleWindows10_XAMLMain::StartRenderLoop()
 	m_renderLoopWorker = ThreadPool::RunAsync(workItemHandler, WorkItemPriority::High, WorkItemOptions::TimeSliced);
 }
 
+// Returns once any frame in progress has finished, so device resources may be used freely.
 void SimpleSampleWindows10_XAMLMain::StopRenderLoop()
 {
+	if (m_renderLoopWorker == nullptr)
+	{
+		return;
+	}
+
 	m_renderLoopWorker->Cancel();
+
+	critical_section::scoped_lock lock(m_frameLock);
+}
+
+bool SimpleSampleWindows10_XAMLMain::QueuePointerInput(const PointerInput& input)
+{
+	if (!m_pointerQueue.TryPush(input))
+	{
+		m_droppedPointerInputs.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+	return true;
+}
+
+// Brings DeviceResources up to date with the latest window state from the UI thread.
+// Runs on the render thread; costs one atomic load when nothing has changed.
+void SimpleSampleWindows10_XAMLMain::ApplyWindowState()
+{
+	if (m_validateDeviceRequested.exchange(false, std::memory_order_acquire))
+	{
+		m_deviceResources->ValidateDevice();
+	}
+
+	uint64_t version = m_windowState.GetVersion();
+	if (version == m_appliedWindowStateVersion)
+	{
+		return;
+	}
+	m_appliedWindowStateVersion = version;
+
+	// Each setter ignores values that have not changed.
+	auto state = m_windowState.Get();
+	m_deviceResources->SetLogicalSize(state->logicalSize);
+	m_deviceResources->SetCurrentOrientation(state->orientation);
+	m_deviceResources->SetCompositionScale(state->compositionScaleX, state->compositionScaleY);
+
+	// Note: The value for LogicalDpi may not match the effective DPI of the app if it is being
+	// scaled for high resolution devices. Once the DPI is set on DeviceResources, you should
+	// always retrieve it using the GetDpi method. See DeviceResources.cpp for more details.
+	m_deviceResources->SetDpi(state->dpi);
+
+	CreateWindowSizeDependentResources();
 }
 
 // Updates the application state once per frame.
 void SimpleSampleWindows10_XAMLMain::Update() 
 {
+	// Apply pointer input queued since the last frame, in arrival order. Only the pointer
+	// that started a drag can move or end it; if its release was dropped, pressing it
+	// again starts over.
+	PointerInput input;
+	while (m_pointerQueue.TryPop(input))
+	{
+		switch (input.kind)
+		{
+		case PointerInput::Pressed:
+			if (!m_sceneRenderer->IsTracking() || input.pointerId == m_trackingPointerId)
+			{
+				m_trackingPointerId = input.pointerId;
+				m_sceneRenderer->StartTracking(input.x);
+			}
+			break;
+
+		case PointerInput::Moved:
+			if (input.pointerId == m_trackingPointerId)
+			{
+				m_sceneRenderer->TrackingUpdate(input.x);
+			}
+			break;
+
+		case PointerInput::Released:
+			if (input.pointerId == m_trackingPointerId)
+			{
+				m_sceneRenderer->StopTracking();
+			}
+			break;
+		}
+	}
+
+	// A full queue drops events rather than stalling the input thread; say so when it happens.
+	uint32_t dropped = m_droppedPointerInputs.load(std::memory_order_relaxed);
+	if (dropped != m_reportedDroppedPointerInputs)
+	{
+		wchar_t message[96];
+		swprintf_s(message, L"Pointer queue full: %u input event(s) dropped so far\n", dropped);
+		OutputDebugStringW(message);
+		m_reportedDroppedPointerInputs = dropped;
+	}
+
 	// Update scene objects.
 	m_timer.Tick([&]()
 	{
@@ -93,7 +193,18 @@ bool SimpleSampleWindows10_XAMLMain::Render()
 
 	auto context = m_deviceResources->GetD3DDeviceContext();
 
-	// Reset the viewport to target the whole screen.
+	// Pick the resolution for this frame from the GPU time of a frame that has finished. The
+	// CPU frame time is no use here as it is held at the refresh rate by Present.
+	double gpuMilliseconds;
+	if (m_gpuTimer.TryGetMilliseconds(context, gpuMilliseconds))
+	{
+		float scale = m_dynamicResolution.Update(static_cast<float>(gpuMilliseconds));
+		m_deviceResources->SetResolutionScale(scale);
+	}
+
+	m_gpuTimer.Begin(context);
+
+	// Reset the viewport to target the rendered region of the screen.
 	auto viewport = m_deviceResources->GetScreenViewport();
 	context->RSSetViewports(1, &viewport);
 
@@ -109,6 +220,8 @@ bool SimpleSampleWindows10_XAMLMain::Render()
 	// TODO: Replace this with your app's content rendering functions.
     m_sceneRenderer->Render();
 
+	m_gpuTimer.End(context);
+
 	return true;
 }
 
@@ -116,11 +229,15 @@ bool SimpleSampleWindows10_XAMLMain::Render()
 void SimpleSampleWindows10_XAMLMain::OnDeviceLost()
 {
     m_sceneRenderer->ReleaseDeviceDependentResources();
+	m_gpuTimer.ReleaseDeviceDependentResources();
 }
 
 // Notifies renderers that device resources may now be recreated.
 void SimpleSampleWindows10_XAMLMain::OnDeviceRestored()
 {
     m_sceneRenderer->CreateDeviceDependentResources();
+	m_gpuTimer.CreateDeviceDependentResources(m_deviceResources->GetD3DDevice());
+	m_dynamicResolution.Reset();
+	m_deviceResources->SetResolutionScale(m_dynamicResolution.GetScale());
     CreateWindowSizeDependentResources();
 }
@@ -2,11 +2,51 @@
 
 #include "Common\StepTimer.h"
 #include "Common\DeviceResources.h"
+#include "Common\DynamicResolution.h"
+#include "Common\GpuTimer.h"
+#include "Common\MpscQueue.h"
+#include "Common\Snapshot.h"
 #include "Content\DirectXTK3DSceneRenderer.h"
 
 // Renders Direct2D and 3D content on the screen.
 namespace SimpleSampleWindows10_XAML
 {
+	// A pointer event captured on the input thread, in DIPs.
+	struct PointerInput
+	{
+		enum Kind
+		{
+			Pressed,
+			Moved,
+			Released,
+		};
+
+		Kind		kind;
+		uint32_t	pointerId;
+		float		x;
+		float		y;
+	};
+
+	// Window properties reported by the UI thread. Published as a whole to the render thread,
+	// which applies whatever changed to DeviceResources at the start of the next frame.
+	struct WindowState
+	{
+		WindowState() :
+			logicalSize(0.0f, 0.0f),
+			orientation(Windows::Graphics::Display::DisplayOrientations::None),
+			dpi(-1.0f),
+			compositionScaleX(1.0f),
+			compositionScaleY(1.0f)
+		{
+		}
+
+		Windows::Foundation::Size							logicalSize;
+		Windows::Graphics::Display::DisplayOrientations		orientation;
+		float												dpi;		// LogicalDpi, not the effective DPI
+		float												compositionScaleX;
+		float												compositionScaleY;
+	};
+
 	class SimpleSampleWindows10_XAMLMain : public DX::IDeviceNotify
 	{
 	public:
@@ -15,13 +55,23 @@ namespace SimpleSampleWindows10_XAML
 		void CreateWindowSizeDependentResources();
         void StartRenderLoop();
 		void StopRenderLoop();
-		Concurrency::critical_section& GetCriticalSection() { return m_criticalSection; }
+
+		// Safe to call from any thread; nothing waits for the render thread. Changes are
+		// applied at the start of the next frame, coalescing any that arrive in between.
+		template<typename Func>
+		void UpdateWindowState(Func&& change) { m_windowState.Update(std::forward<Func>(change)); }
+		void RequestValidateDevice() { m_validateDeviceRequested.store(true, std::memory_order_release); }
+
+		// Safe to call from any thread without the critical section. Input is applied at the
+		// start of the next Update. Returns false if the queue was full and the event dropped.
+		bool QueuePointerInput(const PointerInput& input);
 
 		// IDeviceNotify
 		virtual void OnDeviceLost();
 		virtual void OnDeviceRestored();
 
 	private:
+		void ApplyWindowState();
 		void Update();
 		bool Render();
 
@@ -32,12 +82,29 @@ namespace SimpleSampleWindows10_XAML
         std::unique_ptr<DirectXTK3DSceneRenderer> m_sceneRenderer;
 
 		Windows::Foundation::IAsyncAction^ m_renderLoopWorker;
-		Concurrency::critical_section m_criticalSection;
+
+		// Held by the render thread for each frame. Other threads take it only to wait out the
+		// frame in flight when stopping the loop, so it is never contended while rendering.
+		Concurrency::critical_section m_frameLock;
+
+		// Shared with the UI thread without locking.
+		DX::Snapshot<WindowState> m_windowState;
+		uint64_t m_appliedWindowStateVersion;
+		std::atomic<bool> m_validateDeviceRequested;
 
 		// Rendering loop timer.
 		DX::StepTimer m_timer;
 
-		// Track current input pointer position.
-		float m_pointerLocationX;
+		// Scales the rendered resolution to keep GPU frame time under budget.
+		DX::GpuTimer m_gpuTimer;
+		DX::DynamicResolution m_dynamicResolution;
+
+		// Pointer events waiting for the render thread.
+		DX::MpscQueue<PointerInput, 1024> m_pointerQueue;
+		std::atomic<uint32_t> m_droppedPointerInputs;
+		uint32_t m_reportedDroppedPointerInputs;
+
+		// The pointer that last started dragging the scene.
+		uint32_t m_trackingPointerId;
 	};
 }
\ No newline at end of file